@@ -4,156 +4,170 @@
 // 12-1-2022
 
 #include "animation.h"
+
+#include <algorithm>
 #include "main.h"
 
+MatrixCounters matrixCounters;
+
 //
-// VEC3 OVERLOADS
+// StaticModel
 //
 
-// Vec3 is a cheap copy, so we'll return it by value in overloads
-
-Vec3 Vec3::operator+(const Vec3& rhs) const
+const mat4& StaticModel::worldMatrix() const
 {
-	Vec3 result;
-	result.x = x + rhs.x;
-	result.y = y + rhs.y;
-	result.z = z + rhs.z;
-	return result;
-}
+	if (!worldDirty_)
+	{
+		matrixCounters.clean.fetch_add(1, std::memory_order_relaxed);
+		return world_;
+	}
 
-Vec3 Vec3::operator-(const Vec3& rhs) const
-{
-	Vec3 result;
-	result.x = x - rhs.x;
-	result.y = y - rhs.y;
-	result.z = z - rhs.z;
-	return result;
+	world_ = mat4::translation(pos_.x, pos_.y, pos_.z);
+	world_.rotate(rot_.x, 1, 0, 0);
+	world_.rotate(rot_.y, 0, 1, 0);
+	world_.rotate(rot_.z, 0, 0, 1);
+	world_.scale(scale_.x, scale_.y, scale_.z);
+	worldDirty_ = false;
+	matrixCounters.dirty.fetch_add(1, std::memory_order_relaxed);
+	return world_;
 }
 
-Vec3 Vec3::operator*(const Vec3& rhs) const
+const mat4& StaticModel::inverseWorldMatrix() const
 {
-	Vec3 result;
-	result.x = x * rhs.x;
-	result.y = y * rhs.y;
-	result.z = z * rhs.z;
-	return result;
+	if (inverseDirty_)
+	{
+		inverseWorld_ = worldMatrix().affineInverse();
+		inverseDirty_ = false;
+	}
+	return inverseWorld_;
 }
 
-Vec3 Vec3::operator/(const Vec3& rhs) const
+void StaticModel::draw(GLuint* textureIDs) const
 {
-	Vec3 result;
-	result.x = x / rhs.x;
-	result.y = y / rhs.y;
-	result.z = z / rhs.z;
-	return result;
+	// Only ever drawn from the render thread, so the scratch list can be shared
+	static std::vector<ScenePart> parts;
+	parts.clear();
+	collectParts(parts);
+	drawParts(parts, textureIDs, wireframe_);
 }
 
-Vec3 Vec3::operator*(const float scalar) const
+//
+// Tree : StaticModel
+//
+
+// Adds a cube of the given texture, moved and scaled relative to the model
+static void addCube(std::vector<ScenePart>& parts, const mat4& model, const int texture, const float3& offset, const float3& size)
 {
-	Vec3 result;
-	result.x = x * scalar;
-	result.y = y * scalar;
-	result.z = z * scalar;
-	return result;
+	ScenePart part = { Primitive::CUBE, texture, 1.0f, model };
+	part.transform.translate(offset.x, offset.y, offset.z);
+	part.transform.scale(size.x, size.y, size.z);
+	parts.push_back(part);
 }
 
-Vec3 Vec3::operator/(const float scalar) const
+void Tree::collectParts(std::vector<ScenePart>& parts) const
 {
-	Vec3 result;
-	result.x = x / scalar;
-	result.y = y / scalar;
-	result.z = z / scalar;
-	return result;
+	const mat4& model = worldMatrix();
+
+	// The trunk
+	addCube(parts, model, TEXTURE_OAK_LOG, { 0, 1.2f, 0 }, { 2, 4.5f, 2 });
+
+	// The leaves
+	addCube(parts, model, TEXTURE_OAK_LEAVES, { 0, 4.5f, 0 }, { 10.0f, 2.0f, 10.0f });
+	addCube(parts, model, TEXTURE_OAK_LEAVES, { 0, 6.5f, 0 }, { 6.0f, 2.0f, 6.0f });
+	addCube(parts, model, TEXTURE_OAK_LEAVES, { 0, 8.5f, 0 }, { 2.0f, 2.0f, 6.0f });
+	addCube(parts, model, TEXTURE_OAK_LEAVES, { 2.0f, 8.5f, 0 }, { 2.0f, 2.0f, 2.0f });
+	addCube(parts, model, TEXTURE_OAK_LEAVES, { -2.0f, 8.5f, 0 }, { 2.0f, 2.0f, 2.0f });
 }
 
 //
-// StaticModel
+// DynamicModel
 //
 
-void StaticModel::setTransform() const
+void DynamicModel::draw() const
 {
-	glTranslatef(pos_.x, pos_.y, pos_.z);
-	glRotatef(rot_.x, 1, 0, 0);
-	glRotatef(rot_.y, 0, 1, 0);
-	glRotatef(rot_.z, 0, 0, 1);
-	glScalef(scale_.x, scale_.y, scale_.z);
-}
+	// Only ever drawn from the render thread, so the scratch list can be shared
+	static std::vector<ScenePart> parts;
+	parts.clear();
+	collectParts(parts);
 
-//
-// Tree : StaticModel
-//
+	glColor3f(1, 1, 1); // Color suitable for texturing
+	drawParts(parts, nullptr, wireframe_);
+}
 
-void Tree::draw(GLuint* textureIDs) const
+DynamicModel::DynamicModel(const float3& pos, const float3& rot, const float3& scale)
 {
-	// Start a new matrix
-	glPushMatrix();
+	pos_ = pos;
+	rot_ = quat::fromEuler(rot);
+	scale_ = scale;
+}
 
-	// Set transform
-	setTransform();
+void DynamicModel::savePose()
+{
+	savedJoints_ = joints_;
+	savedPos_ = pos_;
+	savedRot_ = rot_;
+	worldDirty_ = inverseDirty_ = true;
+}
 
-	// Draw the trunk
-	if (textureIDs != nullptr)
+const mat4& DynamicModel::worldMatrix(const float blend) const
+{
+	if (!worldDirty_ && blend == worldBlend_)
 	{
-		glBindTexture(GL_TEXTURE_2D, textureIDs[0]);
+		matrixCounters.clean.fetch_add(1, std::memory_order_relaxed);
+		return world_;
 	}
-	glPushMatrix();
-	glTranslatef(0, 1.2f, 0);
-	glScalef(2, 4.5f, 2);
-	wireframe_? glutWireCube(1) : solidCube(1);
-	glPopMatrix();
 
-	// Draw the leaves
-	if (textureIDs != nullptr)
+	world_ = buildWorldMatrix(blend);
+	worldBlend_ = blend;
+	worldDirty_ = false;
+	matrixCounters.dirty.fetch_add(1, std::memory_order_relaxed);
+	return world_;
+}
+
+const mat4& DynamicModel::inverseWorldMatrix(const float blend) const
+{
+	if (inverseDirty_ || blend != inverseBlend_)
 	{
-		glBindTexture(GL_TEXTURE_2D, textureIDs[1]);
+		inverseWorld_ = worldMatrix(blend).affineInverse();
+		inverseBlend_ = blend;
+		inverseDirty_ = false;
 	}
-	glPushMatrix();
-	glTranslatef(0, 4.5f, 0);
-	glScalef(10.0f, 2.0f, 10.0f);
-	wireframe_ ? glutWireCube(1) : solidCube(1);
-	glPopMatrix();
-
-	glPushMatrix();
-	glTranslatef(0, 6.5f, 0);
-	glScalef(6.0f, 2.0f, 6.0f);
-	wireframe_ ? glutWireCube(1) : solidCube(1);
-	glPopMatrix();
-
-	glPushMatrix();
-	glTranslatef(0, 8.5f, 0);
-	glScalef(2.0f, 2.0f, 6.0f);
-	wireframe_ ? glutWireCube(1) : solidCube(1);
-	glPopMatrix();
+	return inverseWorld_;
+}
 
-	glPushMatrix();
-	glTranslatef(2.0f, 8.5f, 0);
-	glScalef(2.0f, 2.0f, 2.0f);
-	wireframe_ ? glutWireCube(1) : solidCube(1);
-	glPopMatrix();
+mat4 DynamicModel::buildWorldMatrix(const float blend) const
+{
+	const float3 pos = blendedPos(blend);
 
-	glPushMatrix();
-	glTranslatef(-2.0f, 8.5f, 0);
-	glScalef(2.0f, 2.0f, 2.0f);
-	wireframe_ ? glutWireCube(1) : solidCube(1);
-	glPopMatrix();
+	mat4 result = mat4::translation(pos.x, pos.y, pos.z) * blendedRot(blend).matrix();
+	result.scale(scale_.x, scale_.y, scale_.z);
+	return result;
+}
 
-	// Pop the used matrix
-	glPopMatrix();
+float3 DynamicModel::blendedPos(const float blend) const
+{
+	return savedPos_ + (pos_ - savedPos_) * blend;
 }
 
-//
-// DynamicModel
-//
+quat DynamicModel::blendedRot(const float blend) const
+{
+	return nlerp(savedRot_, rot_, blend);
+}
 
-DynamicModel::DynamicModel(const struct Vec3& pos, const struct Vec3& rot, const struct Vec3& scale)
+float DynamicModel::blendedJointRot(const std::string& joint, const float blend) const
 {
-	pos_ = pos;
-	rot_ = rot;
-	scale_ = scale;
+	const float current = joints_.at(joint);
+	std::unordered_map<std::string, float>::const_iterator saved = savedJoints_.find(joint);
+	if (saved == savedJoints_.end())
+	{
+		return current;
+	}
+	return saved->second + (current - saved->second) * blend;
 }
 
-void DynamicModel::translate(const Vec3& pos, const bool delta)
+void DynamicModel::translate(const float3& pos, const bool delta)
 {
+	worldDirty_ = inverseDirty_ = true;
 	if (delta)
 	{
 		pos_ = pos_ + pos;
@@ -164,20 +178,22 @@ void DynamicModel::translate(const Vec3& pos, const bool delta)
 	}
 }
 
-void DynamicModel::rotate(const Vec3& rot, const bool delta)
+void DynamicModel::rotate(const float3& rot, const bool delta)
 {
+	worldDirty_ = inverseDirty_ = true;
 	if (delta)
 	{
-		rot_ = rot_ + rot;
+		rot_ = rot_ * quat::fromEuler(rot);
 	}
 	else
 	{
-		rot_ = rot;
+		rot_ = quat::fromEuler(rot);
 	}
 }
 
-void DynamicModel::scale(const Vec3& scale, const bool delta)
+void DynamicModel::scale(const float3& scale, const bool delta)
 {
+	worldDirty_ = inverseDirty_ = true;
 	if (delta)
 	{
 		scale_ = scale_ * scale;
@@ -188,6 +204,14 @@ void DynamicModel::scale(const Vec3& scale, const bool delta)
 	}
 }
 
+void DynamicModel::setPose(const float3& pos, const quat& rot, const float3& scale)
+{
+	worldDirty_ = inverseDirty_ = true;
+	pos_ = pos;
+	rot_ = rot;
+	scale_ = scale;
+}
+
 //
 // Robot : DynamicModel
 //
@@ -205,126 +229,60 @@ Robot::Robot()
 	joints_["right knee"] = 0;
 }
 
-void Robot::draw() const
+// Adds an upper and lower limb hanging from a joint. The upper limb rotates
+// about the first joint, and the lower limb about the second one.
+static void addLimb
+(
+	std::vector<ScenePart>& parts,
+	const mat4& model,
+	const float3& joint,
+	const float upperOffsetX,
+	const float upperOffsetY,
+	const float upperRot,
+	const float lowerRot
+)
+{
+	// Upper limb
+	mat4 limb = model;
+	limb.translate(joint.x, joint.y, joint.z); // Move center to point of rotation
+	limb.rotate(upperRot, 1, 0, 0); // Rotate joint
+	limb.translate(upperOffsetX, upperOffsetY, 0); // Move into position
+	addCube(parts, limb, TEXTURE_METAL, { 0, 0, 0 }, { 0.4f, 0.85f, 0.4f });
+
+	// Lower limb
+	limb.translate(0, -0.5f, 0); // Move center to point of rotation
+	limb.rotate(lowerRot, 1, 0, 0); // Rotate joint
+	limb.translate(0, -0.35f, 0); // Move into position
+	addCube(parts, limb, TEXTURE_METAL, { 0, 0, 0 }, { 0.4f, 0.85f, 0.4f });
+}
+
+mat4 Robot::buildWorldMatrix(const float blend) const
 {
-	// Init
-	glPushMatrix();
+	const float3 pos = blendedPos(blend);
 
 	// Set up rotation and translation
-	glTranslatef(0, 2.5f, 0);	// Move center to point of rotation
-	glRotatef(rot_.x, 1, 0, 0);	// Rotate
-	glRotatef(rot_.y, 0, 1, 0);
-	glRotatef(rot_.z, 0, 0, 1);
-	glTranslatef(pos_.x, pos_.y - 2.5f, pos_.z); // Translate to actual position
-	glColor3f(1, 1, 1); // Color suitable for texturing
+	mat4 model = mat4::translation(0, 2.5f, 0);	// Move center to point of rotation
+	model = model * blendedRot(blend).matrix();	// Rotate
+	model.translate(pos.x, pos.y - 2.5f, pos.z); // Translate to actual position
+	return model;
+}
+
+void Robot::collectParts(std::vector<ScenePart>& parts, const float frameBlend) const
+{
+	const float blend = spanBlend(frameBlend);
+	const mat4& model = worldMatrix(blend);
 
-	// Draw the head
-	glPushMatrix();
-	glTranslatef(0, 3.65, 0);
-	wireframe_ ? glutWireCube(0.8f) : solidCube(0.8f);
-	glPopMatrix();
-
-	// Draw the body
-	glPushMatrix();
-	glTranslatef(0, 2.5, 0);
-	glScalef(1, 1.5, 0.6f);
-	wireframe_ ? glutWireCube(1) : solidCube(1);
-	glPopMatrix();
-
-	// Draw the left arm
-	glPushMatrix();
-	// Upper arm
-	glTranslatef(0.35, 3.1, 0); // Move center to point of rotation
-	glRotatef(getJointRot("left shoulder"), 1, 0, 0); // Rotate joint
-	glTranslatef(0.35, -0.25, 0); // Move into position
-	// Scale and draw
-	glPushMatrix();
-	glScalef(0.4, 0.85, 0.4);
-	wireframe_ ? glutWireCube(1) : solidCube(1);
-	glPopMatrix();
-	// Lower arm
-	glTranslatef(0, -0.5, 0); // Move center to point of rotation
-	glRotatef(getJointRot("left elbow"), 1, 0, 0); // Rotate joint
-	glTranslatef(0, -0.35, 0); // Move into position
-	glPushMatrix();
-	// Scale and draw
-	glScalef(0.4, 0.85, 0.4);
-	wireframe_ ? glutWireCube(1) : solidCube(1);
-	glPopMatrix();
-	// Pop matrix
-	glPopMatrix();
-
-	// Draw the right arm
-	glPushMatrix();
-	// Upper arm
-	glTranslatef(-0.35, 3.1, 0); // Move center to point of rotation
-	glRotatef(getJointRot("right shoulder"), 1, 0, 0); // Rotate joint
-	glTranslatef(-0.35, -0.25, 0); // Move into position
-	// Scale and draw
-	glPushMatrix();
-	glScalef(0.4, 0.85, 0.4);
-	wireframe_ ? glutWireCube(1) : solidCube(1);
-	glPopMatrix();
-	// Lower arm
-	glTranslatef(0, -0.5, 0); // Move center to point of rotation
-	glRotatef(getJointRot("right elbow"), 1, 0, 0); // Rotate joint
-	glTranslatef(0, -0.35, 0); // Move into position
-	glPushMatrix();
-	// Scale and draw
-	glScalef(0.4, 0.85, 0.4);
-	wireframe_ ? glutWireCube(1) : solidCube(1);
-	glPopMatrix();
-	// Pop matrix
-	glPopMatrix();
-
-	// Draw the left leg
-	glPushMatrix();
-	// Thigh
-	glTranslatef(0.3, 1.75, 0); // Move center to point of rotation
-	glRotatef(getJointRot("left hip"), 1, 0, 0); // Rotate joint
-	glTranslatef(0, -0.4, 0); // Move into position
-	// Scale and draw
-	glPushMatrix();
-	glScalef(0.4, 0.85, 0.4);
-	wireframe_ ? glutWireCube(1) : solidCube(1);
-	glPopMatrix();
-	// Knee
-	glTranslatef(0, -0.5, 0); // Move center to point of rotation
-	glRotatef(getJointRot("left knee"), 1, 0, 0); // Rotate joint
-	glTranslatef(0, -0.35, 0); // Move into position
-	glPushMatrix();
-	// Scale and draw
-	glScalef(0.4, 0.85, 0.4);
-	wireframe_ ? glutWireCube(1) : solidCube(1);
-	glPopMatrix();
-	// Pop matrix
-	glPopMatrix();
-
-	// Draw the right leg
-	glPushMatrix();
-	// Thigh
-	glTranslatef(-0.3, 1.75, 0); // Move center to point of rotation
-	glRotatef(getJointRot("right hip"), 1, 0, 0); // Rotate joint
-	glTranslatef(0, -0.4, 0); // Move into position
-	// Scale and draw
-	glPushMatrix();
-	glScalef(0.4, 0.85, 0.4);
-	wireframe_ ? glutWireCube(1) : solidCube(1);
-	glPopMatrix();
-	// Knee
-	glTranslatef(0, -0.5, 0); // Move center to point of rotation
-	glRotatef(getJointRot("right knee"), 1, 0, 0); // Rotate joint
-	glTranslatef(0, -0.35, 0); // Move into position
-	glPushMatrix();
-	// Scale and draw
-	glScalef(0.4, 0.85, 0.4);
-	wireframe_ ? glutWireCube(1) : solidCube(1);
-	glPopMatrix();
-	// Pop matrix
-	glPopMatrix();
-
-	// Pop initial translation matrix
-	glPopMatrix();
+	// Head and body
+	addCube(parts, model, TEXTURE_METAL, { 0, 3.65f, 0 }, { 0.8f, 0.8f, 0.8f });
+	addCube(parts, model, TEXTURE_METAL, { 0, 2.5f, 0 }, { 1, 1.5f, 0.6f });
+
+	// Arms
+	addLimb(parts, model, { 0.35f, 3.1f, 0 }, 0.35f, -0.25f, blendedJointRot("left shoulder", blend), blendedJointRot("left elbow", blend));
+	addLimb(parts, model, { -0.35f, 3.1f, 0 }, -0.35f, -0.25f, blendedJointRot("right shoulder", blend), blendedJointRot("right elbow", blend));
+
+	// Legs
+	addLimb(parts, model, { 0.3f, 1.75f, 0 }, 0, -0.4f, blendedJointRot("left hip", blend), blendedJointRot("left knee", blend));
+	addLimb(parts, model, { -0.3f, 1.75f, 0 }, 0, -0.4f, blendedJointRot("right hip", blend), blendedJointRot("right knee", blend));
 }
 
 //
@@ -332,7 +290,7 @@ void Robot::draw() const
 //
 
 // Translation
-Translation::Translation(const Vec3& translation, const bool delta)
+Translation::Translation(const float3& translation, const bool delta)
 	: KeyFrameComponent(delta), translation_(translation) {}
 
 void Translation::apply(DynamicModel& model, const float timeDelta) const
@@ -341,7 +299,7 @@ void Translation::apply(DynamicModel& model, const float timeDelta) const
 }
 
 // Rotation
-Rotation::Rotation(const Vec3& rotation, const bool delta)
+Rotation::Rotation(const float3& rotation, const bool delta)
 	: KeyFrameComponent(delta), rotation_(rotation) {}
 
 void Rotation::apply(DynamicModel& model, const float timeDelta) const
@@ -350,7 +308,7 @@ void Rotation::apply(DynamicModel& model, const float timeDelta) const
 }
 
 // Scale
-Scale::Scale(const Vec3& scale, const bool delta)
+Scale::Scale(const float3& scale, const bool delta)
 	: KeyFrameComponent(delta), scale_(scale) {}
 
 void Scale::apply(DynamicModel& model, const float timeDelta) const
@@ -364,46 +322,518 @@ JointRotation::JointRotation
 	const std::string& name,
 	const float value,
 	const bool delta
-) : KeyFrameComponent(delta), name_(name), value_(value) {}
+) : KeyFrameComponent(delta), name_(&name), value_(value) {}
 
 void JointRotation::apply(DynamicModel& model, const float timeDelta) const
 {
-	model.rotateJoint(name_, value_ / timeDelta);
+	model.rotateJoint(*name_, value_ / timeDelta);
 }
 
 //
 // KeyFrame
 //
 
-KeyFrame& KeyFrame::addComponent(KeyFrameComponent* component)
-{
-	components_.push_back(component);
-	return *this;
-}
-
 void KeyFrame::initialize()
 {
 	timeLeft_ = timeDelta_;
 }
 
-void KeyFrame::apply(DynamicModel& model)
+// Applies one kind of component, as a plain loop the compiler can see through
+template <typename Component, typename Allocator>
+static void applyComponents(const std::vector<Component, Allocator>& components, const uint32_t first,
+	const uint32_t count, DynamicModel& model, const float timeDelta)
 {
-	// For each keyframe component, apply the movement
-	// divided by the time delta.
-	for (KeyFrameComponent* component : components_)
+	const Component* component = components.data() + first;
+	for (uint32_t i = 0; i < count; ++i)
 	{
-		component->apply(model, timeDelta_);
+		component[i].apply(model, timeDelta);
 	}
+}
+
+void KeyFrame::apply(const AnimationClip& clip, DynamicModel& model)
+{
+	// For each keyframe component, apply the movement divided by the time
+	// delta. Different kinds change different parts of the model, so
+	// applying them a kind at a time gives the same result as in the order
+	// they were added.
+	const Range* ranges = components_;
+	applyComponents(clip.translations_, ranges[TRANSLATIONS].first, ranges[TRANSLATIONS].count, model, timeDelta_);
+	applyComponents(clip.rotations_, ranges[ROTATIONS].first, ranges[ROTATIONS].count, model, timeDelta_);
+	applyComponents(clip.scales_, ranges[SCALES].first, ranges[SCALES].count, model, timeDelta_);
+	applyComponents(clip.jointRotations_, ranges[JOINT_ROTATIONS].first, ranges[JOINT_ROTATIONS].count, model, timeDelta_);
 
 	// Decrement counter
 	--timeLeft_;
 }
 
+//
+// AnimationClip
+//
+
+AnimationClip::AnimationClip()
+	: arena_(INITIAL_BYTES),
+	keyframes_(ArenaAllocator<KeyFrame>(arena_)),
+	translations_(ArenaAllocator<Translation>(arena_)),
+	rotations_(ArenaAllocator<Rotation>(arena_)),
+	scales_(ArenaAllocator<Scale>(arena_)),
+	jointRotations_(ArenaAllocator<JointRotation>(arena_)) {}
+
+AnimationClip::KeyFrameID AnimationClip::addKeyframe(const float timeDelta)
+{
+	KeyFrame keyframe(timeDelta);
+
+	// Each kind's range starts where the last keyframe's ended
+	keyframe.components_[KeyFrame::TRANSLATIONS].first = (uint32_t)translations_.size();
+	keyframe.components_[KeyFrame::ROTATIONS].first = (uint32_t)rotations_.size();
+	keyframe.components_[KeyFrame::SCALES].first = (uint32_t)scales_.size();
+	keyframe.components_[KeyFrame::JOINT_ROTATIONS].first = (uint32_t)jointRotations_.size();
+
+	keyframes_.push_back(keyframe);
+	return (KeyFrameID)keyframes_.size() - 1;
+}
+
+template <typename Component>
+AnimationClip& AnimationClip::addComponent(const KeyFrameID keyframe, ClipArray<Component>& components,
+	const KeyFrame::ComponentKind kind, const Component& component)
+{
+	if (keyframe != (KeyFrameID)keyframes_.size() - 1)
+	{
+		std::cerr << "ERROR: keyframe components can only be added to the newest"
+			<< " keyframe in a clip!" << std::endl;
+		return *this;
+	}
+
+	components.push_back(component);
+	++keyframes_[keyframe].components_[kind].count;
+	return *this;
+}
+
+AnimationClip& AnimationClip::add(const KeyFrameID keyframe, const Translation& component)
+{
+	return addComponent(keyframe, translations_, KeyFrame::TRANSLATIONS, component);
+}
+
+AnimationClip& AnimationClip::add(const KeyFrameID keyframe, const Rotation& component)
+{
+	return addComponent(keyframe, rotations_, KeyFrame::ROTATIONS, component);
+}
+
+AnimationClip& AnimationClip::add(const KeyFrameID keyframe, const Scale& component)
+{
+	return addComponent(keyframe, scales_, KeyFrame::SCALES, component);
+}
+
+AnimationClip& AnimationClip::add(const KeyFrameID keyframe, const JointRotation& component)
+{
+	return addComponent(keyframe, jointRotations_, KeyFrame::JOINT_ROTATIONS, component);
+}
+
+//
+// AnimationCurves
+//
+
+// Hermite basis weights for p0, the start tangent, p1 and the end tangent
+static void hermiteWeights(const float t, float* weights)
+{
+	const float t2 = t * t;
+	const float t3 = t2 * t;
+	weights[0] = 2.0f * t3 - 3.0f * t2 + 1.0f;
+	weights[1] = t3 - 2.0f * t2 + t;
+	weights[2] = -2.0f * t3 + 3.0f * t2;
+	weights[3] = t3 - t2;
+}
+
+// The Catmull-Rom tangents at each end of the segment from kept[segment]
+// to the next kept key, scaled to the segment's length. The curve's end
+// keys use the one neighbour they have instead.
+static void segmentWeights(const std::vector<int>& times, const std::vector<size_t>& kept, const size_t segment, float& startWeight, float& endWeight)
+{
+	const size_t prev = kept[segment > 0 ? segment - 1 : segment];
+	const size_t start = kept[segment];
+	const size_t end = kept[segment + 1];
+	const size_t next = kept[segment + 2 < kept.size() ? segment + 2 : segment + 1];
+	const float length = (float)(times[end] - times[start]);
+	startWeight = length / (times[end] - times[prev]);
+	endWeight = length / (times[next] - times[start]);
+}
+
+// Every channel at every step of the curves through the kept keys, which
+// are channels floats each, with the rotation in the last four
+static void evaluateCurves(const std::vector<float>& keys, const size_t channels, const std::vector<int>& times,
+	const std::vector<size_t>& kept, std::vector<float>& out)
+{
+	const size_t rotation = channels - 4;
+	out.resize((times.back() + 1) * channels);
+	for (size_t segment = 0; segment + 1 < kept.size(); ++segment)
+	{
+		const size_t prev = kept[segment > 0 ? segment - 1 : segment];
+		const size_t start = kept[segment];
+		const size_t end = kept[segment + 1];
+		const size_t next = kept[segment + 2 < kept.size() ? segment + 2 : segment + 1];
+		float startWeight, endWeight;
+		segmentWeights(times, kept, segment, startWeight, endWeight);
+
+		// The last segment includes its end
+		const int last = segment + 2 < kept.size() ? times[end] - 1 : times[end];
+		for (int step = times[start]; step <= last; ++step)
+		{
+			const float t = (float)(step - times[start]) / (times[end] - times[start]);
+			float weights[4];
+			hermiteWeights(t, weights);
+
+			float* pose = &out[step * channels];
+			for (size_t channel = 0; channel < rotation; ++channel)
+			{
+				const float p0 = keys[start * channels + channel];
+				const float p1 = keys[end * channels + channel];
+				const float m0 = (p1 - keys[prev * channels + channel]) * startWeight;
+				const float m1 = (keys[next * channels + channel] - p0) * endWeight;
+				pose[channel] = weights[0] * p0 + weights[1] * m0 + weights[2] * p1 + weights[3] * m1;
+			}
+
+			const float* q0 = &keys[start * channels + rotation];
+			const float* q1 = &keys[end * channels + rotation];
+			const quat q = nlerp(quat(q0[0], q0[1], q0[2], q0[3]), quat(q1[0], q1[1], q1[2], q1[3]), t);
+			pose[rotation] = q.x;
+			pose[rotation + 1] = q.y;
+			pose[rotation + 2] = q.z;
+			pose[rotation + 3] = q.w;
+		}
+	}
+}
+
+// In degrees, either way round. Measured from the rotation between them,
+// since acos of their dot product has no precision left for small angles.
+static float angleBetween(const float* a, const float* b)
+{
+	const quat difference = quat(b[0], b[1], b[2], b[3]).conjugate() * quat(a[0], a[1], a[2], a[3]);
+	const float sine = sqrtf(difference.x * difference.x + difference.y * difference.y + difference.z * difference.z);
+	return 2.0f * atan2f(sine, fabsf(difference.w)) / DEGREES_TO_RADIANS;
+}
+
+void AnimationCurves::build(AnimationClip& clip, const std::vector<AnimationClip::KeyFrameID>& keyframes, const DynamicModel& model)
+{
+	// Every joint the model has, in a fixed order
+	joints_.clear();
+	for (const std::pair<const std::string, float>& joint : model.getJoints())
+	{
+		joints_.push_back(joint.first);
+	}
+	std::sort(joints_.begin(), joints_.end());
+	const size_t rotation = FIRST_JOINT + joints_.size();
+	channels_ = rotation + 4;
+
+	// Play the keyframes on a copy the same way they used to be played
+	// directly, recording each keyframe's length in steps and the pose after
+	std::vector<float> keys;
+	std::vector<int> times(1, 0);
+	DynamicModel* scratch = model.clone();
+	for (size_t i = 0; i <= keyframes.size(); ++i)
+	{
+		if (i > 0)
+		{
+			KeyFrame& keyframe = clip.keyframe(keyframes[i - 1]);
+			int steps = 0;
+			keyframe.initialize();
+			do
+			{
+				keyframe.apply(clip, *scratch);
+				++steps;
+			} while (!keyframe.finished());
+			keyframe.reset();
+			times.push_back(times.back() + steps);
+		}
+
+		const size_t first = keys.size();
+		keys.resize(first + channels_);
+		keys[first + POS_X] = scratch->getPos().x;
+		keys[first + POS_Y] = scratch->getPos().y;
+		keys[first + POS_Z] = scratch->getPos().z;
+		keys[first + SCALE_X] = scratch->getScale().x;
+		keys[first + SCALE_Y] = scratch->getScale().y;
+		keys[first + SCALE_Z] = scratch->getScale().z;
+		for (size_t joint = 0; joint < joints_.size(); ++joint)
+		{
+			keys[first + FIRST_JOINT + joint] = scratch->getJoints().at(joints_[joint]);
+		}
+
+		// Each key on the same side as the last, so the components change
+		// smoothly and quantize over a small range
+		quat q = scratch->getRot();
+		if (i > 0 && dot(q, quat(keys[first - 4], keys[first - 3], keys[first - 2], keys[first - 1])) < 0.0f)
+		{
+			q = quat(-q.x, -q.y, -q.z, -q.w);
+		}
+		keys[first + rotation] = q.x;
+		keys[first + rotation + 1] = q.y;
+		keys[first + rotation + 2] = q.z;
+		keys[first + rotation + 3] = q.w;
+	}
+	delete scratch;
+	const size_t keyCount = times.size();
+
+	// The curves through every key are what the compressed ones are held to
+	std::vector<size_t> kept(keyCount);
+	for (size_t key = 0; key < keyCount; ++key)
+	{
+		kept[key] = key;
+	}
+	std::vector<float> reference;
+	evaluateCurves(keys, channels_, times, kept, reference);
+	const int stepCount = times.back() + 1;
+
+	// Channels that stay close enough to their first key everywhere are
+	// left out. Half of each tolerance is kept back for quantizing.
+	std::vector<bool> animated(channels_, false);
+	for (int step = 0; step < stepCount; ++step)
+	{
+		const float* pose = &reference[step * channels_];
+		for (size_t channel = 0; channel < rotation; ++channel)
+		{
+			animated[channel] = animated[channel] || fabsf(pose[channel] - keys[channel]) > tolerance(channel) * 0.5f;
+		}
+		animated[rotation] = animated[rotation] || angleBetween(pose + rotation, &keys[rotation]) > MAX_ANGLE_ERROR * 0.5f;
+	}
+	rotationAnimated_ = animated[rotation];
+	rotation_ = quat(keys[rotation], keys[rotation + 1], keys[rotation + 2], keys[rotation + 3]);
+
+	// Drop each key in turn if the curves through the rest stay close enough
+	std::vector<float> candidate;
+	for (size_t key = 1; key + 1 < keyCount; ++key)
+	{
+		std::vector<size_t> without;
+		for (const size_t k : kept)
+		{
+			if (k != key)
+			{
+				without.push_back(k);
+			}
+		}
+		evaluateCurves(keys, channels_, times, without, candidate);
+
+		bool close = true;
+		for (int step = 0; step < stepCount && close; ++step)
+		{
+			const float* expected = &reference[step * channels_];
+			const float* actual = &candidate[step * channels_];
+			for (size_t channel = 0; channel < rotation && close; ++channel)
+			{
+				close = !animated[channel] || fabsf(actual[channel] - expected[channel]) <= tolerance(channel) * 0.5f;
+			}
+			close = close && (!rotationAnimated_ || angleBetween(actual + rotation, expected + rotation) <= MAX_ANGLE_ERROR * 0.5f);
+		}
+		if (close)
+		{
+			kept.swap(without);
+		}
+	}
+
+	// The rotation takes the first four lanes, so its components decode
+	// together, then the other animated channels
+	targets_.clear();
+	if (rotationAnimated_)
+	{
+		for (size_t component = 0; component < 4; ++component)
+		{
+			targets_.push_back((uint16_t)(rotation + component));
+		}
+	}
+	for (size_t channel = 0; channel < rotation; ++channel)
+	{
+		if (animated[channel])
+		{
+			targets_.push_back((uint16_t)channel);
+		}
+	}
+	laneCount_ = (targets_.size() + 3) / 4 * 4;
+
+	// Each lane's range, split into 16-bit steps
+	groups_.assign(laneCount_ / 4, LaneGroup());
+	for (size_t lane = 0; lane < targets_.size(); ++lane)
+	{
+		float low = keys[kept[0] * channels_ + targets_[lane]];
+		float high = low;
+		for (const size_t key : kept)
+		{
+			low = std::min(low, keys[key * channels_ + targets_[lane]]);
+			high = std::max(high, keys[key * channels_ + targets_[lane]]);
+		}
+		groups_[lane / 4].lows[lane % 4] = low;
+		groups_[lane / 4].stepSizes[lane % 4] = (high - low) / 65535.0f;
+	}
+
+	keys_.assign(kept.size() * laneCount_, 0);
+	for (size_t key = 0; key < kept.size(); ++key)
+	{
+		for (size_t lane = 0; lane < targets_.size(); ++lane)
+		{
+			keys_[key * laneCount_ + lane] = quantize(lane, keys[kept[key] * channels_ + targets_[lane]]);
+		}
+	}
+
+	segments_.resize(kept.size() - 1);
+	for (size_t segment = 0; segment < segments_.size(); ++segment)
+	{
+		segments_[segment].steps = times[kept[segment + 1]] - times[kept[segment]];
+		segmentWeights(times, kept, segment, segments_[segment].startWeight, segments_[segment].endWeight);
+	}
+
+	// The channels that aren't animated keep their first key
+	values_.assign((rotation + 3) / 4 * 4, 0.0f);
+	std::copy(keys.begin(), keys.begin() + rotation, values_.begin());
+
+	// Measure what all that cost by decoding every step
+	stats_ = Stats();
+	int step = 0;
+	for (size_t segment = 0; segment < segments_.size(); ++segment)
+	{
+		const int last = segment + 1 < segments_.size() ? segments_[segment].steps - 1 : segments_[segment].steps;
+		for (int i = 0; i <= last; ++i, ++step)
+		{
+			decode(segment, (float)i / segments_[segment].steps);
+			const float* expected = &reference[step * channels_];
+			for (size_t channel = 0; channel < rotation; ++channel)
+			{
+				const float error = fabsf(values_[channel] - expected[channel]);
+				if (channel < FIRST_JOINT)
+				{
+					stats_.maxDistanceError = std::max(stats_.maxDistanceError, error);
+				}
+				else
+				{
+					stats_.maxAngleError = std::max(stats_.maxAngleError, error);
+				}
+			}
+			const float* q = rotationAnimated_ ? groups_[0].decoded : &rotation_.x;
+			stats_.maxAngleError = std::max(stats_.maxAngleError, angleBetween(q, expected + rotation));
+		}
+	}
+	std::copy(keys.begin(), keys.begin() + rotation, values_.begin());
+
+	stats_.bytes = targets_.size() * sizeof(uint16_t) + groups_.size() * sizeof(LaneGroup) + keys_.size() * sizeof(uint16_t) + segments_.size() * sizeof(Segment);
+	stats_.uncompressedBytes = keyCount * channels_ * sizeof(float);
+	stats_.keys = kept.size();
+	stats_.sourceKeys = keyCount;
+	stats_.channels = targets_.size();
+	stats_.sourceChannels = channels_;
+}
+
+float AnimationCurves::tolerance(const size_t channel)
+{
+	if (channel < FIRST_JOINT)
+	{
+		return MAX_DISTANCE_ERROR;
+	}
+	return MAX_ANGLE_ERROR;
+}
+
+uint16_t AnimationCurves::quantize(const size_t lane, const float value) const
+{
+	const LaneGroup& group = groups_[lane / 4];
+	if (group.stepSizes[lane % 4] == 0.0f)
+	{
+		return 0;
+	}
+	const float steps = floorf((value - group.lows[lane % 4]) / group.stepSizes[lane % 4] + 0.5f);
+	return (uint16_t)std::min(std::max(steps, 0.0f), 65535.0f);
+}
+
+void AnimationCurves::decode(const size_t segment, const float t)
+{
+	const size_t keyCount = segments_.size() + 1;
+	const uint16_t* prev = keys_.data() + (segment > 0 ? segment - 1 : segment) * laneCount_;
+	const uint16_t* start = keys_.data() + segment * laneCount_;
+	const uint16_t* end = keys_.data() + (segment + 1) * laneCount_;
+	const uint16_t* next = keys_.data() + (segment + 2 < keyCount ? segment + 2 : segment + 1) * laneCount_;
+
+	float weights[4];
+	hermiteWeights(t, weights);
+	const simd::Lanes startWeight = simd::splat(segments_[segment].startWeight);
+	const simd::Lanes endWeight = simd::splat(segments_[segment].endWeight);
+	const simd::Lanes w0 = simd::splat(weights[0]), w1 = simd::splat(weights[1]);
+	const simd::Lanes w2 = simd::splat(weights[2]), w3 = simd::splat(weights[3]);
+
+	// Dequantize the four keys around the segment, then
+	// w0 * p0 + w1 * m0 + w2 * p1 + w3 * m1, four lanes at a time
+	for (size_t lane = 0; lane < laneCount_; lane += 4)
+	{
+		LaneGroup& group = groups_[lane / 4];
+		const simd::Lanes low = simd::load(group.lows);
+		const simd::Lanes stepSize = simd::load(group.stepSizes);
+		const simd::Lanes p0 = simd::multiplyAdd(simd::loadShorts(start + lane), stepSize, low);
+		const simd::Lanes p1 = simd::multiplyAdd(simd::loadShorts(end + lane), stepSize, low);
+		const simd::Lanes m0 = simd::mul(simd::sub(p1, simd::multiplyAdd(simd::loadShorts(prev + lane), stepSize, low)), startWeight);
+		const simd::Lanes m1 = simd::mul(simd::sub(simd::multiplyAdd(simd::loadShorts(next + lane), stepSize, low), p0), endWeight);
+
+		simd::Lanes value = simd::mul(w0, p0);
+		value = simd::multiplyAdd(w1, m0, value);
+		value = simd::multiplyAdd(w2, p1, value);
+		value = simd::multiplyAdd(w3, m1, value);
+		simd::store(group.decoded, value);
+
+		// The rotation is lerped between its keys instead
+		if (lane == 0 && rotationAnimated_)
+		{
+			simd::store(group.decoded, nlerp(quat::fromLanes(p0), quat::fromLanes(p1), t).lanes());
+		}
+	}
+
+	const size_t firstLane = rotationAnimated_ ? 4 : 0;
+	for (size_t lane = firstLane; lane < targets_.size(); ++lane)
+	{
+		values_[targets_[lane]] = groups_[lane / 4].decoded[lane % 4];
+	}
+}
+
+void AnimationCurves::sample(const size_t segment, const float t, DynamicModel& model)
+{
+	decode(segment, t);
+
+	model.setPose
+	(
+		float3(values_[POS_X], values_[POS_Y], values_[POS_Z]),
+		rotationAnimated_ ? quat::fromLanes(simd::load(groups_[0].decoded)) : rotation_,
+		float3(values_[SCALE_X], values_[SCALE_Y], values_[SCALE_Z])
+	);
+
+	const size_t firstLane = rotationAnimated_ ? 4 : 0;
+	for (size_t lane = firstLane; lane < targets_.size(); ++lane)
+	{
+		if (targets_[lane] >= FIRST_JOINT)
+		{
+			model.setJointRot(joints_[targets_[lane] - FIRST_JOINT], values_[targets_[lane]]);
+		}
+	}
+}
+
+void AnimationCurves::sample(const size_t segment, const float t, Pose& pose)
+{
+	decode(segment, t);
+	pose.channels.resize(values_.size());
+	std::copy(values_.begin(), values_.end(), pose.channels.begin());
+	pose.rotation = rotationAnimated_ ? quat::fromLanes(simd::load(groups_[0].decoded)) : rotation_;
+}
+
+void AnimationCurves::apply(const Pose& pose, DynamicModel& model) const
+{
+	const float* channels = pose.channels.data();
+	model.setPose
+	(
+		float3(channels[POS_X], channels[POS_Y], channels[POS_Z]),
+		pose.rotation,
+		float3(channels[SCALE_X], channels[SCALE_Y], channels[SCALE_Z])
+	);
+	for (size_t joint = 0; joint < joints_.size(); ++joint)
+	{
+		model.setJointRot(joints_[joint], channels[FIRST_JOINT + joint]);
+	}
+}
+
 //
 // Animation
 //
 
-Animation& Animation::addKeyframe(KeyFrame* keyframe)
+Animation& Animation::addKeyframe(const AnimationClip::KeyFrameID keyframe)
 {
 	keyframes_.push_back(keyframe);
 	initialized_ = false;
@@ -420,9 +850,10 @@ void Animation::initialize()
 		exit(11);
 	}
 
-	// Start up the first keyframe
-	currentKeyframe_ = keyframes_.begin();
-	(*currentKeyframe_)->initialize();
+	// Work out where the keyframes take the model, and start at the first
+	curves_.build(clip_, keyframes_, model_);
+	segment_ = 0;
+	step_ = 0;
 	initialized_ = true;
 
 	// Save the dynamic model's current state
@@ -433,7 +864,7 @@ void Animation::initialize()
 	saveState_ = model_.clone();
 }
 
-void Animation::animate()
+bool Animation::advance()
 {
 	// Crash if not initialized
 	if (!initialized_)
@@ -443,36 +874,64 @@ void Animation::animate()
 		exit(10);
 	}
 
-	// If the current keyframe is finished
-	if ((*currentKeyframe_)->finished())
+	// If the current segment is finished
+	bool restarted = false;
+	if (step_ == curves_.segmentSteps(segment_))
 	{
 		// Go to the next one
-		++currentKeyframe_;
+		++segment_;
+		step_ = 0;
 
-		// If that was the last one, reset
-		if (currentKeyframe_ == keyframes_.end())
+		// If that was the last one, start over
+		if (segment_ == curves_.segmentCount())
 		{
-			reset();
+			segment_ = 0;
+			restarted = true;
 		}
+	}
+
+	++step_;
+	return restarted;
+}
 
-		// Initialize the next keyframe
-		(*currentKeyframe_)->initialize();
+void Animation::animate(const int steps)
+{
+	restarted_ = false;
+	for (int i = 0; i < steps; ++i)
+	{
+		restarted_ = advance() || restarted_;
+	}
+
+	// Starting over snaps the model back to where it began, but keeps the
+	// steps taken since
+	if (restarted_)
+	{
+		const size_t segment = segment_;
+		const int step = step_;
+		reset();
+		segment_ = segment;
+		step_ = step;
 	}
 
-	// Apply the current keyframe
-	(*currentKeyframe_)->apply(model_);
+	// Pose the model that many steps further along
+	curves_.sample(segment_, step_ / (float)curves_.segmentSteps(segment_), model_);
 }
 
-void Animation::reset()
+void Animation::animate(Pose& pose, const int steps)
 {
-	// Reset the current keyframe we're on
-	if (currentKeyframe_ != keyframes_.end())
+	restarted_ = false;
+	for (int i = 0; i < steps; ++i)
 	{
-		(*currentKeyframe_)->reset();
+		restarted_ = advance() || restarted_;
 	}
+	curves_.sample(segment_, step_ / (float)curves_.segmentSteps(segment_), pose);
+}
 
-	// Go back to the first keyframe
-	currentKeyframe_ = keyframes_.begin();
+void Animation::reset()
+{
+	// Go back to the first segment
+	segment_ = 0;
+	step_ = 0;
 
 	// Revert to the saved state (if possible)
 	if (saveState_ != nullptr)
@@ -484,4 +943,153 @@ void Animation::reset()
 		std::cerr << "WARNING: Animation::reset() was called, but "
 			<< "there was no previous save state to revert to!" << std::endl;
 	}
-}
\ No newline at end of file
+}
+
+//
+// AnimationBlend
+//
+
+size_t AnimationBlend::addLayer(Animation& animation, const float weight, const Mode mode)
+{
+	// Layers have to agree on what each channel is
+	if (!layers_.empty() && animation.curves().poseChannels() != pose_.channels.size())
+	{
+		std::cerr << "ERROR: attempt to blend animations of different models!" << std::endl;
+		exit(12);
+	}
+
+	Layer layer;
+	layer.animation = &animation;
+	layer.mode = mode;
+	layer.weight = weight;
+	animation.firstPose(layer.firstPose);
+	layer.pose = layer.firstPose;
+	layers_.push_back(layer);
+
+	pose_ = layer.firstPose;
+	return layers_.size() - 1;
+}
+
+void AnimationBlend::setWeight(const size_t layer, const float weight)
+{
+	layers_[layer].weight = weight;
+
+	// Setting a weight by hand ends any cross-fade
+	fadeSteps_ = 0;
+}
+
+void AnimationBlend::crossFade(const size_t layer, const int steps)
+{
+	for (size_t i = 0; i < layers_.size(); ++i)
+	{
+		if (layers_[i].mode == BLEND)
+		{
+			layers_[i].fadeFrom = layers_[i].weight;
+			layers_[i].fadeTo = i == layer ? 1.0f : 0.0f;
+		}
+	}
+	fadeSteps_ = std::max(steps, 1);
+	fadeStep_ = 0;
+}
+
+void AnimationBlend::animate(const int steps)
+{
+	if (layers_.empty())
+	{
+		return;
+	}
+
+	// Move the weights along any cross-fade
+	if (fadeStep_ < fadeSteps_)
+	{
+		fadeStep_ = std::min(fadeStep_ + steps, fadeSteps_);
+		const float t = fadeStep_ / (float)fadeSteps_;
+		for (Layer& layer : layers_)
+		{
+			if (layer.mode == BLEND)
+			{
+				layer.weight = layer.fadeFrom + (layer.fadeTo - layer.fadeFrom) * t;
+			}
+		}
+	}
+
+	// Every layer keeps playing, weighted or not, so they stay in step
+	float total = 0.0f;
+	restarted_ = false;
+	for (Layer& layer : layers_)
+	{
+		layer.animation->animate(layer.pose, steps);
+		if (layer.mode == BLEND && layer.weight > 0.0f)
+		{
+			total += layer.weight;
+			restarted_ = restarted_ || layer.animation->restarted();
+		}
+	}
+
+	// The blending layers' weighted average
+	const size_t channels = pose_.channels.size();
+	float* mixed = pose_.channels.data();
+	bool first = true;
+	for (const Layer& layer : layers_)
+	{
+		if (layer.mode != BLEND || layer.weight <= 0.0f)
+		{
+			continue;
+		}
+
+		const float weight = layer.weight / total;
+		const simd::Lanes scale = simd::splat(weight);
+		const float* channel = layer.pose.channels.data();
+		if (first)
+		{
+			for (size_t i = 0; i < channels; i += 4)
+			{
+				simd::store(mixed + i, simd::mul(simd::load(channel + i), scale));
+			}
+			pose_.rotation = quat::fromLanes(simd::mul(layer.pose.rotation.lanes(), scale));
+			first = false;
+		}
+		else
+		{
+			for (size_t i = 0; i < channels; i += 4)
+			{
+				simd::store(mixed + i, simd::multiplyAdd(simd::load(channel + i), scale, simd::load(mixed + i)));
+			}
+
+			// Summing quaternions needs them all on the same side
+			const float side = dot(pose_.rotation, layer.pose.rotation) < 0.0f ? -weight : weight;
+			pose_.rotation = quat::fromLanes(simd::multiplyAdd(layer.pose.rotation.lanes(), simd::splat(side), pose_.rotation.lanes()));
+		}
+	}
+
+	// With no weight anywhere the model holds the first layer's pose
+	if (first)
+	{
+		std::copy(layers_[0].pose.channels.begin(), layers_[0].pose.channels.end(), pose_.channels.begin());
+		pose_.rotation = layers_[0].pose.rotation;
+	}
+	pose_.rotation.normalize();
+
+	// Then what the additive layers have done since they started
+	for (const Layer& layer : layers_)
+	{
+		if (layer.mode != ADDITIVE || layer.weight == 0.0f)
+		{
+			continue;
+		}
+
+		const simd::Lanes scale = simd::splat(layer.weight);
+		const float* channel = layer.pose.channels.data();
+		const float* start = layer.firstPose.channels.data();
+		for (size_t i = 0; i < channels; i += 4)
+		{
+			const simd::Lanes difference = simd::sub(simd::load(channel + i), simd::load(start + i));
+			simd::store(mixed + i, simd::multiplyAdd(difference, scale, simd::load(mixed + i)));
+		}
+
+		const quat turned = layer.firstPose.rotation.conjugate() * layer.pose.rotation;
+		pose_.rotation = pose_.rotation * nlerp(quat(), turned, layer.weight);
+	}
+
+	layers_[0].animation->curves().apply(pose_, model_);
+}
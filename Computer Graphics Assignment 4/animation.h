@@ -6,48 +6,69 @@
 #ifndef ANIMATION_H
 #define ANIMATION_H
 
+#include <stdint.h>
+#include <atomic>
 #include <unordered_map>
 #include <string>
-#include <list>
+#include <vector>
+#include "frameArena.h"
 #include "main.h"
+#include "scene.h"
+#include "vectorMath.h"
 
-// A vector with an x, y, and z component,
-// with some simple arithmetic overloads
-struct Vec3
+// World matrices rebuilt because their model had moved (dirty), and reused
+// from the cache because it hadn't (clean), since the counters were last
+// cleared. Models are posed on several threads at once, hence the atomics.
+struct MatrixCounters
 {
-	float x, y, z;
-
-	// Vector arithmetic overloads
-	Vec3 operator+(const Vec3& rhs) const;
-	Vec3 operator-(const Vec3& rhs) const;
-	Vec3 operator*(const Vec3& rhs) const;
-	Vec3 operator/(const Vec3& rhs) const;
-
-	// Scaler multiplication overloads
-	Vec3 operator*(const float scalar) const;
-	Vec3 operator/(const float scalar) const;
+	std::atomic<long long> dirty{ 0 };
+	std::atomic<long long> clean{ 0 };
+
+	void clear()
+	{
+		dirty.store(0, std::memory_order_relaxed);
+		clean.store(0, std::memory_order_relaxed);
+	}
 };
 
+extern MatrixCounters matrixCounters;
+
 // Base class for handling static models which can be animated.
 // Pos_ represents the center of the model
 class StaticModel
 {
 public:
 	StaticModel(){}
-	StaticModel(const Vec3& pos) { pos_ = pos; }
-	virtual void draw(GLuint* textureIDs = nullptr) const = 0;
-	void setPos(Vec3 pos) { pos_ = pos; }
-	void setRot(Vec3 rot) { rot_ = rot; }
-	void setScale(Vec3 scale) { scale_ = scale; }
+	StaticModel(const float3& pos) { pos_ = pos; }
+	virtual ~StaticModel() {}
+
+	// Appends the parts the model is made of, in world space
+	virtual void collectParts(std::vector<ScenePart>& parts) const = 0;
+	void draw(GLuint* textureIDs = nullptr) const;
+
+	void setPos(float3 pos) { pos_ = pos; worldDirty_ = inverseDirty_ = true; }
+	void setRot(float3 rot) { rot_ = rot; worldDirty_ = inverseDirty_ = true; }
+	void setScale(float3 scale) { scale_ = scale; worldDirty_ = inverseDirty_ = true; }
 	void useWireframe(const bool wireframe = true) { wireframe_ = wireframe; }
 
-protected:
-	virtual void setTransform() const final;
+	// Model space to world space, and back. Each is built the first time
+	// it's asked for after the model moves, and reused until it moves again.
+	// A model is only ever posed by one thread at a time, so the caches
+	// don't need a lock.
+	const mat4& worldMatrix() const;
+	const mat4& inverseWorldMatrix() const;
 
-	Vec3 pos_ = { 0 };
-	Vec3 rot_ = { 0 };
-	Vec3 scale_ = { 1, 1, 1 };
+protected:
+	float3 pos_;
+	float3 rot_;
+	float3 scale_ = { 1, 1, 1 };
 	bool wireframe_ = false;
+
+private:
+	mutable mat4 world_;
+	mutable mat4 inverseWorld_;
+	mutable bool worldDirty_ = true;
+	mutable bool inverseDirty_ = true;
 };
 
 //
@@ -58,8 +79,8 @@ class Tree : public StaticModel
 {
 public:
 	Tree(){}
-	Tree(const Vec3& pos): StaticModel(pos) {}
-	void draw(GLuint* textureIDs = nullptr) const override;
+	Tree(const float3& pos): StaticModel(pos) {}
+	void collectParts(std::vector<ScenePart>& parts) const override;
 };
 
 // Base class for handling dynamic animated models which have moving joints
@@ -69,28 +90,83 @@ class DynamicModel
 public:
 	// Constructors
 	DynamicModel() {}
-	DynamicModel(const struct Vec3& pos, const struct Vec3& rot = { 0 }, const struct Vec3& scale = { 1, 1, 1 });
-	virtual DynamicModel* clone() = 0;
+	DynamicModel(const float3& pos, const float3& rot = float3(), const float3& scale = { 1, 1, 1 });
+	virtual ~DynamicModel() {}
+	virtual DynamicModel* clone() const = 0;
 
-	// Transformation functions
-	void translate(const Vec3& pos, const bool delta = true);
-	void rotate(const Vec3& rot,const bool delta = true);
-	void scale(const Vec3& scale, const bool delta = true);
+	// Transformation functions. Rotations are Euler degrees about x, then
+	// y, then z, and a delta one turns the model about its own axes.
+	void translate(const float3& pos, const bool delta = true);
+	void rotate(const float3& rot,const bool delta = true);
+	void scale(const float3& scale, const bool delta = true);
+	void setPose(const float3& pos, const quat& rot, const float3& scale);
 
-	// Joint rotations
-	void rotateJoint(std::string joint, const float rot) {joints_[joint] += rot; }
-	int getJointRot(std::string joint) const { return joints_.at(joint); }
+	const float3& getPos() const { return pos_; }
+	const quat& getRot() const { return rot_; }
+	const float3& getScale() const { return scale_; }
 
-	// Display
-	virtual void draw() const = 0;
+	// Joint rotations
+	void rotateJoint(const std::string& joint, const float rot) {joints_[joint] += rot; }
+	void setJointRot(const std::string& joint, const float rot) { joints_[joint] = rot; }
+	int getJointRot(const std::string& joint) const { return joints_.at(joint); }
+	const std::unordered_map<std::string, float>& getJoints() const { return joints_; }
+
+	// Remembers the current pose, so frames drawn before the next animation
+	// step can be blended between the two
+	void savePose();
+
+	// For models that aren't animated every step: the current pose is
+	// interval steps on from the saved one, and done of those steps have
+	// passed. Frames then blend across the whole gap.
+	void setUpdateSpan(const int done, const int interval) { spanDone_ = done; spanSteps_ = interval; }
+
+	// Display. Parts are appended in world space, in the pose blend of the
+	// way through the current step from the saved pose to the current one,
+	// which is only part of the way there inside a longer update span.
+	virtual void collectParts(std::vector<ScenePart>& parts, const float blend = 1.0f) const = 0;
+	void draw() const;
 	void useWireframe(const bool use = true) { wireframe_ = use; }
 
+	// Model space to world space, and back, in the pose blend of the way
+	// from the saved pose to the current one. Cached like StaticModel's:
+	// they're rebuilt when the model moves, its pose is saved, or it's asked
+	// for at a different blend than last time.
+	const mat4& worldMatrix(const float blend = 1.0f) const;
+	const mat4& inverseWorldMatrix(const float blend = 1.0f) const;
+
 protected:
+	// Builds what worldMatrix() caches
+	virtual mat4 buildWorldMatrix(const float blend) const;
+
+	// Blended between the saved pose and the current one
+	float3 blendedPos(const float blend) const;
+	quat blendedRot(const float blend) const;
+	float blendedJointRot(const std::string& joint, const float blend) const;
+
+	// How far a frame blend of the way through this step is across the
+	// update span
+	float spanBlend(const float blend) const { return (spanDone_ + blend) / spanSteps_; }
+
 	std::unordered_map<std::string, float> joints_;
-	Vec3 pos_ = { 0 };
-	Vec3 rot_ = { 0 };
-	Vec3 scale_ = { 1, 1, 1 };
+	float3 pos_;
+	quat rot_;
+	float3 scale_ = { 1, 1, 1 };
 	bool wireframe_ = false;
+
+	// The pose savePose() saved
+	std::unordered_map<std::string, float> savedJoints_;
+	float3 savedPos_;
+	quat savedRot_;
+	int spanDone_ = 0;
+	int spanSteps_ = 1;
+
+private:
+	mutable mat4 world_;
+	mutable mat4 inverseWorld_;
+	mutable float worldBlend_ = 0.0f;
+	mutable float inverseBlend_ = 0.0f;
+	mutable bool worldDirty_ = true;
+	mutable bool inverseDirty_ = true;
 };
 
 //
@@ -103,24 +179,29 @@ public:
 	Robot();
 	Robot
 	(
-		const struct Vec3& pos,
-		const struct Vec3& rot = { 0 },
-		const struct Vec3& scale = { 1, 1, 1 }
-	) : Robot() { pos_ = pos; rot_ = rot; scale_ = scale; }
+		const float3& pos,
+		const float3& rot = float3(),
+		const float3& scale = { 1, 1, 1 }
+	) : Robot() { pos_ = pos; rot_ = quat::fromEuler(rot); scale_ = scale; }
+
+	virtual Robot* clone() const override { return new Robot(*this); }
 
-	virtual Robot* clone() override { return new Robot(*this); }
+	virtual void collectParts(std::vector<ScenePart>& parts, const float blend = 1.0f) const override;
 
-	virtual void draw() const override;
+protected:
+	// The robot turns about a point 2.5 up from its position
+	virtual mat4 buildWorldMatrix(const float blend) const override;
 };
 
 // A representation of a keyframe component. A list of 1 or more
 // keyframe components constitute a keyframe, which defines one "step"
-// of an animation.
+// of an animation. There's a fixed set of kinds, and each is a plain value
+// with no virtual functions: a clip keeps the components of each kind in an
+// array of their own, and applies them a kind at a time.
 class KeyFrameComponent
 {
 public:
 	KeyFrameComponent(const bool delta = true) : delta_(delta) {}
-	virtual void apply(DynamicModel& model, const float timeDelta) const = 0;
 
 protected:
 	bool delta_; // Should the component add to the transform or set it?
@@ -129,65 +210,251 @@ protected:
 class Translation : public KeyFrameComponent
 {
 public:
-	Translation(const Vec3& translation, const bool delta = true);
-	virtual void apply(DynamicModel& model, const float timeDelta) const override;
+	Translation(const float3& translation, const bool delta = true);
+	void apply(DynamicModel& model, const float timeDelta) const;
 
 protected:
-	const Vec3 translation_;
+	float3 translation_;
 };
 
 class Rotation : public KeyFrameComponent
 {
 public:
-	Rotation(const Vec3& rotation, const bool delta = true);
-	virtual void apply(DynamicModel& model, const float timeDelta) const override;
+	Rotation(const float3& rotation, const bool delta = true);
+	void apply(DynamicModel& model, const float timeDelta) const;
 
 protected:
-	const Vec3 rotation_;
+	float3 rotation_;
 };
 
 class Scale : public KeyFrameComponent
 {
 public:
-	Scale(const Vec3& scale, const bool delta = true);
-	virtual void apply(DynamicModel& model, const float timeDelta) const override;
+	Scale(const float3& scale, const bool delta = true);
+	void apply(DynamicModel& model, const float timeDelta) const;
 
 protected:
-	const Vec3 scale_;
+	float3 scale_;
 };
 
 class JointRotation : public KeyFrameComponent
 {
 public:
 	JointRotation(const std::string& name, const float value, const bool delta = true);
-	virtual void apply(DynamicModel& model, const float timeDelta) const override;
+	void apply(DynamicModel& model, const float timeDelta) const;
 
 protected:
-	const std::string& name_;
-	const float value_;
+	const std::string* name_;
+	float value_;
 };
 
+class AnimationClip;
+
 // A representation of a keyframe, which is constituted of a list of keyframe
-// components.
+// components. Keyframes are made by an AnimationClip, and their components
+// are kept there.
 class KeyFrame
 {
 public:
 	KeyFrame(const float timeDelta): timeDelta_(timeDelta) {}
 
 	float getTimeDelta() const { return timeDelta_; }
-	KeyFrame& addComponent(KeyFrameComponent* component);
 
 	void initialize(); // Finished will return false once this is called
-	void apply(DynamicModel& model);
+	void apply(const AnimationClip& clip, DynamicModel& model);
 	bool finished() { return timeLeft_ <= 0.0f; }
 	void reset() { timeLeft_ = 0.0f; }
 
 private:
-	std::list<KeyFrameComponent*> components_;
-	const float timeDelta_; // in frames
+	friend class AnimationClip;
+
+	enum ComponentKind
+	{
+		TRANSLATIONS,
+		ROTATIONS,
+		SCALES,
+		JOINT_ROTATIONS,
+		COMPONENT_KINDS
+	};
+
+	// Where this keyframe's components of each kind are in the clip's array
+	// of that kind
+	struct Range
+	{
+		uint32_t first = 0;
+		uint32_t count = 0;
+	};
+
+	Range components_[COMPONENT_KINDS];
+	float timeDelta_; // in frames
 	float timeLeft_ = 0.0f;
 };
 
+// Owns a set of keyframes and their components, with the components sorted
+// by kind into arrays, and each keyframe's components of a kind next to each
+// other. Applying a keyframe is then a tight loop over each kind, with no
+// virtual calls. Everything is allocated from one arena, so a clip's data
+// is close together and is freed in one go.
+class AnimationClip
+{
+public:
+	typedef int KeyFrameID;
+
+	AnimationClip();
+	AnimationClip(const AnimationClip&) = delete;
+	AnimationClip& operator=(const AnimationClip&) = delete;
+
+	KeyFrameID addKeyframe(const float timeDelta);
+	KeyFrame& keyframe(const KeyFrameID keyframe) { return keyframes_[keyframe]; }
+
+	// Copies a component into the clip and adds it to keyframe, which has to
+	// be the newest one, so that each keyframe's components stay together
+	AnimationClip& add(const KeyFrameID keyframe, const Translation& component);
+	AnimationClip& add(const KeyFrameID keyframe, const Rotation& component);
+	AnimationClip& add(const KeyFrameID keyframe, const Scale& component);
+	AnimationClip& add(const KeyFrameID keyframe, const JointRotation& component);
+
+	// Memory the clip's keyframes and components take up
+	size_t bytes() const { return arena_.used() + arena_.overflowed(); }
+
+private:
+	friend class KeyFrame;
+
+	template <typename T>
+	using ClipArray = std::vector<T, ArenaAllocator<T>>;
+
+	template <typename Component>
+	AnimationClip& addComponent(const KeyFrameID keyframe, ClipArray<Component>& components,
+		const KeyFrame::ComponentKind kind, const Component& component);
+
+	// Enough for a walk cycle, so most clips never need more
+	static const size_t INITIAL_BYTES = 4096;
+
+	// Declared first, since the arrays allocate from it
+	LinearArena arena_;
+	ClipArray<KeyFrame> keyframes_;
+	ClipArray<Translation> translations_;
+	ClipArray<Rotation> rotations_;
+	ClipArray<Scale> scales_;
+	ClipArray<JointRotation> jointRotations_;
+};
+
+// A model's whole pose as the curves see it: position, scale and every
+// joint in one array, padded to a multiple of four, then the rotation. Poses
+// from curves built on the same model line up channel for channel, so
+// mixing them is one pass over the arrays.
+struct Pose
+{
+	std::vector<float> channels;
+	quat rotation;
+};
+
+// The poses an animation passes through at each keyframe boundary, joined
+// up so the motion is smooth through them rather than changing speed at
+// each one. Position, scale and joint channels are cubic Hermite splines
+// with Catmull-Rom tangents. The rotation is a quaternion, normalized-lerped
+// between keys.
+//
+// The keys are stored compressed. A channel that never moves further than
+// the tolerance from where it starts is dropped. A key is dropped when the
+// curve through the others stays within the tolerance of the curve through
+// all of them, everywhere. That's decided for the whole pose at once, so
+// every remaining channel has its keys at the same times and four channels
+// can still be decoded together. What's left is quantized to 16 bits over
+// each channel's own range.
+class AnimationCurves
+{
+public:
+	// How far the compressed curves may stray from the full ones
+	static constexpr float MAX_DISTANCE_ERROR = 0.001f;	// Position and scale
+	static constexpr float MAX_ANGLE_ERROR = 0.05f;		// Joints and rotation, in degrees
+
+	// Plays keyframes through once, starting from model's pose, and
+	// records the pose after each. model itself isn't changed.
+	void build(AnimationClip& clip, const std::vector<AnimationClip::KeyFrameID>& keyframes, const DynamicModel& model);
+
+	// One segment between each pair of keys that are kept, lasting as many
+	// animation steps as the keyframes between them took
+	size_t segmentCount() const { return segments_.size(); }
+	int segmentSteps(const size_t segment) const { return segments_[segment].steps; }
+
+	// Poses model t of the way through segment, from 0 at its start to 1
+	// at its end. Joints that never move aren't set, so model has to start
+	// from the pose the curves were built from. Uses scratch space of its
+	// own, so it isn't const.
+	void sample(const size_t segment, const float t, DynamicModel& model);
+
+	// The same, into pose, which is sized to fit if it isn't already
+	void sample(const size_t segment, const float t, Pose& pose);
+
+	// Poses model as pose describes, every joint included
+	void apply(const Pose& pose, DynamicModel& model) const;
+
+	// How many floats a pose from these curves has, padding included
+	size_t poseChannels() const { return values_.size(); }
+
+	// What the compression did, measured against the uncompressed curves
+	// at every step when they were built
+	struct Stats
+	{
+		size_t bytes = 0;				// Memory the keys and what's needed to decode them take up
+		size_t uncompressedBytes = 0;	// What every key of every channel would take as floats
+		size_t keys = 0;				// Kept, out of one per keyframe played plus one
+		size_t sourceKeys = 0;
+		size_t channels = 0;			// Animated, out of all of them including the rotation's four
+		size_t sourceChannels = 0;
+		float maxDistanceError = 0.0f;
+		float maxAngleError = 0.0f;		// Degrees
+	};
+	const Stats& stats() const { return stats_; }
+
+private:
+	// The scalar channels, in order. Joints follow, then the rotation's four.
+	enum Channel
+	{
+		POS_X, POS_Y, POS_Z,
+		SCALE_X, SCALE_Y, SCALE_Z,
+		FIRST_JOINT
+	};
+
+	struct Segment
+	{
+		int steps;
+		float startWeight;	// Scales the difference of the keys either side
+		float endWeight;	// into the tangent at each end
+	};
+
+	// Four lanes' ranges, and where decode() leaves their values
+	struct LaneGroup
+	{
+		float lows[4];		// What 0 decodes to
+		float stepSizes[4];	// What each 16-bit step adds
+		float decoded[4];
+	};
+
+	// Decodes every lane at t through segment, with the rotation (if it's
+	// animated) in the first four, and copies the others to values_
+	void decode(const size_t segment, const float t);
+
+	// MAX_DISTANCE_ERROR or MAX_ANGLE_ERROR, whichever the channel is held to
+	static float tolerance(const size_t channel);
+
+	// Stores a lane's channel as its nearest 16-bit step between low and high
+	uint16_t quantize(const size_t lane, const float value) const;
+
+	std::vector<std::string> joints_;
+	size_t channels_ = 0;
+	bool rotationAnimated_ = false;
+	quat rotation_;					// Used when it isn't
+	std::vector<uint16_t> targets_;	// The channel each lane decodes
+	size_t laneCount_ = 0;			// Lanes, padded to a multiple of four
+	std::vector<LaneGroup> groups_;	// laneCount_ / 4, with the ranges next to the output so decoding touches less memory
+	std::vector<uint16_t> keys_;	// laneCount_ per key
+	std::vector<Segment> segments_;
+	std::vector<float> values_;		// A pose's channels, with the constant ones filled in
+	Stats stats_;
+};
+
 // Class for handling animations on dynamic models. An animator
 // takes a list of keyframes, which in turn takes a list of keyframe
 // components.
@@ -195,21 +462,116 @@ class Animation
 {
 public:
 	Animation(DynamicModel& model) : model_(model) {}
+	~Animation() { delete saveState_; }
+	Animation(const Animation&) = delete;
+	Animation& operator=(const Animation&) = delete;
+
+	// Where the animation's keyframes are made. Each animation has its own,
+	// since keyframes keep track of their progress.
+	AnimationClip& clip() { return clip_; }
 
-	Animation& addKeyframe(KeyFrame* keyframe);
+	// Plays keyframe next, after the ones already added. It has to be from
+	// clip(), and can be added more than once to repeat it.
+	Animation& addKeyframe(const AnimationClip::KeyFrameID keyframe);
 
+	// Builds the curves from the model's current pose, which is also where
+	// the animation starts over from
 	void initialize();
-	void animate();
 	void reset();
 
-	static const int FRAME_DELAY = 1000 / 60; // in milliseconds
+	// Moves steps animation steps along, but only poses the model once,
+	// for models that don't need every step
+	void animate(const int steps = 1);
+
+	// Steps forward like animate(), but samples into pose rather than
+	// posing the model, which starting over doesn't touch either. For
+	// mixing with other animations of the same model.
+	void animate(Pose& pose, const int steps = 1);
+
+	// Goes back to the first keyframe without touching the model, for
+	// animations that are only sampled into poses
+	void rewind() { segment_ = 0; step_ = 0; }
+
+	// Where the animation starts from, and starts over from
+	void firstPose(Pose& pose) { curves_.sample(0, 0.0f, pose); }
+
+	const AnimationCurves& curves() const { return curves_; }
+
+	// Whether the last animate() started over, snapping the model back to
+	// where it began rather than moving it one step
+	bool restarted() const { return restarted_; }
+
+	// Keyframe times are counted in animation steps of this many seconds
+	static constexpr double STEP_SECONDS = 1.0 / 60.0;
 
 private:
-	std::list<KeyFrame*> keyframes_;
-	std::list<KeyFrame*>::iterator currentKeyframe_;
+	// Moves on a step, returning whether that started the animation over
+	bool advance();
+
+	AnimationClip clip_;
+	std::vector<AnimationClip::KeyFrameID> keyframes_;
+	AnimationCurves curves_;
+	size_t segment_ = 0;
+	int step_ = 0;			// Steps taken into segment_
 	DynamicModel& model_;
 	bool initialized_ = false;
+	bool restarted_ = false;
 	DynamicModel* saveState_ = nullptr;
 };
 
+// Plays several animations on one model and mixes their poses. Each layer
+// is an Animation of the model of its own, so all of them have to be built
+// from the same starting pose. Blending layers are averaged by weight.
+// Additive layers then add how far they've moved from their first pose,
+// scaled by their weight, so an arm can wave over whatever walk is blended
+// underneath. Mixing goes four channels at a time, a layer at a time.
+class AnimationBlend
+{
+public:
+	enum Mode
+	{
+		BLEND,
+		ADDITIVE
+	};
+
+	AnimationBlend(DynamicModel& model) : model_(model) {}
+
+	// animation has to be initialized, and stay around as long as this does
+	size_t addLayer(Animation& animation, const float weight, const Mode mode = BLEND);
+
+	float weight(const size_t layer) const { return layers_[layer].weight; }
+	void setWeight(const size_t layer, const float weight);
+
+	// Moves all of the blending layers' weight onto layer over steps
+	// animation steps, fading the rest out, from wherever the weights are now
+	void crossFade(const size_t layer, const int steps);
+
+	// Steps every layer steps animation steps, mixes their poses and poses
+	// the model
+	void animate(const int steps = 1);
+
+	// Whether the last animate() started over a blending layer that has
+	// any weight, snapping the model back to where that layer begins
+	bool restarted() const { return restarted_; }
+
+private:
+	struct Layer
+	{
+		Animation* animation;
+		Mode mode;
+		float weight;
+		float fadeFrom = 0.0f;	// Weights at the start and end of a cross-fade
+		float fadeTo = 0.0f;
+		Pose pose;
+		Pose firstPose;			// What additive layers are measured from
+	};
+
+	DynamicModel& model_;
+	std::vector<Layer> layers_;
+	Pose pose_;
+	int fadeSteps_ = 0;
+	int fadeStep_ = 0;
+	bool restarted_ = false;
+};
+
 #endif // ANIMATION_H
\ No newline at end of file
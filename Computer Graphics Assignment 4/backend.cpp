@@ -0,0 +1,390 @@
+// Implementations of the windowing/context backends
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#include "backend.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <GL/freeglut_ext.h>
+#include <FreeImage/FreeImage.h>
+
+#ifdef _WIN32
+#include <mmsystem.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "winmm.lib")
+#endif
+#endif
+
+#ifdef __linux__
+#define OFFSCREEN_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+Backend* backend = nullptr;
+
+//
+// GlutBackend
+//
+
+class GlutBackend : public Backend
+{
+public:
+	GlutBackend(int& argc, char** argv) : argc_(argc), argv_(argv) {}
+
+	~GlutBackend()
+	{
+#ifdef _WIN32
+		if (timerPeriodSet_)
+		{
+			timeEndPeriod(1);
+		}
+#endif
+	}
+
+	bool createContext(const int width, const int height, const char* title) override
+	{
+		//create a double-buffered GLUT window at (50,50) with predefined windowsize
+		glutInit(&argc_, argv_);
+		glutInitDisplayMode(GLUT_DEPTH | GLUT_DOUBLE | GLUT_RGBA);
+		glutInitWindowPosition(50, 50);
+		glutInitWindowSize(width, height);
+		glutCreateWindow(title);
+		glutSetKeyRepeat(GLUT_KEY_REPEAT_ON);
+
+		// Let leaveMainLoop() return to the caller instead of exiting
+		glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_GLUTMAINLOOP_RETURNS);
+
+#ifdef _WIN32
+		// Windows sleeps in whole scheduler ticks, 15.6 ms by default
+		timerPeriodSet_ = timeBeginPeriod(1) == TIMERR_NOERROR;
+#endif
+		return true;
+	}
+
+	void setCallbacks(const BackendCallbacks& callbacks) override
+	{
+		glutDisplayFunc(callbacks.display);
+		glutReshapeFunc(callbacks.reshape);
+		glutMouseFunc(callbacks.mouse);
+		glutKeyboardFunc(callbacks.keyboard);
+		glutSpecialFunc(callbacks.special);
+		glutMotionFunc(callbacks.motion);
+	}
+
+	void setTimer(const unsigned int ms, void (*callback)(int), const int value) override
+	{
+		glutTimerFunc(ms, callback, value);
+	}
+
+	void setIdleFunc(void (*idle)()) override { glutIdleFunc(idle); }
+
+	double time() override
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void waitUntil(const double time) override
+	{
+		// Sleeps can wake a scheduler tick late, so sleep through most of the
+		// wait and spin through the rest
+		const double SPIN_SECONDS = 0.002;
+		for (;;)
+		{
+			const double left = time - this->time();
+			if (left <= 0.0)
+				return;
+			if (left > SPIN_SECONDS)
+				std::this_thread::sleep_for(std::chrono::duration<double>(left - SPIN_SECONDS));
+			else
+				std::this_thread::yield();
+		}
+	}
+
+	void mainLoop() override { glutMainLoop(); }
+	void leaveMainLoop() override { glutLeaveMainLoop(); }
+	void postRedisplay() override { glutPostRedisplay(); }
+	void swapBuffers() override { glutSwapBuffers(); }
+	void* getProcAddress(const char* name) override { return (void*)glutGetProcAddress(name); }
+
+private:
+	int& argc_;
+	char** argv_;
+	bool timerPeriodSet_ = false;	// Whether timeBeginPeriod() needs undoing
+};
+
+Backend* createGlutBackend(int& argc, char** argv)
+{
+	return new GlutBackend(argc, argv);
+}
+
+//
+// OffscreenBackend
+//
+
+#ifdef OFFSCREEN_EGL
+
+class OffscreenBackend : public Backend
+{
+public:
+	OffscreenBackend(const int frameCount, const std::string& outputPath)
+		: frameCount_(frameCount), outputPath_(outputPath) {}
+
+	~OffscreenBackend()
+	{
+		if (display_ != EGL_NO_DISPLAY)
+		{
+			eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			if (context_ != EGL_NO_CONTEXT)
+				eglDestroyContext(display_, context_);
+			if (surface_ != EGL_NO_SURFACE)
+				eglDestroySurface(display_, surface_);
+			eglTerminate(display_);
+		}
+	}
+
+	bool createContext(const int width, const int height, const char* /*title*/) override
+	{
+		width_ = width;
+		height_ = height;
+
+		// Prefer Mesa's surfaceless platform, which needs no X server or GPU
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		EGLint major, minor;
+
+		if (getPlatformDisplay != nullptr)
+		{
+			display_ = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		}
+		if (display_ == EGL_NO_DISPLAY || !eglInitialize(display_, &major, &minor))
+		{
+			display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+			if (display_ == EGL_NO_DISPLAY || !eglInitialize(display_, &major, &minor))
+			{
+				std::cerr << "ERROR: couldn't initialize an EGL display" << std::endl;
+				display_ = EGL_NO_DISPLAY;
+				return false;
+			}
+		}
+
+		// Same buffers as the GLUT window, minus the second colour buffer
+		const EGLint configAttributes[] =
+		{
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_RED_SIZE, 8,
+			EGL_GREEN_SIZE, 8,
+			EGL_BLUE_SIZE, 8,
+			EGL_ALPHA_SIZE, 8,
+			EGL_DEPTH_SIZE, 24,
+			EGL_NONE
+		};
+		EGLConfig config;
+		EGLint configCount = 0;
+		if (!eglBindAPI(EGL_OPENGL_API)
+			|| !eglChooseConfig(display_, configAttributes, &config, 1, &configCount)
+			|| configCount == 0)
+		{
+			std::cerr << "ERROR: no EGL config supports desktop GL pbuffers" << std::endl;
+			return false;
+		}
+
+		const EGLint surfaceAttributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+		surface_ = eglCreatePbufferSurface(display_, config, surfaceAttributes);
+		context_ = eglCreateContext(display_, config, EGL_NO_CONTEXT, nullptr);
+		if (surface_ == EGL_NO_SURFACE || context_ == EGL_NO_CONTEXT
+			|| !eglMakeCurrent(display_, surface_, surface_, context_))
+		{
+			std::cerr << "ERROR: couldn't create an EGL pbuffer context (0x"
+				<< std::hex << eglGetError() << std::dec << ")" << std::endl;
+			return false;
+		}
+
+		std::cout << "Rendering offscreen with " << glGetString(GL_RENDERER)
+			<< " (" << glGetString(GL_VERSION) << ")" << std::endl;
+		return true;
+	}
+
+	void setCallbacks(const BackendCallbacks& callbacks) override
+	{
+		callbacks_ = callbacks;
+	}
+
+	void setTimer(const unsigned int ms, void (*callback)(int), const int value) override
+	{
+		Timer timer = { now_ + ms * 1000000ull, nextTimerID_++, callback, value };
+		timers_.push_back(timer);
+	}
+
+	void setIdleFunc(void (*idle)()) override { idle_ = idle; }
+
+	double time() override { return now_ * 1e-9; }
+
+	void waitUntil(const double time) override
+	{
+		now_ = std::max(now_, (uint64_t)llround(std::max(time, 0.0) * 1e9));
+	}
+
+	void mainLoop() override
+	{
+		if (callbacks_.reshape != nullptr)
+		{
+			callbacks_.reshape(width_, height_);
+		}
+
+		leaving_ = false;
+		while (!leaving_ && frame_ < frameCount_)
+		{
+			runDueTimers();
+
+			if (redisplay_ && callbacks_.display != nullptr)
+			{
+				redisplay_ = false;
+				callbacks_.display();
+				++frame_;
+
+				if (outputPath_.find('%') != std::string::npos)
+				{
+					saveFrame();
+				}
+			}
+			else if (idle_ != nullptr)
+			{
+				idle_();
+			}
+			else if (timers_.empty())
+			{
+				// Nothing can ever change again
+				break;
+			}
+			else
+			{
+				// Skip ahead to the next timer rather than waiting for it
+				uint64_t next = timers_[0].due;
+				for (const Timer& timer : timers_)
+				{
+					if (timer.due < next)
+						next = timer.due;
+				}
+				now_ = next;
+			}
+		}
+
+		if (!outputPath_.empty() && outputPath_.find('%') == std::string::npos)
+		{
+			saveFrame();
+		}
+	}
+
+	void leaveMainLoop() override { leaving_ = true; }
+	void postRedisplay() override { redisplay_ = true; }
+	void swapBuffers() override { eglSwapBuffers(display_, surface_); }
+	void* getProcAddress(const char* name) override { return (void*)eglGetProcAddress(name); }
+
+private:
+	struct Timer
+	{
+		uint64_t due; // Virtual nanoseconds
+		uint64_t id;  // Keeps timers due at the same time in order
+		void (*callback)(int);
+		int value;
+	};
+
+	void runDueTimers()
+	{
+		for (;;)
+		{
+			// Earliest due timer, oldest first
+			int found = -1;
+			for (size_t i = 0; i < timers_.size(); ++i)
+			{
+				const Timer& timer = timers_[i];
+				if (timer.due <= now_ && (found < 0 || timer.due < timers_[found].due
+					|| (timer.due == timers_[found].due && timer.id < timers_[found].id)))
+				{
+					found = (int)i;
+				}
+			}
+			if (found < 0)
+			{
+				return;
+			}
+
+			// Remove it first, since the callback will usually re-arm itself
+			Timer timer = timers_[found];
+			timers_.erase(timers_.begin() + found);
+			timer.callback(timer.value);
+		}
+	}
+
+	void saveFrame()
+	{
+		char filename[1024];
+		snprintf(filename, sizeof(filename), outputPath_.c_str(), frame_);
+
+		FREE_IMAGE_FORMAT format = FreeImage_GetFIFFromFilename(filename);
+		if (format == FIF_UNKNOWN)
+		{
+			std::cerr << "Unknown file format for " << filename << std::endl;
+			return;
+		}
+
+		// FreeImage rows are bottom-up and padded to 4 bytes, same as GL's
+		// default pack alignment, so we can read straight into the bitmap
+		FIBITMAP* bitmap = FreeImage_Allocate(width_, height_, 24);
+		glFinish();
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+		glReadPixels(0, 0, width_, height_, GL_BGR_EXT, GL_UNSIGNED_BYTE, FreeImage_GetBits(bitmap));
+#else
+		glReadPixels(0, 0, width_, height_, GL_RGB, GL_UNSIGNED_BYTE, FreeImage_GetBits(bitmap));
+#endif
+
+		if (!FreeImage_Save(format, bitmap, filename, 0))
+		{
+			std::cerr << "Failed to save frame to " << filename << std::endl;
+		}
+		FreeImage_Unload(bitmap);
+	}
+
+	const int frameCount_;
+	const std::string outputPath_;
+	int width_ = 0;
+	int height_ = 0;
+
+	EGLDisplay display_ = EGL_NO_DISPLAY;
+	EGLSurface surface_ = EGL_NO_SURFACE;
+	EGLContext context_ = EGL_NO_CONTEXT;
+
+	BackendCallbacks callbacks_;
+	std::vector<Timer> timers_;
+	void (*idle_)() = nullptr;
+	uint64_t now_ = 0; // Virtual nanoseconds
+	uint64_t nextTimerID_ = 0;
+	int frame_ = 0;
+	bool redisplay_ = true; // GLUT always draws the first frame
+	bool leaving_ = false;
+};
+
+Backend* createOffscreenBackend(const int frameCount, const std::string& outputPath)
+{
+	return new OffscreenBackend(frameCount, outputPath);
+}
+
+#else
+
+Backend* createOffscreenBackend(const int frameCount, const std::string& outputPath)
+{
+	std::cerr << "ERROR: offscreen rendering needs EGL, which this build doesn't have" << std::endl;
+	return nullptr;
+}
+
+#endif // OFFSCREEN_EGL
@@ -0,0 +1,70 @@
+// Header file for the windowing/context backends the scene can run on
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include <string>
+#include "main.h"
+
+// The callbacks the scene hands to whichever backend is driving it. These
+// mirror the GLUT callbacks, and any of them may be left null.
+struct BackendCallbacks
+{
+	void (*display)() = nullptr;
+	void (*reshape)(int width, int height) = nullptr;
+	void (*mouse)(int button, int state, int x, int y) = nullptr;
+	void (*motion)(int x, int y) = nullptr;
+	void (*keyboard)(unsigned char key, int x, int y) = nullptr;
+	void (*special)(int key, int x, int y) = nullptr;
+};
+
+// Owns the GL context and the main loop. The scene only talks to GL and to
+// this interface, so it doesn't care whether there's a window or not.
+class Backend
+{
+public:
+	virtual ~Backend() {}
+
+	// Creates the context and makes it current. Prints the reason and
+	// returns false if that isn't possible.
+	virtual bool createContext(const int width, const int height, const char* title) = 0;
+	virtual void setCallbacks(const BackendCallbacks& callbacks) = 0;
+
+	// Calls callback(value) once, after at least ms milliseconds
+	virtual void setTimer(const unsigned int ms, void (*callback)(int), const int value) = 0;
+
+	// Calls idle() whenever there are no events to handle, until it's set
+	// back to null
+	virtual void setIdleFunc(void (*idle)()) = 0;
+
+	// Seconds on a clock that never goes backwards, and a wait until it
+	// reaches the given time. The wait doesn't handle events.
+	virtual double time() = 0;
+	virtual void waitUntil(const double time) = 0;
+
+	virtual void mainLoop() = 0;
+	virtual void leaveMainLoop() = 0;
+	virtual void postRedisplay() = 0;
+	virtual void swapBuffers() = 0;
+	virtual void* getProcAddress(const char* name) = 0;
+};
+
+// The backend the scene is currently running on
+extern Backend* backend;
+
+// A double-buffered GLUT window
+Backend* createGlutBackend(int& argc, char** argv);
+
+// Renders into an EGL pbuffer with no window or display server, which works
+// on Mesa's software rasterizer. Timers and waits run on a virtual clock,
+// so frames are produced as fast as they can be drawn and the same run
+// always produces the same frames. Stops after frameCount frames, or once
+// nothing is left to draw. If outputPath is set the last frame is saved
+// there, or every frame if the path contains a printf-style frame number
+// (e.g. %04d). Returns nullptr on platforms without EGL.
+Backend* createOffscreenBackend(const int frameCount, const std::string& outputPath);
+
+#endif // BACKEND_H
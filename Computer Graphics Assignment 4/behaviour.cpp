@@ -0,0 +1,323 @@
+// Implementations for scripting what robots do over time
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#include "behaviour.h"
+
+#include <math.h>
+#include <algorithm>
+#include "trace.h"
+
+// The same angle, between -180 and 180
+static float wrapDegrees(const float degrees)
+{
+	const float wrapped = fmodf(degrees + 180.0f, 360.0f);
+	return (wrapped < 0.0f ? wrapped + 360.0f : wrapped) - 180.0f;
+}
+
+//
+// Agent
+//
+
+Agent::Agent(const AgentGait& gait, const float3& position, const float heading)
+	: gait_(&gait), from_(position), to_(position), fromHeading_(heading), toHeading_(heading) {}
+
+int Agent::walkTo(const uint64_t now, const float3& target)
+{
+	const float3 offset = target - position(now);
+	const float distance = offset.length();
+
+	// Already there, it stays facing the way it was
+	const float heading = distance > 0.0f ? atan2f(offset.x, offset.z) / DEGREES_TO_RADIANS : this->heading(now);
+	return plan(now, WALK, target, heading, (int)ceilf(distance / gait_->walkSpeed), turnTicks(now, heading));
+}
+
+int Agent::turnTo(const uint64_t now, const float heading)
+{
+	const int ticks = turnTicks(now, heading);
+	return plan(now, TURN, position(now), heading, ticks, ticks);
+}
+
+int Agent::turnBy(const uint64_t now, const float degrees)
+{
+	return turnTo(now, heading(now) + degrees);
+}
+
+int Agent::wave(const uint64_t now)
+{
+	return plan(now, WAVE, position(now), heading(now), gait_->waveSteps, 0);
+}
+
+int Agent::wait(const uint64_t now, const double seconds)
+{
+	return plan(now, STAND, position(now), heading(now), (int)ceil(seconds / Animation::STEP_SECONDS), 0);
+}
+
+float3 Agent::position(const uint64_t tick) const
+{
+	if (tick >= end_)
+	{
+		return to_;
+	}
+	if (tick <= start_)
+	{
+		return from_;
+	}
+	const float t = (tick - start_) / (float)(end_ - start_);
+	return from_ + (to_ - from_) * t;
+}
+
+float Agent::heading(const uint64_t tick) const
+{
+	if (tick >= turnEnd_)
+	{
+		return toHeading_;
+	}
+	if (tick <= start_)
+	{
+		return fromHeading_;
+	}
+	const float t = (tick - start_) / (float)(turnEnd_ - start_);
+	return fromHeading_ + (toHeading_ - fromHeading_) * t;
+}
+
+int Agent::plan(const uint64_t now, const Action action, const float3& to, const float heading, int ticks, const int turnTicks)
+{
+	// Carry on from wherever the last action had got to
+	const float3 from = position(now);
+	const float fromHeading = wrapDegrees(this->heading(now));
+
+	// Every action takes at least a tick, so a script can't wait for nothing
+	ticks = std::max(ticks, 1);
+	from_ = from;
+	to_ = to;
+	fromHeading_ = fromHeading;
+	toHeading_ = fromHeading + wrapDegrees(heading - fromHeading);
+	start_ = now;
+	end_ = now + ticks;
+	turnEnd_ = now + std::min(std::max(turnTicks, 0), ticks);
+	action_ = action;
+	return ticks;
+}
+
+int Agent::turnTicks(const uint64_t now, const float heading) const
+{
+	return (int)ceilf(fabsf(wrapDegrees(heading - this->heading(now))) / gait_->turnSpeed);
+}
+
+//
+// BehaviourScheduler
+//
+
+// std::fill() takes it by reference, so it needs a definition
+const uint32_t BehaviourScheduler::NONE;
+
+BehaviourScheduler::BehaviourScheduler()
+{
+	std::fill(wheel_, wheel_ + WHEEL_SIZE, NONE);
+	std::fill(slowWheel_, slowWheel_ + WHEEL_SIZE, NONE);
+}
+
+BehaviourScheduler::~BehaviourScheduler()
+{
+	// Every script that hasn't finished is waiting somewhere in a wheel
+	for (const uint32_t* wheel : { wheel_, slowWheel_ })
+	{
+		for (size_t slot = 0; slot < WHEEL_SIZE; ++slot)
+		{
+			for (uint32_t index = wheel[slot]; index != NONE; index = frame(index).next)
+			{
+				frame(index).script->~BehaviourScript();
+			}
+		}
+	}
+}
+
+uint32_t BehaviourScheduler::allocate()
+{
+	if (free_ == NONE)
+	{
+		// A block at a time, with the free list in index order so frames are
+		// handed out in the order they sit in memory
+		const uint32_t first = (uint32_t)(blocks_.size() * FRAMES_PER_BLOCK);
+		blocks_.emplace_back(new Frame[FRAMES_PER_BLOCK]);
+		for (uint32_t i = 0; i < FRAMES_PER_BLOCK; ++i)
+		{
+			frame(first + i).next = i + 1 < FRAMES_PER_BLOCK ? first + i + 1 : NONE;
+		}
+		free_ = first;
+	}
+
+	const uint32_t index = free_;
+	free_ = frame(index).next;
+	return index;
+}
+
+void BehaviourScheduler::schedule(const uint32_t index, const int ticks)
+{
+	frame(index).due = now_ + std::max(ticks, 1);
+	link(index);
+}
+
+void BehaviourScheduler::link(const uint32_t index)
+{
+	// Waits within the first wheel go straight in it. Longer ones go in the
+	// second, under the run of ticks they're due in, which always starts
+	// after now, since the current run's list has already been emptied.
+	Frame& frame = this->frame(index);
+	uint32_t& first = frame.due - now_ < WHEEL_SIZE
+		? wheel_[frame.due % WHEEL_SIZE]
+		: slowWheel_[frame.due / WHEEL_SIZE % WHEEL_SIZE];
+	frame.next = first;
+	first = index;
+}
+
+void BehaviourScheduler::tick()
+{
+	TRACE_SCOPE("behaviour tick");
+
+	++now_;
+	resumed_ = 0;
+
+	// At the start of each run of ticks, the long waits due in it move to
+	// the first wheel. Any due in a later turn of the second wheel go back
+	// where they were.
+	if (now_ % WHEEL_SIZE == 0)
+	{
+		uint32_t index = slowWheel_[now_ / WHEEL_SIZE % WHEEL_SIZE];
+		slowWheel_[now_ / WHEEL_SIZE % WHEEL_SIZE] = NONE;
+		while (index != NONE)
+		{
+			const uint32_t next = frame(index).next;
+			link(index);
+			index = next;
+		}
+	}
+
+	// Everything in this tick's list is due now. Take the whole list first,
+	// since scripts resumed here can be put back on other lists.
+	uint32_t index = wheel_[now_ % WHEEL_SIZE];
+	wheel_[now_ % WHEEL_SIZE] = NONE;
+
+	while (index != NONE)
+	{
+		Frame& frame = this->frame(index);
+		const uint32_t next = frame.next;
+
+		++resumed_;
+		const int ticks = frame.script->resume(*frame.agent, now_);
+		if (ticks == BehaviourScript::FINISHED)
+		{
+			frame.script->~BehaviourScript();
+			frame.next = free_;
+			free_ = index;
+			--running_;
+		}
+		else
+		{
+			schedule(index, ticks);
+		}
+		index = next;
+	}
+}
+
+//
+// Patrol
+//
+
+int Patrol::resume(Agent& agent, const uint64_t now)
+{
+	SCRIPT_BEGIN
+	home_ = agent.position(now);
+	SCRIPT_AWAIT(delay_);
+
+	for (;;)
+	{
+		SCRIPT_AWAIT(agent.walkTo(now, target_));
+		SCRIPT_AWAIT(agent.turnBy(now, 180.0f));
+		SCRIPT_AWAIT(agent.wave(now));
+		SCRIPT_AWAIT(agent.wait(now, pause_));
+
+		SCRIPT_AWAIT(agent.walkTo(now, home_));
+		SCRIPT_AWAIT(agent.turnBy(now, 180.0f));
+		SCRIPT_AWAIT(agent.wait(now, pause_));
+	}
+	SCRIPT_END
+}
+
+//
+// AgentRig
+//
+
+// Where a robot is in the world, which isn't its position once it's turned
+static float3 placement(const Robot& robot)
+{
+	const float* m = robot.worldMatrix().m;
+	return float3(m[12], m[13], m[14]);
+}
+
+// Which way a robot faces, as a heading
+static float facing(const Robot& robot)
+{
+	const float3 forward = robot.getRot().rotate(float3(0, 0, 1));
+	return atan2f(forward.x, forward.z) / DEGREES_TO_RADIANS;
+}
+
+AgentRig::AgentRig(Robot& robot, const AgentGait& gait, Animation* walk, Animation* wave)
+	: robot_(robot), agent_(gait, placement(robot), facing(robot)), walk_(walk), stand_(new Animation(robot)), wave_(wave), blend_(robot)
+{
+	// Standing is the pose the other animations start from, held
+	AnimationClip& clip = stand_->clip();
+	stand_->addKeyframe(clip.addKeyframe(1));
+	stand_->initialize();
+
+	walkLayer_ = blend_.addLayer(*walk_, 0.0f);
+	standLayer_ = blend_.addLayer(*stand_, 1.0f);
+	waveLayer_ = blend_.addLayer(*wave_, 0.0f, AnimationBlend::ADDITIVE);
+	actionStart_ = agent_.actionStart();
+}
+
+AgentRig::~AgentRig()
+{
+	delete walk_;
+	delete stand_;
+	delete wave_;
+}
+
+void AgentRig::animate(const uint64_t tick, const int steps)
+{
+	// Each new action fades to the gait that suits it. Weights are set by
+	// hand before fading, since that would end the fade.
+	if (agent_.actionStart() != actionStart_)
+	{
+		actionStart_ = agent_.actionStart();
+
+		blend_.setWeight(waveLayer_, 0.0f);
+		if (agent_.action() == Agent::WAVE)
+		{
+			wave_->rewind();
+			blend_.setWeight(waveLayer_, 1.0f);
+		}
+		blend_.crossFade(agent_.action() == Agent::WALK ? walkLayer_ : standLayer_, FADE_STEPS);
+	}
+
+	// The animations pose the joints, and the plan moves the robot. Robots
+	// turn their position along with them, about a point 2.5 up (see
+	// Robot::buildWorldMatrix), so it's turned back to land where the agent is.
+	blend_.animate(steps);
+	const quat rotation = quat::axisAngle(agent_.heading(tick), float3(0, 1, 0));
+	const float3 pivot(0, 2.5f, 0);
+	robot_.setPose(rotation.conjugate().rotate(agent_.position(tick) - pivot) + pivot, rotation, robot_.getScale());
+}
+
+int AgentRig::waveSteps() const
+{
+	const AnimationCurves& curves = wave_->curves();
+	int steps = 0;
+	for (size_t segment = 0; segment < curves.segmentCount(); ++segment)
+	{
+		steps += curves.segmentSteps(segment);
+	}
+	return steps;
+}
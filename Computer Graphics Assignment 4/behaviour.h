@@ -0,0 +1,257 @@
+// Header file for scripting what robots do over time
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef BEHAVIOUR_H
+#define BEHAVIOUR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+#include "animation.h"
+#include "vectorMath.h"
+
+// How fast agents do things, in animation steps, so they match the
+// animations that show them doing it
+struct AgentGait
+{
+	float walkSpeed = 0.025f;	// Distance per step
+	float turnSpeed = 4.0f;		// Degrees per step
+	int waveSteps = 150;		// How long a wave takes
+};
+
+// What a script moves around: a plan of what the agent is doing, from when
+// until when, and where that takes it. Scripts change the plan through the
+// actions, each of which returns how many ticks it takes, so the script can
+// wait for exactly that long. Where the agent is at any tick is worked out
+// from the plan when it's needed, so an agent costs nothing between its
+// script's resumes.
+class Agent
+{
+public:
+	enum Action : uint8_t
+	{
+		STAND,
+		WALK,	// Turning to face where it's going on the way
+		TURN,
+		WAVE
+	};
+
+	// Headings are degrees about y, with 0 facing +z
+	Agent(const AgentGait& gait, const float3& position = float3(), const float heading = 0.0f);
+
+	// Each starts at now, from wherever the current action has got to
+	int walkTo(const uint64_t now, const float3& target);
+	int turnTo(const uint64_t now, const float heading);
+	int turnBy(const uint64_t now, const float degrees);
+	int wave(const uint64_t now);
+	int wait(const uint64_t now, const double seconds);
+
+	// Where the plan has the agent at tick. Past the end of the action it
+	// stays where the action finished.
+	float3 position(const uint64_t tick) const;
+	float heading(const uint64_t tick) const;
+
+	Action action() const { return action_; }
+	uint64_t actionStart() const { return start_; }
+
+private:
+	// Replaces the action with one that lasts ticks from now, turning to
+	// heading over turnTicks of them
+	int plan(const uint64_t now, const Action action, const float3& to, const float heading, int ticks, const int turnTicks);
+
+	// Ticks the gait needs to turn from the current heading to heading
+	int turnTicks(const uint64_t now, const float heading) const;
+
+	const AgentGait* gait_;
+	float3 from_;
+	float3 to_;
+	float fromHeading_;
+	float toHeading_;		// Within 180 of fromHeading_, so it turns the short way
+	uint64_t start_ = 0;
+	uint64_t end_ = 0;
+	uint64_t turnEnd_ = 0;
+	Action action_ = STAND;
+};
+
+// A script: a function that can suspend partway through and carry on from
+// there at a later tick, without a stack of its own. Locals that live past
+// an await have to be members, since resume() returns at each one. The body
+// goes between SCRIPT_BEGIN and SCRIPT_END, and can loop and branch around
+// the awaits like any other code:
+//
+//	int resume(Agent& agent, const uint64_t now) override
+//	{
+//		SCRIPT_BEGIN
+//		for (laps_ = 0; laps_ < 3; ++laps_)
+//		{
+//			SCRIPT_AWAIT(agent.walkTo(now, target_));
+//			SCRIPT_AWAIT(agent.wait(now, 2.0));
+//		}
+//		SCRIPT_END
+//	}
+//
+// Scripts live in the scheduler's frames, so they have to fit in one.
+class BehaviourScript
+{
+public:
+	static const int FINISHED = -1;
+
+	virtual ~BehaviourScript() {}
+
+	// Runs until the next await, and returns how many ticks that waits, or
+	// FINISHED once the end is reached
+	virtual int resume(Agent& agent, const uint64_t now) = 0;
+
+protected:
+	int resumeAt_ = 0;	// Which await to carry on after, or 0 to start
+};
+
+// Each await is a case of one switch, numbered by __COUNTER__ (not
+// __LINE__, which isn't a constant with edit and continue on), so resuming
+// jumps straight back in after the await it left from
+#define SCRIPT_BEGIN switch (resumeAt_) { case 0:
+#define SCRIPT_AWAIT(ticks) SCRIPT_AWAIT_AT(ticks, __COUNTER__ + 1)
+#define SCRIPT_AWAIT_AT(ticks, label) do { resumeAt_ = label; return (ticks); case label:; } while (false)
+#define SCRIPT_END } resumeAt_ = -1; return BehaviourScript::FINISHED;
+
+// Resumes scripts once a tick, but only the ones whose wait is over. Waiting
+// scripts sit in a timer wheel with a list for each of the next WHEEL_SIZE
+// ticks, so a tick only touches the scripts it resumes. Longer waits sit in
+// a second wheel with a list for each of the next WHEEL_SIZE runs of
+// WHEEL_SIZE ticks, and are only moved to the first as their run starts,
+// so they cost nothing until then. Only waits longer than the second wheel
+// goes round, over 18 minutes, are ever looked at more than twice. Scripts
+// are kept in fixed-size frames pooled in blocks, which are reused as
+// scripts finish, so once the number of scripts settles nothing is
+// allocated.
+class BehaviourScheduler
+{
+public:
+	static const size_t FRAME_BYTES = 64;	// Most a script can take up
+	static const size_t WHEEL_SIZE = 256;	// Ticks, a little over 4 seconds
+
+	BehaviourScheduler();
+	~BehaviourScheduler();
+	BehaviourScheduler(const BehaviourScheduler&) = delete;
+	BehaviourScheduler& operator=(const BehaviourScheduler&) = delete;
+
+	// Starts a script for agent, which has to stay around until it
+	// finishes. Its first resume is at the next tick.
+	template <typename Script, typename... Args>
+	void spawn(Agent& agent, Args&&... args)
+	{
+		static_assert(sizeof(Script) <= FRAME_BYTES, "Script is too big for a behaviour frame");
+		static_assert(alignof(Script) <= alignof(Frame), "Script needs more alignment than a behaviour frame has");
+
+		const uint32_t index = allocate();
+		Frame& frame = this->frame(index);
+		frame.script = new (frame.storage) Script(std::forward<Args>(args)...);
+		frame.agent = &agent;
+		schedule(index, 1);
+		++running_;
+	}
+
+	// Moves on a tick and resumes every script that's due
+	void tick();
+
+	uint64_t now() const { return now_; }
+	size_t running() const { return running_; }
+	size_t resumed() const { return resumed_; }	// In the last tick
+
+	// Memory the frames take up, used or not
+	size_t bytes() const { return blocks_.size() * FRAMES_PER_BLOCK * sizeof(Frame); }
+
+private:
+	struct alignas(16) Frame
+	{
+		unsigned char storage[FRAME_BYTES];	// The script itself
+		BehaviourScript* script;
+		Agent* agent;
+		uint64_t due;
+		uint32_t next;	// In its wheel list, or the free list
+	};
+
+	static const uint32_t NONE = 0xffffffff;
+	static const size_t FRAMES_PER_BLOCK = 1024;
+
+	Frame& frame(const uint32_t index) { return blocks_[index / FRAMES_PER_BLOCK][index % FRAMES_PER_BLOCK]; }
+
+	uint32_t allocate();
+	void schedule(const uint32_t index, const int ticks);
+
+	// Adds the frame to whichever wheel list its due tick belongs in
+	void link(const uint32_t index);
+
+	// Blocks never move once allocated, so frames stay put while a script
+	// that's running spawns another
+	std::vector<std::unique_ptr<Frame[]>> blocks_;
+	uint32_t free_ = NONE;
+	uint32_t wheel_[WHEEL_SIZE];		// The first frame due at each tick, modulo the wheel
+	uint32_t slowWheel_[WHEEL_SIZE];	// The first frame due in each run of WHEEL_SIZE ticks, modulo the wheel
+	uint64_t now_ = 0;
+	size_t running_ = 0;
+	size_t resumed_ = 0;
+};
+
+// Walks between where the agent starts and target, turning round, waving
+// and waiting at each end, forever. Starts after a delay, so agents spawned
+// together don't all move in step.
+class Patrol : public BehaviourScript
+{
+public:
+	Patrol(const float3& target, const double pause, const int delay) : target_(target), pause_(pause), delay_(delay) {}
+
+	int resume(Agent& agent, const uint64_t now) override;
+
+private:
+	float3 target_;
+	float3 home_;
+	double pause_;	// Seconds spent standing after each wave
+	int delay_;		// Ticks before setting off
+};
+
+// Poses a robot as its agent's plan has it, with the robot's own animations:
+// walking in place while the agent walks, standing still otherwise, and a
+// wave added on top while it waves. Where the robot is and which way it
+// faces come from the plan, not the animations.
+class AgentRig
+{
+public:
+	// Takes walk and wave, which have to be of robot and initialized, and
+	// deletes them along with the rig. walk shouldn't move the robot.
+	AgentRig(Robot& robot, const AgentGait& gait, Animation* walk, Animation* wave);
+	~AgentRig();
+	AgentRig(const AgentRig&) = delete;
+	AgentRig& operator=(const AgentRig&) = delete;
+
+	Agent& agent() { return agent_; }
+
+	// Steps the animations steps animation steps, and poses the robot where
+	// the agent is at tick
+	void animate(const uint64_t tick, const int steps = 1);
+
+	// Animation steps the wave animation lasts, for the gait
+	int waveSteps() const;
+
+private:
+	// Steps to fade between walking and standing over
+	static const int FADE_STEPS = 10;
+
+	Robot& robot_;
+	Agent agent_;
+	Animation* walk_;
+	Animation* stand_;
+	Animation* wave_;
+	AnimationBlend blend_;
+	size_t walkLayer_;
+	size_t standLayer_;
+	size_t waveLayer_;
+	uint64_t actionStart_;	// Of the action the layers were last set up for
+};
+
+#endif // BEHAVIOUR_H
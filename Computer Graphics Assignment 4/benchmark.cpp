@@ -0,0 +1,249 @@
+// Implementations for the frame benchmark harness
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#include "benchmark.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+DrawCounters drawCounters;
+
+double processCpuSeconds()
+{
+#ifdef _WIN32
+	FILETIME created, exited, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+	{
+		return 0.0;
+	}
+	// FILETIMEs count 100 ns intervals
+	const double kernelTicks = (double)(((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime);
+	const double userTicks = (double)(((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime);
+	return (kernelTicks + userTicks) * 1e-7;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0.0;
+	}
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+#ifdef __linux__
+
+CacheMissCounter::CacheMissCounter()
+{
+	perf_event_attr attributes;
+	memset(&attributes, 0, sizeof(attributes));
+	attributes.size = sizeof(attributes);
+	attributes.type = PERF_TYPE_HARDWARE;
+	attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+	attributes.disabled = 1;
+	attributes.exclude_kernel = 1;
+	attributes.exclude_hv = 1;
+	fd_ = (int)syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+}
+
+CacheMissCounter::~CacheMissCounter()
+{
+	if (fd_ >= 0)
+	{
+		close(fd_);
+	}
+}
+
+void CacheMissCounter::start()
+{
+	if (fd_ >= 0)
+	{
+		ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+long long CacheMissCounter::stop()
+{
+	if (fd_ < 0)
+	{
+		return -1;
+	}
+	ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+	long long misses = 0;
+	if (read(fd_, &misses, sizeof(misses)) != sizeof(misses))
+	{
+		return -1;
+	}
+	return misses;
+}
+
+#else
+
+CacheMissCounter::CacheMissCounter() {}
+CacheMissCounter::~CacheMissCounter() {}
+void CacheMissCounter::start() {}
+long long CacheMissCounter::stop() { return -1; }
+
+#endif
+
+CameraPath& CameraPath::addKey(const float time, const float3& value)
+{
+	std::vector<std::pair<float, float3>>::iterator it = keys_.begin();
+	while (it != keys_.end() && it->first <= time)
+	{
+		++it;
+	}
+	keys_.insert(it, std::make_pair(time, value));
+	return *this;
+}
+
+float3 CameraPath::at(const float time) const
+{
+	if (keys_.empty())
+	{
+		return float3();
+	}
+	if (time <= keys_.front().first)
+	{
+		return keys_.front().second;
+	}
+
+	for (size_t i = 1; i < keys_.size(); ++i)
+	{
+		if (time < keys_[i].first)
+		{
+			const float3& a = keys_[i - 1].second;
+			const float3& b = keys_[i].second;
+			const float t = (time - keys_[i - 1].first) / (keys_[i].first - keys_[i - 1].first);
+			return a + (b - a) * t;
+		}
+	}
+	return keys_.back().second;
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const std::vector<double>& sorted, const double p)
+{
+	if (sorted.empty())
+	{
+		return 0.0;
+	}
+	const size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+	return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+// Escapes quotes and backslashes in driver strings
+static std::string jsonString(const std::string& value)
+{
+	std::string escaped = "\"";
+	for (char c : value)
+	{
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		escaped += c;
+	}
+	return escaped + "\"";
+}
+
+bool FrameBenchmark::writeJson(const std::string& path, const BenchmarkInfo& info) const
+{
+	std::vector<double> times;
+	double totalMs = 0.0;
+	long long drawCalls = 0, vertices = 0, stateChanges = 0, culled = 0;
+	long long matricesDirty = 0, matricesClean = 0;
+	double animationMs = 0.0;
+	long long robotsVisible = 0, robotsUpdated = 0;
+	long long minDrawCalls = 0, maxDrawCalls = 0;
+	long long heapAllocations = 0, maxHeapAllocations = 0;
+	bool countedAllocations = !frames_.empty();
+	for (const Frame& frame : frames_)
+	{
+		times.push_back(frame.cpuMs);
+		totalMs += frame.cpuMs;
+		drawCalls += frame.drawCalls;
+		vertices += frame.vertices;
+		stateChanges += frame.stateChanges;
+		culled += frame.culled;
+		matricesDirty += frame.matricesDirty;
+		matricesClean += frame.matricesClean;
+		animationMs += frame.animationMs;
+		robotsVisible += frame.robotsVisible;
+		robotsUpdated += frame.robotsUpdated;
+		minDrawCalls = times.size() == 1 ? frame.drawCalls : std::min(minDrawCalls, frame.drawCalls);
+		maxDrawCalls = std::max(maxDrawCalls, frame.drawCalls);
+		countedAllocations = countedAllocations && frame.heapAllocations >= 0;
+		heapAllocations += frame.heapAllocations;
+		maxHeapAllocations = std::max(maxHeapAllocations, frame.heapAllocations);
+	}
+	std::sort(times.begin(), times.end());
+	const double count = std::max((double)frames_.size(), 1.0);
+
+	std::ostringstream json;
+	json << "{" << std::endl
+		<< "  \"scene\": { \"robots\": " << info.robots << ", \"trees\": " << info.trees << " }," << std::endl
+		<< "  \"resolution\": [" << info.width << ", " << info.height << "]," << std::endl
+		<< "  \"renderer\": " << jsonString(info.renderer) << "," << std::endl
+		<< "  \"warmupFrames\": " << info.warmupFrames << "," << std::endl
+		<< "  \"frames\": " << frames_.size() << "," << std::endl
+		<< "  \"cpuFrameMs\": {" << std::endl
+		<< "    \"mean\": " << totalMs / count << "," << std::endl
+		<< "    \"p50\": " << percentile(times, 50) << "," << std::endl
+		<< "    \"p95\": " << percentile(times, 95) << "," << std::endl
+		<< "    \"p99\": " << percentile(times, 99) << "," << std::endl
+		<< "    \"max\": " << (times.empty() ? 0.0 : times.back()) << std::endl
+		<< "  }," << std::endl
+		<< "  \"drawCalls\": { \"total\": " << drawCalls << ", \"perFrame\": " << drawCalls / count
+		<< ", \"min\": " << minDrawCalls << ", \"max\": " << maxDrawCalls << " }," << std::endl
+		<< "  \"vertices\": { \"total\": " << vertices << ", \"perFrame\": " << vertices / count << " }," << std::endl
+		<< "  \"stateChanges\": { \"total\": " << stateChanges << ", \"perFrame\": " << stateChanges / count << " }," << std::endl
+		<< "  \"culled\": { \"total\": " << culled << ", \"perFrame\": " << culled / count << " }," << std::endl
+		<< "  \"worldMatrices\": { \"dirty\": " << matricesDirty << ", \"clean\": " << matricesClean
+		<< ", \"dirtyPerFrame\": " << matricesDirty / count << " }," << std::endl
+		<< "  \"animation\": { \"msPerFrame\": " << animationMs / count
+		<< ", \"visibleRobots\": " << robotsVisible / count << ", \"updatedRobots\": " << robotsUpdated / count
+		<< ", \"usPerVisibleRobot\": " << (robotsVisible > 0 ? animationMs * 1000.0 / robotsVisible : 0.0) << " }";
+	if (countedAllocations)
+	{
+		json << "," << std::endl
+			<< "  \"heapAllocations\": { \"total\": " << heapAllocations << ", \"max\": " << maxHeapAllocations << " }";
+	}
+	json << std::endl << "}" << std::endl;
+
+	if (path.empty())
+	{
+		std::cout << json.str();
+		return true;
+	}
+
+	std::ofstream file(path);
+	if (!file)
+	{
+		std::cerr << "Failed to open " << path << " for writing" << std::endl;
+		return false;
+	}
+	file << json.str();
+	return true;
+}
@@ -0,0 +1,116 @@
+// Header file for the frame benchmark harness
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "vectorMath.h"
+
+// Work submitted to GL since the counters were last cleared. Every
+// glBegin/glEnd pair in the scene calls countDraw() with its vertex count,
+// and every texture bind or glEnable/glDisable calls countStateChange().
+struct DrawCounters
+{
+	long long drawCalls = 0;
+	long long vertices = 0;
+	long long stateChanges = 0;
+	long long culled = 0;		// Parts skipped for being outside the view
+};
+
+extern DrawCounters drawCounters;
+
+inline void countDraw(const int vertices)
+{
+	++drawCounters.drawCalls;
+	drawCounters.vertices += vertices;
+}
+
+inline void countStateChange()
+{
+	++drawCounters.stateChanges;
+}
+
+// CPU time the whole process has used so far, across all threads, in seconds
+double processCpuSeconds();
+
+// Counts the calling thread's last-level cache misses with the CPU's
+// performance counters. Only Linux lets a process read those directly, and
+// only when the kernel and any hypervisor expose them, so check available().
+class CacheMissCounter
+{
+public:
+	CacheMissCounter();
+	~CacheMissCounter();
+	CacheMissCounter(const CacheMissCounter&) = delete;
+	CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+	bool available() const { return fd_ >= 0; }
+
+	// Misses between start() and stop(), or -1 if they can't be counted
+	void start();
+	long long stop();
+
+private:
+	int fd_ = -1;
+};
+
+// A scripted path for a camera value (a position or spherical coordinates),
+// linearly interpolated between keys. Keys are placed by how far through
+// the run they are, from 0 to 1, so the same path fits any frame count.
+class CameraPath
+{
+public:
+	CameraPath& addKey(const float time, const float3& value);
+	float3 at(const float time) const;
+
+private:
+	std::vector<std::pair<float, float3>> keys_; // Sorted by time
+};
+
+// What a benchmark run was measuring, written alongside its results
+struct BenchmarkInfo
+{
+	int robots = 0;
+	int trees = 0;
+	int width = 0;
+	int height = 0;
+	int warmupFrames = 0;
+	std::string renderer;
+};
+
+// Collects per-frame measurements and reports them as JSON. Frame times
+// vary run to run, but the counters are exact, so those can be compared
+// directly against a baseline.
+class FrameBenchmark
+{
+public:
+	struct Frame
+	{
+		double cpuMs;			// Updating and submitting the frame
+		long long drawCalls;
+		long long vertices;
+		long long stateChanges;
+		long long culled;
+		long long matricesDirty;	// World matrices rebuilt
+		long long matricesClean;	// World matrices reused from the cache
+		double animationMs;		// The simulation's last step
+		int robotsVisible;
+		int robotsUpdated;		// In that step
+		long long heapAllocations;	// -1 if they weren't counted
+	};
+
+	void addFrame(const Frame& frame) { frames_.push_back(frame); }
+
+	// Writes to stdout if path is empty. Returns false if it can't be written.
+	bool writeJson(const std::string& path, const BenchmarkInfo& info) const;
+
+private:
+	std::vector<Frame> frames_;
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,208 @@
+// Implementations for the per-frame arena
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#include "frameArena.h"
+
+#include <stdlib.h>
+
+// Rounds address up to a multiple of alignment, which is a power of two
+static size_t alignUp(const size_t address, const size_t alignment)
+{
+	return (address + alignment - 1) & ~(alignment - 1);
+}
+
+//
+// LinearArena
+//
+
+LinearArena::LinearArena(const size_t capacity)
+{
+	reserve(capacity);
+}
+
+LinearArena::~LinearArena()
+{
+	for (void* raw : overflow_)
+	{
+		::operator delete(raw);
+	}
+	::operator delete(rawBlock_);
+}
+
+void* LinearArena::allocate(const size_t size, const size_t alignment)
+{
+	size_t offset = offset_.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		const size_t start = alignUp((size_t)block_ + offset, alignment) - (size_t)block_;
+		if (block_ == nullptr || start + size > capacity_)
+		{
+			return allocateOverflow(size, alignment);
+		}
+		if (offset_.compare_exchange_weak(offset, start + size, std::memory_order_relaxed))
+		{
+			return block_ + start;
+		}
+	}
+}
+
+void* LinearArena::allocateOverflow(const size_t size, const size_t alignment)
+{
+	std::lock_guard<std::mutex> lock(overflowMutex_);
+	void* raw = ::operator new(size + alignment);
+	overflow_.push_back(raw);
+	overflowBytes_ += size + alignment;
+	return (void*)alignUp((size_t)raw, alignment);
+}
+
+void LinearArena::reset()
+{
+	const size_t needed = std::min(offset_.load(std::memory_order_relaxed), capacity_) + overflowBytes_;
+	highWater_ = std::max(highWater_, needed);
+
+	for (void* raw : overflow_)
+	{
+		::operator delete(raw);
+	}
+	overflow_.clear();
+	offset_.store(0, std::memory_order_relaxed);
+
+	// Leave some room so a frame that grows a little doesn't overflow again
+	if (overflowBytes_ > 0)
+	{
+		overflowBytes_ = 0;
+		reserve(highWater_ + highWater_ / 2);
+	}
+}
+
+void LinearArena::reserve(const size_t capacity)
+{
+	if (capacity <= capacity_)
+	{
+		return;
+	}
+
+	::operator delete(rawBlock_);
+	rawBlock_ = ::operator new(capacity + BLOCK_ALIGNMENT);
+	block_ = (char*)alignUp((size_t)rawBlock_, BLOCK_ALIGNMENT);
+	capacity_ = capacity;
+}
+
+//
+// FrameArenas
+//
+
+FrameArenas frameArenas(1 << 20);
+
+FrameArenas::FrameArenas(const size_t capacity)
+{
+	arenas_[0].reserve(capacity);
+	arenas_[1].reserve(capacity);
+}
+
+void FrameArenas::beginFrame()
+{
+	current_ ^= 1;
+	arenas_[current_].reset();
+}
+
+//
+// Heap allocation counting
+//
+
+#ifdef ENABLE_ALLOC_COUNTING
+
+static std::atomic<long long> allocationCount{ 0 };
+
+long long heapAllocations()
+{
+	return allocationCount.load(std::memory_order_relaxed);
+}
+
+// Replacing the plain forms replaces every form of new and delete that
+// isn't over-aligned, since the rest forward to these
+void* operator new(size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (size == 0)
+	{
+		size = 1;
+	}
+	for (;;)
+	{
+		void* memory = malloc(size);
+		if (memory != nullptr)
+		{
+			return memory;
+		}
+		std::new_handler handler = std::get_new_handler();
+		if (handler == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+		handler();
+	}
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return operator new(size);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new[](size_t size, const std::nothrow_t& nothrow) noexcept
+{
+	return operator new(size, nothrow);
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	free(memory);
+}
+
+#else
+
+long long heapAllocations()
+{
+	return -1;
+}
+
+#endif
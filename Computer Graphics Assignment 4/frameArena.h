@@ -0,0 +1,138 @@
+// Header file for the per-frame arena that transient data is allocated from
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Hands out memory by bumping an offset through one block, and takes all of
+// it back at once with reset(). Nothing is freed on its own. Allocating is
+// a single atomic add, so several threads can share an arena.
+//
+// If a frame needs more than the block holds, the rest comes from the heap
+// for that frame, and the next reset() replaces the block with one big
+// enough for the whole frame. So the heap is only touched while the frame's
+// size is still growing.
+class LinearArena
+{
+public:
+	explicit LinearArena(const size_t capacity = 0);
+	~LinearArena();
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	// Never returns null. alignment has to be a power of two.
+	void* allocate(const size_t size, const size_t alignment = alignof(std::max_align_t));
+
+	// Only while nothing else is allocating. Everything allocated since the
+	// last reset is gone afterwards.
+	void reset();
+
+	// Replaces the block with one of at least capacity bytes. Only right
+	// after a reset.
+	void reserve(const size_t capacity);
+
+	size_t capacity() const { return capacity_; }
+	size_t used() const { return std::min(offset_.load(std::memory_order_relaxed), capacity_); }
+	size_t highWater() const { return highWater_; }		// Most any frame has needed
+	size_t overflowed() const { return overflowBytes_; }	// Bytes from the heap since the last reset
+
+private:
+	static const size_t BLOCK_ALIGNMENT = 64;
+
+	void* allocateOverflow(const size_t size, const size_t alignment);
+
+	void* rawBlock_ = nullptr;	// What block_ was carved from
+	char* block_ = nullptr;
+	size_t capacity_ = 0;
+	std::atomic<size_t> offset_{ 0 };
+	size_t highWater_ = 0;
+
+	std::mutex overflowMutex_;
+	std::vector<void*> overflow_;
+	size_t overflowBytes_ = 0;
+};
+
+// Two arenas, swapped each frame. Whatever was allocated during a frame is
+// still there through the next one, so work that trails a frame (drawing
+// what the last frame built, say) can keep reading it.
+class FrameArenas
+{
+public:
+	explicit FrameArenas(const size_t capacity = 0);
+
+	// Makes the older arena current and empties it. Only between frames.
+	void beginFrame();
+
+	LinearArena& current() { return arenas_[current_]; }
+	const LinearArena& previous() const { return arenas_[current_ ^ 1]; }
+
+private:
+	LinearArena arenas_[2];
+	int current_ = 0;
+};
+
+// What transient per-frame data is allocated from. main.cpp calls
+// beginFrame() at the start of every frame.
+extern FrameArenas frameArenas;
+
+// A standard allocator that takes memory from an arena and never gives it
+// back, so containers using it don't touch the heap. A container has to be
+// done with before its arena is reset.
+template <typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	// Containers take their allocator along when moved or swapped, so one
+	// built in this frame's arena can replace one from the last frame's
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	// The current frame's arena unless told otherwise
+	ArenaAllocator() : arena_(&frameArenas.current()) {}
+	explicit ArenaAllocator(LinearArena& arena) : arena_(&arena) {}
+
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+	T* allocate(const size_t count)
+	{
+		return static_cast<T*>(arena_->allocate(count * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T*, size_t) {}
+
+	LinearArena* arena() const { return arena_; }
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return arena_ == other.arena(); }
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return arena_ != other.arena(); }
+
+private:
+	LinearArena* arena_;
+};
+
+// A vector whose storage lives in the arena of the frame it was made in
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+// Global operator new calls so far, on every thread. They're only counted
+// when ENABLE_ALLOC_COUNTING is defined (the Debug configurations define
+// it), and this returns -1 otherwise.
+long long heapAllocations();
+
+#endif // FRAME_ARENA_H
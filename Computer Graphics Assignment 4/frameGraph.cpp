@@ -0,0 +1,230 @@
+// Implementations for the frame graph scheduler
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#include "frameGraph.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <iostream>
+#include "trace.h"
+
+typedef std::chrono::steady_clock Clock;
+
+void FrameGraph::clear()
+{
+	count_ = 0;
+}
+
+FrameGraph::StageID FrameGraph::newStage(const char* name, std::initializer_list<StageID> dependencies)
+{
+	if (count_ == (int)stages_.size())
+	{
+		stages_.emplace_back();
+	}
+
+	const StageID id = count_++;
+	Stage& stage = stages_[id];
+	stage.name = name;
+	stage.parallel = false;
+	stage.jobs = 1;
+	stage.affinity = Affinity::ANY;
+	stage.dependents.clear();
+	stage.dependencies = 0;
+	stage.startMs = 0.0;
+	stage.ms = 0.0;
+	stage.thread = NO_THREAD;
+
+	for (const StageID dependency : dependencies)
+	{
+		if (dependency < 0 || dependency >= id)
+		{
+			std::cerr << "ERROR: frame graph stage " << name << " depends on a stage added after it" << std::endl;
+			continue;
+		}
+		stages_[dependency].dependents.push_back(id);
+		++stage.dependencies;
+	}
+	return id;
+}
+
+FrameGraph::StageID FrameGraph::addStage
+(
+	const char* name,
+	const std::function<void()>& work,
+	std::initializer_list<StageID> dependencies,
+	const Affinity affinity
+)
+{
+	const StageID id = newStage(name, dependencies);
+	stages_[id].work = work;
+	stages_[id].affinity = affinity;
+	return id;
+}
+
+FrameGraph::StageID FrameGraph::addParallelStage
+(
+	const char* name,
+	const int jobCount,
+	const std::function<void(int index, int thread)>& work,
+	std::initializer_list<StageID> dependencies
+)
+{
+	const StageID id = newStage(name, dependencies);
+	stages_[id].parallelWork = work;
+	stages_[id].parallel = true;
+	stages_[id].jobs = std::max(jobCount, 0);
+	return id;
+}
+
+void FrameGraph::run(ThreadPool& pool)
+{
+	TRACE_SCOPE("frame graph");
+	start_ = Clock::now();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		ready_.clear();
+		readyForContext_.clear();
+		finished_ = 0;
+		for (StageID i = 0; i < count_; ++i)
+		{
+			stages_[i].waiting = stages_[i].dependencies;
+			stages_[i].nextJob = 0;
+			stages_[i].jobsLeft = stages_[i].jobs;
+		}
+		for (StageID i = 0; i < count_; ++i)
+		{
+			if (stages_[i].dependencies == 0)
+			{
+				makeReady(i);
+			}
+		}
+	}
+
+	// One job per thread, each of which runs stages until there are none
+	// left. The pool always runs the caller's share as thread 0.
+	pool.parallelFor(pool.size(), [this](int /*index*/, int thread) { runStages(thread); });
+
+	runMs_ = std::chrono::duration<double, std::milli>(Clock::now() - start_).count();
+}
+
+void FrameGraph::makeReady(const StageID stage)
+{
+	if (stages_[stage].jobs == 0)
+	{
+		// A parallel stage with nothing to do is done as soon as it can start
+		stages_[stage].thread = 0;
+		finishStage(stage);
+	}
+	else if (stages_[stage].affinity == Affinity::CONTEXT)
+	{
+		readyForContext_.push_back(stage);
+	}
+	else
+	{
+		ready_.push_back(stage);
+	}
+}
+
+void FrameGraph::finishStage(const StageID stage)
+{
+	++finished_;
+	for (const StageID dependent : stages_[stage].dependents)
+	{
+		if (--stages_[dependent].waiting == 0)
+		{
+			makeReady(dependent);
+		}
+	}
+}
+
+void FrameGraph::runStages(const int thread)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (finished_ < count_)
+	{
+		// The context thread takes its own stages first, since nobody else
+		// can. A parallel stage stays ready until all its jobs are taken.
+		StageID id = -1;
+		int job = 0;
+		if (thread == 0 && !readyForContext_.empty())
+		{
+			id = readyForContext_.back();
+			readyForContext_.pop_back();
+		}
+		else if (!ready_.empty())
+		{
+			id = ready_.back();
+			job = stages_[id].nextJob++;
+			if (stages_[id].nextJob == stages_[id].jobs)
+			{
+				ready_.pop_back();
+			}
+		}
+
+		if (id < 0)
+		{
+			changed_.wait(lock);
+			continue;
+		}
+		lock.unlock();
+
+		Stage& stage = stages_[id];
+		const Clock::time_point start = Clock::now();
+		{
+			TRACE_SCOPE(stage.name);
+			if (stage.parallel)
+				stage.parallelWork(job, thread);
+			else
+				stage.work();
+		}
+		const double startMs = std::chrono::duration<double, std::milli>(start - start_).count();
+		const double endMs = std::chrono::duration<double, std::milli>(Clock::now() - start_).count();
+
+		lock.lock();
+
+		// A parallel stage spans its first job starting to its last ending
+		if (stage.thread == NO_THREAD)
+		{
+			stage.startMs = startMs;
+			stage.ms = endMs - startMs;
+			stage.thread = thread;
+		}
+		else
+		{
+			const double stageEndMs = std::max(stage.startMs + stage.ms, endMs);
+			stage.startMs = std::min(stage.startMs, startMs);
+			stage.ms = stageEndMs - stage.startMs;
+			if (stage.thread != thread)
+				stage.thread = -1;
+		}
+
+		if (--stage.jobsLeft == 0)
+		{
+			finishStage(id);
+			changed_.notify_all();
+		}
+	}
+}
+
+void FrameGraph::printTimings(std::ostream& out) const
+{
+	char line[256];
+	snprintf(line, sizeof(line), "%-20s %8s %8s %10s %10s\n", "Stage", "Jobs", "Thread", "Start ms", "ms");
+	out << line;
+	for (StageID i = 0; i < count_; ++i)
+	{
+		const Stage& stage = stages_[i];
+		char thread[16];
+		if (stage.thread == -1)
+			snprintf(thread, sizeof(thread), "several");
+		else
+			snprintf(thread, sizeof(thread), "%d", stage.thread);
+		snprintf(line, sizeof(line), "%-20s %8d %8s %10.3f %10.3f\n", stage.name, stage.jobs, thread, stage.startMs, stage.ms);
+		out << line;
+	}
+	snprintf(line, sizeof(line), "%-20s %8s %8s %10s %10.3f\n", "Whole graph", "", "", "", runMs_);
+	out << line;
+}
@@ -0,0 +1,120 @@
+// Header file for scheduling a frame's work as a graph of stages
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <ostream>
+#include <vector>
+#include "threadPool.h"
+
+// A frame's work split into stages, each of which starts once the stages it
+// depends on have finished. Stages that don't depend on each other run at
+// the same time on a thread pool, and a parallel stage is itself split into
+// jobs that any free thread can pick up. Stages that touch GL are pinned to
+// the thread that calls run(), which is the one holding the context.
+//
+// The graph is meant to be declared again each frame. clear() keeps the
+// storage from the last frame, so doing so doesn't allocate once the shape
+// of the frame settles.
+class FrameGraph
+{
+public:
+	typedef int StageID;
+
+	enum class Affinity
+	{
+		ANY,		// Any thread in the pool
+		CONTEXT		// Only the thread calling run()
+	};
+
+	// Forgets the stages, keeping their storage
+	void clear();
+
+	// Dependencies have to be added first, so the graph can't have cycles.
+	// The name is kept as a pointer for the trace, so it has to be a string
+	// literal.
+	StageID addStage
+	(
+		const char* name,
+		const std::function<void()>& work,
+		std::initializer_list<StageID> dependencies = {},
+		const Affinity affinity = Affinity::ANY
+	);
+
+	// A stage made of jobCount jobs, each called as work(index, thread).
+	// thread is unique among the jobs running at the same time, so it can
+	// pick per-thread scratch space, and is below the pool's size(). The
+	// stage finishes when every job has.
+	StageID addParallelStage
+	(
+		const char* name,
+		const int jobCount,
+		const std::function<void(int index, int thread)>& work,
+		std::initializer_list<StageID> dependencies = {}
+	);
+
+	// Runs every stage once, then returns. Each stage is a span in the
+	// trace when tracing is on.
+	void run(ThreadPool& pool);
+
+	// What the last run() did
+	int stageCount() const { return count_; }
+	const char* stageName(const StageID stage) const { return stages_[stage].name; }
+	double stageStartMs(const StageID stage) const { return stages_[stage].startMs; }	// Since run() started
+	double stageMs(const StageID stage) const { return stages_[stage].ms; }
+	int stageThread(const StageID stage) const { return stages_[stage].thread; }		// 0 is the caller, -1 several
+	double runMs() const { return runMs_; }
+
+	// One line per stage, in the order they were added
+	void printTimings(std::ostream& out) const;
+
+private:
+	struct Stage
+	{
+		const char* name;
+		std::function<void()> work;
+		std::function<void(int, int)> parallelWork;
+		bool parallel;
+		int jobs;
+		Affinity affinity;
+		std::vector<StageID> dependents;
+		int dependencies;
+		int waiting;		// Dependencies still running in this run()
+		int nextJob;
+		int jobsLeft;		// Jobs not finished yet
+		double startMs;
+		double ms;
+		int thread;			// NO_THREAD until a job has run
+	};
+
+	static const int NO_THREAD = -2;
+
+	StageID newStage(const char* name, std::initializer_list<StageID> dependencies);
+	void runStages(const int thread);
+	void makeReady(const StageID stage);
+	void finishStage(const StageID stage);
+
+	std::vector<Stage> stages_;		// Only the first count_ are in use
+	int count_ = 0;
+	double runMs_ = 0.0;
+
+	// Stages ready to run, finished count and waiting are all guarded by
+	// mutex_. There are only a handful of stages, so the lock is cheap next
+	// to the work in them.
+	std::mutex mutex_;
+	std::condition_variable changed_;
+	std::vector<StageID> ready_;
+	std::vector<StageID> readyForContext_;
+	int finished_ = 0;
+	std::chrono::steady_clock::time_point start_;
+};
+
+#endif // FRAME_GRAPH_H
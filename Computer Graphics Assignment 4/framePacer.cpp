@@ -0,0 +1,132 @@
+// Implementations for the fixed-step frame pacer
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#include "framePacer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+
+FramePacer::FramePacer(const double stepSeconds, const double frameSeconds)
+	: step_(toNanoseconds(stepSeconds)), interval_(toNanoseconds(frameSeconds)) {}
+
+int64_t FramePacer::toNanoseconds(const double seconds)
+{
+	return (int64_t)llround(seconds * 1e9);
+}
+
+void FramePacer::setFrameRate(const double framesPerSecond)
+{
+	if (framesPerSecond > 0.0)
+	{
+		interval_ = toNanoseconds(1.0 / framesPerSecond);
+	}
+}
+
+void FramePacer::restart(const double now)
+{
+	// The next frame still waits out the interval since the last one, so a
+	// burst of input right after a frame can't draw faster than the cap
+	simTime_ = toNanoseconds(now);
+	frameTime_ = simTime_;
+	counting_ = false;
+}
+
+bool FramePacer::frameDue(const double now) const
+{
+	return mode_ == Mode::UNLIMITED || toNanoseconds(now) >= nextFrame_;
+}
+
+int FramePacer::beginFrame(const double now)
+{
+	const int64_t time = toNanoseconds(now);
+
+	if (counting_)
+	{
+		const int64_t interval = time - frameTime_;
+		intervals_.record((uint64_t)((interval + 500) / 1000));
+		sumSquares_ += (interval * 1e-6) * (interval * 1e-6);
+		if (mode_ == Mode::CAPPED && interval >= 2 * interval_)
+		{
+			++late_;
+		}
+	}
+	frameTime_ = time;
+	counting_ = true;
+
+	// Stay on the schedule unless we've fallen a whole frame behind it, in
+	// which case start a new one rather than rushing to catch up
+	nextFrame_ += interval_;
+	if (nextFrame_ <= time)
+	{
+		nextFrame_ = time + interval_;
+	}
+
+	// Step until the simulation is at or just past this frame
+	int steps = 0;
+	while (simTime_ < time)
+	{
+		if (steps == MAX_STEPS)
+		{
+			droppedSteps_ += (uint64_t)((time - simTime_ + step_ - 1) / step_);
+			simTime_ = time;
+			break;
+		}
+		simTime_ += step_;
+		++steps;
+	}
+	steps_ += steps;
+	return steps;
+}
+
+float FramePacer::alpha() const
+{
+	const float ahead = (simTime_ - frameTime_) / (float)step_;
+	return std::min(std::max(1.0f - ahead, 0.0f), 1.0f);
+}
+
+void FramePacer::printStats(std::ostream& out) const
+{
+	char line[256];
+	if (mode_ == Mode::CAPPED)
+	{
+		snprintf(line, sizeof(line), "Frame pacing: capped at %.1f fps, %.3f ms steps\n", 1e9 / interval_, step_ * 1e-6);
+	}
+	else
+	{
+		snprintf(line, sizeof(line), "Frame pacing: unlimited, %.3f ms steps\n", step_ * 1e-6);
+	}
+	out << line;
+
+	const uint64_t frames = intervals_.count();
+	if (frames == 0)
+	{
+		out << "  No frame intervals yet" << std::endl;
+		return;
+	}
+
+	// The standard deviation of the intervals is the jitter
+	const double meanMs = intervals_.mean() / 1000.0;
+	const double jitterMs = sqrt(std::max(sumSquares_ / frames - meanMs * meanMs, 0.0));
+	snprintf(line, sizeof(line), "  %llu intervals: mean %.3f ms (%.1f fps), jitter %.3f ms\n",
+		(unsigned long long)frames, meanMs, meanMs > 0.0 ? 1000.0 / meanMs : 0.0, jitterMs);
+	out << line;
+	snprintf(line, sizeof(line), "  min %.3f  p50 %.3f  p99 %.3f  max %.3f ms\n",
+		intervals_.min() / 1000.0, intervals_.valueAtPercentile(50) / 1000.0,
+		intervals_.valueAtPercentile(99) / 1000.0, intervals_.max() / 1000.0);
+	out << line;
+	snprintf(line, sizeof(line), "  %llu late frames, %llu steps simulated, %llu dropped\n",
+		(unsigned long long)late_, (unsigned long long)steps_, (unsigned long long)droppedSteps_);
+	out << line;
+}
+
+void FramePacer::resetStats()
+{
+	intervals_.reset();
+	sumSquares_ = 0.0;
+	late_ = 0;
+	steps_ = 0;
+	droppedSteps_ = 0;
+}
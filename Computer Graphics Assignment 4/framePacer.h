@@ -0,0 +1,76 @@
+// Header file for the fixed-step frame pacer
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <stdint.h>
+#include <ostream>
+#include "overlay.h"
+
+// Decides when frames are drawn and how many fixed simulation steps each one
+// needs. Time is kept in whole nanoseconds, so frames due every interval stay
+// on that schedule instead of drifting by the rounding of a millisecond
+// timer. The simulation runs ahead of the frame being drawn by up to one
+// step, and alpha() says how far between the last two steps the frame falls.
+class FramePacer
+{
+public:
+	enum class Mode
+	{
+		CAPPED,		// A frame every frame interval
+		UNLIMITED	// Frames back to back, as fast as they can be drawn
+	};
+
+	// Steps beyond this many in one frame are dropped, so a long stall
+	// can't leave the simulation further and further behind
+	static const int MAX_STEPS = 5;
+
+	FramePacer(const double stepSeconds, const double frameSeconds);
+
+	void setMode(const Mode mode) { mode_ = mode; }
+	Mode mode() const { return mode_; }
+	void setFrameRate(const double framesPerSecond);
+
+	// Starts the simulation from now, as after waking from idle, so the time
+	// spent idle isn't simulated. The next frame interval isn't counted
+	// toward the jitter.
+	void restart(const double now);
+
+	// When the next frame should start, in the same seconds as now
+	bool frameDue(const double now) const;
+	double nextFrame() const { return nextFrame_ * 1e-9; }
+
+	// Starts a frame at now and returns how many steps to simulate for it
+	int beginFrame(const double now);
+
+	// Where the frame falls between the state before the last step (0) and
+	// after it (1)
+	float alpha() const;
+
+	// Frame intervals and late frames since the stats were last reset
+	void printStats(std::ostream& out) const;
+	void resetStats();
+
+private:
+	static int64_t toNanoseconds(const double seconds);
+
+	Mode mode_ = Mode::CAPPED;
+	const int64_t step_;
+	int64_t interval_;
+	int64_t simTime_ = 0;		// Where the simulation has been stepped to
+	int64_t frameTime_ = 0;		// When the current frame started
+	int64_t nextFrame_ = 0;
+	bool counting_ = false;		// Whether frameTime_ is a frame to measure from
+
+	// Frame intervals in microseconds
+	LatencyHistogram intervals_;
+	double sumSquares_ = 0.0;	// Of the intervals in milliseconds
+	uint64_t late_ = 0;			// Frames that started a whole interval late
+	uint64_t steps_ = 0;
+	uint64_t droppedSteps_ = 0;
+};
+
+#endif // FRAME_PACER_H
@@ -0,0 +1,90 @@
+// Header file for GL entry points newer than OpenGL 1.1
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "main.h"
+
+// opengl32.lib on Windows only exports OpenGL 1.1, so anything newer has to
+// be looked up at runtime once a context exists. The types and enums below
+// are only defined if the system headers didn't already provide them.
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+#ifndef GL_VERSION_1_5
+typedef ptrdiff_t GLsizeiptr;
+typedef ptrdiff_t GLintptr;
+#endif
+
+#ifndef GL_VERSION_3_2
+typedef struct __GLsync* GLsync;
+typedef uint64_t GLuint64;
+#endif
+
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT 0x0002
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_ALREADY_SIGNALED
+#define GL_ALREADY_SIGNALED 0x911A
+#endif
+#ifndef GL_CONDITION_SATISFIED
+#define GL_CONDITION_SATISFIED 0x911C
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+
+namespace glext
+{
+	typedef void (APIENTRY* GenBuffersProc)(GLsizei n, GLuint* buffers);
+	typedef void (APIENTRY* DeleteBuffersProc)(GLsizei n, const GLuint* buffers);
+	typedef void (APIENTRY* BindBufferProc)(GLenum target, GLuint buffer);
+	typedef void (APIENTRY* BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+	typedef void* (APIENTRY* MapBufferRangeProc)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+	typedef GLboolean (APIENTRY* UnmapBufferProc)(GLenum target);
+	typedef GLsync (APIENTRY* FenceSyncProc)(GLenum condition, GLbitfield flags);
+	typedef GLenum (APIENTRY* ClientWaitSyncProc)(GLsync sync, GLbitfield flags, GLuint64 timeout);
+	typedef void (APIENTRY* DeleteSyncProc)(GLsync sync);
+
+	extern GenBuffersProc genBuffers;
+	extern DeleteBuffersProc deleteBuffers;
+	extern BindBufferProc bindBuffer;
+	extern BufferStorageProc bufferStorage;
+	extern MapBufferRangeProc mapBufferRange;
+	extern UnmapBufferProc unmapBuffer;
+	extern FenceSyncProc fenceSync;
+	extern ClientWaitSyncProc clientWaitSync;
+	extern DeleteSyncProc deleteSync;
+
+	// Looks up every entry point above through the active backend. Must be
+	// called with a current context.
+	void load();
+
+	// True if the context can do persistently mapped buffers and fences
+	// (OpenGL 4.4, or ARB_buffer_storage on top of 3.2)
+	bool hasPersistentBuffers();
+}
+
+#endif // GL_EXTENSIONS_H
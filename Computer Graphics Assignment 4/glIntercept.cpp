@@ -0,0 +1,847 @@
+// Implementations for intercepting, counting and recording GL calls
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#define GL_INTERCEPT_IMPLEMENTATION
+#include "glIntercept.h"
+
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+// A capture file is a header followed by the call stream. Each call is its
+// Call as one byte, then its arguments in native byte order. Draws carry
+// the vertex data they read, padded to 4 bytes so it can be pointed at in
+// place, and textures are stored as TEXTURE_DATA records of RGBA pixels.
+namespace
+{
+	const char CAPTURE_MAGIC[4] = { 'G', 'L', 'C', 'P' };
+	const uint32_t CAPTURE_VERSION = 1;
+	const uint8_t TEXTURE_DATA = 0xFF;
+
+	// Which client arrays a draw carries
+	const uint8_t ARRAY_VERTEX = 1;
+	const uint8_t ARRAY_COLOR = 2;
+	const uint8_t ARRAY_TEXCOORD = 4;
+
+	const char* const CALL_NAMES[] =
+	{
+#define GL_INTERCEPT_NAME(name) #name,
+		GL_INTERCEPT_CALLS(GL_INTERCEPT_NAME)
+#undef GL_INTERCEPT_NAME
+	};
+
+	struct Reader
+	{
+		const uint8_t* data;
+		size_t size;
+		size_t offset;
+
+		bool has(const size_t bytes) const { return size - offset >= bytes; }
+
+		template <typename T>
+		T get()
+		{
+			T value;
+			memcpy(&value, data + offset, sizeof(T));
+			offset += sizeof(T);
+			return value;
+		}
+
+		void align() { offset = std::min((offset + 3) & ~(size_t)3, size); }
+	};
+}
+
+namespace glintercept
+{
+	const char* callName(const Call call)
+	{
+		return (int)call < (int)Call::COUNT ? CALL_NAMES[(int)call] : "?";
+	}
+
+	uint64_t CallCounts::total() const
+	{
+		uint64_t sum = 0;
+		for (uint32_t count : calls)
+		{
+			sum += count;
+		}
+		return sum;
+	}
+
+	void CallCounts::print(std::ostream& out) const
+	{
+		std::vector<int> order;
+		for (int i = 0; i < (int)Call::COUNT; ++i)
+		{
+			if (calls[i] != 0)
+				order.push_back(i);
+		}
+		std::stable_sort(order.begin(), order.end(), [this](int a, int b) { return calls[a] > calls[b]; });
+
+		for (int i : order)
+		{
+			const bool glu = i == (int)Call::Ortho2D || i == (int)Call::Perspective || i == (int)Call::LookAt;
+			out << (glu ? "  glu" : "  gl") << CALL_NAMES[i] << ": " << calls[i] << std::endl;
+		}
+		out << "  total: " << total() << std::endl;
+	}
+
+	//
+	// Replay
+	//
+
+	bool Replay::load(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+		{
+			std::cerr << "Failed to open " << path << std::endl;
+			return false;
+		}
+		std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		Reader reader = { contents.data(), contents.size(), 0 };
+		const size_t headerSize = sizeof(CAPTURE_MAGIC) + 5 * sizeof(uint32_t) + sizeof(counts_.calls);
+		if (!reader.has(headerSize) || memcmp(contents.data(), CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0)
+		{
+			std::cerr << path << " isn't a GL capture" << std::endl;
+			return false;
+		}
+		reader.offset += sizeof(CAPTURE_MAGIC);
+
+		const uint32_t version = reader.get<uint32_t>();
+		width_ = (int)reader.get<uint32_t>();
+		height_ = (int)reader.get<uint32_t>();
+		const uint32_t callTypes = reader.get<uint32_t>();
+		if (version != CAPTURE_VERSION || callTypes != (uint32_t)Call::COUNT)
+		{
+			std::cerr << path << " was recorded by a different version of the program" << std::endl;
+			return false;
+		}
+		for (uint32_t& count : counts_.calls)
+		{
+			count = reader.get<uint32_t>();
+		}
+
+		const uint32_t streamSize = reader.get<uint32_t>();
+		if (!reader.has(streamSize))
+		{
+			std::cerr << path << " is truncated" << std::endl;
+			return false;
+		}
+		stream_.assign(contents.begin() + reader.offset, contents.begin() + reader.offset + streamSize);
+		textures_.clear();
+		uploaded_.clear();
+
+		if (!walk(false))
+		{
+			std::cerr << path << " has a corrupt call stream" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	void Replay::play()
+	{
+		walk(true);
+	}
+
+	bool Replay::walk(const bool execute)
+	{
+		Reader in = { stream_.data(), stream_.size(), 0 };
+		GLfloat f[16];
+		GLdouble d[9];
+
+		// Reads n values of type T into values, or fails the walk
+#define READ(values, T, n) \
+		if (!in.has(sizeof(T) * (n))) return false; \
+		for (int i = 0; i < (n); ++i) values[i] = in.get<T>()
+
+		while (in.has(1))
+		{
+			const size_t recordOffset = in.offset;
+			const uint8_t op = in.get<uint8_t>();
+
+			if (op == TEXTURE_DATA)
+			{
+				GLint header[8];
+				READ(header, int32_t, 8);
+				const uint32_t name = (uint32_t)header[0];
+				const size_t bytes = (size_t)std::max(header[2], 0) * (size_t)std::max(header[3], 0) * 4;
+				if (!in.has(bytes))
+				{
+					return false;
+				}
+				const uint8_t* pixels = in.data + in.offset;
+				in.offset += bytes;
+
+				if (execute && !uploaded_[recordOffset])
+				{
+					uploaded_[recordOffset] = true;
+					if (textures_.find(name) == textures_.end())
+					{
+						glGenTextures(1, &textures_[name]);
+					}
+
+					GLint previous = 0;
+					glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+					glBindTexture(GL_TEXTURE_2D, textures_[name]);
+					glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+					glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+					if (bytes > 0)
+					{
+						glTexImage2D(GL_TEXTURE_2D, 0, header[1], header[2], header[3], 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+					}
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, header[4]);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, header[5]);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, header[6]);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, header[7]);
+					glPopClientAttrib();
+					glBindTexture(GL_TEXTURE_2D, (GLuint)previous);
+				}
+				continue;
+			}
+
+			GLuint u[3];
+			GLint n[4];
+			switch ((Call)op)
+			{
+			case Call::Begin: READ(u, uint32_t, 1); if (execute) glBegin(u[0]); break;
+			case Call::End: if (execute) glEnd(); break;
+			case Call::Vertex2f: READ(f, float, 2); if (execute) glVertex2f(f[0], f[1]); break;
+			case Call::Vertex3f: READ(f, float, 3); if (execute) glVertex3f(f[0], f[1], f[2]); break;
+			case Call::Vertex3fv: READ(f, float, 3); if (execute) glVertex3fv(f); break;
+			case Call::Normal3f: READ(f, float, 3); if (execute) glNormal3f(f[0], f[1], f[2]); break;
+			case Call::Normal3fv: READ(f, float, 3); if (execute) glNormal3fv(f); break;
+			case Call::Color3f: READ(f, float, 3); if (execute) glColor3f(f[0], f[1], f[2]); break;
+			case Call::Color4f: READ(f, float, 4); if (execute) glColor4f(f[0], f[1], f[2], f[3]); break;
+			case Call::TexCoord2f: READ(f, float, 2); if (execute) glTexCoord2f(f[0], f[1]); break;
+			case Call::Enable: READ(u, uint32_t, 1); if (execute) glEnable(u[0]); break;
+			case Call::Disable: READ(u, uint32_t, 1); if (execute) glDisable(u[0]); break;
+			case Call::ShadeModel: READ(u, uint32_t, 1); if (execute) glShadeModel(u[0]); break;
+			case Call::BlendFunc: READ(u, uint32_t, 2); if (execute) glBlendFunc(u[0], u[1]); break;
+			case Call::Lightfv:
+			{
+				READ(u, uint32_t, 2);
+				if (!in.has(1)) return false;
+				const int count = std::min((int)in.get<uint8_t>(), 4);
+				READ(f, float, count);
+				if (execute) glLightfv(u[0], u[1], f);
+				break;
+			}
+			case Call::PushAttrib: READ(u, uint32_t, 1); if (execute) glPushAttrib(u[0]); break;
+			case Call::PopAttrib: if (execute) glPopAttrib(); break;
+			case Call::MatrixMode: READ(u, uint32_t, 1); if (execute) glMatrixMode(u[0]); break;
+			case Call::LoadIdentity: if (execute) glLoadIdentity(); break;
+			case Call::LoadMatrixf: READ(f, float, 16); if (execute) glLoadMatrixf(f); break;
+			case Call::MultMatrixf: READ(f, float, 16); if (execute) glMultMatrixf(f); break;
+			case Call::PushMatrix: if (execute) glPushMatrix(); break;
+			case Call::PopMatrix: if (execute) glPopMatrix(); break;
+			case Call::Translatef: READ(f, float, 3); if (execute) glTranslatef(f[0], f[1], f[2]); break;
+			case Call::Rotatef: READ(f, float, 4); if (execute) glRotatef(f[0], f[1], f[2], f[3]); break;
+			case Call::Scalef: READ(f, float, 3); if (execute) glScalef(f[0], f[1], f[2]); break;
+			case Call::Ortho2D: READ(d, double, 4); if (execute) gluOrtho2D(d[0], d[1], d[2], d[3]); break;
+			case Call::Perspective: READ(d, double, 4); if (execute) gluPerspective(d[0], d[1], d[2], d[3]); break;
+			case Call::LookAt: READ(d, double, 9); if (execute) gluLookAt(d[0], d[1], d[2], d[3], d[4], d[5], d[6], d[7], d[8]); break;
+			case Call::Viewport: READ(n, int32_t, 4); if (execute) glViewport(n[0], n[1], n[2], n[3]); break;
+			case Call::Clear: READ(u, uint32_t, 1); if (execute) glClear(u[0]); break;
+			case Call::ClearColor: READ(f, float, 4); if (execute) glClearColor(f[0], f[1], f[2], f[3]); break;
+			case Call::Flush: if (execute) glFlush(); break;
+			case Call::Finish: if (execute) glFinish(); break;
+			case Call::BindTexture:
+			{
+				READ(u, uint32_t, 2);
+				if (execute)
+				{
+					std::unordered_map<uint32_t, GLuint>::const_iterator texture = textures_.find(u[1]);
+					glBindTexture(u[0], texture != textures_.end() ? texture->second : 0);
+				}
+				break;
+			}
+			case Call::TexParameteri: READ(u, uint32_t, 2); READ(n, int32_t, 1); if (execute) glTexParameteri(u[0], u[1], n[0]); break;
+			case Call::TexEnvf: READ(u, uint32_t, 2); READ(f, float, 1); if (execute) glTexEnvf(u[0], u[1], f[0]); break;
+			case Call::PixelStorei: READ(u, uint32_t, 1); READ(n, int32_t, 1); if (execute) glPixelStorei(u[0], n[0]); break;
+			case Call::PushClientAttrib: READ(u, uint32_t, 1); if (execute) glPushClientAttrib(u[0]); break;
+			case Call::PopClientAttrib: if (execute) glPopClientAttrib(); break;
+			case Call::EnableClientState: READ(u, uint32_t, 1); if (execute) glEnableClientState(u[0]); break;
+			case Call::DisableClientState: READ(u, uint32_t, 1); if (execute) glDisableClientState(u[0]); break;
+			case Call::DrawArrays:
+			{
+				READ(u, uint32_t, 2);
+				if (!in.has(1)) return false;
+				const uint8_t arrays = in.get<uint8_t>();
+				for (uint8_t bit = ARRAY_VERTEX; bit <= ARRAY_TEXCOORD; bit <<= 1)
+				{
+					if ((arrays & bit) == 0)
+					{
+						continue;
+					}
+					if (!in.has(1)) return false;
+					const GLint size = in.get<uint8_t>();
+					in.align();
+					const size_t bytes = (size_t)size * u[1] * sizeof(float);
+					if (!in.has(bytes)) return false;
+					const float* data = (const float*)(in.data + in.offset);
+					in.offset += bytes;
+
+					if (!execute)
+						continue;
+					if (bit == ARRAY_VERTEX)
+						glVertexPointer(size, GL_FLOAT, 0, data);
+					else if (bit == ARRAY_COLOR)
+						glColorPointer(size, GL_FLOAT, 0, data);
+					else
+						glTexCoordPointer(size, GL_FLOAT, 0, data);
+				}
+				if (execute) glDrawArrays(u[0], 0, (GLsizei)u[1]);
+				break;
+			}
+			default:
+				return false;
+			}
+		}
+#undef READ
+		return true;
+	}
+}
+
+#ifndef ENABLE_GL_INTERCEPT
+
+namespace glintercept
+{
+	namespace
+	{
+		const CallCounts noCounts = CallCounts();
+	}
+
+	void beginFrame() {}
+	void endFrame() {}
+	const CallCounts& currentFrameCounts() { return noCounts; }
+	const CallCounts& lastFrameCounts() { return noCounts; }
+
+	bool recordNextFrame(const std::string& /*path*/, const int /*width*/, const int /*height*/)
+	{
+		std::cerr << "GL calls can only be recorded when ENABLE_GL_INTERCEPT is defined" << std::endl;
+		return false;
+	}
+}
+
+#else
+
+namespace
+{
+	using glintercept::Call;
+
+	glintercept::CallCounts currentFrame;
+	glintercept::CallCounts lastFrame;
+
+	// A capture waiting for the next frame, or running
+	std::string capturePath;
+	int captureWidth = 0, captureHeight = 0;
+	bool recording = false;
+	std::vector<uint8_t> stream;
+	std::unordered_map<GLuint, bool> capturedTextures;
+
+	// Client array state, which GL can't hand back by the time a draw is
+	// recorded, since the pointers are only good during the call
+	struct ClientArray
+	{
+		bool enabled = false;
+		GLint size = 4;
+		GLenum type = GL_FLOAT;
+		GLsizei stride = 0;
+		const GLvoid* pointer = nullptr;
+	};
+	struct ClientArrays
+	{
+		ClientArray vertex, color, texCoord;
+	};
+	ClientArrays clientArrays;
+	std::vector<std::pair<GLbitfield, ClientArrays>> clientArrayStack;
+
+	ClientArray* clientArray(const GLenum array)
+	{
+		switch (array)
+		{
+		case GL_VERTEX_ARRAY: return &clientArrays.vertex;
+		case GL_COLOR_ARRAY: return &clientArrays.color;
+		case GL_TEXTURE_COORD_ARRAY: return &clientArrays.texCoord;
+		default: return nullptr;
+		}
+	}
+
+	template <typename T>
+	void put(const T& value)
+	{
+		const uint8_t* bytes = (const uint8_t*)&value;
+		stream.insert(stream.end(), bytes, bytes + sizeof(T));
+	}
+
+	void putFloats(const GLfloat* values, const int count)
+	{
+		const uint8_t* bytes = (const uint8_t*)values;
+		stream.insert(stream.end(), bytes, bytes + count * sizeof(GLfloat));
+	}
+
+	// Counts a call, and returns whether it should be recorded too
+	inline bool count(const Call call)
+	{
+		++currentFrame.calls[(int)call];
+		return recording;
+	}
+
+	inline void putCall(const Call call)
+	{
+		stream.push_back((uint8_t)call);
+	}
+
+	// Reads back whatever texture is bound and records it under name
+	void captureBoundTexture(const GLuint name)
+	{
+		GLint width = 0, height = 0, internalFormat = GL_RGBA;
+		GLint parameters[4] = { GL_LINEAR, GL_LINEAR, GL_REPEAT, GL_REPEAT };
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+		glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, &parameters[0]);
+		glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, &parameters[1]);
+		glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, &parameters[2]);
+		glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, &parameters[3]);
+
+		stream.push_back(TEXTURE_DATA);
+		put((int32_t)name);
+		put((int32_t)internalFormat);
+		put((int32_t)width);
+		put((int32_t)height);
+		for (GLint parameter : parameters)
+		{
+			put((int32_t)parameter);
+		}
+
+		const size_t offset = stream.size();
+		stream.resize(offset + (size_t)width * height * 4);
+		if (width > 0 && height > 0)
+		{
+			glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, stream.data() + offset);
+			glPopClientAttrib();
+		}
+		capturedTextures[name] = true;
+	}
+
+	void putEnable(const GLenum cap)
+	{
+		putCall(glIsEnabled(cap) ? Call::Enable : Call::Disable);
+		put((uint32_t)cap);
+	}
+
+	void putMatrix(const GLenum mode, const GLenum query)
+	{
+		GLfloat m[16];
+		glGetFloatv(query, m);
+		putCall(Call::MatrixMode);
+		put((uint32_t)mode);
+		putCall(Call::LoadMatrixf);
+		putFloats(m, 16);
+	}
+
+	// Starts the capture with calls that put GL back into its current state,
+	// for everything the scene sets up outside of a frame
+	void recordState()
+	{
+		const GLenum caps[] =
+		{
+			GL_LIGHTING, GL_LIGHT0, GL_DEPTH_TEST, GL_TEXTURE_2D, GL_BLEND,
+			GL_POINT_SMOOTH, GL_CULL_FACE, GL_COLOR_MATERIAL, GL_NORMALIZE
+		};
+		for (GLenum cap : caps)
+		{
+			putEnable(cap);
+		}
+
+		GLint values[4];
+		GLfloat floats[4];
+		glGetIntegerv(GL_SHADE_MODEL, values);
+		putCall(Call::ShadeModel);
+		put((uint32_t)values[0]);
+
+		glGetIntegerv(GL_BLEND_SRC, &values[0]);
+		glGetIntegerv(GL_BLEND_DST, &values[1]);
+		putCall(Call::BlendFunc);
+		put((uint32_t)values[0]);
+		put((uint32_t)values[1]);
+
+		glGetTexEnviv(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, values);
+		putCall(Call::TexEnvf);
+		put((uint32_t)GL_TEXTURE_ENV);
+		put((uint32_t)GL_TEXTURE_ENV_MODE);
+		put((float)values[0]);
+
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, values);
+		putCall(Call::PixelStorei);
+		put((uint32_t)GL_UNPACK_ALIGNMENT);
+		put((int32_t)values[0]);
+
+		glGetFloatv(GL_COLOR_CLEAR_VALUE, floats);
+		putCall(Call::ClearColor);
+		putFloats(floats, 4);
+
+		glGetFloatv(GL_CURRENT_COLOR, floats);
+		putCall(Call::Color4f);
+		putFloats(floats, 4);
+
+		glGetIntegerv(GL_VIEWPORT, values);
+		putCall(Call::Viewport);
+		for (GLint value : values)
+		{
+			put((int32_t)value);
+		}
+
+		// GL hands back the light's position in eye space, which is where it
+		// ends up if it's set again with no modelview transform
+		putCall(Call::MatrixMode);
+		put((uint32_t)GL_MODELVIEW);
+		putCall(Call::LoadIdentity);
+		const GLenum lightParameters[] = { GL_AMBIENT, GL_DIFFUSE, GL_SPECULAR, GL_POSITION };
+		for (GLenum parameter : lightParameters)
+		{
+			glGetLightfv(GL_LIGHT0, parameter, floats);
+			putCall(Call::Lightfv);
+			put((uint32_t)GL_LIGHT0);
+			put((uint32_t)parameter);
+			put((uint8_t)4);
+			putFloats(floats, 4);
+		}
+
+		GLint matrixMode = GL_MODELVIEW;
+		glGetIntegerv(GL_MATRIX_MODE, &matrixMode);
+		putMatrix(GL_PROJECTION, GL_PROJECTION_MATRIX);
+		putMatrix(GL_TEXTURE, GL_TEXTURE_MATRIX);
+		putMatrix(GL_MODELVIEW, GL_MODELVIEW_MATRIX);
+		putCall(Call::MatrixMode);
+		put((uint32_t)matrixMode);
+
+		const GLenum arrays[] = { GL_VERTEX_ARRAY, GL_COLOR_ARRAY, GL_TEXTURE_COORD_ARRAY };
+		for (GLenum array : arrays)
+		{
+			putCall(clientArray(array)->enabled ? Call::EnableClientState : Call::DisableClientState);
+			put((uint32_t)array);
+		}
+
+		GLint bound = 0;
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+		if (bound != 0)
+		{
+			captureBoundTexture((GLuint)bound);
+		}
+		putCall(Call::BindTexture);
+		put((uint32_t)GL_TEXTURE_2D);
+		put((uint32_t)bound);
+	}
+
+	void writeCapture()
+	{
+		std::ofstream file(capturePath, std::ios::binary);
+		if (!file)
+		{
+			std::cerr << "Failed to open " << capturePath << " for writing" << std::endl;
+			return;
+		}
+
+		const uint32_t header[] = { CAPTURE_VERSION, (uint32_t)captureWidth, (uint32_t)captureHeight, (uint32_t)Call::COUNT };
+		const uint32_t streamSize = (uint32_t)stream.size();
+		file.write(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+		file.write((const char*)header, sizeof(header));
+		file.write((const char*)lastFrame.calls, sizeof(lastFrame.calls));
+		file.write((const char*)&streamSize, sizeof(streamSize));
+		file.write((const char*)stream.data(), stream.size());
+
+		std::cout << "Recorded " << lastFrame.total() << " GL calls (" << stream.size() / 1024 << " KB) to " << capturePath << std::endl;
+	}
+
+	// Whether a draw can carry the array. Everything in the scene is floats.
+	bool recordable(const ClientArray& array)
+	{
+		return array.enabled && array.type == GL_FLOAT && array.pointer != nullptr;
+	}
+
+	// Appends one client array's elements [first, first + count) as floats
+	void putClientArray(const ClientArray& array, const GLint first, const GLsizei count)
+	{
+		put((uint8_t)array.size);
+		while (stream.size() % 4 != 0)
+		{
+			stream.push_back(0);
+		}
+
+		const size_t elementSize = array.size * sizeof(GLfloat);
+		const size_t stride = array.stride != 0 ? array.stride : elementSize;
+		const uint8_t* source = (const uint8_t*)array.pointer + first * stride;
+		for (GLsizei i = 0; i < count; ++i, source += stride)
+		{
+			stream.insert(stream.end(), source, source + elementSize);
+		}
+	}
+}
+
+namespace glintercept
+{
+	void beginFrame()
+	{
+		currentFrame = CallCounts();
+		if (!capturePath.empty() && !recording)
+		{
+			recording = true;
+			stream.clear();
+			capturedTextures.clear();
+			recordState();
+		}
+	}
+
+	void endFrame()
+	{
+		lastFrame = currentFrame;
+		if (recording)
+		{
+			recording = false;
+			writeCapture();
+			capturePath.clear();
+			stream = std::vector<uint8_t>();
+		}
+	}
+
+	const CallCounts& currentFrameCounts() { return currentFrame; }
+	const CallCounts& lastFrameCounts() { return lastFrame; }
+
+	bool recordNextFrame(const std::string& path, const int width, const int height)
+	{
+		capturePath = path;
+		captureWidth = width;
+		captureHeight = height;
+		return true;
+	}
+
+	//
+	// Wrappers
+	//
+
+	void Begin(GLenum mode) { glBegin(mode); if (count(Call::Begin)) { putCall(Call::Begin); put((uint32_t)mode); } }
+	void End() { glEnd(); if (count(Call::End)) putCall(Call::End); }
+	void Vertex2f(GLfloat x, GLfloat y) { glVertex2f(x, y); if (count(Call::Vertex2f)) { putCall(Call::Vertex2f); put(x); put(y); } }
+	void Vertex3f(GLfloat x, GLfloat y, GLfloat z) { glVertex3f(x, y, z); if (count(Call::Vertex3f)) { putCall(Call::Vertex3f); put(x); put(y); put(z); } }
+	void Vertex3fv(const GLfloat* v) { glVertex3fv(v); if (count(Call::Vertex3fv)) { putCall(Call::Vertex3fv); putFloats(v, 3); } }
+	void Normal3f(GLfloat x, GLfloat y, GLfloat z) { glNormal3f(x, y, z); if (count(Call::Normal3f)) { putCall(Call::Normal3f); put(x); put(y); put(z); } }
+	void Normal3fv(const GLfloat* v) { glNormal3fv(v); if (count(Call::Normal3fv)) { putCall(Call::Normal3fv); putFloats(v, 3); } }
+	void Color3f(GLfloat r, GLfloat g, GLfloat b) { glColor3f(r, g, b); if (count(Call::Color3f)) { putCall(Call::Color3f); put(r); put(g); put(b); } }
+	void Color4f(GLfloat r, GLfloat g, GLfloat b, GLfloat a) { glColor4f(r, g, b, a); if (count(Call::Color4f)) { putCall(Call::Color4f); put(r); put(g); put(b); put(a); } }
+	void TexCoord2f(GLfloat s, GLfloat t) { glTexCoord2f(s, t); if (count(Call::TexCoord2f)) { putCall(Call::TexCoord2f); put(s); put(t); } }
+	void Enable(GLenum cap) { glEnable(cap); if (count(Call::Enable)) { putCall(Call::Enable); put((uint32_t)cap); } }
+	void Disable(GLenum cap) { glDisable(cap); if (count(Call::Disable)) { putCall(Call::Disable); put((uint32_t)cap); } }
+	void ShadeModel(GLenum mode) { glShadeModel(mode); if (count(Call::ShadeModel)) { putCall(Call::ShadeModel); put((uint32_t)mode); } }
+	void BlendFunc(GLenum source, GLenum destination) { glBlendFunc(source, destination); if (count(Call::BlendFunc)) { putCall(Call::BlendFunc); put((uint32_t)source); put((uint32_t)destination); } }
+
+	void Lightfv(GLenum light, GLenum name, const GLfloat* params)
+	{
+		glLightfv(light, name, params);
+		if (count(Call::Lightfv))
+		{
+			const int values = name == GL_SPOT_DIRECTION ? 3 :
+				name == GL_AMBIENT || name == GL_DIFFUSE || name == GL_SPECULAR || name == GL_POSITION ? 4 : 1;
+			putCall(Call::Lightfv);
+			put((uint32_t)light);
+			put((uint32_t)name);
+			put((uint8_t)values);
+			putFloats(params, values);
+		}
+	}
+
+	void PushAttrib(GLbitfield mask) { glPushAttrib(mask); if (count(Call::PushAttrib)) { putCall(Call::PushAttrib); put((uint32_t)mask); } }
+	void PopAttrib() { glPopAttrib(); if (count(Call::PopAttrib)) putCall(Call::PopAttrib); }
+	void MatrixMode(GLenum mode) { glMatrixMode(mode); if (count(Call::MatrixMode)) { putCall(Call::MatrixMode); put((uint32_t)mode); } }
+	void LoadIdentity() { glLoadIdentity(); if (count(Call::LoadIdentity)) putCall(Call::LoadIdentity); }
+	void LoadMatrixf(const GLfloat* m) { glLoadMatrixf(m); if (count(Call::LoadMatrixf)) { putCall(Call::LoadMatrixf); putFloats(m, 16); } }
+	void MultMatrixf(const GLfloat* m) { glMultMatrixf(m); if (count(Call::MultMatrixf)) { putCall(Call::MultMatrixf); putFloats(m, 16); } }
+	void PushMatrix() { glPushMatrix(); if (count(Call::PushMatrix)) putCall(Call::PushMatrix); }
+	void PopMatrix() { glPopMatrix(); if (count(Call::PopMatrix)) putCall(Call::PopMatrix); }
+	void Translatef(GLfloat x, GLfloat y, GLfloat z) { glTranslatef(x, y, z); if (count(Call::Translatef)) { putCall(Call::Translatef); put(x); put(y); put(z); } }
+	void Rotatef(GLfloat angle, GLfloat x, GLfloat y, GLfloat z) { glRotatef(angle, x, y, z); if (count(Call::Rotatef)) { putCall(Call::Rotatef); put(angle); put(x); put(y); put(z); } }
+	void Scalef(GLfloat x, GLfloat y, GLfloat z) { glScalef(x, y, z); if (count(Call::Scalef)) { putCall(Call::Scalef); put(x); put(y); put(z); } }
+
+	void Ortho2D(GLdouble left, GLdouble right, GLdouble bottom, GLdouble top)
+	{
+		gluOrtho2D(left, right, bottom, top);
+		if (count(Call::Ortho2D))
+		{
+			putCall(Call::Ortho2D);
+			put(left); put(right); put(bottom); put(top);
+		}
+	}
+
+	void Perspective(GLdouble fovy, GLdouble aspect, GLdouble zNear, GLdouble zFar)
+	{
+		gluPerspective(fovy, aspect, zNear, zFar);
+		if (count(Call::Perspective))
+		{
+			putCall(Call::Perspective);
+			put(fovy); put(aspect); put(zNear); put(zFar);
+		}
+	}
+
+	void LookAt(GLdouble eyeX, GLdouble eyeY, GLdouble eyeZ, GLdouble centerX, GLdouble centerY, GLdouble centerZ, GLdouble upX, GLdouble upY, GLdouble upZ)
+	{
+		gluLookAt(eyeX, eyeY, eyeZ, centerX, centerY, centerZ, upX, upY, upZ);
+		if (count(Call::LookAt))
+		{
+			putCall(Call::LookAt);
+			put(eyeX); put(eyeY); put(eyeZ);
+			put(centerX); put(centerY); put(centerZ);
+			put(upX); put(upY); put(upZ);
+		}
+	}
+
+	void Viewport(GLint x, GLint y, GLsizei width, GLsizei height) { glViewport(x, y, width, height); if (count(Call::Viewport)) { putCall(Call::Viewport); put((int32_t)x); put((int32_t)y); put((int32_t)width); put((int32_t)height); } }
+	void Clear(GLbitfield mask) { glClear(mask); if (count(Call::Clear)) { putCall(Call::Clear); put((uint32_t)mask); } }
+	void ClearColor(GLclampf r, GLclampf g, GLclampf b, GLclampf a) { glClearColor(r, g, b, a); if (count(Call::ClearColor)) { putCall(Call::ClearColor); put(r); put(g); put(b); put(a); } }
+	void Flush() { glFlush(); if (count(Call::Flush)) putCall(Call::Flush); }
+	void Finish() { glFinish(); if (count(Call::Finish)) putCall(Call::Finish); }
+
+	// Texture names are the replay's own business, so these aren't recorded
+	void GenTextures(GLsizei n, GLuint* textures) { glGenTextures(n, textures); count(Call::GenTextures); }
+	void DeleteTextures(GLsizei n, const GLuint* textures) { glDeleteTextures(n, textures); count(Call::DeleteTextures); }
+
+	void BindTexture(GLenum target, GLuint texture)
+	{
+		glBindTexture(target, texture);
+		if (count(Call::BindTexture))
+		{
+			if (target == GL_TEXTURE_2D && texture != 0 && !capturedTextures[texture])
+			{
+				captureBoundTexture(texture);
+			}
+			putCall(Call::BindTexture);
+			put((uint32_t)target);
+			put((uint32_t)texture);
+		}
+	}
+
+	void TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid* pixels)
+	{
+		glTexImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
+
+		// Read back rather than copied from pixels, which may be an offset
+		// into a pixel buffer object
+		if (count(Call::TexImage2D) && target == GL_TEXTURE_2D && level == 0)
+		{
+			GLint bound = 0;
+			glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+			captureBoundTexture((GLuint)bound);
+		}
+	}
+
+	void TexParameteri(GLenum target, GLenum name, GLint param) { glTexParameteri(target, name, param); if (count(Call::TexParameteri)) { putCall(Call::TexParameteri); put((uint32_t)target); put((uint32_t)name); put((int32_t)param); } }
+	void TexEnvf(GLenum target, GLenum name, GLfloat param) { glTexEnvf(target, name, param); if (count(Call::TexEnvf)) { putCall(Call::TexEnvf); put((uint32_t)target); put((uint32_t)name); put(param); } }
+	void PixelStorei(GLenum name, GLint param) { glPixelStorei(name, param); if (count(Call::PixelStorei)) { putCall(Call::PixelStorei); put((uint32_t)name); put((int32_t)param); } }
+
+	void PushClientAttrib(GLbitfield mask)
+	{
+		glPushClientAttrib(mask);
+		clientArrayStack.push_back(std::make_pair(mask, clientArrays));
+		if (count(Call::PushClientAttrib))
+		{
+			putCall(Call::PushClientAttrib);
+			put((uint32_t)mask);
+		}
+	}
+
+	void PopClientAttrib()
+	{
+		glPopClientAttrib();
+		if (!clientArrayStack.empty())
+		{
+			if (clientArrayStack.back().first & GL_CLIENT_VERTEX_ARRAY_BIT)
+			{
+				clientArrays = clientArrayStack.back().second;
+			}
+			clientArrayStack.pop_back();
+		}
+		if (count(Call::PopClientAttrib))
+		{
+			putCall(Call::PopClientAttrib);
+		}
+	}
+
+	void EnableClientState(GLenum array)
+	{
+		glEnableClientState(array);
+		if (ClientArray* tracked = clientArray(array))
+			tracked->enabled = true;
+		if (count(Call::EnableClientState)) { putCall(Call::EnableClientState); put((uint32_t)array); }
+	}
+
+	void DisableClientState(GLenum array)
+	{
+		glDisableClientState(array);
+		if (ClientArray* tracked = clientArray(array))
+			tracked->enabled = false;
+		if (count(Call::DisableClientState)) { putCall(Call::DisableClientState); put((uint32_t)array); }
+	}
+
+	// The arrays themselves are recorded by the draws that read them
+	void VertexPointer(GLint size, GLenum type, GLsizei stride, const GLvoid* pointer)
+	{
+		glVertexPointer(size, type, stride, pointer);
+		clientArrays.vertex = { clientArrays.vertex.enabled, size, type, stride, pointer };
+		count(Call::VertexPointer);
+	}
+
+	void ColorPointer(GLint size, GLenum type, GLsizei stride, const GLvoid* pointer)
+	{
+		glColorPointer(size, type, stride, pointer);
+		clientArrays.color = { clientArrays.color.enabled, size, type, stride, pointer };
+		count(Call::ColorPointer);
+	}
+
+	void TexCoordPointer(GLint size, GLenum type, GLsizei stride, const GLvoid* pointer)
+	{
+		glTexCoordPointer(size, type, stride, pointer);
+		clientArrays.texCoord = { clientArrays.texCoord.enabled, size, type, stride, pointer };
+		count(Call::TexCoordPointer);
+	}
+
+	void DrawArrays(GLenum mode, GLint first, GLsizei elements)
+	{
+		glDrawArrays(mode, first, elements);
+		if (!count(Call::DrawArrays))
+		{
+			return;
+		}
+
+		const uint8_t arrays = (uint8_t)(
+			(recordable(clientArrays.vertex) ? ARRAY_VERTEX : 0) |
+			(recordable(clientArrays.color) ? ARRAY_COLOR : 0) |
+			(recordable(clientArrays.texCoord) ? ARRAY_TEXCOORD : 0));
+		putCall(Call::DrawArrays);
+		put((uint32_t)mode);
+		put((uint32_t)elements);
+		put(arrays);
+		if (arrays & ARRAY_VERTEX)
+			putClientArray(clientArrays.vertex, first, elements);
+		if (arrays & ARRAY_COLOR)
+			putClientArray(clientArrays.color, first, elements);
+		if (arrays & ARRAY_TEXCOORD)
+			putClientArray(clientArrays.texCoord, first, elements);
+	}
+
+	// Queries don't change anything, so they're only counted
+	const GLubyte* GetString(GLenum name) { count(Call::GetString); return glGetString(name); }
+	void GetIntegerv(GLenum name, GLint* params) { count(Call::GetIntegerv); glGetIntegerv(name, params); }
+	void GetFloatv(GLenum name, GLfloat* params) { count(Call::GetFloatv); glGetFloatv(name, params); }
+	void ReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, GLvoid* pixels) { count(Call::ReadPixels); glReadPixels(x, y, width, height, format, type, pixels); }
+}
+
+#endif // ENABLE_GL_INTERCEPT
@@ -0,0 +1,216 @@
+// Header file for intercepting, counting and recording GL calls
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef GL_INTERCEPT_H
+#define GL_INTERCEPT_H
+
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <GL/glut.h>
+
+// Every GL and GLU entry point the project calls. When ENABLE_GL_INTERCEPT
+// is defined (the Debug configurations define it), main.h pulls this header
+// in and each of these names is redirected to a wrapper in glintercept,
+// which counts the call and, while a capture is running, records it.
+#define GL_INTERCEPT_CALLS(X) \
+	X(Begin) X(End) X(Vertex2f) X(Vertex3f) X(Vertex3fv) X(Normal3f) X(Normal3fv) \
+	X(Color3f) X(Color4f) X(TexCoord2f) \
+	X(Enable) X(Disable) X(ShadeModel) X(BlendFunc) X(Lightfv) \
+	X(PushAttrib) X(PopAttrib) \
+	X(MatrixMode) X(LoadIdentity) X(LoadMatrixf) X(MultMatrixf) X(PushMatrix) X(PopMatrix) \
+	X(Translatef) X(Rotatef) X(Scalef) X(Ortho2D) X(Perspective) X(LookAt) \
+	X(Viewport) X(Clear) X(ClearColor) X(Flush) X(Finish) \
+	X(GenTextures) X(DeleteTextures) X(BindTexture) X(TexImage2D) X(TexParameteri) X(TexEnvf) X(PixelStorei) \
+	X(PushClientAttrib) X(PopClientAttrib) X(EnableClientState) X(DisableClientState) \
+	X(VertexPointer) X(ColorPointer) X(TexCoordPointer) X(DrawArrays) \
+	X(GetString) X(GetIntegerv) X(GetFloatv) X(ReadPixels)
+
+namespace glintercept
+{
+#define GL_INTERCEPT_ENUM(name) name,
+	enum class Call : uint8_t
+	{
+		GL_INTERCEPT_CALLS(GL_INTERCEPT_ENUM)
+		COUNT
+	};
+#undef GL_INTERCEPT_ENUM
+
+	const char* callName(const Call call);
+
+	// How many times each entry point was called
+	struct CallCounts
+	{
+		uint32_t calls[(int)Call::COUNT] = {};
+
+		uint64_t total() const;
+
+		// One line per entry point that was called, most called first
+		void print(std::ostream& out) const;
+	};
+
+	// Frames are bracketed by these, so counts can be reported per frame.
+	// They do nothing unless ENABLE_GL_INTERCEPT is defined.
+	void beginFrame();
+	void endFrame();
+
+	// Calls so far in the current frame, and in the whole of the last one
+	const CallCounts& currentFrameCounts();
+	const CallCounts& lastFrameCounts();
+
+	// Records the whole of the next frame to path. The capture starts with
+	// the GL state the scene relies on and the contents of every texture the
+	// frame binds, so it can be replayed with nothing else loaded. Returns
+	// false if interception isn't compiled in.
+	bool recordNextFrame(const std::string& path, const int width, const int height);
+
+	// Plays a recorded frame back on the current context
+	class Replay
+	{
+	public:
+		// Reads and checks a capture. Prints why and returns false if it
+		// can't be used.
+		bool load(const std::string& path);
+
+		int width() const { return width_; }
+		int height() const { return height_; }
+
+		// What the recorded frame called, including calls that aren't
+		// replayed (queries, and pointer setup folded into draws)
+		const CallCounts& counts() const { return counts_; }
+
+		// Issues the whole frame. Textures are created the first time.
+		void play();
+
+	private:
+		// Walks the stream, issuing each call if execute is set. Returns
+		// false if the stream is cut short or has an unknown call in it.
+		bool walk(const bool execute);
+
+		std::vector<uint8_t> stream_;
+		int width_ = 0;
+		int height_ = 0;
+		CallCounts counts_;
+		std::unordered_map<uint32_t, GLuint> textures_;	// Recorded name to ours
+		std::unordered_map<size_t, bool> uploaded_;		// Texture records already played
+	};
+
+#ifdef ENABLE_GL_INTERCEPT
+	void Begin(GLenum mode);
+	void End();
+	void Vertex2f(GLfloat x, GLfloat y);
+	void Vertex3f(GLfloat x, GLfloat y, GLfloat z);
+	void Vertex3fv(const GLfloat* v);
+	void Normal3f(GLfloat x, GLfloat y, GLfloat z);
+	void Normal3fv(const GLfloat* v);
+	void Color3f(GLfloat r, GLfloat g, GLfloat b);
+	void Color4f(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+	void TexCoord2f(GLfloat s, GLfloat t);
+	void Enable(GLenum cap);
+	void Disable(GLenum cap);
+	void ShadeModel(GLenum mode);
+	void BlendFunc(GLenum source, GLenum destination);
+	void Lightfv(GLenum light, GLenum name, const GLfloat* params);
+	void PushAttrib(GLbitfield mask);
+	void PopAttrib();
+	void MatrixMode(GLenum mode);
+	void LoadIdentity();
+	void LoadMatrixf(const GLfloat* m);
+	void MultMatrixf(const GLfloat* m);
+	void PushMatrix();
+	void PopMatrix();
+	void Translatef(GLfloat x, GLfloat y, GLfloat z);
+	void Rotatef(GLfloat angle, GLfloat x, GLfloat y, GLfloat z);
+	void Scalef(GLfloat x, GLfloat y, GLfloat z);
+	void Ortho2D(GLdouble left, GLdouble right, GLdouble bottom, GLdouble top);
+	void Perspective(GLdouble fovy, GLdouble aspect, GLdouble zNear, GLdouble zFar);
+	void LookAt(GLdouble eyeX, GLdouble eyeY, GLdouble eyeZ, GLdouble centerX, GLdouble centerY, GLdouble centerZ, GLdouble upX, GLdouble upY, GLdouble upZ);
+	void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+	void Clear(GLbitfield mask);
+	void ClearColor(GLclampf r, GLclampf g, GLclampf b, GLclampf a);
+	void Flush();
+	void Finish();
+	void GenTextures(GLsizei n, GLuint* textures);
+	void DeleteTextures(GLsizei n, const GLuint* textures);
+	void BindTexture(GLenum target, GLuint texture);
+	void TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid* pixels);
+	void TexParameteri(GLenum target, GLenum name, GLint param);
+	void TexEnvf(GLenum target, GLenum name, GLfloat param);
+	void PixelStorei(GLenum name, GLint param);
+	void PushClientAttrib(GLbitfield mask);
+	void PopClientAttrib();
+	void EnableClientState(GLenum array);
+	void DisableClientState(GLenum array);
+	void VertexPointer(GLint size, GLenum type, GLsizei stride, const GLvoid* pointer);
+	void ColorPointer(GLint size, GLenum type, GLsizei stride, const GLvoid* pointer);
+	void TexCoordPointer(GLint size, GLenum type, GLsizei stride, const GLvoid* pointer);
+	void DrawArrays(GLenum mode, GLint first, GLsizei count);
+	const GLubyte* GetString(GLenum name);
+	void GetIntegerv(GLenum name, GLint* params);
+	void GetFloatv(GLenum name, GLfloat* params);
+	void ReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, GLvoid* pixels);
+#endif
+}
+
+// glIntercept.cpp calls the real entry points, so it's left alone
+#if defined(ENABLE_GL_INTERCEPT) && !defined(GL_INTERCEPT_IMPLEMENTATION)
+#define glBegin glintercept::Begin
+#define glEnd glintercept::End
+#define glVertex2f glintercept::Vertex2f
+#define glVertex3f glintercept::Vertex3f
+#define glVertex3fv glintercept::Vertex3fv
+#define glNormal3f glintercept::Normal3f
+#define glNormal3fv glintercept::Normal3fv
+#define glColor3f glintercept::Color3f
+#define glColor4f glintercept::Color4f
+#define glTexCoord2f glintercept::TexCoord2f
+#define glEnable glintercept::Enable
+#define glDisable glintercept::Disable
+#define glShadeModel glintercept::ShadeModel
+#define glBlendFunc glintercept::BlendFunc
+#define glLightfv glintercept::Lightfv
+#define glPushAttrib glintercept::PushAttrib
+#define glPopAttrib glintercept::PopAttrib
+#define glMatrixMode glintercept::MatrixMode
+#define glLoadIdentity glintercept::LoadIdentity
+#define glLoadMatrixf glintercept::LoadMatrixf
+#define glMultMatrixf glintercept::MultMatrixf
+#define glPushMatrix glintercept::PushMatrix
+#define glPopMatrix glintercept::PopMatrix
+#define glTranslatef glintercept::Translatef
+#define glRotatef glintercept::Rotatef
+#define glScalef glintercept::Scalef
+#define gluOrtho2D glintercept::Ortho2D
+#define gluPerspective glintercept::Perspective
+#define gluLookAt glintercept::LookAt
+#define glViewport glintercept::Viewport
+#define glClear glintercept::Clear
+#define glClearColor glintercept::ClearColor
+#define glFlush glintercept::Flush
+#define glFinish glintercept::Finish
+#define glGenTextures glintercept::GenTextures
+#define glDeleteTextures glintercept::DeleteTextures
+#define glBindTexture glintercept::BindTexture
+#define glTexImage2D glintercept::TexImage2D
+#define glTexParameteri glintercept::TexParameteri
+#define glTexEnvf glintercept::TexEnvf
+#define glPixelStorei glintercept::PixelStorei
+#define glPushClientAttrib glintercept::PushClientAttrib
+#define glPopClientAttrib glintercept::PopClientAttrib
+#define glEnableClientState glintercept::EnableClientState
+#define glDisableClientState glintercept::DisableClientState
+#define glVertexPointer glintercept::VertexPointer
+#define glColorPointer glintercept::ColorPointer
+#define glTexCoordPointer glintercept::TexCoordPointer
+#define glDrawArrays glintercept::DrawArrays
+#define glGetString glintercept::GetString
+#define glGetIntegerv glintercept::GetIntegerv
+#define glGetFloatv glintercept::GetFloatv
+#define glReadPixels glintercept::ReadPixels
+#endif
+
+#endif // GL_INTERCEPT_H
@@ -5,6 +5,8 @@
 
 #include <math.h>
 #include "main.h"
+#include "scene.h"
+#include "benchmark.h"
 
 typedef struct
 {
@@ -62,6 +64,50 @@ void solidCube(const GLfloat size)
 		glTexCoord2f(1.0, 0.0);
 		glVertex3fv(&v[faces[i][3]][0]);
 		glEnd();
+		countDraw(4);
+	}
+}
+
+// Same as glutWireCube, but doesn't need GLUT to be initialized
+void wireCube(const GLfloat size)
+{
+	static GLfloat n[6][3] =
+	{
+	  {-1.0, 0.0, 0.0},
+	  {0.0, 1.0, 0.0},
+	  {1.0, 0.0, 0.0},
+	  {0.0, -1.0, 0.0},
+	  {0.0, 0.0, 1.0},
+	  {0.0, 0.0, -1.0}
+	};
+	static GLint faces[6][4] =
+	{
+	  {0, 1, 2, 3},
+	  {3, 2, 6, 7},
+	  {7, 6, 5, 4},
+	  {4, 5, 1, 0},
+	  {5, 6, 2, 1},
+	  {7, 4, 0, 3}
+	};
+	GLfloat v[8][3];
+	GLint i;
+
+	v[0][0] = v[1][0] = v[2][0] = v[3][0] = -size / 2;
+	v[4][0] = v[5][0] = v[6][0] = v[7][0] = size / 2;
+	v[0][1] = v[1][1] = v[4][1] = v[5][1] = -size / 2;
+	v[2][1] = v[3][1] = v[6][1] = v[7][1] = size / 2;
+	v[0][2] = v[3][2] = v[4][2] = v[7][2] = -size / 2;
+	v[1][2] = v[2][2] = v[5][2] = v[6][2] = size / 2;
+
+	for (i = 5; i >= 0; i--) {
+		glBegin(GL_LINE_LOOP);
+		glNormal3fv(&n[i][0]);
+		glVertex3fv(&v[faces[i][0]][0]);
+		glVertex3fv(&v[faces[i][1]][0]);
+		glVertex3fv(&v[faces[i][2]][0]);
+		glVertex3fv(&v[faces[i][3]][0]);
+		glEnd();
+		countDraw(4);
 	}
 }
 
@@ -127,4 +173,90 @@ void solidSphere(const GLfloat size)
 	}
 
 	glEnd();
-}
\ No newline at end of file
+	countDraw(VertexCount * 2);
+}
+
+void drawPart(const ScenePart& part, const GLuint* textureIDs, const bool wireframe)
+{
+	if (textureIDs != nullptr)
+	{
+		glBindTexture(GL_TEXTURE_2D, textureIDs[part.texture]);
+		countStateChange();
+	}
+
+	glPushMatrix();
+	glMultMatrixf(part.transform.m);
+
+	switch (part.primitive)
+	{
+	case Primitive::CUBE:
+		wireframe ? wireCube(1) : solidCube(1);
+		break;
+
+	case Primitive::SPHERE:
+	{
+		const std::vector<MeshVertex>& mesh = primitiveMesh(Primitive::SPHERE);
+		glBegin(wireframe ? GL_LINES : GL_TRIANGLES);
+		for (const MeshVertex& vertex : mesh)
+		{
+			glNormal3f(vertex.x * 2, vertex.y * 2, vertex.z * 2);
+			glTexCoord2f(vertex.u * part.uvScale, vertex.v * part.uvScale);
+			glVertex3f(vertex.x, vertex.y, vertex.z);
+		}
+		glEnd();
+		countDraw((int)mesh.size());
+		break;
+	}
+
+	case Primitive::QUAD:
+	{
+		// Drawn as a quad rather than from the mesh, same as the ground always was
+		const std::vector<MeshVertex>& mesh = primitiveMesh(Primitive::QUAD);
+		const int corners[4] = { 0, 1, 2, 5 };
+		glBegin(wireframe ? GL_LINE_LOOP : GL_QUADS);
+		for (int corner : corners)
+		{
+			const MeshVertex& vertex = mesh[corner];
+			glTexCoord2f(vertex.u * part.uvScale, vertex.v * part.uvScale);
+			glVertex3f(vertex.x, vertex.y, vertex.z);
+		}
+		glEnd();
+		countDraw(4);
+		break;
+	}
+	}
+
+	glPopMatrix();
+}
+
+void drawParts(const std::vector<ScenePart>& parts, const GLuint* textureIDs, const bool wireframe)
+{
+	// Skip rebinding the texture between consecutive parts that share one
+	int bound = -1;
+	for (const ScenePart& part : parts)
+	{
+		drawPart(part, part.texture != bound ? textureIDs : nullptr, wireframe);
+		if (textureIDs != nullptr)
+		{
+			bound = part.texture;
+		}
+	}
+}
+
+void drawParts(const DrawLists& lists, const int camera, const GLuint* textureIDs, const bool wireframe)
+{
+	const FrameVector<DrawPacket>& list = lists.list(camera);
+	drawCounters.culled += (long long)(lists.partCount() - list.size());
+
+	// The list is sorted by texture, so each one is bound once
+	int bound = -1;
+	for (const DrawPacket& packet : list)
+	{
+		const ScenePart& part = lists.part(packet);
+		drawPart(part, part.texture != bound ? textureIDs : nullptr, wireframe);
+		if (textureIDs != nullptr)
+		{
+			bound = part.texture;
+		}
+	}
+}
@@ -0,0 +1,280 @@
+// Implementations for placing robots' hands and feet with inverse kinematics
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#include "limbSolver.h"
+
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include "trace.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// The joints of each limb, upper then lower
+static const std::string JOINT_NAMES[LimbSolver::LIMBS][2] =
+{
+	{ "left shoulder", "left elbow" },
+	{ "right shoulder", "right elbow" },
+	{ "left hip", "left knee" },
+	{ "right hip", "right knee" }
+};
+
+// The robot's limbs as Robot::collectParts builds them, a lane per limb.
+// Lengths run from one joint to the next, and then to the middle of the
+// end of the lower limb. Knees bend back and elbows bend forward.
+static const float ROOT_Y[LimbSolver::LIMBS] = { 3.1f, 3.1f, 1.75f, 1.75f };
+static const float END_X[LimbSolver::LIMBS] = { 0.7f, -0.7f, 0.3f, -0.3f };
+static const float UPPER_LENGTH[LimbSolver::LIMBS] = { 0.75f, 0.75f, 0.9f, 0.9f };
+static const float LOWER_LENGTH = 0.775f;
+static const float BEND[LimbSolver::LIMBS] = { -1.0f, -1.0f, 1.0f, 1.0f };
+
+static const float PI = 3.14159265358979f;
+
+// atan2 to within about 0.001 degrees, in every lane
+static simd::Lanes atan2Lanes(const simd::Lanes y, const simd::Lanes x)
+{
+	const simd::Lanes zero = simd::splat(0.0f);
+	const simd::Lanes absX = simd::max(x, simd::sub(zero, x));
+	const simd::Lanes absY = simd::max(y, simd::sub(zero, y));
+
+	// atan of the smaller over the larger, which is between 0 and 1
+	const simd::Lanes a = simd::div(simd::min(absX, absY), simd::max(simd::max(absX, absY), simd::splat(1e-30f)));
+	const simd::Lanes s = simd::mul(a, a);
+	simd::Lanes r = simd::multiplyAdd(simd::splat(-0.0464964749f), s, simd::splat(0.15931422f));
+	r = simd::multiplyAdd(r, s, simd::splat(-0.327622764f));
+	r = simd::multiplyAdd(simd::mul(r, s), a, a);
+
+	// Then back out to the octant and quadrant it came from
+	r = simd::select(simd::lessThan(absX, absY), simd::sub(simd::splat(PI * 0.5f), r), r);
+	r = simd::select(simd::lessThan(x, zero), simd::sub(simd::splat(PI), r), r);
+	return simd::select(simd::lessThan(y, zero), simd::sub(zero, r), r);
+}
+
+// sin and cos to within about 0.00001, for angles up to about a turn and a
+// half either way, which covers any two joints added together
+static void sinCosLanes(const simd::Lanes angle, simd::Lanes& sine, simd::Lanes& cosine)
+{
+	// Bring the angle to within half a turn. Adding and taking away 1.5 * 2^23
+	// rounds to the nearest whole number.
+	const simd::Lanes magic = simd::splat(12582912.0f);
+	const simd::Lanes turns = simd::sub(simd::add(simd::mul(angle, simd::splat(0.5f / PI)), magic), magic);
+	const simd::Lanes x = simd::sub(angle, simd::mul(turns, simd::splat(2.0f * PI)));
+
+	// Both as sines within a quarter turn of zero, folding sin about a
+	// quarter turn either way, and with cos(x) = sin(pi / 2 - x)
+	const simd::Lanes halfPi = simd::splat(PI * 0.5f);
+	const simd::Lanes pi = simd::splat(PI);
+	simd::Lanes s = simd::select(simd::lessThan(halfPi, x), simd::sub(pi, x), x);
+	s = simd::select(simd::lessThan(x, simd::sub(simd::splat(0.0f), halfPi)), simd::sub(simd::sub(simd::splat(0.0f), pi), x), s);
+	simd::Lanes c = simd::sub(halfPi, x);
+	c = simd::select(simd::lessThan(halfPi, c), simd::sub(pi, c), c);
+
+	// Taylor series to x^9, for both at once
+	for (int i = 0; i < 2; ++i)
+	{
+		const simd::Lanes v = i == 0 ? s : c;
+		const simd::Lanes v2 = simd::mul(v, v);
+		simd::Lanes p = simd::multiplyAdd(simd::splat(1.0f / 362880.0f), v2, simd::splat(-1.0f / 5040.0f));
+		p = simd::multiplyAdd(p, v2, simd::splat(1.0f / 120.0f));
+		p = simd::multiplyAdd(p, v2, simd::splat(-1.0f / 6.0f));
+		p = simd::multiplyAdd(simd::mul(p, v2), v, v);
+		(i == 0 ? sine : cosine) = p;
+	}
+}
+
+void LimbSolver::reserve(const size_t robotCount)
+{
+	const size_t lanes = robotCount * LIMBS;
+	upper_.resize(std::max(upper_.size(), lanes));
+	lower_.resize(upper_.size());
+	targetY_.resize(upper_.size());
+	targetZ_.resize(upper_.size());
+	weights_.resize(upper_.size());
+	robots_.resize(upper_.size() / LIMBS);
+
+	if (handWeights_.size() < lanes)
+	{
+		handTargets_.resize(lanes);
+		handWeights_.resize(lanes, 0.0f);
+	}
+}
+
+void LimbSolver::setHandTarget(const size_t robot, const Limb arm, const float3& target, const float weight)
+{
+	reserve(robot + 1);
+	handTargets_[robot * LIMBS + arm] = target;
+	handWeights_[robot * LIMBS + arm] = weight;
+}
+
+void LimbSolver::clearHandTargets()
+{
+	std::fill(handWeights_.begin(), handWeights_.end(), 0.0f);
+}
+
+float3 LimbSolver::limbEnd(const Limb limb, const float upper, const float lower)
+{
+	const float a = upper * DEGREES_TO_RADIANS;
+	const float b = (upper + lower) * DEGREES_TO_RADIANS;
+	return float3
+	(
+		END_X[limb],
+		ROOT_Y[limb] - UPPER_LENGTH[limb] * cosf(a) - LOWER_LENGTH * cosf(b),
+		-UPPER_LENGTH[limb] * sinf(a) - LOWER_LENGTH * sinf(b)
+	);
+}
+
+bool LimbSolver::gather(Robot& robot, const uint32_t index, const size_t first)
+{
+	const std::unordered_map<std::string, float>& joints = robot.getJoints();
+	for (int limb = 0; limb < LIMBS; ++limb)
+	{
+		upper_[first + limb] = joints.at(JOINT_NAMES[limb][0]);
+		lower_[first + limb] = joints.at(JOINT_NAMES[limb][1]);
+	}
+
+	// Where the hands and feet are now, all four limbs at once
+	const simd::Lanes upper = simd::mul(simd::load(&upper_[first]), simd::splat(DEGREES_TO_RADIANS));
+	const simd::Lanes lower = simd::mul(simd::load(&lower_[first]), simd::splat(DEGREES_TO_RADIANS));
+	simd::Lanes sinUpper, cosUpper, sinBoth, cosBoth;
+	sinCosLanes(upper, sinUpper, cosUpper);
+	sinCosLanes(simd::add(upper, lower), sinBoth, cosBoth);
+
+	const simd::Lanes upperLength = simd::load(UPPER_LENGTH);
+	const simd::Lanes lowerLength = simd::splat(LOWER_LENGTH);
+	float endY[LIMBS], endZ[LIMBS];
+	simd::store(endY, simd::sub(simd::sub(simd::load(ROOT_Y), simd::mul(upperLength, cosUpper)), simd::mul(lowerLength, cosBoth)));
+	simd::store(endZ, simd::sub(simd::sub(simd::splat(0.0f), simd::mul(upperLength, sinUpper)), simd::mul(lowerLength, sinBoth)));
+
+	// Limbs that don't move keep a target where they are, so every lane
+	// solves to something sensible
+	bool adjust = false;
+	for (int limb = 0; limb < LIMBS; ++limb)
+	{
+		float y = endY[limb];
+		float z = endZ[limb];
+		float weight = 0.0f;
+
+		if (limb == LEFT_LEG || limb == RIGHT_LEG)
+		{
+			// Feet below the ground are lifted straight up onto it
+			const float3 foot = robot.worldMatrix().transformPoint(float3(END_X[limb], y, z));
+			const float height = ground_(foot.x, foot.z);
+			if (foot.y < height)
+			{
+				y += height - foot.y;
+				weight = 1.0f;
+			}
+		}
+		else if (handWeights_[index * LIMBS + limb] > 0.0f)
+		{
+			const float3 hand = robot.inverseWorldMatrix().transformPoint(handTargets_[index * LIMBS + limb]);
+			y = hand.y;
+			z = hand.z;
+			weight = handWeights_[index * LIMBS + limb];
+		}
+
+		targetY_[first + limb] = y - ROOT_Y[limb];
+		targetZ_[first + limb] = z;
+		weights_[first + limb] = weight;
+		adjust = adjust || weight > 0.0f;
+	}
+	return adjust;
+}
+
+void LimbSolver::solveLanes(const size_t lanes)
+{
+	const simd::Lanes zero = simd::splat(0.0f);
+	const simd::Lanes one = simd::splat(1.0f);
+	const simd::Lanes toDegrees = simd::splat(1.0f / DEGREES_TO_RADIANS);
+
+	// The same for every robot
+	const simd::Lanes upperLength = simd::load(UPPER_LENGTH);
+	const simd::Lanes lowerLength = simd::splat(LOWER_LENGTH);
+	const simd::Lanes bend = simd::load(BEND);
+	const simd::Lanes lengthsSquared = simd::add(simd::mul(upperLength, upperLength), simd::mul(lowerLength, lowerLength));
+	const simd::Lanes twoLengths = simd::mul(simd::splat(2.0f), simd::mul(upperLength, lowerLength));
+	const simd::Lanes difference = simd::sub(upperLength, lowerLength);
+	const simd::Lanes minReach = simd::add(simd::max(difference, simd::sub(zero, difference)), simd::splat(0.001f));
+	const simd::Lanes maxReach = simd::sub(simd::add(upperLength, lowerLength), simd::splat(0.0001f));
+
+	for (size_t i = 0; i < lanes; i += LIMBS)
+	{
+		const simd::Lanes y = simd::load(&targetY_[i]);
+		const simd::Lanes z = simd::load(&targetZ_[i]);
+
+		// Targets out of reach are reached for as far as the limb goes
+		const simd::Lanes reach = simd::min(simd::max(simd::sqrt(simd::add(simd::mul(y, y), simd::mul(z, z))), minReach), maxReach);
+
+		// The elbow or knee, from the law of cosines
+		simd::Lanes cosLower = simd::div(simd::sub(simd::mul(reach, reach), lengthsSquared), twoLengths);
+		cosLower = simd::min(simd::max(cosLower, simd::splat(-1.0f)), one);
+		const simd::Lanes sinLower = simd::mul(bend, simd::sqrt(simd::max(simd::sub(one, simd::mul(cosLower, cosLower)), zero)));
+		const simd::Lanes lower = atan2Lanes(sinLower, cosLower);
+
+		// The shoulder or hip turns the bent limb's end onto the target.
+		// Angles are measured from straight down, turning towards -z.
+		const simd::Lanes toTargetCos = simd::sub(zero, y);
+		const simd::Lanes toTargetSin = simd::sub(zero, z);
+		const simd::Lanes bentCos = simd::multiplyAdd(lowerLength, cosLower, upperLength);
+		const simd::Lanes bentSin = simd::mul(lowerLength, sinLower);
+		const simd::Lanes upper = atan2Lanes
+		(
+			simd::sub(simd::mul(toTargetSin, bentCos), simd::mul(toTargetCos, bentSin)),
+			simd::add(simd::mul(toTargetCos, bentCos), simd::mul(toTargetSin, bentSin))
+		);
+
+		// As far from the keyframes' angles as the weight says
+		const simd::Lanes weight = simd::load(&weights_[i]);
+		const simd::Lanes keyUpper = simd::load(&upper_[i]);
+		const simd::Lanes keyLower = simd::load(&lower_[i]);
+		simd::store(&upper_[i], simd::multiplyAdd(simd::sub(simd::mul(upper, toDegrees), keyUpper), weight, keyUpper));
+		simd::store(&lower_[i], simd::multiplyAdd(simd::sub(simd::mul(lower, toDegrees), keyLower), weight, keyLower));
+	}
+}
+
+void LimbSolver::solve(const std::vector<Robot*>& robots, const uint32_t* indices, const size_t count)
+{
+	TRACE_SCOPE("limb solve");
+	reserve(std::max(count, robots.size()));
+
+	const Clock::time_point start = Clock::now();
+	size_t adjusted = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (gather(*robots[indices[i]], indices[i], adjusted * LIMBS))
+		{
+			robots_[adjusted++] = indices[i];
+		}
+	}
+
+	const Clock::time_point gathered = Clock::now();
+	solveLanes(adjusted * LIMBS);
+
+	const Clock::time_point solved = Clock::now();
+	size_t limbs = 0;
+	for (size_t i = 0; i < adjusted; ++i)
+	{
+		Robot& robot = *robots[robots_[i]];
+		for (int limb = 0; limb < LIMBS; ++limb)
+		{
+			const size_t lane = i * LIMBS + limb;
+			if (weights_[lane] > 0.0f)
+			{
+				robot.setJointRot(JOINT_NAMES[limb][0], upper_[lane]);
+				robot.setJointRot(JOINT_NAMES[limb][1], lower_[lane]);
+				++limbs;
+			}
+		}
+	}
+	const Clock::time_point end = Clock::now();
+
+	stats_.robots = count;
+	stats_.adjusted = adjusted;
+	stats_.limbs = limbs;
+	stats_.gatherNs = std::chrono::duration<double, std::nano>(gathered - start).count();
+	stats_.solveNs = std::chrono::duration<double, std::nano>(solved - gathered).count();
+	stats_.scatterNs = std::chrono::duration<double, std::nano>(end - solved).count();
+}
@@ -0,0 +1,100 @@
+// Header file for placing robots' hands and feet with inverse kinematics
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef LIMB_SOLVER_H
+#define LIMB_SOLVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "animation.h"
+#include "vectorMath.h"
+
+// Bends robots' arms and legs after their keyframes are sampled, so their
+// feet stay out of the ground and their hands reach for targets. Each limb
+// is two bones hinged about x, so it's solved exactly in its own y-z plane:
+// the law of cosines gives the elbow or knee, and the direction to the
+// target less the bend gives the shoulder or hip.
+//
+// Everything the solve touches is kept as separate arrays of floats, one
+// entry per limb with a robot's four next to each other, so the limbs are
+// solved four at a time. Robots with nothing to adjust are left out before
+// solving, so a crowd whose feet are clear of the ground costs only the
+// check. Robots only ever turn about y, so a height in the world is the same
+// height in their model space.
+class LimbSolver
+{
+public:
+	// In the order of a robot's lanes
+	enum Limb
+	{
+		LEFT_ARM,
+		RIGHT_ARM,
+		LEFT_LEG,
+		RIGHT_LEG,
+		LIMBS
+	};
+
+	// How high the ground is under a point in the world
+	typedef float (*GroundHeight)(const float x, const float z);
+
+	LimbSolver(GroundHeight ground) : ground_(ground) {}
+
+	// Sizes everything for robotCount robots, so solving doesn't allocate
+	void reserve(const size_t robotCount);
+
+	// Where robot's hand on arm reaches for, in the world, and how far to go
+	// from the keyframes' pose (0) to reaching it (1). Hands only swing
+	// forward and back, so it's the nearest they can get.
+	void setHandTarget(const size_t robot, const Limb arm, const float3& target, const float weight);
+	void clearHandTargets();
+
+	// Adjusts the limbs of robots[indices[0]] to robots[indices[count - 1]],
+	// which have just been posed. Indices are the robots' places in robots,
+	// which hand targets use too.
+	void solve(const std::vector<Robot*>& robots, const uint32_t* indices, const size_t count);
+
+	// What the last solve() did and how long each part took
+	struct Stats
+	{
+		size_t robots = 0;		// Checked
+		size_t adjusted = 0;	// With any limb to move
+		size_t limbs = 0;		// Moved
+		double gatherNs = 0.0;	// Reading joints, finding where hands and feet are, and choosing targets
+		double solveNs = 0.0;
+		double scatterNs = 0.0;	// Writing joints back
+	};
+	const Stats& stats() const { return stats_; }
+
+	// Where the limb's hand or foot is in robot's model space, for angles
+	// in degrees at the shoulder or hip and the elbow or knee
+	static float3 limbEnd(const Limb limb, const float upper, const float lower);
+
+private:
+	// Reads robot's joints into lanes first to first + 3, finds where its
+	// hands and feet are, and sets their targets. Returns whether any limb
+	// needs moving.
+	bool gather(Robot& robot, const uint32_t index, const size_t first);
+
+	// Solves every limb gathered, four at a time
+	void solveLanes(const size_t lanes);
+
+	GroundHeight ground_;
+	Stats stats_;
+
+	// One per limb gathered
+	std::vector<float> upper_;		// Shoulder or hip, in degrees
+	std::vector<float> lower_;		// Elbow or knee
+	std::vector<float> targetY_;	// From the shoulder or hip, in model space
+	std::vector<float> targetZ_;
+	std::vector<float> weights_;
+	std::vector<uint32_t> robots_;	// Which robot each group of four is
+
+	// One per limb of every robot, whether gathered or not
+	std::vector<float3> handTargets_;
+	std::vector<float> handWeights_;
+};
+
+#endif // LIMB_SOLVER_H
@@ -1,11 +1,30 @@
-#include "point.h"
 #include "animation.h"
+#include "behaviour.h"
+#include "limbSolver.h"
 #include "main.h"
+#include "backend.h"
+#include "texture.h"
+#include "textureStreamer.h"
+#include "scene.h"
+#include "softwareRenderer.h"
+#include "rayTracer.h"
+#include "benchmark.h"
+#include "trace.h"
+#include "overlay.h"
+#include "framePacer.h"
+#include "simulation.h"
+#include "frameArena.h"
+#include "frameGraph.h"
+#include "threadPool.h"
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
 #include <vector>
-#include <FreeImage/FreeImage.h>
 
 using namespace std;
 void loadTextures();
@@ -30,18 +49,26 @@ enum cameraList currentCamera = CAMERA_OUTER;
 
 #define USING_INNER (currentCamera == CAMERA_INNER)
 
-float M_PI = 3.141592;
+const float PI = 3.141592f;
 
-Point outerCamTPR;
-Point outerCamXYZ;
+float3 outerCamTPR;
+float3 outerCamXYZ;
 
-Point innerCamXYZ;
-Point innerCamTPR;
-Point innerCamDir;
+float3 innerCamXYZ;
+float3 innerCamTPR;
+float3 innerCamDir;
 
-// Robot
-Robot robot;
-Animation robotWalking(robot);
+// Robots, each walking with its own animation. Once the scene is built only
+//  the simulation touches them, and everything else draws its snapshots.
+vector<Robot*> robots;
+vector<Animation*> robotAnimations;
+Simulation simulation(robots, robotAnimations, Animation::STEP_SECONDS);
+
+// With --scripted the robots follow behaviour scripts instead, each posed by
+//  a rig that owns its animations
+BehaviourScheduler behaviours;
+AgentGait robotGait;
+vector<AgentRig*> robotRigs;
 
 const std::string leftShoulder = "left shoulder";
 const std::string leftElbow = "left elbow";
@@ -55,6 +82,17 @@ const std::string rightKnee = "right knee";
 // Trees
 vector<StaticModel*> trees;
 
+// Ground
+const int groundSize = 10;
+const int groundHeight = -1;
+
+// With --ik robots' feet are kept out of the ground after they're posed
+float groundAt(const float /*x*/, const float /*z*/)
+{
+    return (float)groundHeight;
+}
+LimbSolver limbSolver(groundAt);
+
 // Textures
 const int numTextures = 4;
 char* textureNames[numTextures] =
@@ -65,6 +103,87 @@ char* textureNames[numTextures] =
     (char*)"textures/metal.jpg"
 };
 GLuint textureIDs[numTextures];
+TextureStreamer textureStreamer;
+
+// Performance overlay
+PerformanceOverlay overlay;
+std::chrono::steady_clock::time_point lastFrameStart;
+
+// What has changed since the last frame. Nothing is drawn unless one of
+//  these is set, and input only sets them, so any number of events between
+//  two ticks turn into a single frame.
+enum DirtyFlags
+{
+    DIRTY_CAMERA = 1 << 0,                  // Either camera moved, or we switched cameras
+    DIRTY_MODELS = 1 << 1,                  // Model transforms or joint poses changed
+    DIRTY_SETTINGS = 1 << 2,                // Wireframe, axes or animation toggled
+    DIRTY_TEXTURES = 1 << 3,                // A streamed texture may be ready to swap in
+    DIRTY_WINDOW = 1 << 4,                  // Resized, or the context is new
+    DIRTY_OVERLAY = 1 << 5,                 // The overlay was toggled
+    DIRTY_CAPTURE = 1 << 6                  // A frame is wanted for a GL capture
+};
+unsigned int dirtyFlags = 0;
+bool ticking = false;                       // Whether frameTick() is the idle function
+
+// Frames are drawn on the pacer's schedule, with the robots blended between
+//  their last two animation steps
+FramePacer pacer(Animation::STEP_SECONDS, Animation::STEP_SECONDS);
+float renderBlend = 1.0f;
+
+// Each frame is a graph of stages run on the frame pool. Only the stages
+//  that submit to GL are held to the context thread.
+FrameGraph frameGraph;
+ThreadPool* framePool = nullptr;
+
+// What traversal finds for each camera, for submission to draw
+DrawLists drawLists;
+const int OUTER_LIST = 0;
+const int INNER_LIST = 1;
+const int MODELS_PER_JOB = 64;              // Models each traversal job poses and culls
+
+// Activity since it was last reported
+struct ActivityStats
+{
+    long long events = 0;                   // Input and window events
+    long long ticks = 0;
+    long long frames = 0;
+    int eventsSinceFrame = 0;
+    double cpuSeconds = 0.0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+ActivityStats activity;
+
+// markDirty() /////////////////////////////////////////////////////////////////
+//
+//  Notes that the scene changed, and makes sure ticks are running to draw
+//      it. The pacer still waits until the next frame is due, so bursts of
+//      input can't render faster than the frame rate cap.
+//
+////////////////////////////////////////////////////////////////////////////////
+void frameTick();
+
+void markDirty(const unsigned int flags)
+{
+    dirtyFlags |= flags;
+    if (ticking || backend == nullptr)
+        return;
+
+    // Nothing was animating while we were idle, so don't catch up on it
+    pacer.restart(backend->time());
+    ticking = true;
+    backend->setIdleFunc(frameTick);
+}
+
+// countEvent() ////////////////////////////////////////////////////////////////
+//
+//  Counts an input or window event toward the events-per-frame report.
+//
+////////////////////////////////////////////////////////////////////////////////
+void countEvent()
+{
+    ++activity.events;
+    ++activity.eventsSinceFrame;
+}
 
 // recomputeOrientation() //////////////////////////////////////////////////////
 //
@@ -73,12 +192,12 @@ GLuint textureIDs[numTextures];
 //  either camera's spherical coordinates are updated.
 //
 ////////////////////////////////////////////////////////////////////////////////
-void recomputeOrientation(Point& xyz, Point& tpr)
+void recomputeOrientation(float3& xyz, float3& tpr)
 {
     xyz.x = tpr.z * sinf(tpr.x) * sinf(tpr.y);
     xyz.z = tpr.z * -cosf(tpr.x) * sinf(tpr.y);
     xyz.y = tpr.z * -cosf(tpr.y);
-    glutPostRedisplay();
+    markDirty(DIRTY_CAMERA);
 }
 
 // resizeWindow() //////////////////////////////////////////////////////////////
@@ -88,6 +207,9 @@ void recomputeOrientation(Point& xyz, Point& tpr)
 ////////////////////////////////////////////////////////////////////////////////
 void resizeWindow(int w, int h)
 {
+    TRACE_SCOPE("resizeWindow");
+    countEvent();
+
     aspectRatio = w / (float)h;
 
     windowWidth = w;
@@ -101,7 +223,7 @@ void resizeWindow(int w, int h)
     glLoadIdentity();
     gluPerspective(45.0, aspectRatio, 0.1, 100000);
 
-    glutPostRedisplay();
+    markDirty(DIRTY_WINDOW);
 }
 
 
@@ -115,6 +237,8 @@ void resizeWindow(int w, int h)
 ////////////////////////////////////////////////////////////////////////////////
 void mouseCallback(int button, int state, int thisX, int thisY)
 {
+    countEvent();
+
     //update the left and right mouse button states, if applicable
     if (button == GLUT_LEFT_BUTTON)
         leftMouseButton = state;
@@ -137,17 +261,20 @@ void mouseCallback(int button, int state, int thisX, int thisY)
 ////////////////////////////////////////////////////////////////////////////////
 void mouseMotion(int x, int y)
 {
+    TRACE_SCOPE("mouseMotion");
+    countEvent();
+
     if (leftMouseButton == GLUT_DOWN)
     {
-        Point* curTPR = (USING_INNER ? &innerCamTPR : &outerCamTPR);      //just for conciseness below
+        float3* curTPR = (USING_INNER ? &innerCamTPR : &outerCamTPR);      //just for conciseness below
         curTPR->x += (x - mouseX) * 0.005;
         curTPR->y += (USING_INNER ? -1 : 1) * (y - mouseY) * 0.005;
 
-        // make sure that phi stays within the range (0, M_PI)
+        // make sure that phi stays within the range (0, PI)
         if (curTPR->y <= 0)
             curTPR->y = 0 + 0.001;
-        if (curTPR->y >= M_PI)
-            curTPR->y = M_PI - 0.001;
+        if (curTPR->y >= PI)
+            curTPR->y = PI - 0.001;
 
         //update camera (x,y,z) based on (radius,theta,phi)
         if (USING_INNER)
@@ -162,7 +289,7 @@ void mouseMotion(int x, int y)
     else if (rightMouseButton == GLUT_DOWN && !USING_INNER) {
         double totalChangeSq = (x - mouseX) + (y - mouseY);
 
-        Point* curTPR = &outerCamTPR;      //just for conciseness below
+        float3* curTPR = &outerCamTPR;      //just for conciseness below
         curTPR->z += totalChangeSq * 0.01;
 
         //limit the camera radius to some reasonable values so the user can't get lost
@@ -189,6 +316,8 @@ void mouseMotion(int x, int y)
 ////////////////////////////////////////////////////////////////////////////////
 void initScene()
 {
+    TRACE_SCOPE("initScene");
+
     glEnable(GL_DEPTH_TEST);
 
     float lightCol[4] = { 1, 1, 1, 1 };
@@ -209,21 +338,102 @@ void initScene()
     glLoadIdentity();
     loadTextures();
 
-    glutPostRedisplay();
+    // Later texture loads are streamed in while the scene keeps rendering
+    glext::load();
+    textureStreamer.initialize();
+    overlay.initialize();
+
+    markDirty(DIRTY_WINDOW);
+}
+
+
+// groundPart() ///////////////////////////////////////////////////////////////
+//
+//  The textured ground, as a quad covering the grid the wireframe draws.
+//
+////////////////////////////////////////////////////////////////////////////////
+ScenePart groundPart()
+{
+    ScenePart ground;
+    ground.primitive = Primitive::QUAD;
+    ground.texture = TEXTURE_GRASS;
+    ground.uvScale = groundSize;
+    ground.transform = mat4::translation(0, groundHeight, 0).scale(2 * groundSize, 1, 2 * groundSize);
+    return ground;
+}
+
+// collectModelParts() /////////////////////////////////////////////////////////
+//
+//  The robots and trees, in the order drawSceneElements() draws them.
+//
+////////////////////////////////////////////////////////////////////////////////
+void collectModelParts(std::vector<ScenePart>& parts)
+{
+    for (const Robot& robot : simulation.snapshot().robots)
+    {
+        robot.collectParts(parts, renderBlend);
+    }
+    for (StaticModel* tree : trees)
+    {
+        tree->collectParts(parts);
+    }
+}
+
+// collectSceneParts() /////////////////////////////////////////////////////////
+//
+//  Everything drawSceneElements() draws with triangles, for the renderers
+//      that don't go through GL.
+//
+////////////////////////////////////////////////////////////////////////////////
+void collectSceneParts(std::vector<ScenePart>& parts)
+{
+    parts.push_back(groundPart());
+    collectModelParts(parts);
+}
+
+// sceneProjection() //////////////////////////////////////////////////////////
+//
+//  The projection resizeWindow() sets up, for work that can't ask GL for it.
+//      Both cameras use it, since their viewports have the same shape.
+//
+////////////////////////////////////////////////////////////////////////////////
+mat4 sceneProjection()
+{
+    return mat4::perspective(45.0f, aspectRatio, 0.1f, 100000);
+}
+
+// outerCameraView() ///////////////////////////////////////////////////////////
+//
+//  The modelview matrix each camera draws the scene with.
+//
+////////////////////////////////////////////////////////////////////////////////
+mat4 outerCameraView()
+{
+    return mat4::lookAt(outerCamXYZ.x, outerCamXYZ.y, outerCamXYZ.z, 0, 0, 0, 0, 1, 0);
 }
 
+mat4 innerCameraView()
+{
+    return mat4::lookAt(innerCamXYZ.x, innerCamXYZ.y, innerCamXYZ.z,
+        innerCamXYZ.x + innerCamDir.x, innerCamXYZ.y + innerCamDir.y, innerCamXYZ.z + innerCamDir.z,
+        0, 1, 0);
+}
 
 // drawSceneElements() /////////////////////////////////////////////////////////
 //
 //  Because we'll be drawing the scene twice from different viewpoints,
 //      we encapsulate the code to draw the scene here, so that we can just
 //      call this function twice once the projection and modelview matrices
-//      have been set appropriately.
+//      have been set appropriately. The models drawn are the camera's list
+//      in drawLists.
 //
 ////////////////////////////////////////////////////////////////////////////////
-void drawSceneElements(void)
+void drawSceneElements(const int camera)
 {
+    TRACE_SCOPE("drawSceneElements");
+
     glDisable(GL_LIGHTING);
+    countStateChange();
 
     // Draw axes
     if (showAxes)
@@ -239,6 +449,7 @@ void drawSceneElements(void)
         glColor3f(0, 0, 1);
         glVertex3f(0, 0, 0); glVertex3f(0, 0, 3);
         glEnd();
+        countDraw(6);
     }
 
     // Wireframes should be white and don't need lighting or textures
@@ -247,12 +458,11 @@ void drawSceneElements(void)
     {
         glEnable(GL_LIGHTING);
         glEnable(GL_TEXTURE_2D);
+        countStateChange();
+        countStateChange();
     }
 
     // Draw the ground
-    const int groundSize = 10;
-    const int groundHeight = -1;
-
     if (wireframe)
     {
         //draw a simple grid under the teapot
@@ -265,38 +475,20 @@ void drawSceneElements(void)
                 for (int j = -groundSize; j <= groundSize; j++)
                     glVertex3f(dir < 1 ? i : j, groundHeight, dir < 1 ? j : i);
                 glEnd();
+                countDraw(2 * groundSize + 1);
             }
         }
     }
     else
     {
-        glBindTexture(GL_TEXTURE_2D, textureIDs[2]); // ground.png
-        glBegin(GL_QUADS);
-        glTexCoord2f(0.0, 0.0);
-        glVertex3f(groundSize, groundHeight, groundSize);
-        glTexCoord2f(0.0, groundSize);
-        glVertex3f(groundSize, groundHeight, -groundSize);
-        glTexCoord2f(groundSize, groundSize);
-        glVertex3f(-groundSize, groundHeight, -groundSize);
-        glTexCoord2f(groundSize, 0.0);
-        glVertex3f(-groundSize, groundHeight, groundSize);
-        glEnd();
+        drawPart(groundPart(), textureIDs, false);
     }
 
-
-    // Draw the robot
-    glBindTexture(GL_TEXTURE_2D, textureIDs[3]); // metal.jpg
-    robot.useWireframe(wireframe);
-    robot.draw();
-
-    // Draw trees
-    for (StaticModel* tree : trees)
-    {
-        tree->useWireframe(wireframe);
-        tree->draw(textureIDs);
-    }
+    // Draw the robots and trees, skipping any parts the camera can't see
+    drawParts(drawLists, camera, textureIDs, wireframe);
 
     glDisable(GL_TEXTURE_2D);
+    countStateChange();
 }
 
 
@@ -310,51 +502,95 @@ void drawSceneElements(void)
 ////////////////////////////////////////////////////////////////////////////////
 void drawInnerCamera()
 {
+    TRACE_SCOPE("drawInnerCamera");
+
     glPushAttrib(GL_LIGHTING_BIT);
     glDisable(GL_LIGHTING);
+    countStateChange();
 
     glMatrixMode(GL_MODELVIEW);
     glPushMatrix();
     glTranslatef(innerCamXYZ.x, innerCamXYZ.y, innerCamXYZ.z);
-    glRotatef(-innerCamTPR.x * 180.0 / M_PI, 0, 1, 0);
-    glRotatef(innerCamTPR.y * 180.0 / M_PI, 1, 0, 0);
+    glRotatef(-innerCamTPR.x * 180.0 / PI, 0, 1, 0);
+    glRotatef(innerCamTPR.y * 180.0 / PI, 1, 0, 0);
     glColor3f(0, 1, 0);
 
     // Camera box
     glPushMatrix();
     glScalef(2, 0.5, 1.5);
-    glutWireCube(1.0f);
+    wireCube(1.0f);
     glPopMatrix();
 
     // Camera flash
     glPushMatrix();
     glTranslatef(-0.5f, 0, -0.85f);
     glScalef(2, 1, 1);
-    glutWireCube(0.2f);
+    wireCube(0.2f);
     glPopMatrix();
     
     // Camera lens
     const float lensRadius = 0.5f;
+    int lensVertices = 0;
     glBegin(GL_LINE_LOOP);
-    for (float i = 0; i < 2 * M_PI; i += 0.1f)
+    for (float i = 0; i < 2 * PI; i += 0.1f)
     {
         glVertex3f(lensRadius * cos(i), -0.25f, lensRadius * sin(i));
+        ++lensVertices;
     }
     glEnd();
+    countDraw(lensVertices);
 
     glPopMatrix();
     glPopAttrib();
 }
 
-// renderCallback() ////////////////////////////////////////////////////////////
+// Frame graph stages //////////////////////////////////////////////////////////
 //
-//  GLUT callback for scene rendering. Sets up the modelview matrix, renders
-//      a teapot to the back buffer, and switches the back buffer with the
-//      front buffer (what the user sees).
+//  What renderCallback() runs each frame. Traversal poses and culls the
+//      models in chunks spread over the frame pool, then each camera's
+//      packets are merged and sorted. GL submission stays on the context
+//      thread: the outer camera can be drawn as soon as its own list is
+//      sorted, while the inner camera's is still being sorted.
 //
 ////////////////////////////////////////////////////////////////////////////////
-void renderCallback(void)
+int modelCount()
+{
+    return (int)(simulation.snapshot().robots.size() + trees.size());
+}
+
+void traverseModels(const int job, const int thread)
+{
+    const std::vector<Robot>& snapshotRobots = simulation.snapshot().robots;
+    const int count = modelCount();
+    const int end = std::min((job + 1) * MODELS_PER_JOB, count);
+    std::vector<ScenePart>& parts = drawLists.threadParts(thread);
+
+    for (int model = job * MODELS_PER_JOB; model < end; ++model)
+    {
+        const size_t firstPart = parts.size();
+        if (model < (int)snapshotRobots.size())
+            snapshotRobots[model].collectParts(parts, renderBlend);
+        else
+            trees[model - snapshotRobots.size()]->collectParts(parts);
+        drawLists.cull(thread, (uint32_t)model, firstPart);
+    }
+}
+
+void sortOuterCamera()
+{
+    drawLists.sort(OUTER_LIST);
+}
+
+void sortInnerCamera()
+{
+    drawLists.sort(INNER_LIST);
+}
+
+void submitOuterCamera()
 {
+    // Swap in any textures that finished streaming since the last frame
+    textureStreamer.update();
+
     //clear the render buffer
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
@@ -366,6 +602,8 @@ void renderCallback(void)
     glViewport(0, 0, windowWidth, windowHeight);
     glDisable(GL_LIGHTING);
     glDisable(GL_DEPTH_TEST);
+    countStateChange();
+    countStateChange();
     glMatrixMode(GL_PROJECTION);
     
     glPushMatrix();
@@ -386,6 +624,7 @@ void renderCallback(void)
     glBegin(GL_QUADS);
     glVertex2f(0, 0); glVertex2f(0, 1); glVertex2f(1, 1); glVertex2f(1, 0);
     glEnd();
+    countDraw(4);
 
     // Set the viewport dimensions
     glViewport(borderWidth, borderWidth, windowWidth - borderWidth * 2, windowHeight - borderWidth * 2);
@@ -395,12 +634,15 @@ void renderCallback(void)
     glBegin(GL_QUADS);
     glVertex2f(0, 0); glVertex2f(0, 1); glVertex2f(1, 1); glVertex2f(1, 0);
     glEnd();
+    countDraw(4);
 
     // Set up lighting and depth
     glMatrixMode(GL_PROJECTION);
     glPopMatrix();
     glEnable(GL_LIGHTING);
     glEnable(GL_DEPTH_TEST);
+    countStateChange();
+    countStateChange();
 
     //update the modelview matrix based on the camera's position
     glMatrixMode(GL_MODELVIEW);
@@ -409,12 +651,19 @@ void renderCallback(void)
         0, 0, 0,
         0, 1, 0);
 
-    drawSceneElements();
+    drawSceneElements(OUTER_LIST);
     drawInnerCamera();
+}
+
+void submitInnerCamera()
+{
+    float borderWidth = 3;
 
     // Set up the inner camera
     glDisable(GL_LIGHTING);
     glDisable(GL_DEPTH_TEST);
+    countStateChange();
+    countStateChange();
 
     //step 1: set the projection matrix using gluOrtho2D -- but save it first!
     glMatrixMode(GL_PROJECTION);
@@ -438,6 +687,7 @@ void renderCallback(void)
     glBegin(GL_QUADS);
     glVertex2f(0, 0); glVertex2f(0, 1); glVertex2f(1, 1); glVertex2f(1, 0);
     glEnd();
+    countDraw(4);
 
     //step 4: trim the viewport window to the size we want it...
     glViewport(2 * windowWidth / 3.0, 2 * windowHeight / 3.0,
@@ -448,6 +698,7 @@ void renderCallback(void)
     glBegin(GL_QUADS);
     glVertex2f(0, 0); glVertex2f(0, 1); glVertex2f(1, 1); glVertex2f(1, 0);
     glEnd();
+    countDraw(4);
 
     //before rendering the scene in the corner, pop the old projection matrix back
     //and re-enable lighting!
@@ -455,6 +706,8 @@ void renderCallback(void)
     glPopMatrix();
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_LIGHTING);
+    countStateChange();
+    countStateChange();
 
     // Begin drawing scene in upper corner
 
@@ -474,257 +727,1605 @@ void renderCallback(void)
     glClear(GL_DEPTH_BUFFER_BIT);                   //ensure that the overlay is always on top!
 
 
-    drawSceneElements();
-
-    //push the back buffer to the screen
-    glutSwapBuffers();
+    drawSceneElements(INNER_LIST);
 }
 
-void doAnimation(int v)
+// renderCallback() ////////////////////////////////////////////////////////////
+//
+//  GLUT callback for scene rendering. Sets up the modelview matrix, renders
+//      a teapot to the back buffer, and switches the back buffer with the
+//      front buffer (what the user sees).
+//
+////////////////////////////////////////////////////////////////////////////////
+void renderCallback(void)
 {
-    if (doRobotAnim)
+    TRACE_SCOPE("renderCallback");
+    const std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+    drawCounters = DrawCounters();
+    matrixCounters.clear();
+    glintercept::beginFrame();
+    frameArenas.beginFrame();
+    dirtyFlags = 0;
+    ++activity.frames;
+
+    // Pose, cull and sort on the frame pool while this thread waits to submit
+    const Frustum frustums[] =
+    {
+        Frustum::fromMatrix(sceneProjection() * outerCameraView()),
+        Frustum::fromMatrix(sceneProjection() * innerCameraView())
+    };
+    drawLists.begin(framePool->size(), frustums, 2);
+
+    // The simulation animates robots these make look small less often
+    SimViews views;
+    views.frustums[0] = frustums[0];
+    views.frustums[1] = frustums[1];
+    views.eyes[0] = outerCamXYZ;
+    views.eyes[1] = innerCamXYZ;
+    views.tanHalfFov = tanf(22.5f * DEGREES_TO_RADIANS); // Half of sceneProjection()'s
+    views.count = 2;
+    simulation.setViews(views);
+
+    frameGraph.clear();
+    const FrameGraph::StageID traverse = frameGraph.addParallelStage("traverse",
+        (modelCount() + MODELS_PER_JOB - 1) / MODELS_PER_JOB, traverseModels);
+    const FrameGraph::StageID outerSort = frameGraph.addStage("sort outer", sortOuterCamera, { traverse });
+    const FrameGraph::StageID innerSort = frameGraph.addStage("sort inner", sortInnerCamera, { traverse });
+    const FrameGraph::StageID outerSubmit = frameGraph.addStage("submit outer", submitOuterCamera,
+        { outerSort }, FrameGraph::Affinity::CONTEXT);
+    frameGraph.addStage("submit inner", submitInnerCamera, { outerSubmit, innerSort }, FrameGraph::Affinity::CONTEXT);
+    frameGraph.run(*framePool);
+
+    // Everything up to here counts as the frame. The overlay's own cost is
+    // shown separately.
+    const std::chrono::steady_clock::time_point frameEnd = std::chrono::steady_clock::now();
+    PerformanceOverlay::Frame frame;
+    frame.frameMs = std::chrono::duration<double, std::milli>(frameStart - lastFrameStart).count();
+    frame.cpuMs = std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+    frame.animationMs = simulation.snapshot().animationMs;
+    frame.robotsVisible = simulation.snapshot().robotsVisible;
+    frame.robotsUpdated = simulation.snapshot().robotsUpdated;
+    frame.drawCalls = drawCounters.drawCalls;
+    frame.vertices = drawCounters.vertices;
+    frame.stateChanges = drawCounters.stateChanges;
+    frame.culled = drawCounters.culled;
+    frame.matricesDirty = matrixCounters.dirty.load(std::memory_order_relaxed);
+    frame.matricesClean = matrixCounters.clean.load(std::memory_order_relaxed);
+    frame.events = activity.eventsSinceFrame;
+    activity.eventsSinceFrame = 0;
+#ifdef ENABLE_GL_INTERCEPT
+    frame.glCalls = (long long)glintercept::currentFrameCounts().total();
+#else
+    frame.glCalls = -1;
+#endif
+    if (lastFrameStart != std::chrono::steady_clock::time_point())
+    {
+        overlay.addFrame(frame);
+    }
+    lastFrameStart = frameStart;
+
+    if (overlay.visible())
     {
-        robotWalking.animate();
+        overlay.draw(windowWidth, windowHeight);
     }
-    glutPostRedisplay();
-    glutTimerFunc(Animation::FRAME_DELAY, doAnimation, v);
+    glintercept::endFrame();
+
+    //push the back buffer to the screen
+    TRACE_SCOPE("swapBuffers");
+    backend->swapBuffers();
 }
 
-void loadTextures()
+// renderSoftwareFrame() ///////////////////////////////////////////////////////
+//
+//  Renders the same frame renderCallback() does, on the CPU. The axes, the
+//      wireframe and the inner camera's model are lines, which the software
+//      renderer doesn't draw. Returns the work done for both cameras.
+//
+////////////////////////////////////////////////////////////////////////////////
+SoftwareRenderer::Stats renderSoftwareFrame(SoftwareRenderer& renderer, const std::vector<ScenePart>& parts)
 {
-    glGenTextures(numTextures, textureIDs); // Get the texture object IDs
+    const int width = renderer.width();
+    const int height = renderer.height();
+    const int borderWidth = 3;
+    const mat4 projection = mat4::perspective(45.0f, width / (float)height, 0.1f, 100000);
 
-    // Load all textures
+    // Outer camera, with its border
+    if (currentCamera == CAMERA_OUTER)
+        renderer.fillRect(0, 0, width, height, 1, 0, 0);
+    else
+        renderer.fillRect(0, 0, width, height, 1, 1, 1);
+    renderer.fillRect(borderWidth, borderWidth, width - borderWidth * 2, height - borderWidth * 2, 0, 0, 0);
+
+    renderer.drawParts(parts, outerCameraView(), projection,
+        borderWidth, borderWidth, width - borderWidth * 2, height - borderWidth * 2);
+    SoftwareRenderer::Stats total = renderer.stats();
+
+    // Inner camera in the upper corner, using the same viewports GL does
+    const int innerX = (int)(2 * width / 3.0);
+    const int innerY = (int)(2 * height / 3.0);
+    const int innerWidth = (int)(width / 3.0);
+    const int innerHeight = (int)(height / 3.0);
+
+    if (currentCamera == CAMERA_OUTER)
+        renderer.fillRect((int)(2 * width / 3.0 - borderWidth), (int)(2 * height / 3.0 - borderWidth),
+            (int)(width / 3.0 + borderWidth), (int)(height / 3.0 + borderWidth), 1, 1, 1);
+    else
+        renderer.fillRect((int)(2 * width / 3.0 - borderWidth), (int)(2 * height / 3.0 - borderWidth),
+            (int)(width / 3.0 + borderWidth), (int)(height / 3.0 + borderWidth), 1, 0, 0);
+    renderer.fillRect(innerX, innerY, innerWidth, innerHeight, 0, 0, 0);
+
+    renderer.drawParts(parts, innerCameraView(), projection, innerX, innerY, innerWidth, innerHeight);
+
+    total.triangles += renderer.stats().triangles;
+    total.binEntries += renderer.stats().binEntries;
+    total.fragments += renderer.stats().fragments;
+    total.setupMs += renderer.stats().setupMs;
+    total.rasterMs += renderer.stats().rasterMs;
+    return total;
+}
+
+// loadSoftwareTextures() //////////////////////////////////////////////////////
+//
+//  Decodes every texture into client memory for the software renderer.
+//
+////////////////////////////////////////////////////////////////////////////////
+void loadSoftwareTextures(SoftwareTexture* textures)
+{
     for (int i = 0; i < numTextures; ++i)
     {
-        // Check image format
-        FREE_IMAGE_FORMAT format = FreeImage_GetFIFFromFilename(textureNames[i]);
-        if (format == FIF_UNKNOWN)
+        int error = loadSoftwareTexture(textureNames[i], textures[i]);
+        if (error != 0)
         {
-            std::cerr << "Unknown file format for " << textureNames[i] << std::endl;
-            exit(1);
+            exit(error);
         }
+    }
+}
 
-        // Get image bitmap
-        FIBITMAP* bitmap = FreeImage_Load(format, textureNames[i], 0);
-        if (bitmap == nullptr)
-        {
-            std::cerr << "Failed to load image " << textureNames[i] << std::endl;
-            exit(2);
-        }
+// benchmarkSoftwareRenderer() /////////////////////////////////////////////////
+//
+//  Renders the current frame on the CPU with 1, 2, 4... threads up to
+//      maxThreads and prints how the throughput scales.
+//
+////////////////////////////////////////////////////////////////////////////////
+void benchmarkSoftwareRenderer(const int maxThreads, const int frames, const std::string& outputPath)
+{
+    SoftwareTexture textures[numTextures];
+    loadSoftwareTextures(textures);
 
-        // Convert to BGR format
-        {
-            FIBITMAP* temp = FreeImage_ConvertTo24Bits(bitmap);
-            FreeImage_Unload(bitmap);
-            bitmap = temp;
-        }
+    std::vector<ScenePart> parts;
+    collectSceneParts(parts);
 
-        // Grab data from bitmap
-        void* imgData = FreeImage_GetBits(bitmap);
-        int imgWidth = FreeImage_GetWidth(bitmap);
-        int imgHeight = FreeImage_GetHeight(bitmap);
+    std::cout << "Software renderer, " << windowWidth << "x" << windowHeight << ", "
+        << parts.size() << " parts, " << frames << " frames per run" << std::endl;
 
-        // Bind the texture
-        if (imgData != nullptr)
+    double singleThreadMs = 0.0;
+    for (int threads = 1; ; threads = std::min(threads * 2, maxThreads))
+    {
+        ThreadPool pool(threads);
+        SoftwareRenderer renderer(windowWidth, windowHeight, pool);
+        renderer.setTextures(textures, numTextures);
+
+        // One untimed frame to warm up the caches and the bins
+        renderSoftwareFrame(renderer, parts);
+
+        long long triangles = 0, fragments = 0;
+        double setupMs = 0.0, rasterMs = 0.0;
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; ++i)
         {
-            glBindTexture(GL_TEXTURE_2D, textureIDs[i]);
-            glTexImage2D
-            (
-                GL_TEXTURE_2D,
-                0,
-                GL_RGBA,
-                imgWidth,
-                imgHeight,
-                0,
-                GL_BGR_EXT,
-                GL_UNSIGNED_BYTE,
-                imgData
-            );
-            // Required since there are no mipmaps.
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+            const SoftwareRenderer::Stats stats = renderSoftwareFrame(renderer, parts);
+            triangles += stats.triangles;
+            fragments += stats.fragments;
+            setupMs += stats.setupMs;
+            rasterMs += stats.rasterMs;
         }
-        else
+        const double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        const double frameMs = totalMs / frames;
+        if (threads == 1)
+            singleThreadMs = frameMs;
+
+        std::cout << "  " << threads << " thread(s): " << frameMs << " ms/frame ("
+            << setupMs / frames << " setup, " << rasterMs / frames << " raster), "
+            << singleThreadMs / frameMs << "x speedup, "
+            << triangles / (totalMs * 1000.0) << " Mtri/s, "
+            << fragments / (totalMs * 1000.0) << " Mfrag/s" << std::endl;
+
+        if (threads == maxThreads)
         {
-            std::cerr << "Failed to get texture data from " << textureNames[i] << std::endl;
-            exit(3);
+            if (!outputPath.empty())
+                renderer.save(outputPath);
+            break;
         }
     }
 }
 
-void processKeyInput(unsigned char key, int x, int y)
+// compareSoftwareRenderer() ///////////////////////////////////////////////////
+//
+//  Renders the current frame with GL and on the CPU and reports how closely
+//      they match. The GL context has to be current.
+//
+////////////////////////////////////////////////////////////////////////////////
+void compareSoftwareRenderer(const int threads, const int tolerance)
 {
-    switch (key)
+    // The software renderer doesn't draw lines
+    showAxes = false;
+    wireframe = false;
+
+    renderCallback();
+    std::vector<uint32_t> reference(windowWidth * windowHeight);
+    glReadPixels(0, 0, windowWidth, windowHeight, GL_RGBA, GL_UNSIGNED_BYTE, reference.data());
+
+    SoftwareTexture textures[numTextures];
+    loadSoftwareTextures(textures);
+    std::vector<ScenePart> parts;
+    collectSceneParts(parts);
+
+    ThreadPool pool(threads);
+    SoftwareRenderer renderer(windowWidth, windowHeight, pool);
+    renderer.setTextures(textures, numTextures);
+    renderSoftwareFrame(renderer, parts);
+
+    long long totalError = 0;
+    size_t matching = 0;
+    for (size_t i = 0; i < reference.size(); ++i)
     {
-    case 27: // Escape key
-        exit(0);
-    case '1': // Toggle wireframe
-        wireframe = !wireframe;
-        break;
-    case '2': // Toggle axes
-        showAxes = !showAxes;
-        break;
-    case 'a': // Toggle robot animation
-        doRobotAnim = !doRobotAnim;
-        break;
-    case 'i': // Switch to inner camera
-        currentCamera = CAMERA_INNER;
-        break;
-    case 'o': // Switch to outer camera
-        currentCamera = CAMERA_OUTER;
-        break;
+        int worst = 0;
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            const int error = abs((int)((reference[i] >> shift) & 0xFF) - (int)((renderer.pixels()[i] >> shift) & 0xFF));
+            totalError += error;
+            worst = std::max(worst, error);
+        }
+        matching += worst <= tolerance;
     }
 
-    glutPostRedisplay();
+    std::cout << "Software vs GL: mean absolute error " << totalError / (3.0 * reference.size())
+        << ", " << 100.0 * matching / reference.size() << "% of pixels within " << tolerance << std::endl;
 }
 
-void processSpecialKeys(int key, int x, int y)
+// outerRayCamera() ////////////////////////////////////////////////////////////
+//
+//  The outer camera, as the ray tracer describes it.
+//
+////////////////////////////////////////////////////////////////////////////////
+RayCamera outerRayCamera()
 {
-    const float cameraSpeedDivisor = 5;
-
-    switch (key)
+    RayCamera camera =
     {
-    case GLUT_KEY_UP: // Move inner camera forward
-        innerCamXYZ += (innerCamDir / cameraSpeedDivisor);
-        break;
-    case GLUT_KEY_DOWN: // Move inner camera backward
-        innerCamXYZ -= (innerCamDir / cameraSpeedDivisor);
-        break;
-    case GLUT_KEY_LEFT: // Strafe inner camera left
-        innerCamXYZ -= (cross(innerCamDir, Point(0, 1, 0)) / cameraSpeedDivisor);
-        break;
-    case GLUT_KEY_RIGHT:
-        innerCamXYZ += (cross(innerCamDir, Point(0, 1, 0)) / cameraSpeedDivisor);
-        break;
-    }
+        { (float)outerCamXYZ.x, (float)outerCamXYZ.y, (float)outerCamXYZ.z },
+        { 0, 0, 0 },
+        { 0, 1, 0 },
+        45.0f
+    };
+    return camera;
+}
 
-    glutPostRedisplay();
+// raytraceFrame() /////////////////////////////////////////////////////////////
+//
+//  Ray traces the current frame from the outer camera, with samples x samples
+//      rays per pixel, and saves it to outputPath if there is one.
+//
+////////////////////////////////////////////////////////////////////////////////
+void raytraceFrame(const int threads, const int samples, const std::string& outputPath)
+{
+    SoftwareTexture textures[numTextures];
+    loadSoftwareTextures(textures);
+    std::vector<ScenePart> parts;
+    collectSceneParts(parts);
+
+    ThreadPool pool(threads);
+    RayTracer tracer(pool);
+    tracer.setTextures(textures, numTextures);
+    tracer.build(parts);
+
+    std::vector<uint32_t> pixels(windowWidth * windowHeight);
+    tracer.render(outerRayCamera(), windowWidth, windowHeight, samples, pixels.data());
+
+    const RayTracer::Stats& stats = tracer.stats();
+    std::cout << "Ray traced " << windowWidth << "x" << windowHeight << " at " << samples * samples
+        << " rays per pixel on " << threads << " thread(s): BVH of " << stats.triangles
+        << " triangles built in " << stats.buildMs << " ms, traced in " << stats.traceMs << " ms ("
+        << stats.rays / (stats.traceMs * 1000.0) << " Mrays/s)" << std::endl;
+
+    if (!outputPath.empty())
+        saveFramebuffer(outputPath, pixels.data(), windowWidth, windowHeight);
 }
 
-// main() //////////////////////////////////////////////////////////////////////
+// benchmarkRayTracer() ////////////////////////////////////////////////////////
 //
-//  Program entry point. Does not process command line arguments.
+//  Times the BVH build and tracing as the scene grows, by laying out copies
+//      of it in a grid and pulling the camera back to keep them in view.
 //
 ////////////////////////////////////////////////////////////////////////////////
-int main(int argc, char** argv)
+void benchmarkRayTracer(const int threads)
 {
-    // Print controls
-    std::cout << "CONTROLS:" << std::endl
-        << "Hold left click and drag to move the outer camera" << std::endl
-        << "ESC:\t\tExit the program" << std::endl
-        << "1:\t\tToggle wireframes" << std::endl
-        << "2:\t\tToggle the axes in the center of the screen" << std::endl
-        << "a:\t\tToggle the robot's animation on and off" << std::endl
-        << "i:\t\tSwitch control to the inner camera" << std::endl
-        << "o:\t\tSwitch control to the outer camera" << std::endl
-        << "Arrow Keys:\tMove the inner camera" << std::endl;
-
-    //create a double-buffered GLUT window at (50,50) with predefined windowsize
-    glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_DEPTH | GLUT_DOUBLE | GLUT_RGBA);
-    glutInitWindowPosition(50, 50);
-    glutInitWindowSize(windowWidth, windowHeight);
-    glutCreateWindow("double cameras... woahhhhh double cameras");
+    SoftwareTexture textures[numTextures];
+    loadSoftwareTextures(textures);
+    std::vector<ScenePart> scene;
+    collectSceneParts(scene);
 
-    //give the camera a 'pretty' starting point!
-    innerCamXYZ = Point(5, 5, 5);
-    innerCamTPR = Point(-M_PI / 4.0, M_PI / 4.0, 1);
-    recomputeOrientation(innerCamDir, innerCamTPR);
-    innerCamDir.normalize();
+    ThreadPool pool(threads);
+    RayTracer tracer(pool);
+    tracer.setTextures(textures, numTextures);
+    std::vector<uint32_t> pixels(windowWidth * windowHeight);
 
-    outerCamTPR = Point(1.50, 2.0, 14.0);
-    outerCamXYZ = Point(0, 0, 0);
-    recomputeOrientation(outerCamXYZ, outerCamTPR);
+    std::cout << "Ray tracer, " << windowWidth << "x" << windowHeight << ", "
+        << threads << " thread(s)" << std::endl;
 
-    // Set up robot's starting position
-    robot.translate({ 0, -1, -6 }, false);
-    robot.rotateJoint(leftElbow, -20.0f);
-    robot.rotateJoint(leftShoulder, 30.0f);
-    robot.rotateJoint(rightElbow, -20.0f);
-    robot.rotateJoint(rightShoulder, -30.0f);
-    robot.rotateJoint(leftHip, -30.0f);
-    robot.rotateJoint(leftKnee, 5.0f);
-    robot.rotateJoint(rightHip, 20.0f);
+    const float spacing = 4.0f * groundSize;
+    for (int grid = 1; grid <= 16; grid *= 2)
+    {
+        std::vector<ScenePart> parts;
+        for (int i = 0; i < grid; ++i)
+        {
+            for (int j = 0; j < grid; ++j)
+            {
+                const mat4 offset = mat4::translation((i - (grid - 1) / 2.0f) * spacing, 0, (j - (grid - 1) / 2.0f) * spacing);
+                for (ScenePart part : scene)
+                {
+                    part.transform = offset * part.transform;
+                    parts.push_back(part);
+                }
+            }
+        }
 
-    //
-    // Create straight line walking animation
-    //
-
-    KeyFrame walk1(30);
-    walk1.addComponent(new JointRotation(leftShoulder, -30.0f));
-    walk1.addComponent(new JointRotation(rightShoulder, 30.0f));
-    walk1.addComponent(new JointRotation(leftHip, 25.0f));
-    walk1.addComponent(new JointRotation(leftKnee, -5.0f));
-    walk1.addComponent(new JointRotation(rightHip, -25.0f));
-    walk1.addComponent(new JointRotation(rightKnee, 40.0f));
-    walk1.addComponent(new Translation({ 0, 0, 0.75f }));
-    robotWalking.addKeyframe(&walk1);
-
-    KeyFrame walk2(30);
-    walk2.addComponent(new JointRotation(leftShoulder, -30.0f));
-    walk2.addComponent(new JointRotation(rightShoulder, 30.0f));
-    walk2.addComponent(new JointRotation(leftHip, 25.0f));
-    walk2.addComponent(new JointRotation(rightHip, -25.0f));
-    walk2.addComponent(new JointRotation(rightKnee, -35.0f));
-    walk2.addComponent(new Translation({ 0, 0, 0.75f }));
-    robotWalking.addKeyframe(&walk2);
-
-    KeyFrame walk3(30);
-    walk3.addComponent(new JointRotation(leftShoulder, 30.0f));
-    walk3.addComponent(new JointRotation(rightShoulder, -30.0f));
-    walk3.addComponent(new JointRotation(leftHip, -25.0f));
-    walk3.addComponent(new JointRotation(leftKnee, 40.0f));
-    walk3.addComponent(new JointRotation(rightHip, 25.0f));
-    walk3.addComponent(new JointRotation(rightKnee, -5.0f));
-    walk3.addComponent(new Translation({ 0, 0, 0.75f }));
-    robotWalking.addKeyframe(&walk3);
-
-    KeyFrame walk4(30);
-    walk4.addComponent(new JointRotation(leftShoulder, 30.0f));
-    walk4.addComponent(new JointRotation(rightShoulder, -30.0f));
-    walk4.addComponent(new JointRotation(leftHip, -25.0f));
-    walk4.addComponent(new JointRotation(leftKnee, -35.0f));
-    walk4.addComponent(new JointRotation(rightHip, 25.0f));
-    walk4.addComponent(new Translation({ 0, 0, 0.75f }));
-    robotWalking.addKeyframe(&walk4);
-
-    // repeat the walking cycle three times
-    robotWalking.addKeyframe(&walk1);
-    robotWalking.addKeyframe(&walk2);
-    robotWalking.addKeyframe(&walk3);
-    robotWalking.addKeyframe(&walk4);
-    robotWalking.addKeyframe(&walk1);
-    robotWalking.addKeyframe(&walk2);
-    robotWalking.addKeyframe(&walk3);
-    robotWalking.addKeyframe(&walk4);
-    robotWalking.addKeyframe(&walk1);
-    robotWalking.addKeyframe(&walk2);
-    robotWalking.addKeyframe(&walk3);
-    robotWalking.addKeyframe(&walk4);
-
-    robotWalking.initialize();
+        tracer.build(parts);
 
-    // Create some trees
-    trees.emplace_back(new Tree({ -8, 0, -8 }));
-    trees.emplace_back(new Tree({ -8, 0, 8 }));
-    trees.emplace_back(new Tree({ 8, 0, -8 }));
+        RayCamera camera = outerRayCamera();
+        for (int axis = 0; axis < 3; ++axis)
+            camera.eye[axis] *= grid;
 
-    //register callback functions
-    glutSetKeyRepeat(GLUT_KEY_REPEAT_ON);
-    glutDisplayFunc(renderCallback);
-    glutReshapeFunc(resizeWindow);
-    glutMouseFunc(mouseCallback);
-    glutKeyboardFunc(processKeyInput);
-    glutSpecialFunc(processSpecialKeys);
-    glutMotionFunc(mouseMotion);
-    glutTimerFunc(0, doAnimation, 0);
+        // Best of a few, since the first one warms the caches
+        double traceMs = 1e30;
+        for (int run = 0; run < 3; ++run)
+        {
+            tracer.render(camera, windowWidth, windowHeight, 1, pixels.data());
+            traceMs = std::min(traceMs, tracer.stats().traceMs);
+        }
 
-    //do some basic OpenGL setup
-    initScene();
+        const RayTracer::Stats& stats = tracer.stats();
+        std::cout << "  " << grid * grid << " scene(s), " << stats.triangles << " triangles: build "
+            << stats.buildMs << " ms (" << stats.nodes << " nodes, " << stats.leaves << " leaves, depth "
+            << stats.maxDepth << "), " << stats.rays / (traceMs * 1000.0) << " Mrays/s" << std::endl;
+    }
+}
+
+// benchmarkKeyframes() ////////////////////////////////////////////////////////
+//
+//  Times stepping every robot's walk, which evaluates one keyframe per robot,
+//      and counts the cache misses doing so where the counters can be read.
+//      With enough robots the keyframes don't fit in cache, so how they're
+//      laid out in memory shows. Also reports how far compressing the
+//      curves shrank them, and what it cost in accuracy.
+//
+////////////////////////////////////////////////////////////////////////////////
+void benchmarkKeyframes()
+{
+    const int steps = 600;
+    const long long evaluations = (long long)steps * robotAnimations.size();
+    if (evaluations == 0)
+    {
+        std::cout << "No robots to animate" << std::endl;
+        return;
+    }
+
+    // One pass first, so every keyframe has been started once
+    for (Animation* animation : robotAnimations)
+        animation->animate();
+
+    CacheMissCounter misses;
+    misses.start();
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; ++step)
+    {
+        for (Animation* animation : robotAnimations)
+            animation->animate();
+    }
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    const long long missCount = misses.stop();
+
+    std::cout << "Keyframes, " << robotAnimations.size() << " robot(s), " << steps << " steps: "
+        << ns / evaluations << " ns per keyframe evaluation";
+    if (missCount >= 0)
+        std::cout << ", " << (double)missCount / evaluations << " cache misses each";
+    else
+        std::cout << " (cache misses can't be counted here)";
+    std::cout << std::endl;
+
+    // Every robot walks the same way, so one's curves stand for them all
+    const AnimationCurves::Stats& stats = robotAnimations[0]->curves().stats();
+    std::cout << "Curves: " << stats.bytes << " bytes of keys per clip (" << stats.uncompressedBytes << " as floats), "
+        << stats.keys << " of " << stats.sourceKeys << " keys and "
+        << stats.channels << " of " << stats.sourceChannels << " channels kept, worst errors "
+        << stats.maxDistanceError << " units and " << stats.maxAngleError << " degrees" << std::endl;
+}
+
+// benchmarkComponents() ///////////////////////////////////////////////////////
+//
+//  Times applying the components of a clip with 10000 of them, a quarter of
+//      each kind, to see what evaluating a keyframe costs per component.
+//      Animations only do that once, when initialize() bakes their curves,
+//      so the keyframes are applied to the robot directly here. Sampling
+//      the baked curves is timed too, for comparison.
+//
+////////////////////////////////////////////////////////////////////////////////
+void benchmarkComponents()
+{
+    const int keyframeCount = 100;
+    const int componentsPerKeyframe = 100;
+    const std::string* joints[] = { &leftShoulder, &leftElbow, &rightShoulder, &rightElbow, &leftHip, &leftKnee, &rightHip, &rightKnee };
+
+    Robot robot;
+    Animation animation(robot);
+    AnimationClip& clip = animation.clip();
+    std::vector<AnimationClip::KeyFrameID> keyframes;
+    for (int i = 0; i < keyframeCount; ++i)
+    {
+        const AnimationClip::KeyFrameID keyframe = clip.addKeyframe(1);
+        keyframes.push_back(keyframe);
+        for (int j = 0; j < componentsPerKeyframe; ++j)
+        {
+            const float amount = (j % 2 == 0 ? 0.001f : -0.001f);
+            switch (j % 4)
+            {
+            case 0: clip.add(keyframe, Translation({ amount, 0, amount })); break;
+            case 1: clip.add(keyframe, Rotation({ 0, amount, 0 })); break;
+            case 2: clip.add(keyframe, Scale({ amount, amount, amount })); break;
+            default: clip.add(keyframe, JointRotation(*joints[(j / 4) % 8], amount)); break;
+            }
+        }
+        animation.addKeyframe(keyframe);
+    }
+    robot.savePose();
+    animation.initialize();
+
+    // A pass through the whole clip first, so it's all been touched once
+    for (const AnimationClip::KeyFrameID keyframe : keyframes)
+        clip.keyframe(keyframe).apply(clip, robot);
+
+    const int steps = 20000;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; ++step)
+        clip.keyframe(keyframes[step % keyframeCount]).apply(clip, robot);
+    const double appliedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    // Then what playing the animation costs now that it's baked
+    for (int i = 0; i < keyframeCount; ++i)
+        animation.animate();
+    start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; ++step)
+        animation.animate();
+    const double sampledNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Keyframe components, " << keyframeCount * componentsPerKeyframe << " in the clip: "
+        << appliedNs / ((double)steps * componentsPerKeyframe) << " ns per component applied, "
+        << sampledNs / steps << " ns per step sampling the baked curves" << std::endl;
+}
 
-    //and enter the GLUT loop, never to exit.
-    glutMainLoop();
+// frameTick() /////////////////////////////////////////////////////////////////
+//
+//  The idle function while anything is changing. Waits for the pacer to say
+//      a frame is due, then takes the newest robot poses, and draws a frame
+//      if the scene changed since the last one. Takes itself off the idle
+//      function once nothing would change on its own, so an idle scene uses
+//      no CPU until the next input.
+//
+////////////////////////////////////////////////////////////////////////////////
+void frameTick()
+{
+    const double now = backend->time();
+    if (!pacer.frameDue(now))
+    {
+        backend->waitUntil(pacer.nextFrame());
+        return;
+    }
+
+    TRACE_SCOPE("frameTick");
+    ++activity.ticks;
+    const int steps = pacer.beginFrame(now);
+
+    // On its own thread the simulation keeps its own time, so the robots
+    //  are blended by how long ago its last step was due. Otherwise we run
+    //  the steps the pacer says are owed. Even without a new step, the
+    //  robots move further between the last two each frame.
+    bool changed;
+    float blend;
+    if (simulation.threaded())
+    {
+        changed = simulation.acquire();
+        blend = (float)((now - simulation.snapshot().time) / Animation::STEP_SECONDS);
+    }
+    else
+    {
+        changed = simulation.advance(steps);
+        blend = pacer.alpha();
+    }
+
+    // Once the animation stops they're shown where they are
+    const SimSnapshot& snapshot = simulation.snapshot();
+    blend = snapshot.animating ? std::min(std::max(blend, 0.0f), 1.0f) : 1.0f;
+    if (changed || blend != renderBlend)
+    {
+        renderBlend = blend;
+        dirtyFlags |= DIRTY_MODELS;
+    }
+
+    // The streamer only makes progress when frames call update()
+    if (textureStreamer.busy())
+    {
+        dirtyFlags |= DIRTY_TEXTURES;
+    }
+
+    if (dirtyFlags != 0)
+    {
+        backend->postRedisplay();
+    }
+
+    // Keep going until the simulation has caught up with the last toggle
+    if (!doRobotAnim && !snapshot.animating && !textureStreamer.busy())
+    {
+        ticking = false;
+        backend->setIdleFunc(nullptr);
+    }
+}
+
+// reportActivity() ////////////////////////////////////////////////////////////
+//
+//  Prints how busy the program has been since the last report: frames drawn
+//      against ticks and input events, and the CPU time it used.
+//
+////////////////////////////////////////////////////////////////////////////////
+void reportActivity()
+{
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - activity.start).count();
+    const double cpuSeconds = processCpuSeconds();
+    const double cpuPercent = seconds > 0.0 ? 100.0 * (cpuSeconds - activity.cpuSeconds) / seconds : 0.0;
+
+    std::cout << "Over the last " << seconds << " s: " << activity.frames << " frames, "
+        << activity.ticks << " ticks, " << activity.events << " input events ("
+        << (activity.frames > 0 ? activity.events / (double)activity.frames : 0.0) << " per frame), "
+        << cpuPercent << "% of a core" << std::endl;
+
+    activity = ActivityStats();
+    activity.cpuSeconds = cpuSeconds;
+}
+
+void loadTextures()
+{
+    TRACE_SCOPE("loadTextures");
+
+    glGenTextures(numTextures, textureIDs); // Get the texture object IDs
+
+    // Load all textures
+    for (int i = 0; i < numTextures; ++i)
+    {
+        // Decode straight into the layout we'll upload in
+        DecodedImage image;
+        int error = decodeImage(textureNames[i], image);
+        if (error != 0)
+        {
+            exit(error);
+        }
+
+        // Bind the texture, converting only if the decoded layout doesn't match
+        uploadImage(textureIDs[i], image);
+        releaseImage(image);
+
+        // Required since there are no mipmaps.
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+    }
+}
+
+void processKeyInput(unsigned char key, int x, int y)
+{
+    TRACE_SCOPE("processKeyInput");
+    countEvent();
+
+    switch (key)
+    {
+    case 27: // Escape key
+        exit(0);
+    case '1': // Toggle wireframe
+        wireframe = !wireframe;
+        markDirty(DIRTY_SETTINGS);
+        break;
+    case '2': // Toggle axes
+        showAxes = !showAxes;
+        markDirty(DIRTY_SETTINGS);
+        break;
+    case 'a': // Toggle robot animation
+        doRobotAnim = !doRobotAnim;
+        simulation.send({ SimInput::SET_ANIMATING, doRobotAnim ? 1 : 0 });
+        markDirty(DIRTY_SETTINGS);
+        break;
+    case 'i': // Switch to inner camera
+        currentCamera = CAMERA_INNER;
+        markDirty(DIRTY_CAMERA);
+        break;
+    case 'o': // Switch to outer camera
+        currentCamera = CAMERA_OUTER;
+        markDirty(DIRTY_CAMERA);
+        break;
+    case 'p': // Toggle the performance overlay
+        overlay.toggle();
+        markDirty(DIRTY_OVERLAY);
+        break;
+    case 'u': // Report frames, events and CPU use since the last report
+        reportActivity();
+        break;
+    case 'l': // Switch between a capped and an unlimited frame rate
+        pacer.setMode(pacer.mode() == FramePacer::Mode::CAPPED ? FramePacer::Mode::UNLIMITED : FramePacer::Mode::CAPPED);
+        pacer.resetStats();
+        markDirty(DIRTY_SETTINGS);
+        break;
+    case 'j': // Report frame pacing since the last report
+        pacer.printStats(std::cout);
+        pacer.resetStats();
+        break;
+    case 'f': // Print how long each stage of the last frame took
+        frameGraph.printTimings(std::cout);
+        break;
+    case 'h': // Print the frame time histogram
+        std::cout << "Frame times:" << std::endl;
+        overlay.histogram().print(std::cout, "ms", 1000.0);
+        break;
+    case 'g': // Print the GL calls the last frame made
+        std::cout << "GL calls last frame:" << std::endl;
+        glintercept::lastFrameCounts().print(std::cout);
+        break;
+    case 'c': // Record the next frame's GL calls
+        if (glintercept::recordNextFrame("frame.glcap", windowWidth, windowHeight))
+            markDirty(DIRTY_CAPTURE);
+        break;
+    case 't': // Dump the trace recorded so far
+        writeTrace("trace.json");
+        break;
+    case 'r': // Reload textures from disk without stalling the scene
+        for (int i = 0; i < numTextures; ++i)
+        {
+            textureStreamer.request(textureNames[i], &textureIDs[i]);
+        }
+        markDirty(DIRTY_TEXTURES);
+        break;
+    }
+}
+
+void processSpecialKeys(int key, int x, int y)
+{
+    TRACE_SCOPE("processSpecialKeys");
+    countEvent();
+
+    const float cameraSpeedDivisor = 5;
+
+    switch (key)
+    {
+    case GLUT_KEY_UP: // Move inner camera forward
+        innerCamXYZ += (innerCamDir / cameraSpeedDivisor);
+        break;
+    case GLUT_KEY_DOWN: // Move inner camera backward
+        innerCamXYZ -= (innerCamDir / cameraSpeedDivisor);
+        break;
+    case GLUT_KEY_LEFT: // Strafe inner camera left
+        innerCamXYZ -= (cross(innerCamDir, float3(0, 1, 0)) / cameraSpeedDivisor);
+        break;
+    case GLUT_KEY_RIGHT:
+        innerCamXYZ += (cross(innerCamDir, float3(0, 1, 0)) / cameraSpeedDivisor);
+        break;
+    }
+
+    markDirty(DIRTY_CAMERA);
+}
+
+// poseRobot() /////////////////////////////////////////////////////////////////
+//
+//  Puts a robot at the given position, mid-stride, which is where all of its
+//      animations start from.
+//
+////////////////////////////////////////////////////////////////////////////////
+void poseRobot(Robot& robot, const float3& position)
+{
+    robot.translate(position, false);
+    robot.rotateJoint(leftElbow, -20.0f);
+    robot.rotateJoint(leftShoulder, 30.0f);
+    robot.rotateJoint(rightElbow, -20.0f);
+    robot.rotateJoint(rightShoulder, -30.0f);
+    robot.rotateJoint(leftHip, -30.0f);
+    robot.rotateJoint(leftKnee, 5.0f);
+    robot.rotateJoint(rightHip, 20.0f);
+}
+
+// addWalk() ///////////////////////////////////////////////////////////////////
+//
+//  Gives an animation four cycles of walking in a straight line, moving
+//      stride forward in each of the frames long steps of a cycle.
+//
+////////////////////////////////////////////////////////////////////////////////
+void addWalk(Animation& animation, const float stride, const float frames)
+{
+    AnimationClip& clip = animation.clip();
+
+    const AnimationClip::KeyFrameID walk1 = clip.addKeyframe(frames);
+    clip.add(walk1, JointRotation(leftShoulder, -30.0f));
+    clip.add(walk1, JointRotation(rightShoulder, 30.0f));
+    clip.add(walk1, JointRotation(leftHip, 25.0f));
+    clip.add(walk1, JointRotation(leftKnee, -5.0f));
+    clip.add(walk1, JointRotation(rightHip, -25.0f));
+    clip.add(walk1, JointRotation(rightKnee, 40.0f));
+    clip.add(walk1, Translation({ 0, 0, stride }));
+
+    const AnimationClip::KeyFrameID walk2 = clip.addKeyframe(frames);
+    clip.add(walk2, JointRotation(leftShoulder, -30.0f));
+    clip.add(walk2, JointRotation(rightShoulder, 30.0f));
+    clip.add(walk2, JointRotation(leftHip, 25.0f));
+    clip.add(walk2, JointRotation(rightHip, -25.0f));
+    clip.add(walk2, JointRotation(rightKnee, -35.0f));
+    clip.add(walk2, Translation({ 0, 0, stride }));
+
+    const AnimationClip::KeyFrameID walk3 = clip.addKeyframe(frames);
+    clip.add(walk3, JointRotation(leftShoulder, 30.0f));
+    clip.add(walk3, JointRotation(rightShoulder, -30.0f));
+    clip.add(walk3, JointRotation(leftHip, -25.0f));
+    clip.add(walk3, JointRotation(leftKnee, 40.0f));
+    clip.add(walk3, JointRotation(rightHip, 25.0f));
+    clip.add(walk3, JointRotation(rightKnee, -5.0f));
+    clip.add(walk3, Translation({ 0, 0, stride }));
+
+    const AnimationClip::KeyFrameID walk4 = clip.addKeyframe(frames);
+    clip.add(walk4, JointRotation(leftShoulder, 30.0f));
+    clip.add(walk4, JointRotation(rightShoulder, -30.0f));
+    clip.add(walk4, JointRotation(leftHip, -25.0f));
+    clip.add(walk4, JointRotation(leftKnee, -35.0f));
+    clip.add(walk4, JointRotation(rightHip, 25.0f));
+    clip.add(walk4, Translation({ 0, 0, stride }));
+
+    // the walking cycle, then three repeats
+    for (int cycle = 0; cycle < 4; ++cycle)
+    {
+        animation.addKeyframe(walk1);
+        animation.addKeyframe(walk2);
+        animation.addKeyframe(walk3);
+        animation.addKeyframe(walk4);
+    }
+}
+
+// addWave() ///////////////////////////////////////////////////////////////////
+//
+//  Gives an animation a wave of the right arm: up, three waves of the
+//      forearm, and back down to where it started. Meant to be added on top
+//      of a walk.
+//
+////////////////////////////////////////////////////////////////////////////////
+void addWave(Animation& animation)
+{
+    AnimationClip& clip = animation.clip();
+
+    const AnimationClip::KeyFrameID raise = clip.addKeyframe(30);
+    clip.add(raise, JointRotation(rightShoulder, -120.0f));
+    clip.add(raise, JointRotation(rightElbow, -30.0f));
+
+    const AnimationClip::KeyFrameID waveOut = clip.addKeyframe(15);
+    clip.add(waveOut, JointRotation(rightElbow, 40.0f));
+
+    const AnimationClip::KeyFrameID waveIn = clip.addKeyframe(15);
+    clip.add(waveIn, JointRotation(rightElbow, -40.0f));
+
+    const AnimationClip::KeyFrameID lower = clip.addKeyframe(30);
+    clip.add(lower, JointRotation(rightShoulder, 120.0f));
+    clip.add(lower, JointRotation(rightElbow, 30.0f));
+
+    animation.addKeyframe(raise);
+    for (int wave = 0; wave < 3; ++wave)
+    {
+        animation.addKeyframe(waveOut);
+        animation.addKeyframe(waveIn);
+    }
+    animation.addKeyframe(lower);
+}
+
+// addRobot() //////////////////////////////////////////////////////////////////
+//
+//  Adds a robot at the given position, walking in a straight line. Every
+//      robot gets its own keyframes since they keep track of their progress,
+//      made in its animation's clip.
+//
+////////////////////////////////////////////////////////////////////////////////
+void addRobot(const float3& position)
+{
+    Robot* robot = new Robot();
+    Animation* robotWalking = new Animation(*robot);
+
+    poseRobot(*robot, position);
+    addWalk(*robotWalking, 0.75f, 30);
+
+    robot->savePose();
+    robotWalking->initialize();
+
+    robots.push_back(robot);
+    robotAnimations.push_back(robotWalking);
+}
+
+// addScriptedRobot() //////////////////////////////////////////////////////////
+//
+//  Adds a robot at the given position that patrols to a point ahead of it
+//      and back, waving at the far end. It walks in place, since its agent
+//      does the moving, at the same pace as the marching robots. index
+//      staggers when it sets off and how long it stops for, so the robots
+//      don't all move in step.
+//
+////////////////////////////////////////////////////////////////////////////////
+void addScriptedRobot(const float3& position, const int index)
+{
+    Robot* robot = new Robot();
+    Animation* walk = new Animation(*robot);
+    Animation* wave = new Animation(*robot);
+
+    poseRobot(*robot, position);
+    addWalk(*walk, 0.0f, 30);
+    addWave(*wave);
+
+    robot->savePose();
+    walk->initialize();
+    wave->initialize();
+
+    AgentRig* rig = new AgentRig(*robot, robotGait, walk, wave);
+    robotGait.walkSpeed = 0.75f / 30;
+    robotGait.waveSteps = rig->waveSteps();
+    behaviours.spawn<Patrol>(rig->agent(), position + float3(0, 0, 12), 0.5 + (index % 4) * 0.5, index * 17 % 120);
+
+    robots.push_back(robot);
+    robotRigs.push_back(rig);
+}
+
+// benchmarkBlending() /////////////////////////////////////////////////////////
+//
+//  Times stepping robots that each mix four animations: a walk, a stroll
+//      and a run blended together, cross-fading from one to the next, with
+//      a wave added on top. Compares that with playing the walk alone.
+//
+////////////////////////////////////////////////////////////////////////////////
+void benchmarkBlending(const int robotCount)
+{
+    const int steps = 600;
+    const int fadeSteps = 40;
+
+    std::vector<Robot*> crowd;
+    std::vector<Animation*> animations;
+    std::vector<AnimationBlend*> blends;
+    for (int i = 0; i < robotCount; ++i)
+    {
+        Robot* robot = new Robot();
+        poseRobot(*robot, float3((float)(i % 50), 0, (float)(i / 50)));
+        crowd.push_back(robot);
+
+        Animation* walk = new Animation(*robot);
+        Animation* stroll = new Animation(*robot);
+        Animation* run = new Animation(*robot);
+        Animation* wave = new Animation(*robot);
+        addWalk(*walk, 0.75f, 30);
+        addWalk(*stroll, 0.4f, 40);
+        addWalk(*run, 1.2f, 20);
+        addWave(*wave);
+        for (Animation* animation : { walk, stroll, run, wave })
+        {
+            animation->initialize();
+            animations.push_back(animation);
+        }
+
+        AnimationBlend* blend = new AnimationBlend(*robot);
+        blend->addLayer(*walk, 1.0f);
+        blend->addLayer(*stroll, 0.0f);
+        blend->addLayer(*run, 0.0f);
+        blend->addLayer(*wave, 1.0f, AnimationBlend::ADDITIVE);
+        blends.push_back(blend);
+    }
+
+    // Every robot playing its walk on its own
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; ++step)
+    {
+        for (size_t i = 0; i < crowd.size(); ++i)
+            animations[i * 4]->animate();
+    }
+    const double singleNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    // Then mixing all four, fading to the next gait every so often
+    start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; ++step)
+    {
+        if (step % (fadeSteps * 3) == 0)
+        {
+            for (AnimationBlend* blend : blends)
+                blend->crossFade((step / (fadeSteps * 3)) % 3, fadeSteps);
+        }
+        for (AnimationBlend* blend : blends)
+            blend->animate();
+    }
+    const double blendNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    const double evaluations = (double)steps * robotCount;
+    std::cout << "Blending, " << robotCount << " robot(s), " << steps << " steps: "
+        << blendNs / evaluations << " ns per robot for four layers, "
+        << singleNs / evaluations << " ns for one animation alone" << std::endl;
+
+    for (AnimationBlend* blend : blends)
+        delete blend;
+    for (Animation* animation : animations)
+        delete animation;
+    for (Robot* robot : crowd)
+        delete robot;
+}
+
+// benchmarkBehaviours() ///////////////////////////////////////////////////////
+//
+//  Times the scheduler running a patrol for each of agentCount agents, with
+//      no robots to pose, so it's only what resuming scripts costs. Runs
+//      once with short stops and once with long ones: far fewer scripts are
+//      due each tick in the second, and ticks should cost that much less.
+//
+////////////////////////////////////////////////////////////////////////////////
+void benchmarkBehaviours(const int agentCount)
+{
+    const int steps = 600;
+    const AgentGait gait;
+
+    for (const double pause : { 0.5, 30.0 })
+    {
+        std::vector<Agent> agents;
+        agents.reserve(agentCount);
+        BehaviourScheduler scheduler;
+        for (int i = 0; i < agentCount; ++i)
+        {
+            agents.emplace_back(gait, float3((float)(i % 300), 0, (float)(i / 300)));
+            scheduler.spawn<Patrol>(agents.back(), agents.back().position(0) + float3(0, 0, 6.0f + i % 5), pause, i % 240);
+        }
+
+        // Past the staggered starts first
+        for (int step = 0; step < steps; ++step)
+            scheduler.tick();
+
+        size_t resumed = 0;
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int step = 0; step < steps; ++step)
+        {
+            scheduler.tick();
+            resumed += scheduler.resumed();
+        }
+        const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Behaviours, " << agentCount << " agent(s), " << steps << " ticks, stopping "
+            << pause << " s: " << ns / steps << " ns per tick, "
+            << (double)resumed / steps << " scripts resumed per tick, "
+            << (resumed > 0 ? ns / resumed : 0.0) << " ns per resume" << std::endl;
+        if (pause == 0.5)
+        {
+            std::cout << "Memory: " << scheduler.bytes() << " bytes of script frames, "
+                << agents.size() * sizeof(Agent) << " bytes of agents" << std::endl;
+        }
+    }
+}
+
+// benchmarkLimbs() ///////////////////////////////////////////////////////////
+//
+//  Times placing the hands and feet of robotCount robots walking over bumpy
+//      ground, at staggered points in their walks, with every other robot
+//      reaching its right hand out in front of it. Reports what each part of
+//      the solve costs per robot, and how far the solved limbs miss.
+//
+////////////////////////////////////////////////////////////////////////////////
+float bumpyGround(const float x, const float z)
+{
+    return -0.9f + 0.3f * sinf(x * 1.3f) * sinf(z * 1.1f);
+}
+
+void benchmarkLimbs(const int robotCount)
+{
+    const int steps = 600;
+
+    std::vector<Robot*> crowd;
+    std::vector<Animation*> animations;
+    std::vector<uint32_t> indices;
+    for (int i = 0; i < robotCount; ++i)
+    {
+        Robot* robot = new Robot();
+        poseRobot(*robot, float3((float)(i % 100) * 2.5f, -1, (float)(i / 100) * 3.0f));
+        crowd.push_back(robot);
+
+        Animation* walk = new Animation(*robot);
+        addWalk(*walk, 0.75f, 30);
+        walk->initialize();
+        walk->animate(i % 120);
+        animations.push_back(walk);
+        indices.push_back((uint32_t)i);
+    }
+
+    LimbSolver solver(bumpyGround);
+    solver.reserve(crowd.size());
+    double gatherNs = 0.0;
+    double solveNs = 0.0;
+    double scatterNs = 0.0;
+    size_t adjusted = 0;
+    size_t limbs = 0;
+    for (int step = 0; step < steps; ++step)
+    {
+        for (size_t i = 0; i < crowd.size(); ++i)
+        {
+            animations[i]->animate();
+            if (i % 2 == 0)
+                solver.setHandTarget(i, LimbSolver::RIGHT_ARM, crowd[i]->worldMatrix().transformPoint(float3(-0.7f, 2.6f, 0.9f)), 1.0f);
+        }
+
+        solver.solve(crowd, indices.data(), indices.size());
+        const LimbSolver::Stats& stats = solver.stats();
+        gatherNs += stats.gatherNs;
+        solveNs += stats.solveNs;
+        scatterNs += stats.scatterNs;
+        adjusted += stats.adjusted;
+        limbs += stats.limbs;
+    }
+
+    // How far the last step's hands are from their targets, and how far any
+    //  foot is still under the ground
+    float handMiss = 0.0f;
+    float footMiss = 0.0f;
+    for (size_t i = 0; i < crowd.size(); ++i)
+    {
+        const Robot& robot = *crowd[i];
+        if (i % 2 == 0)
+        {
+            const float3 hand = LimbSolver::limbEnd(LimbSolver::RIGHT_ARM, robot.getJoints().at(rightShoulder), robot.getJoints().at(rightElbow));
+            handMiss = std::max(handMiss, (hand - float3(-0.7f, 2.6f, 0.9f)).length());
+        }
+        for (const LimbSolver::Limb leg : { LimbSolver::LEFT_LEG, LimbSolver::RIGHT_LEG })
+        {
+            const std::string& hip = leg == LimbSolver::LEFT_LEG ? leftHip : rightHip;
+            const std::string& knee = leg == LimbSolver::LEFT_LEG ? leftKnee : rightKnee;
+            const float3 foot = robot.worldMatrix().transformPoint(LimbSolver::limbEnd(leg, robot.getJoints().at(hip), robot.getJoints().at(knee)));
+            footMiss = std::max(footMiss, bumpyGround(foot.x, foot.z) - foot.y);
+        }
+    }
+
+    const double evaluations = (double)steps * robotCount;
+    std::cout << "Limbs, " << robotCount << " robot(s), " << steps << " steps: "
+        << (gatherNs + solveNs + scatterNs) / evaluations << " ns per robot ("
+        << gatherNs / evaluations << " gathering, " << solveNs / evaluations << " solving, "
+        << scatterNs / evaluations << " writing back), "
+        << adjusted / evaluations * 100.0 << "% of robots and " << (double)limbs / steps << " limbs adjusted per step" << std::endl;
+    std::cout << "Worst hand miss " << handMiss << ", worst foot below the ground " << std::max(footMiss, 0.0f) << std::endl;
+
+    for (Animation* animation : animations)
+        delete animation;
+    for (Robot* robot : crowd)
+        delete robot;
+}
+
+// destroyScene() //////////////////////////////////////////////////////////////
+//
+//  Frees the robots, their animations or rigs and the trees. The simulation
+//      is stopped first, since its thread may still be stepping them.
+//
+////////////////////////////////////////////////////////////////////////////////
+void destroyScene()
+{
+    simulation.stop();
+
+    for (Animation* animation : robotAnimations)
+        delete animation;
+    for (AgentRig* rig : robotRigs)
+        delete rig;
+    for (Robot* robot : robots)
+        delete robot;
+    for (StaticModel* tree : trees)
+        delete tree;
+
+    robotAnimations.clear();
+    robotRigs.clear();
+    robots.clear();
+    trees.clear();
+}
+
+// buildScene() ////////////////////////////////////////////////////////////////
+//
+//  Sets up a scene preset. The first robot and the first three trees are
+//      where they've always been, and any more are laid out around them in
+//      a fixed pattern so the same preset is always the same scene.
+//      Scripted robots start in the same places.
+//
+////////////////////////////////////////////////////////////////////////////////
+void buildScene(const int robotCount, const int treeCount, const bool scripted)
+{
+    // Robots march side by side in rows of seven, alternating outwards
+    for (int i = 0; i < robotCount; ++i)
+    {
+        const int column = i % 7;
+        const float x = (column % 2 == 0 ? 1.0f : -1.0f) * ((column + 1) / 2) * 2.5f;
+        const float3 position(x, -1, -6.0f - (i / 7) * 3.0f);
+        if (scripted)
+            addScriptedRobot(position, i);
+        else
+            addRobot(position);
+    }
+
+    // Create some trees
+    const float3 firstTrees[3] = { { -8, 0, -8 }, { -8, 0, 8 }, { 8, 0, -8 } };
+    for (int i = 0; i < treeCount; ++i)
+    {
+        if (i < 3)
+        {
+            trees.emplace_back(new Tree(firstTrees[i]));
+            continue;
+        }
+
+        // The rest spiral outwards past the ground
+        const float angle = i * 2.39996f;
+        const float radius = 14.0f + (i - 3) * 0.75f;
+        trees.emplace_back(new Tree({ radius * cosf(angle), 0, radius * sinf(angle) }));
+    }
+}
+
+// runBenchmark() //////////////////////////////////////////////////////////////
+//
+//  Flies both cameras along scripted paths for the given number of frames,
+//      timing each one on the CPU, then writes the results as JSON. Frames
+//      are driven directly rather than by timers and nothing depends on
+//      input or the clock, so every run renders exactly the same frames.
+//      Returns false if heap allocations are counted and any measured frame
+//      made one.
+//
+////////////////////////////////////////////////////////////////////////////////
+bool runBenchmark(const int frames, const BenchmarkInfo& info, const std::string& jsonPath)
+{
+    // The outer camera orbits once while bobbing up and down and zooming
+    CameraPath outerPath;
+    outerPath.addKey(0.0f, float3(1.50, 2.0, 14.0))
+        .addKey(0.25f, float3(1.50 + PI / 2, 1.7, 18.0))
+        .addKey(0.5f, float3(1.50 + PI, 2.3, 10.0))
+        .addKey(0.75f, float3(1.50 + 3 * PI / 2, 1.9, 22.0))
+        .addKey(1.0f, float3(1.50 + 2 * PI, 2.0, 14.0));
+
+    // The inner camera walks a loop around the robot, looking around
+    CameraPath innerPosition;
+    innerPosition.addKey(0.0f, float3(5, 5, 5))
+        .addKey(0.25f, float3(-5, 3, 6))
+        .addKey(0.5f, float3(-6, 4, -5))
+        .addKey(0.75f, float3(4, 2, -6))
+        .addKey(1.0f, float3(5, 5, 5));
+
+    CameraPath innerAngles;
+    innerAngles.addKey(0.0f, float3(-PI / 4.0, PI / 4.0, 1))
+        .addKey(0.5f, float3(-PI / 4.0 + PI, PI / 3.0, 1))
+        .addKey(1.0f, float3(-PI / 4.0 + 2 * PI, PI / 4.0, 1));
+
+    resizeWindow(windowWidth, windowHeight);
+
+    FrameBenchmark results;
+    long long measuredAllocations = 0;
+    for (int frame = -info.warmupFrames; frame < frames; ++frame)
+    {
+        // Warmup frames stay on the first frame so they don't change the run
+        const float time = frame > 0 && frames > 1 ? frame / (float)(frames - 1) : 0.0f;
+        TRACE_SCOPE("benchmark frame");
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        outerCamTPR = outerPath.at(time);
+        recomputeOrientation(outerCamXYZ, outerCamTPR);
+        innerCamXYZ = innerPosition.at(time);
+        innerCamTPR = innerAngles.at(time);
+        recomputeOrientation(innerCamDir, innerCamTPR);
+        innerCamDir.normalize();
+
+        const long long allocationsBefore = heapAllocations();
+        simulation.advance(frame >= 0 ? 1 : 0);
+        renderCallback();
+        const long long allocations = heapAllocations() - allocationsBefore;
+
+        const double cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (frame >= 0)
+        {
+            const SimSnapshot& snapshot = simulation.snapshot();
+            results.addFrame({ cpuMs, drawCounters.drawCalls, drawCounters.vertices, drawCounters.stateChanges, drawCounters.culled,
+                matrixCounters.dirty.load(std::memory_order_relaxed), matrixCounters.clean.load(std::memory_order_relaxed),
+                snapshot.animationMs, snapshot.robotsVisible, snapshot.robotsUpdated,
+                heapAllocations() >= 0 ? allocations : -1 });
+            measuredAllocations += std::max(allocations, 0LL);
+        }
+    }
+
+    // Once warmed up, a frame shouldn't need the heap at all
+    results.writeJson(jsonPath, info);
+    if (measuredAllocations > 0)
+    {
+        std::cerr << "ERROR: " << measuredAllocations << " heap allocations in " << frames << " measured frames" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// replayCallback() ////////////////////////////////////////////////////////////
+//
+//  Display callback for --replay. Plays the capture once per frame, timing
+//      each play through to glFinish(), and reports once enough are done.
+//
+////////////////////////////////////////////////////////////////////////////////
+glintercept::Replay capture;
+int replayFrames = 0;
+vector<double> replayTimes;
+
+void replayCallback()
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    capture.play();
+    glFinish();
+    replayTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    backend->swapBuffers();
+
+    if ((int)replayTimes.size() < replayFrames)
+    {
+        backend->postRedisplay();
+        return;
+    }
+
+    vector<double> sorted = replayTimes;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0.0;
+    for (double ms : sorted)
+    {
+        total += ms;
+    }
+    std::cout << "Calls in the captured frame:" << std::endl;
+    capture.counts().print(std::cout);
+    std::cout << "Replayed " << sorted.size() << " times on " << (const char*)glGetString(GL_RENDERER) << ": mean "
+        << total / sorted.size() << " ms, min " << sorted.front() << " ms, median " << sorted[sorted.size() / 2]
+        << " ms, max " << sorted.back() << " ms" << std::endl;
+    backend->leaveMainLoop();
+}
+
+// replayCapture() /////////////////////////////////////////////////////////////
+//
+//  Plays a frame recorded with --record or the 'c' key back the given
+//      number of times, on a context the same size it was recorded at.
+//
+////////////////////////////////////////////////////////////////////////////////
+int replayCapture(const std::string& path, const bool headless, const int frames, const std::string& outputPath, int& argc, char** argv)
+{
+    if (!capture.load(path))
+    {
+        return(1);
+    }
+
+    backend = headless ? createOffscreenBackend(frames, outputPath) : createGlutBackend(argc, argv);
+    if (backend == nullptr || !backend->createContext(capture.width(), capture.height(), "replay"))
+    {
+        return(1);
+    }
+
+    BackendCallbacks callbacks;
+    callbacks.display = replayCallback;
+    backend->setCallbacks(callbacks);
+
+    // The first play uploads the textures, so it isn't timed
+    capture.play();
+    glFinish();
+
+    replayFrames = std::max(frames, 1);
+    backend->postRedisplay();
+    backend->mainLoop();
+    return(0);
+}
+
+// main() //////////////////////////////////////////////////////////////////////
+//
+//  Program entry point. Options:
+//      --bench-textures    Time texture conversion against FreeImage's and exit
+//      --headless          Render offscreen with no window (needs EGL)
+//      --frames N          Number of frames to render when headless
+//      --output FILE       Save the last headless frame to FILE, or every
+//                          frame if FILE has a frame number (e.g. out%04d.png)
+//      --software          Animate for the given number of frames, then time
+//                          the software renderer with more and more threads
+//      --threads N         Most threads the software renderer may use
+//      --compare           Check the software renderer against the last
+//                          headless frame
+//      --raytrace          Animate for the given number of frames, then ray
+//                          trace the outer camera's view to --output
+//      --samples N         Rays per pixel along each axis when ray tracing
+//      --bench-raytrace    Time the ray tracer as the scene grows and exit
+//      --bench-keyframes   Time evaluating the robots' keyframes and exit
+//      --bench-components  Time applying keyframe components and exit
+//      --bench-blend       Time mixing four animations on each of --robots
+//                          robots and exit
+//      --bench-behaviour   Time behaviour scripts for --robots agents and exit
+//      --robots N          Scene preset with N robots
+//      --trees N           Scene preset with N trees
+//      --scripted          Robots patrol by behaviour script instead of marching
+//      --ik                Keep the robots' feet out of the ground
+//      --bench-ik          Time placing hands and feet on --robots robots and exit
+//      --benchmark         Play scripted camera paths for the given number
+//                          of frames and report frame times as JSON. Exits
+//                          with 1 if a measured frame allocated (needs
+//                          ENABLE_ALLOC_COUNTING)
+//      --json FILE         Write the benchmark results to FILE, not stdout
+//      --trace FILE        Write the trace to FILE when a headless or
+//                          benchmark run finishes (needs ENABLE_TRACING)
+//      --bench-trace       Measure the cost of one trace span and exit
+//      --overlay           Start with the performance overlay showing
+//      --fps N             Cap the frame rate at N frames per second
+//      --unlimited         Draw frames as fast as possible, for measuring
+//                          throughput in a window
+//      --no-sim-thread     Animate the robots on the render thread in a window
+//      --anim-budget MS    Animate distant robots less often while a step
+//                          takes longer than MS
+//      --record FILE       Record the first frame's GL calls to FILE (needs
+//                          ENABLE_GL_INTERCEPT)
+//      --replay FILE       Play recorded GL calls back the given number of
+//                          frames and report how long they took
+//
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    bool headless = false;
+    bool software = false;
+    bool compare = false;
+    bool raytrace = false;
+    bool benchRaytrace = false;
+    bool benchKeyframes = false;
+    bool benchBlend = false;
+    bool benchBehaviour = false;
+    bool scripted = false;
+    bool ik = false;
+    bool benchIk = false;
+    bool benchmark = false;
+    bool simThread = true;
+    int robotCount = 1;
+    int treeCount = 3;
+    std::string jsonPath;
+    std::string tracePath;
+    std::string recordPath;
+    std::string replayPath;
+    int frameCount = 300;
+    int samples = 2;
+    int threadCount = (int)std::thread::hardware_concurrency();
+    std::string outputPath;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--bench-textures") == 0)
+        {
+            benchmarkTextureConversion(textureNames, numTextures);
+            return(0);
+        }
+        else if (strcmp(argv[i], "--headless") == 0)
+            headless = true;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frameCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            outputPath = argv[++i];
+        else if (strcmp(argv[i], "--software") == 0)
+            software = true;
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threadCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--compare") == 0)
+            compare = true;
+        else if (strcmp(argv[i], "--raytrace") == 0)
+            raytrace = true;
+        else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+            samples = std::max(atoi(argv[++i]), 1);
+        else if (strcmp(argv[i], "--bench-raytrace") == 0)
+            benchRaytrace = true;
+        else if (strcmp(argv[i], "--bench-components") == 0)
+        {
+            benchmarkComponents();
+            return(0);
+        }
+        else if (strcmp(argv[i], "--bench-keyframes") == 0)
+            benchKeyframes = true;
+        else if (strcmp(argv[i], "--bench-blend") == 0)
+            benchBlend = true;
+        else if (strcmp(argv[i], "--bench-behaviour") == 0)
+            benchBehaviour = true;
+        else if (strcmp(argv[i], "--robots") == 0 && i + 1 < argc)
+            robotCount = std::max(atoi(argv[++i]), 0);
+        else if (strcmp(argv[i], "--trees") == 0 && i + 1 < argc)
+            treeCount = std::max(atoi(argv[++i]), 0);
+        else if (strcmp(argv[i], "--scripted") == 0)
+            scripted = true;
+        else if (strcmp(argv[i], "--ik") == 0)
+            ik = true;
+        else if (strcmp(argv[i], "--bench-ik") == 0)
+            benchIk = true;
+        else if (strcmp(argv[i], "--benchmark") == 0)
+            benchmark = true;
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            tracePath = argv[++i];
+        else if (strcmp(argv[i], "--overlay") == 0)
+            overlay.toggle();
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+            pacer.setFrameRate(atof(argv[++i]));
+        else if (strcmp(argv[i], "--unlimited") == 0)
+            pacer.setMode(FramePacer::Mode::UNLIMITED);
+        else if (strcmp(argv[i], "--no-sim-thread") == 0)
+            simThread = false;
+        else if (strcmp(argv[i], "--anim-budget") == 0 && i + 1 < argc)
+            simulation.setAnimationBudget(atof(argv[++i]));
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replayPath = argv[++i];
+        else if (strcmp(argv[i], "--bench-trace") == 0)
+        {
+            const double ns = measureTraceOverhead();
+            std::cout << "Trace span: " << ns << " ns (budget 50 ns)" << std::endl;
+#ifndef ENABLE_TRACING
+            std::cout << "Tracing is compiled out of this build; define ENABLE_TRACING to record spans" << std::endl;
+#endif
+            return(ns < 50.0 ? 0 : 1);
+        }
+    }
+    threadCount = std::max(threadCount, 1);
+    TRACE_THREAD_NAME("main");
+
+    // Replays bring everything they need with them
+    if (!replayPath.empty())
+    {
+        return replayCapture(replayPath, headless, frameCount, outputPath, argc, argv);
+    }
+
+    aspectRatio = windowWidth / (float)windowHeight;
+
+    //give the camera a 'pretty' starting point!
+    innerCamXYZ = float3(5, 5, 5);
+    innerCamTPR = float3(-PI / 4.0, PI / 4.0, 1);
+    recomputeOrientation(innerCamDir, innerCamTPR);
+    innerCamDir.normalize();
+
+    outerCamTPR = float3(1.50, 2.0, 14.0);
+    outerCamXYZ = float3(0, 0, 0);
+    recomputeOrientation(outerCamXYZ, outerCamTPR);
+
+    if (benchBlend)
+    {
+        benchmarkBlending(std::max(robotCount, 1));
+        return(0);
+    }
+    if (benchBehaviour)
+    {
+        benchmarkBehaviours(std::max(robotCount, 1));
+        return(0);
+    }
+    if (benchIk)
+    {
+        benchmarkLimbs(std::max(robotCount, 1));
+        return(0);
+    }
+
+    // Registered after the simulation was constructed, so this runs before
+    //  it's destroyed, however the program exits
+    buildScene(robotCount, treeCount, scripted);
+    atexit(destroyScene);
+    if (scripted)
+        simulation.setBehaviours(behaviours, robotRigs);
+    if (ik)
+        simulation.setLimbSolver(limbSolver);
+    if (benchKeyframes)
+    {
+        benchmarkKeyframes();
+        return(0);
+    }
+    simulation.advance(0); // Publishes the starting poses
+
+    // The software renderers don't need GL at all
+    if (software || raytrace || benchRaytrace)
+    {
+        simulation.advance(frameCount);
+
+        if (benchRaytrace)
+            benchmarkRayTracer(threadCount);
+        else if (raytrace)
+            raytraceFrame(threadCount, samples, outputPath);
+        else
+            benchmarkSoftwareRenderer(threadCount, 20, outputPath);
+        return(0);
+    }
+
+    if (headless)
+    {
+        backend = createOffscreenBackend(frameCount, outputPath);
+    }
+    else if (benchmark)
+    {
+        backend = createGlutBackend(argc, argv);
+    }
+    else
+    {
+        // Print controls
+        std::cout << "CONTROLS:" << std::endl
+            << "Hold left click and drag to move the outer camera" << std::endl
+            << "ESC:\t\tExit the program" << std::endl
+            << "1:\t\tToggle wireframes" << std::endl
+            << "2:\t\tToggle the axes in the center of the screen" << std::endl
+            << "a:\t\tToggle the robot's animation on and off" << std::endl
+            << "i:\t\tSwitch control to the inner camera" << std::endl
+            << "o:\t\tSwitch control to the outer camera" << std::endl
+            << "r:\t\tReload the textures from disk" << std::endl
+            << "p:\t\tToggle the performance overlay" << std::endl
+            << "h:\t\tPrint the frame time histogram" << std::endl
+            << "u:\t\tPrint frames, input events and CPU use since last time" << std::endl
+            << "l:\t\tSwitch between a capped and an unlimited frame rate" << std::endl
+            << "j:\t\tPrint frame pacing and jitter since last time" << std::endl
+            << "f:\t\tPrint the stages of the last frame and their timings" << std::endl
+#ifdef ENABLE_TRACING
+            << "t:\t\tWrite the trace so far to trace.json" << std::endl
+#endif
+#ifdef ENABLE_GL_INTERCEPT
+            << "g:\t\tPrint the GL calls the last frame made" << std::endl
+            << "c:\t\tRecord the next frame's GL calls to frame.glcap" << std::endl
+#endif
+            << "Arrow Keys:\tMove the inner camera" << std::endl;
+
+        backend = createGlutBackend(argc, argv);
+    }
+
+    if (backend == nullptr || !backend->createContext(windowWidth, windowHeight, "double cameras... woahhhhh double cameras"))
+    {
+        return(1);
+    }
+
+    //register callback functions
+    BackendCallbacks callbacks;
+    callbacks.display = renderCallback;
+    callbacks.reshape = resizeWindow;
+    callbacks.mouse = mouseCallback;
+    callbacks.keyboard = processKeyInput;
+    callbacks.special = processSpecialKeys;
+    callbacks.motion = mouseMotion;
+    backend->setCallbacks(callbacks);
+
+    //do some basic OpenGL setup
+    initScene();
+
+    // In a window the robots walk on a thread of their own. Headless runs and
+    //  benchmarks step them by hand, so they always draw the same frames.
+    if (!headless && !benchmark && simThread && std::thread::hardware_concurrency() > 1)
+    {
+        simulation.start();
+    }
+
+    if (!recordPath.empty() && !glintercept::recordNextFrame(recordPath, windowWidth, windowHeight))
+    {
+        return(1);
+    }
+
+    framePool = new ThreadPool(threadCount);
+
+    if (benchmark)
+    {
+        BenchmarkInfo info;
+        info.robots = robotCount;
+        info.trees = treeCount;
+        info.width = windowWidth;
+        info.height = windowHeight;
+        info.warmupFrames = 10;
+        info.renderer = (const char*)glGetString(GL_RENDERER);
+        const bool allocationFree = runBenchmark(frameCount, info, jsonPath);
+        if (!tracePath.empty())
+            writeTrace(tracePath);
+        return(allocationFree ? 0 : 1);
+    }
+
+    //and enter the main loop. A window never exits it, but offscreen runs do.
+    backend->mainLoop();
+
+    if (headless && compare)
+    {
+        compareSoftwareRenderer(threadCount, 8);
+    }
+    if (!tracePath.empty())
+    {
+        writeTrace(tracePath);
+    }
 
     return(0);
 }
\ No newline at end of file
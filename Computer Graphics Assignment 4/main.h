@@ -8,8 +8,10 @@
 
 #include <GL/glut.h>
 #include <iostream>
+#include "glIntercept.h"
 
 void solidCube(const GLfloat size);
+void wireCube(const GLfloat size);
 void solidSphere(const GLfloat size);
 
 #endif // MAIN_H
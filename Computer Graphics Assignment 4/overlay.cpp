@@ -0,0 +1,459 @@
+// Implementations for the live performance overlay
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#include "overlay.h"
+#include "benchmark.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+
+//
+// LatencyHistogram
+//
+
+void LatencyHistogram::record(const uint64_t value)
+{
+	++counts_[bucketIndex(value)];
+	++total_;
+	sum_ += value;
+	min_ = std::min(min_, value);
+	max_ = std::max(max_, value);
+}
+
+void LatencyHistogram::reset()
+{
+	std::fill(counts_, counts_ + BUCKET_COUNT, 0);
+	total_ = 0;
+	sum_ = 0;
+	min_ = UINT64_MAX;
+	max_ = 0;
+}
+
+int LatencyHistogram::bucketIndex(const uint64_t value)
+{
+	// Small values get a bucket each
+	if (value < SUB_BUCKETS)
+	{
+		return (int)value;
+	}
+
+	// Anything too big to track goes in the last bucket
+	const uint64_t largest = ((uint64_t)SUB_BUCKETS << MAGNITUDES) - 1;
+	const uint64_t clamped = std::min(value, largest);
+
+	int highestBit = 0;
+	while ((clamped >> (highestBit + 1)) != 0)
+	{
+		++highestBit;
+	}
+	const int shift = highestBit - SUB_BUCKET_BITS;
+	const int subBucket = (int)(clamped >> shift) - SUB_BUCKETS;
+	return (shift + 1) * SUB_BUCKETS + subBucket;
+}
+
+uint64_t LatencyHistogram::bucketLowest(const int index)
+{
+	if (index < SUB_BUCKETS)
+	{
+		return (uint64_t)index;
+	}
+	const int shift = index / SUB_BUCKETS - 1;
+	return (uint64_t)(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+}
+
+uint64_t LatencyHistogram::bucketHighest(const int index)
+{
+	const int shift = index < SUB_BUCKETS ? 0 : index / SUB_BUCKETS - 1;
+	return bucketLowest(index) + ((uint64_t)1 << shift) - 1;
+}
+
+uint64_t LatencyHistogram::valueAtPercentile(const double percent) const
+{
+	if (total_ == 0)
+	{
+		return 0;
+	}
+
+	const uint64_t rank = std::max((uint64_t)(percent / 100.0 * total_ + 0.5), (uint64_t)1);
+	uint64_t seen = 0;
+	for (int i = 0; i < BUCKET_COUNT; ++i)
+	{
+		seen += counts_[i];
+		if (seen >= rank)
+		{
+			return std::min(bucketHighest(i), max_);
+		}
+	}
+	return max_;
+}
+
+void LatencyHistogram::print(std::ostream& out, const char* unit, const double valuesPerUnit) const
+{
+	char line[128];
+	snprintf(line, sizeof(line), "%12s %12s %12s\n", unit, "Percentile", "Count");
+	out << line;
+
+	uint64_t seen = 0;
+	for (int i = 0; i < BUCKET_COUNT; ++i)
+	{
+		if (counts_[i] == 0)
+		{
+			continue;
+		}
+		seen += counts_[i];
+		const double value = std::min(bucketHighest(i), max_) / valuesPerUnit;
+		snprintf(line, sizeof(line), "%12.3f %12.6f %12llu\n", value, seen / (double)total_, (unsigned long long)seen);
+		out << line;
+	}
+
+	snprintf(line, sizeof(line), "#[Count = %llu, Min = %.3f, Mean = %.3f, Max = %.3f]\n",
+		(unsigned long long)total_, min() / valuesPerUnit, mean() / valuesPerUnit, max_ / valuesPerUnit);
+	out << line;
+	snprintf(line, sizeof(line), "#[p50 = %.3f, p90 = %.3f, p99 = %.3f, p99.9 = %.3f]\n",
+		valueAtPercentile(50) / valuesPerUnit, valueAtPercentile(90) / valuesPerUnit,
+		valueAtPercentile(99) / valuesPerUnit, valueAtPercentile(99.9) / valuesPerUnit);
+	out << line << std::flush;
+}
+
+//
+// PerformanceOverlay
+//
+
+namespace
+{
+	// A 5x7 font covering what the overlay prints. Lower case letters are
+	// drawn in upper case, and anything missing is drawn as '?'.
+	const char FONT_CHARACTERS[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ .:/%-()=<>_,+?";
+	const int FONT_GLYPHS = sizeof(FONT_CHARACTERS) - 1;
+	const int GLYPH_WIDTH = 5;
+	const int GLYPH_HEIGHT = 7;
+
+	// One row per byte, top to bottom, with the leftmost pixel in bit 4
+	const unsigned char FONT_ROWS[FONT_GLYPHS][GLYPH_HEIGHT] =
+	{
+		{ 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E },	// 0
+		{ 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E },	// 1
+		{ 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F },	// 2
+		{ 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E },	// 3
+		{ 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 },	// 4
+		{ 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E },	// 5
+		{ 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E },	// 6
+		{ 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },	// 7
+		{ 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E },	// 8
+		{ 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C },	// 9
+		{ 0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11 },	// A
+		{ 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E },	// B
+		{ 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E },	// C
+		{ 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C },	// D
+		{ 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F },	// E
+		{ 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 },	// F
+		{ 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F },	// G
+		{ 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 },	// H
+		{ 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E },	// I
+		{ 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C },	// J
+		{ 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 },	// K
+		{ 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F },	// L
+		{ 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 },	// M
+		{ 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 },	// N
+		{ 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },	// O
+		{ 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 },	// P
+		{ 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D },	// Q
+		{ 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 },	// R
+		{ 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E },	// S
+		{ 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },	// T
+		{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },	// U
+		{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 },	// V
+		{ 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A },	// W
+		{ 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 },	// X
+		{ 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 },	// Y
+		{ 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F },	// Z
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// space
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C },	// .
+		{ 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 },	// :
+		{ 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 },	// /
+		{ 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 },	// %
+		{ 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 },	// -
+		{ 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 },	// (
+		{ 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 },	// )
+		{ 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 },	// =
+		{ 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 },	// <
+		{ 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 },	// >
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F },	// _
+		{ 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 },	// ,
+		{ 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 },	// +
+		{ 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }	// ?
+	};
+
+	// Glyphs sit in 8x8 cells of a 128x32 atlas
+	const int CELL_SIZE = 8;
+	const int ATLAS_COLUMNS = 16;
+	const int ATLAS_WIDTH = CELL_SIZE * ATLAS_COLUMNS;
+	const int ATLAS_HEIGHT = 32;
+
+	// Each font pixel covers TEXT_SCALE window pixels in each direction
+	const float TEXT_SCALE = 2.0f;
+	const float LINE_HEIGHT = (GLYPH_HEIGHT + 1) * TEXT_SCALE;
+
+	// The panel, in window pixels from the bottom left corner
+	const float PANEL_X = 8, PANEL_Y = 8;
+	const float PANEL_WIDTH = 320;
+	const float MARGIN = 8;
+	const float HISTOGRAM_HEIGHT = 36;
+	const float GRAPH_HEIGHT = 60;
+	const float GRAPH_MAX_MS = 50.0f;
+	const int TEXT_LINES = 8;
+
+	// The histogram shows one bar per power of two from 256 us to 128 ms
+	const int FIRST_MAGNITUDE = 8;
+	const int HISTOGRAM_BARS = 10;
+
+	int glyphIndex(const char c)
+	{
+		const char upper = c >= 'a' && c <= 'z' ? (char)(c - 'a' + 'A') : c;
+		for (int i = 0; i < FONT_GLYPHS; ++i)
+		{
+			if (FONT_CHARACTERS[i] == upper)
+			{
+				return i;
+			}
+		}
+		return FONT_GLYPHS - 1;
+	}
+
+	void addColoredVertex(std::vector<GLfloat>& vertices, const float x, const float y, const float* color)
+	{
+		const GLfloat vertex[6] = { x, y, color[0], color[1], color[2], color[3] };
+		vertices.insert(vertices.end(), vertex, vertex + 6);
+	}
+
+	void addRect(std::vector<GLfloat>& quads, const float x0, const float y0, const float x1, const float y1, const float* color)
+	{
+		addColoredVertex(quads, x0, y0, color);
+		addColoredVertex(quads, x1, y0, color);
+		addColoredVertex(quads, x1, y1, color);
+		addColoredVertex(quads, x0, y1, color);
+	}
+
+	void addLine(std::vector<GLfloat>& lines, const float x0, const float y0, const float x1, const float y1, const float* color)
+	{
+		addColoredVertex(lines, x0, y0, color);
+		addColoredVertex(lines, x1, y1, color);
+	}
+
+	void drawColored(const std::vector<GLfloat>& vertices, const GLenum mode)
+	{
+		glVertexPointer(2, GL_FLOAT, 6 * sizeof(GLfloat), vertices.data());
+		glColorPointer(4, GL_FLOAT, 6 * sizeof(GLfloat), vertices.data() + 2);
+		glDrawArrays(mode, 0, (GLsizei)(vertices.size() / 6));
+		countDraw((int)(vertices.size() / 6));
+	}
+}
+
+void PerformanceOverlay::initialize()
+{
+	std::vector<GLubyte> atlas(ATLAS_WIDTH * ATLAS_HEIGHT, 0);
+	for (int glyph = 0; glyph < FONT_GLYPHS; ++glyph)
+	{
+		const int cellX = glyph % ATLAS_COLUMNS * CELL_SIZE;
+		const int cellY = glyph / ATLAS_COLUMNS * CELL_SIZE;
+		for (int row = 0; row < GLYPH_HEIGHT; ++row)
+		{
+			for (int column = 0; column < GLYPH_WIDTH; ++column)
+			{
+				if (FONT_ROWS[glyph][row] & (0x10 >> column))
+				{
+					atlas[(cellY + row) * ATLAS_WIDTH + cellX + column] = 255;
+				}
+			}
+		}
+	}
+
+	glGenTextures(1, &fontTexture_);
+	glBindTexture(GL_TEXTURE_2D, fontTexture_);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, ATLAS_WIDTH, ATLAS_HEIGHT, 0, GL_ALPHA, GL_UNSIGNED_BYTE, atlas.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void PerformanceOverlay::addFrame(const Frame& frame)
+{
+	last_ = frame;
+	history_[next_] = (float)frame.frameMs;
+	next_ = (next_ + 1) % HISTORY;
+	histogram_.record((uint64_t)(frame.frameMs * 1000.0 + 0.5));
+}
+
+void PerformanceOverlay::addText(const float x, const float y, const char* text)
+{
+	const float width = GLYPH_WIDTH * TEXT_SCALE;
+	const float height = GLYPH_HEIGHT * TEXT_SCALE;
+	float left = x;
+	for (const char* c = text; *c != '\0'; ++c, left += (GLYPH_WIDTH + 1) * TEXT_SCALE)
+	{
+		if (*c == ' ')
+		{
+			continue;
+		}
+
+		// The atlas's first row is the top of the glyphs, so v runs downwards
+		const int glyph = glyphIndex(*c);
+		const float u0 = glyph % ATLAS_COLUMNS * CELL_SIZE / (float)ATLAS_WIDTH;
+		const float v0 = glyph / ATLAS_COLUMNS * CELL_SIZE / (float)ATLAS_HEIGHT;
+		const float u1 = u0 + GLYPH_WIDTH / (float)ATLAS_WIDTH;
+		const float v1 = v0 + GLYPH_HEIGHT / (float)ATLAS_HEIGHT;
+		const GLfloat corners[16] =
+		{
+			left, y, u0, v1,
+			left + width, y, u1, v1,
+			left + width, y + height, u1, v0,
+			left, y + height, u0, v0
+		};
+		text_.insert(text_.end(), corners, corners + 16);
+	}
+}
+
+void PerformanceOverlay::draw(const int width, const int height)
+{
+	TRACE_SCOPE("PerformanceOverlay::draw");
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	static const float PANEL_COLOR[4] = { 0, 0, 0, 0.65f };
+	static const float GRID_COLOR[4] = { 0.5f, 0.5f, 0.5f, 0.8f };
+	static const float BAR_COLOR[4] = { 0.2f, 0.7f, 1.0f, 0.9f };
+
+	quads_.clear();
+	lines_.clear();
+	graph_.clear();
+	text_.clear();
+
+	// Laid out from the bottom up: histogram, its caption, graph, then text
+	const float left = PANEL_X + MARGIN;
+	const float right = PANEL_X + PANEL_WIDTH - MARGIN;
+	const float histogramY = PANEL_Y + MARGIN;
+	const float captionY = histogramY + HISTOGRAM_HEIGHT + MARGIN / 2;
+	const float graphY = captionY + LINE_HEIGHT + MARGIN / 2;
+	const float textY = graphY + GRAPH_HEIGHT + MARGIN;
+	const float panelTop = textY + TEXT_LINES * LINE_HEIGHT + MARGIN;
+	addRect(quads_, PANEL_X, PANEL_Y, PANEL_X + PANEL_WIDTH, panelTop, PANEL_COLOR);
+
+	// Histogram bars, scaled so the fullest one reaches the top
+	uint64_t bars[HISTOGRAM_BARS] = {};
+	for (int i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i)
+	{
+		const uint64_t count = histogram_.bucketCount(i);
+		if (count == 0)
+		{
+			continue;
+		}
+		// Power of two the bucket starts in (the small exact buckets all land in the first bar)
+		const int magnitude = i < LatencyHistogram::SUB_BUCKETS ? 0 : i / LatencyHistogram::SUB_BUCKETS - 1 + LatencyHistogram::SUB_BUCKET_BITS;
+		bars[std::min(std::max(magnitude - FIRST_MAGNITUDE, 0), HISTOGRAM_BARS - 1)] += count;
+	}
+	const uint64_t fullest = std::max(*std::max_element(bars, bars + HISTOGRAM_BARS), (uint64_t)1);
+	const float barWidth = (right - left) / HISTOGRAM_BARS;
+	for (int i = 0; i < HISTOGRAM_BARS; ++i)
+	{
+		const float x = left + i * barWidth;
+		addRect(quads_, x + 1, histogramY, x + barWidth - 1, histogramY + HISTOGRAM_HEIGHT * bars[i] / fullest, BAR_COLOR);
+	}
+	addText(left, captionY, "LOG2 HISTOGRAM 0.25-128 MS");
+
+	// Frame time graph, with lines at 60 and 30 frames per second
+	const float msToY = GRAPH_HEIGHT / GRAPH_MAX_MS;
+	addLine(lines_, left, graphY, right, graphY, GRID_COLOR);
+	addLine(lines_, left, graphY + 16.667f * msToY, right, graphY + 16.667f * msToY, GRID_COLOR);
+	addLine(lines_, left, graphY + 33.333f * msToY, right, graphY + 33.333f * msToY, GRID_COLOR);
+	for (int i = 0; i < HISTORY; ++i)
+	{
+		const float ms = std::min(history_[(next_ + i) % HISTORY], GRAPH_MAX_MS);
+		graph_.push_back(left + (right - left) * i / (HISTORY - 1));
+		graph_.push_back(graphY + ms * msToY);
+	}
+
+	// Counters, top line first
+	char line[64];
+	float y = textY + (TEXT_LINES - 1) * LINE_HEIGHT;
+	snprintf(line, sizeof(line), "FRAME %6.2f MS  CPU %6.2f MS", last_.frameMs, last_.cpuMs);
+	addText(left, y, line);
+	y -= LINE_HEIGHT;
+	snprintf(line, sizeof(line), "P50 %.1f  P99 %.1f  MAX %.1f",
+		histogram_.valueAtPercentile(50) / 1000.0, histogram_.valueAtPercentile(99) / 1000.0, histogram_.max() / 1000.0);
+	addText(left, y, line);
+	y -= LINE_HEIGHT;
+	snprintf(line, sizeof(line), "DRAWS %lld  VERTS %lld", last_.drawCalls, last_.vertices);
+	addText(left, y, line);
+	y -= LINE_HEIGHT;
+	snprintf(line, sizeof(line), "STATE %lld  CULLED %lld", last_.stateChanges, last_.culled);
+	addText(left, y, line);
+	y -= LINE_HEIGHT;
+	snprintf(line, sizeof(line), "MATRICES DIRTY %lld  CLEAN %lld", last_.matricesDirty, last_.matricesClean);
+	addText(left, y, line);
+	y -= LINE_HEIGHT;
+	snprintf(line, sizeof(line), "ANIM %.3f  OVERLAY %.3f MS", last_.animationMs, overlayMs_);
+	addText(left, y, line);
+	y -= LINE_HEIGHT;
+	snprintf(line, sizeof(line), "ROBOTS VISIBLE %d  UPDATED %d", last_.robotsVisible, last_.robotsUpdated);
+	addText(left, y, line);
+	y -= LINE_HEIGHT;
+	if (last_.glCalls >= 0)
+		snprintf(line, sizeof(line), "GL CALLS %lld  EVENTS %d", last_.glCalls, last_.events);
+	else
+		snprintf(line, sizeof(line), "GL CALLS -  EVENTS %d", last_.events);
+	addText(left, y, line);
+
+	// Window coordinates, with nothing from the scene left enabled
+	glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_CURRENT_BIT | GL_TEXTURE_BIT | GL_VIEWPORT_BIT | GL_LINE_BIT);
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glViewport(0, 0, width, height);
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	gluOrtho2D(0, width, 0, height);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	glDisable(GL_LIGHTING);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_TEXTURE_2D);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glEnableClientState(GL_VERTEX_ARRAY);
+
+	glEnableClientState(GL_COLOR_ARRAY);
+	drawColored(quads_, GL_QUADS);
+	drawColored(lines_, GL_LINES);
+	glDisableClientState(GL_COLOR_ARRAY);
+
+	glColor3f(0.3f, 1.0f, 0.3f);
+	glVertexPointer(2, GL_FLOAT, 0, graph_.data());
+	glDrawArrays(GL_LINE_STRIP, 0, HISTORY);
+	countDraw(HISTORY);
+
+	// All the text in one draw
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, fontTexture_);
+	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glColor3f(1, 1, 1);
+	glVertexPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), text_.data());
+	glTexCoordPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), text_.data() + 2);
+	glDrawArrays(GL_QUADS, 0, (GLsizei)(text_.size() / 4));
+	countDraw((int)(text_.size() / 4));
+
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopMatrix();
+	glPopClientAttrib();
+	glPopAttrib();
+
+	overlayMs_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,114 @@
+// Header file for the live performance overlay
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+#include "main.h"
+
+// Counts values in logarithmic buckets, HdrHistogram style: each power of
+// two is split into SUB_BUCKETS linear buckets, so every recorded value is
+// kept to within 1/SUB_BUCKETS of itself no matter how large it is. The
+// buckets are a fixed array, so recording never allocates.
+class LatencyHistogram
+{
+public:
+	static const int SUB_BUCKET_BITS = 5;
+	static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static const int MAGNITUDES = 32;			// Values up to 2^36 (19 hours in microseconds)
+	static const int BUCKET_COUNT = (MAGNITUDES + 1) * SUB_BUCKETS;
+
+	LatencyHistogram() { reset(); }
+
+	void record(const uint64_t value);
+	void reset();
+
+	uint64_t count() const { return total_; }
+	uint64_t min() const { return total_ == 0 ? 0 : min_; }
+	uint64_t max() const { return max_; }
+	double mean() const { return total_ == 0 ? 0.0 : (double)sum_ / total_; }
+
+	// Smallest recorded value that percent of the values are at or below,
+	// rounded up to the top of its bucket
+	uint64_t valueAtPercentile(const double percent) const;
+
+	// Buckets from the smallest value to the largest
+	static int bucketIndex(const uint64_t value);
+	static uint64_t bucketLowest(const int index);
+	static uint64_t bucketHighest(const int index);
+	uint64_t bucketCount(const int index) const { return counts_[index]; }
+
+	// Prints the percentile distribution, in the given unit per value
+	void print(std::ostream& out, const char* unit, const double valuesPerUnit) const;
+
+private:
+	uint64_t counts_[BUCKET_COUNT];
+	uint64_t total_;
+	uint64_t sum_;
+	uint64_t min_;
+	uint64_t max_;
+};
+
+// Frame times, draw counters and a histogram, drawn over the scene in
+// window coordinates. Everything is drawn from client-side vertex arrays
+// in a handful of glDrawArrays calls, with all the text in one of them.
+class PerformanceOverlay
+{
+public:
+	struct Frame
+	{
+		double frameMs;			// Since the previous frame started
+		double cpuMs;			// Updating and submitting this frame
+		double animationMs;		// Advancing the robots
+		long long drawCalls;
+		long long vertices;
+		long long stateChanges;
+		long long culled;
+		long long matricesDirty;	// World matrices rebuilt
+		long long matricesClean;	// World matrices reused from the cache
+		int robotsVisible;		// At the simulation's last step
+		int robotsUpdated;		// Animated in that step
+		long long glCalls;		// Negative if they aren't being counted
+		int events;				// Input events handled since the previous frame
+	};
+
+	// Builds the font texture, so this needs a current GL context
+	void initialize();
+
+	// Call every frame, shown or not, so the histogram covers the whole run
+	void addFrame(const Frame& frame);
+
+	// Leaves the GL state as it found it
+	void draw(const int width, const int height);
+
+	bool visible() const { return visible_; }
+	void toggle() { visible_ = !visible_; }
+
+	// Frame times in microseconds
+	const LatencyHistogram& histogram() const { return histogram_; }
+
+private:
+	static const int HISTORY = 240;
+
+	void addText(const float x, const float y, const char* text);
+
+	float history_[HISTORY] = {};	// Frame times in ms, oldest first from next_
+	int next_ = 0;
+	Frame last_ = {};
+	double overlayMs_ = 0.0;		// What the last draw() cost
+	LatencyHistogram histogram_;
+	bool visible_ = false;
+
+	GLuint fontTexture_ = 0;
+	std::vector<GLfloat> quads_;	// x, y, r, g, b, a per corner
+	std::vector<GLfloat> lines_;	// Same layout as quads_
+	std::vector<GLfloat> graph_;	// x, y per frame in the history
+	std::vector<GLfloat> text_;		// x, y, u, v per corner of each glyph
+};
+
+#endif // OVERLAY_H
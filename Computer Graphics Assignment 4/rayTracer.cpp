@@ -0,0 +1,583 @@
+// Implementations for the BVH ray tracer
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#include "rayTracer.h"
+
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define RAY_SSE
+#include <xmmintrin.h>
+#endif
+
+// Build tuning
+static const int SAH_BINS = 12;
+static const int MAX_LEAF_SIZE = 8;
+static const int MAX_DEPTH = 60;		// Keeps the traversal stack bounded
+static const float TRAVERSAL_COST = 1.0f;	// Relative to one triangle test
+
+// Four floats that are processed together. Comparisons give masks, which
+// can only be combined with & and |, passed to select() or read with bits().
+#ifdef RAY_SSE
+struct Float4
+{
+	__m128 v;
+};
+
+static inline Float4 splat(const float x) { return { _mm_set1_ps(x) }; }
+static inline Float4 load4(const float* p) { return { _mm_loadu_ps(p) }; }
+static inline void store4(const Float4 a, float* p) { _mm_storeu_ps(p, a.v); }
+static inline Float4 operator+(const Float4 a, const Float4 b) { return { _mm_add_ps(a.v, b.v) }; }
+static inline Float4 operator-(const Float4 a, const Float4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+static inline Float4 operator*(const Float4 a, const Float4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+static inline Float4 operator/(const Float4 a, const Float4 b) { return { _mm_div_ps(a.v, b.v) }; }
+static inline Float4 min4(const Float4 a, const Float4 b) { return { _mm_min_ps(a.v, b.v) }; }
+static inline Float4 max4(const Float4 a, const Float4 b) { return { _mm_max_ps(a.v, b.v) }; }
+static inline Float4 operator<(const Float4 a, const Float4 b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+static inline Float4 operator<=(const Float4 a, const Float4 b) { return { _mm_cmple_ps(a.v, b.v) }; }
+static inline Float4 operator>(const Float4 a, const Float4 b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+static inline Float4 operator>=(const Float4 a, const Float4 b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+static inline Float4 operator&(const Float4 a, const Float4 b) { return { _mm_and_ps(a.v, b.v) }; }
+static inline Float4 operator|(const Float4 a, const Float4 b) { return { _mm_or_ps(a.v, b.v) }; }
+static inline Float4 select(const Float4 mask, const Float4 a, const Float4 b) { return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+static inline int bits(const Float4 mask) { return _mm_movemask_ps(mask.v); }
+#else
+struct Float4
+{
+	float v[4];
+};
+
+// Masks are 1 or 0 in each lane
+#define FLOAT4_LANES(expression) { Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = (expression); return r; }
+static inline Float4 splat(const float x) FLOAT4_LANES(x)
+static inline Float4 load4(const float* p) FLOAT4_LANES(p[i])
+static inline void store4(const Float4 a, float* p) { for (int i = 0; i < 4; ++i) p[i] = a.v[i]; }
+static inline Float4 operator+(const Float4 a, const Float4 b) FLOAT4_LANES(a.v[i] + b.v[i])
+static inline Float4 operator-(const Float4 a, const Float4 b) FLOAT4_LANES(a.v[i] - b.v[i])
+static inline Float4 operator*(const Float4 a, const Float4 b) FLOAT4_LANES(a.v[i] * b.v[i])
+static inline Float4 operator/(const Float4 a, const Float4 b) FLOAT4_LANES(a.v[i] / b.v[i])
+static inline Float4 min4(const Float4 a, const Float4 b) FLOAT4_LANES(a.v[i] < b.v[i] ? a.v[i] : b.v[i])
+static inline Float4 max4(const Float4 a, const Float4 b) FLOAT4_LANES(a.v[i] > b.v[i] ? a.v[i] : b.v[i])
+static inline Float4 operator<(const Float4 a, const Float4 b) FLOAT4_LANES(a.v[i] < b.v[i])
+static inline Float4 operator<=(const Float4 a, const Float4 b) FLOAT4_LANES(a.v[i] <= b.v[i])
+static inline Float4 operator>(const Float4 a, const Float4 b) FLOAT4_LANES(a.v[i] > b.v[i])
+static inline Float4 operator>=(const Float4 a, const Float4 b) FLOAT4_LANES(a.v[i] >= b.v[i])
+static inline Float4 operator&(const Float4 a, const Float4 b) FLOAT4_LANES(a.v[i] != 0.0f && b.v[i] != 0.0f)
+static inline Float4 operator|(const Float4 a, const Float4 b) FLOAT4_LANES(a.v[i] != 0.0f || b.v[i] != 0.0f)
+static inline Float4 select(const Float4 mask, const Float4 a, const Float4 b) FLOAT4_LANES(mask.v[i] != 0.0f ? a.v[i] : b.v[i])
+static inline int bits(const Float4 mask) { int r = 0; for (int i = 0; i < 4; ++i) r |= (mask.v[i] != 0.0f) << i; return r; }
+#undef FLOAT4_LANES
+#endif
+
+// Four rays, one per pixel of a 2x2 block
+struct RayTracer::Packet
+{
+	Float4 originX, originY, originZ;
+	Float4 dirX, dirY, dirZ;
+	Float4 invX, invY, invZ;
+	Float4 t;			// Nearest hit so far
+	Float4 hitU, hitV;	// Barycentric coordinates of that hit
+	int triangle[4];	// -1 for a miss
+};
+
+static double millisecondsSince(const std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static float surfaceArea(const float* min, const float* max)
+{
+	const float dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+	return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+static void growBounds(float* min, float* max, const float* otherMin, const float* otherMax)
+{
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		min[axis] = std::min(min[axis], otherMin[axis]);
+		max[axis] = std::max(max[axis], otherMax[axis]);
+	}
+}
+
+static void emptyBounds(float* min, float* max)
+{
+	min[0] = min[1] = min[2] = FLT_MAX;
+	max[0] = max[1] = max[2] = -FLT_MAX;
+}
+
+RayTracer::RayTracer(ThreadPool& pool) : pool_(pool)
+{
+}
+
+void RayTracer::setTextures(const SoftwareTexture* textures, const int count)
+{
+	textures_ = textures;
+	textureCount_ = count;
+}
+
+void RayTracer::build(const std::vector<ScenePart>& parts)
+{
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// Flatten the parts into world space triangles
+	triangles_.clear();
+	for (const ScenePart& part : parts)
+	{
+		const std::vector<MeshVertex>& mesh = primitiveMesh(part.primitive);
+		const std::vector<float3>& positions = primitivePositions(part.primitive);
+		world_.resize(positions.size());
+		transformPoints(part.transform, positions.data(), world_.data(), positions.size());
+
+		for (size_t i = 0; i + 2 < mesh.size(); i += 3)
+		{
+			const float3& v0 = world_[i];
+			const float3 edge1 = world_[i + 1] - v0;
+			const float3 edge2 = world_[i + 2] - v0;
+
+			Triangle triangle;
+			triangle.v0[0] = v0.x; triangle.v0[1] = v0.y; triangle.v0[2] = v0.z;
+			triangle.edge1[0] = edge1.x; triangle.edge1[1] = edge1.y; triangle.edge1[2] = edge1.z;
+			triangle.edge2[0] = edge2.x; triangle.edge2[1] = edge2.y; triangle.edge2[2] = edge2.z;
+			for (int k = 0; k < 3; ++k)
+			{
+				triangle.u[k] = mesh[i + k].u * part.uvScale;
+				triangle.v[k] = mesh[i + k].v * part.uvScale;
+			}
+			triangle.texture = part.texture;
+			triangles_.push_back(triangle);
+		}
+	}
+
+	// Per triangle bounds and centroids for the build
+	const int count = (int)triangles_.size();
+	std::vector<float> centroids(count * 3);
+	std::vector<float> bounds(count * 6);
+	for (int i = 0; i < count; ++i)
+	{
+		const Triangle& triangle = triangles_[i];
+		float* min = &bounds[i * 6];
+		float* max = min + 3;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float a = triangle.v0[axis];
+			const float b = a + triangle.edge1[axis];
+			const float c = a + triangle.edge2[axis];
+			min[axis] = std::min(a, std::min(b, c));
+			max[axis] = std::max(a, std::max(b, c));
+			centroids[i * 3 + axis] = 0.5f * (min[axis] + max[axis]);
+		}
+	}
+
+	order_.resize(count);
+	for (int i = 0; i < count; ++i)
+	{
+		order_[i] = i;
+	}
+
+	nodes_.clear();
+	stats_ = Stats();
+	if (count > 0)
+	{
+		nodes_.reserve(count * 2);
+		nodes_.resize(1);
+		stats_.maxDepth = buildNode(0, 0, count, 1, centroids, bounds);
+
+		// Store the triangles in leaf order so leaves read them sequentially
+		std::vector<Triangle> sorted(count);
+		for (int i = 0; i < count; ++i)
+		{
+			sorted[i] = triangles_[order_[i]];
+		}
+		triangles_.swap(sorted);
+	}
+
+	stats_.triangles = count;
+	stats_.nodes = (int)nodes_.size();
+	for (const Node& node : nodes_)
+	{
+		stats_.leaves += node.count > 0;
+	}
+	stats_.buildMs = millisecondsSince(start);
+}
+
+// Builds the node covering order_[begin, end) and returns the depth of its
+// deepest leaf. Splits are chosen with binned SAH along every axis.
+int RayTracer::buildNode(const int node, const int begin, const int end, const int depth, std::vector<float>& centroids, std::vector<float>& bounds)
+{
+	float nodeMin[3], nodeMax[3], centroidMin[3], centroidMax[3];
+	emptyBounds(nodeMin, nodeMax);
+	emptyBounds(centroidMin, centroidMax);
+	for (int i = begin; i < end; ++i)
+	{
+		const float* min = &bounds[order_[i] * 6];
+		const float* centroid = &centroids[order_[i] * 3];
+		growBounds(nodeMin, nodeMax, min, min + 3);
+		growBounds(centroidMin, centroidMax, centroid, centroid);
+	}
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		nodes_[node].min[axis] = nodeMin[axis];
+		nodes_[node].max[axis] = nodeMax[axis];
+	}
+
+	const int count = end - begin;
+	if (count <= 2 || depth >= MAX_DEPTH)
+	{
+		nodes_[node].first = begin;
+		nodes_[node].count = (uint32_t)count;
+		nodes_[node].axis = 0;
+		return depth;
+	}
+
+	// Find the cheapest split between bins
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	int bestBin = 0;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const float extent = centroidMax[axis] - centroidMin[axis];
+		if (extent <= 0.0f)
+		{
+			continue;
+		}
+
+		int binCounts[SAH_BINS] = { 0 };
+		float binMin[SAH_BINS][3], binMax[SAH_BINS][3];
+		for (int b = 0; b < SAH_BINS; ++b)
+		{
+			emptyBounds(binMin[b], binMax[b]);
+		}
+
+		const float scale = SAH_BINS / extent;
+		for (int i = begin; i < end; ++i)
+		{
+			const int b = std::min(SAH_BINS - 1, (int)((centroids[order_[i] * 3 + axis] - centroidMin[axis]) * scale));
+			const float* min = &bounds[order_[i] * 6];
+			++binCounts[b];
+			growBounds(binMin[b], binMax[b], min, min + 3);
+		}
+
+		// Sweep from the right to get the cost of everything past each split
+		float rightCost[SAH_BINS];
+		float sweepMin[3], sweepMax[3];
+		emptyBounds(sweepMin, sweepMax);
+		int sweepCount = 0;
+		for (int b = SAH_BINS - 1; b > 0; --b)
+		{
+			growBounds(sweepMin, sweepMax, binMin[b], binMax[b]);
+			sweepCount += binCounts[b];
+			rightCost[b] = sweepCount > 0 ? sweepCount * surfaceArea(sweepMin, sweepMax) : 0.0f;
+		}
+
+		// Then from the left, splitting after bin b
+		emptyBounds(sweepMin, sweepMax);
+		sweepCount = 0;
+		for (int b = 0; b < SAH_BINS - 1; ++b)
+		{
+			growBounds(sweepMin, sweepMax, binMin[b], binMax[b]);
+			sweepCount += binCounts[b];
+			if (sweepCount == 0 || sweepCount == count)
+			{
+				continue;
+			}
+
+			const float cost = sweepCount * surfaceArea(sweepMin, sweepMax) + rightCost[b + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = b;
+			}
+		}
+	}
+
+	const float nodeArea = surfaceArea(nodeMin, nodeMax);
+	const float leafCost = (float)count;
+	const float splitCost = TRAVERSAL_COST + (nodeArea > 0.0f ? bestCost / nodeArea : 0.0f);
+	if (count <= MAX_LEAF_SIZE && (bestAxis < 0 || splitCost >= leafCost))
+	{
+		nodes_[node].first = begin;
+		nodes_[node].count = (uint32_t)count;
+		nodes_[node].axis = 0;
+		return depth;
+	}
+
+	int middle;
+	if (bestAxis >= 0)
+	{
+		const float extent = centroidMax[bestAxis] - centroidMin[bestAxis];
+		const float scale = SAH_BINS / extent;
+		const float axisMin = centroidMin[bestAxis];
+		middle = (int)(std::partition(order_.begin() + begin, order_.begin() + end, [&](int index)
+		{
+			return std::min(SAH_BINS - 1, (int)((centroids[index * 3 + bestAxis] - axisMin) * scale)) <= bestBin;
+		}) - order_.begin());
+	}
+	else
+	{
+		// Every centroid is in the same place, so any split is as good
+		bestAxis = 0;
+		middle = (begin + end) / 2;
+	}
+
+	const int children = (int)nodes_.size();
+	nodes_.resize(children + 2);
+	nodes_[node].first = children;
+	nodes_[node].count = 0;
+	nodes_[node].axis = (uint32_t)bestAxis;
+
+	const int leftDepth = buildNode(children, begin, middle, depth + 1, centroids, bounds);
+	const int rightDepth = buildNode(children + 1, middle, end, depth + 1, centroids, bounds);
+	return std::max(leftDepth, rightDepth);
+}
+
+void RayTracer::render(const RayCamera& camera, const int width, const int height, const int samples, uint32_t* pixels)
+{
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	const int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	const int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	pool_.parallelFor(tilesX * tilesY, [&](int tile, int /*thread*/)
+	{
+		traceTile(tile, camera, width, height, samples, pixels);
+	});
+
+	stats_.rays = (long long)width * height * samples * samples;
+	stats_.traceMs = millisecondsSince(start);
+}
+
+void RayTracer::traceTile(const int tile, const RayCamera& camera, const int width, const int height, const int samples, uint32_t* pixels)
+{
+	const int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	const int x0 = (tile % tilesX) * TILE_SIZE;
+	const int y0 = (tile / tilesX) * TILE_SIZE;
+	const int x1 = std::min(x0 + TILE_SIZE, width);
+	const int y1 = std::min(y0 + TILE_SIZE, height);
+
+	// Camera basis, the same one gluLookAt builds
+	float forward[3], right[3], up[3];
+	float length = 0.0f;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		forward[axis] = camera.center[axis] - camera.eye[axis];
+		length += forward[axis] * forward[axis];
+	}
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		forward[axis] /= sqrtf(length);
+	}
+	right[0] = forward[1] * camera.up[2] - forward[2] * camera.up[1];
+	right[1] = forward[2] * camera.up[0] - forward[0] * camera.up[2];
+	right[2] = forward[0] * camera.up[1] - forward[1] * camera.up[0];
+	length = sqrtf(right[0] * right[0] + right[1] * right[1] + right[2] * right[2]);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		right[axis] /= length;
+	}
+	up[0] = right[1] * forward[2] - right[2] * forward[1];
+	up[1] = right[2] * forward[0] - right[0] * forward[2];
+	up[2] = right[0] * forward[1] - right[1] * forward[0];
+
+	const float tanHalf = tanf(camera.fovy * 0.5f * 3.14159265358979f / 180.0f);
+	const float scaleX = tanHalf * width / (float)height;
+
+	// Per channel sums for every pixel in the tile
+	uint32_t sums[TILE_SIZE * TILE_SIZE][3] = { { 0 } };
+
+	for (int sampleY = 0; sampleY < samples; ++sampleY)
+	{
+		for (int sampleX = 0; sampleX < samples; ++sampleX)
+		{
+			const float offsetX = (sampleX + 0.5f) / samples;
+			const float offsetY = (sampleY + 0.5f) / samples;
+
+			for (int y = y0; y < y1; y += 2)
+			{
+				for (int x = x0; x < x1; x += 2)
+				{
+					// Lanes past the edge of the image repeat a pixel that isn't
+					int laneX[4], laneY[4];
+					float dir[3][4];
+					for (int lane = 0; lane < 4; ++lane)
+					{
+						laneX[lane] = std::min(x + (lane & 1), x1 - 1);
+						laneY[lane] = std::min(y + (lane >> 1), y1 - 1);
+						const float ndcX = (laneX[lane] + offsetX) / width * 2.0f - 1.0f;
+						const float ndcY = (laneY[lane] + offsetY) / height * 2.0f - 1.0f;
+						for (int axis = 0; axis < 3; ++axis)
+						{
+							dir[axis][lane] = forward[axis] + ndcX * scaleX * right[axis] + ndcY * tanHalf * up[axis];
+						}
+					}
+
+					Packet packet;
+					packet.originX = splat(camera.eye[0]);
+					packet.originY = splat(camera.eye[1]);
+					packet.originZ = splat(camera.eye[2]);
+					packet.dirX = load4(dir[0]);
+					packet.dirY = load4(dir[1]);
+					packet.dirZ = load4(dir[2]);
+					packet.invX = splat(1.0f) / packet.dirX;
+					packet.invY = splat(1.0f) / packet.dirY;
+					packet.invZ = splat(1.0f) / packet.dirZ;
+					packet.t = splat(FLT_MAX);
+					packet.hitU = splat(0.0f);
+					packet.hitV = splat(0.0f);
+					packet.triangle[0] = packet.triangle[1] = packet.triangle[2] = packet.triangle[3] = -1;
+					trace(packet);
+
+					float hitU[4], hitV[4];
+					store4(packet.hitU, hitU);
+					store4(packet.hitV, hitV);
+					for (int lane = 0; lane < 4; ++lane)
+					{
+						if (x + (lane & 1) >= x1 || y + (lane >> 1) >= y1 || packet.triangle[lane] < 0)
+						{
+							continue;
+						}
+
+						const Triangle& triangle = triangles_[packet.triangle[lane]];
+						const float w = 1.0f - hitU[lane] - hitV[lane];
+						const float u = triangle.u[0] * w + triangle.u[1] * hitU[lane] + triangle.u[2] * hitV[lane];
+						const float v = triangle.v[0] * w + triangle.v[1] * hitU[lane] + triangle.v[2] * hitV[lane];
+						const uint32_t color = textures_ != nullptr && triangle.texture >= 0 && triangle.texture < textureCount_
+							? sampleTexture(textures_[triangle.texture], u, v) : 0xFFFFFFFFu;
+
+						uint32_t* sum = sums[(laneY[lane] - y0) * TILE_SIZE + laneX[lane] - x0];
+						sum[0] += color & 0xFF;
+						sum[1] += (color >> 8) & 0xFF;
+						sum[2] += (color >> 16) & 0xFF;
+					}
+				}
+			}
+		}
+	}
+
+	// Average the samples
+	const uint32_t sampleCount = samples * samples;
+	for (int y = y0; y < y1; ++y)
+	{
+		for (int x = x0; x < x1; ++x)
+		{
+			const uint32_t* sum = sums[(y - y0) * TILE_SIZE + x - x0];
+			pixels[(size_t)y * width + x] = (sum[0] + sampleCount / 2) / sampleCount
+				| (sum[1] + sampleCount / 2) / sampleCount << 8
+				| (sum[2] + sampleCount / 2) / sampleCount << 16
+				| 0xFF000000u;
+		}
+	}
+}
+
+// Walks the hierarchy front to back with the whole packet, skipping nodes
+// none of the four rays can hit before their nearest hit so far
+void RayTracer::trace(Packet& packet) const
+{
+	if (nodes_.empty())
+	{
+		return;
+	}
+
+	const float epsilon = 1e-5f;
+	const Float4 zero = splat(0.0f);
+	const Float4 one = splat(1.0f);
+
+	float firstDir[3];
+	{
+		float dirX[4], dirY[4], dirZ[4];
+		store4(packet.dirX, dirX);
+		store4(packet.dirY, dirY);
+		store4(packet.dirZ, dirZ);
+		firstDir[0] = dirX[0];
+		firstDir[1] = dirY[0];
+		firstDir[2] = dirZ[0];
+	}
+
+	int stack[MAX_DEPTH + 2];
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0)
+	{
+		const Node& node = nodes_[stack[--top]];
+
+		// Slab test against all four rays
+		const Float4 tx0 = (splat(node.min[0]) - packet.originX) * packet.invX;
+		const Float4 tx1 = (splat(node.max[0]) - packet.originX) * packet.invX;
+		const Float4 ty0 = (splat(node.min[1]) - packet.originY) * packet.invY;
+		const Float4 ty1 = (splat(node.max[1]) - packet.originY) * packet.invY;
+		const Float4 tz0 = (splat(node.min[2]) - packet.originZ) * packet.invZ;
+		const Float4 tz1 = (splat(node.max[2]) - packet.originZ) * packet.invZ;
+		const Float4 enter = max4(max4(min4(tx0, tx1), min4(ty0, ty1)), max4(min4(tz0, tz1), zero));
+		const Float4 leave = min4(min4(max4(tx0, tx1), max4(ty0, ty1)), min4(max4(tz0, tz1), packet.t));
+		if (bits(enter <= leave) == 0)
+		{
+			continue;
+		}
+
+		if (node.count == 0)
+		{
+			// Visit the child on the near side of the split first
+			if (firstDir[node.axis] > 0.0f)
+			{
+				stack[top++] = node.first + 1;
+				stack[top++] = node.first;
+			}
+			else
+			{
+				stack[top++] = node.first;
+				stack[top++] = node.first + 1;
+			}
+			continue;
+		}
+
+		// Moller-Trumbore against every triangle in the leaf
+		for (int i = node.first; i < node.first + node.count; ++i)
+		{
+			const Triangle& triangle = triangles_[i];
+			const Float4 e1x = splat(triangle.edge1[0]), e1y = splat(triangle.edge1[1]), e1z = splat(triangle.edge1[2]);
+			const Float4 e2x = splat(triangle.edge2[0]), e2y = splat(triangle.edge2[1]), e2z = splat(triangle.edge2[2]);
+
+			const Float4 px = packet.dirY * e2z - packet.dirZ * e2y;
+			const Float4 py = packet.dirZ * e2x - packet.dirX * e2z;
+			const Float4 pz = packet.dirX * e2y - packet.dirY * e2x;
+			const Float4 inverseDet = one / (e1x * px + e1y * py + e1z * pz);
+
+			const Float4 sx = packet.originX - splat(triangle.v0[0]);
+			const Float4 sy = packet.originY - splat(triangle.v0[1]);
+			const Float4 sz = packet.originZ - splat(triangle.v0[2]);
+			const Float4 u = (sx * px + sy * py + sz * pz) * inverseDet;
+
+			const Float4 qx = sy * e1z - sz * e1y;
+			const Float4 qy = sz * e1x - sx * e1z;
+			const Float4 qz = sx * e1y - sy * e1x;
+			const Float4 v = (packet.dirX * qx + packet.dirY * qy + packet.dirZ * qz) * inverseDet;
+			const Float4 t = (e2x * qx + e2y * qy + e2z * qz) * inverseDet;
+
+			// A parallel ray divides by zero, which fails every comparison
+			const Float4 hit = (u >= zero) & (v >= zero) & (u + v <= one) & (t > splat(epsilon)) & (t < packet.t);
+			const int mask = bits(hit);
+			if (mask == 0)
+			{
+				continue;
+			}
+
+			packet.t = select(hit, t, packet.t);
+			packet.hitU = select(hit, u, packet.hitU);
+			packet.hitV = select(hit, v, packet.hitV);
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				if (mask & (1 << lane))
+				{
+					packet.triangle[lane] = i;
+				}
+			}
+		}
+	}
+}
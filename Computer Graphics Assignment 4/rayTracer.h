@@ -0,0 +1,103 @@
+// Header file for the BVH ray tracer
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef RAY_TRACER_H
+#define RAY_TRACER_H
+
+#include <stdint.h>
+#include <vector>
+#include "scene.h"
+#include "softwareRenderer.h"
+#include "threadPool.h"
+
+// A camera described the same way as gluLookAt and gluPerspective
+struct RayCamera
+{
+	float eye[3];
+	float center[3];
+	float up[3];
+	float fovy;		// Degrees
+};
+
+// Ray traces scene parts on the CPU for reference-quality frames. The parts
+// are flattened into world space triangles and put into a bounding volume
+// hierarchy built with the surface area heuristic. Rays are traced in
+// packets of four (a 2x2 block of pixels) with SSE, and the image is split
+// into tiles that are traced in parallel.
+//
+// Shading matches the GL path: textures replace the colour, and there's no
+// lighting. Rays that hit nothing are black.
+class RayTracer
+{
+public:
+	struct Stats
+	{
+		int triangles = 0;
+		int nodes = 0;
+		int leaves = 0;
+		int maxDepth = 0;
+		double buildMs = 0.0;
+		long long rays = 0;	// From the last render()
+		double traceMs = 0.0;
+	};
+
+	explicit RayTracer(ThreadPool& pool);
+
+	void setTextures(const SoftwareTexture* textures, const int count);
+
+	// Rebuilds the hierarchy from scratch
+	void build(const std::vector<ScenePart>& parts);
+
+	// Traces a width x height image into pixels (RGBA8, bottom row first),
+	// firing samples x samples rays per pixel and averaging them
+	void render(const RayCamera& camera, const int width, const int height, const int samples, uint32_t* pixels);
+
+	const Stats& stats() const { return stats_; }
+
+	static const int TILE_SIZE = 16;
+
+private:
+	// Everything needed to intersect and shade one triangle
+	struct Triangle
+	{
+		float v0[3];
+		float edge1[3];		// v1 - v0
+		float edge2[3];		// v2 - v0
+		float u[3];			// Texture coordinates at each vertex
+		float v[3];
+		int texture;
+	};
+
+	// 32 bytes, so two nodes share a cache line. Interior nodes have a count
+	// of 0 and their children at first and first + 1. Leaves hold triangles
+	// [first, first + count). Leaves forced at the depth limit can hold any
+	// number of triangles, so count has all but the axis's two bits.
+	struct Node
+	{
+		float min[3];
+		int first;
+		float max[3];
+		uint32_t count : 30;
+		uint32_t axis : 2;	// Split axis, to visit the nearer child first
+	};
+
+	struct Packet;
+
+	int buildNode(const int node, const int begin, const int end, const int depth, std::vector<float>& centroids, std::vector<float>& bounds);
+	void traceTile(const int tile, const RayCamera& camera, const int width, const int height, const int samples, uint32_t* pixels);
+	void trace(Packet& packet) const;
+
+	ThreadPool& pool_;
+	const SoftwareTexture* textures_ = nullptr;
+	int textureCount_ = 0;
+
+	std::vector<Triangle> triangles_;	// Sorted so each leaf's are together
+	std::vector<Node> nodes_;
+	std::vector<int> order_;			// Scratch space for build()
+	std::vector<float3> world_;			// Scratch space for build(), one part's vertices
+	Stats stats_;
+};
+
+#endif // RAY_TRACER_H
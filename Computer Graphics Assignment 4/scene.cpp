@@ -0,0 +1,316 @@
+// Implementations for describing the scene independently of GL
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#include "scene.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <iostream>
+
+// Splits a quad into two triangles, keeping the quad's winding
+static void addQuad(std::vector<MeshVertex>& mesh, const MeshVertex& a, const MeshVertex& b, const MeshVertex& c, const MeshVertex& d)
+{
+	mesh.push_back(a); mesh.push_back(b); mesh.push_back(c);
+	mesh.push_back(a); mesh.push_back(c); mesh.push_back(d);
+}
+
+// The same faces, in the same order, as solidCube
+static std::vector<MeshVertex> buildCube()
+{
+	static const int faces[6][4] =
+	{
+	  {0, 1, 2, 3},
+	  {3, 2, 6, 7},
+	  {7, 6, 5, 4},
+	  {4, 5, 1, 0},
+	  {5, 6, 2, 1},
+	  {7, 4, 0, 3}
+	};
+	float v[8][3];
+	v[0][0] = v[1][0] = v[2][0] = v[3][0] = -0.5f;
+	v[4][0] = v[5][0] = v[6][0] = v[7][0] = 0.5f;
+	v[0][1] = v[1][1] = v[4][1] = v[5][1] = -0.5f;
+	v[2][1] = v[3][1] = v[6][1] = v[7][1] = 0.5f;
+	v[0][2] = v[3][2] = v[4][2] = v[7][2] = -0.5f;
+	v[1][2] = v[2][2] = v[5][2] = v[6][2] = 0.5f;
+
+	static const float uvs[4][2] = { {0, 0}, {0, 1}, {1, 1}, {1, 0} };
+
+	std::vector<MeshVertex> mesh;
+	for (int i = 5; i >= 0; i--)
+	{
+		MeshVertex corners[4];
+		for (int j = 0; j < 4; ++j)
+		{
+			const float* p = v[faces[i][j]];
+			corners[j] = { p[0], p[1], p[2], uvs[j][0], uvs[j][1] };
+		}
+		addQuad(mesh, corners[0], corners[1], corners[2], corners[3]);
+	}
+	return mesh;
+}
+
+// A latitude/longitude sphere with a diameter of 1
+static std::vector<MeshVertex> buildSphere()
+{
+	const int slices = 24;
+	const int stacks = 12;
+	const float pi = 3.14159265358979f;
+
+	std::vector<MeshVertex> mesh;
+	for (int i = 0; i < stacks; ++i)
+	{
+		for (int j = 0; j < slices; ++j)
+		{
+			MeshVertex corners[4];
+			for (int k = 0; k < 4; ++k)
+			{
+				const float u = (float)(j + (k == 1 || k == 2)) / slices;
+				const float v = (float)(i + (k >= 2)) / stacks;
+				const float theta = u * 2.0f * pi;
+				const float phi = v * pi;
+				corners[k] =
+				{
+					0.5f * sinf(phi) * cosf(theta),
+					-0.5f * cosf(phi),
+					0.5f * sinf(phi) * sinf(theta),
+					u, v
+				};
+			}
+			addQuad(mesh, corners[0], corners[3], corners[2], corners[1]);
+		}
+	}
+	return mesh;
+}
+
+// The ground quad, with corners in the order the ground used to be drawn
+static std::vector<MeshVertex> buildQuad()
+{
+	std::vector<MeshVertex> mesh;
+	addQuad
+	(
+		mesh,
+		{ 0.5f, 0, 0.5f, 0, 0 },
+		{ 0.5f, 0, -0.5f, 0, 1 },
+		{ -0.5f, 0, -0.5f, 1, 1 },
+		{ -0.5f, 0, 0.5f, 1, 0 }
+	);
+	return mesh;
+}
+
+const std::vector<MeshVertex>& primitiveMesh(const Primitive primitive)
+{
+	static const std::vector<MeshVertex> cube = buildCube();
+	static const std::vector<MeshVertex> sphere = buildSphere();
+	static const std::vector<MeshVertex> quad = buildQuad();
+
+	switch (primitive)
+	{
+	case Primitive::SPHERE:
+		return sphere;
+	case Primitive::QUAD:
+		return quad;
+	default:
+		return cube;
+	}
+}
+
+static std::vector<float3> meshPositions(const std::vector<MeshVertex>& mesh)
+{
+	std::vector<float3> positions;
+	positions.reserve(mesh.size());
+	for (const MeshVertex& vertex : mesh)
+	{
+		positions.push_back(float3(vertex.x, vertex.y, vertex.z));
+	}
+	return positions;
+}
+
+const std::vector<float3>& primitivePositions(const Primitive primitive)
+{
+	static const std::vector<float3> cube = meshPositions(primitiveMesh(Primitive::CUBE));
+	static const std::vector<float3> sphere = meshPositions(primitiveMesh(Primitive::SPHERE));
+	static const std::vector<float3> quad = meshPositions(primitiveMesh(Primitive::QUAD));
+
+	switch (primitive)
+	{
+	case Primitive::SPHERE:
+		return sphere;
+	case Primitive::QUAD:
+		return quad;
+	default:
+		return cube;
+	}
+}
+
+Frustum Frustum::fromMatrix(const mat4& viewProjection)
+{
+	// Each plane is the fourth row plus or minus one of the others
+	const float* m = viewProjection.m;
+	Frustum frustum;
+	for (int i = 0; i < 6; ++i)
+	{
+		const int row = i / 2;
+		const float sign = i % 2 == 0 ? 1.0f : -1.0f;
+		float* plane = frustum.planes[i];
+		plane[0] = m[3] + sign * m[row];
+		plane[1] = m[7] + sign * m[4 + row];
+		plane[2] = m[11] + sign * m[8 + row];
+		plane[3] = m[15] + sign * m[12 + row];
+
+		const float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		if (length > 0.0f)
+		{
+			for (int j = 0; j < 4; ++j)
+			{
+				plane[j] /= length;
+			}
+		}
+	}
+	return frustum;
+}
+
+bool Frustum::intersectsSphere(const float x, const float y, const float z, const float radius) const
+{
+	for (const float* plane : planes)
+	{
+		if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < -radius)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void partBounds(const ScenePart& part, float* center, float& radius)
+{
+	// Every primitive fits in the unit cube around the origin, so scale the
+	// cube's bounding sphere by the longest axis of the transform
+	const float* m = part.transform.m;
+	float longest = 0.0f;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const float* column = m + axis * 4;
+		longest = fmaxf(longest, column[0] * column[0] + column[1] * column[1] + column[2] * column[2]);
+	}
+
+	center[0] = m[12];
+	center[1] = m[13];
+	center[2] = m[14];
+	radius = sqrtf(longest) * 0.8660254f; // sqrt(3) / 2
+}
+
+// std::min() takes it by reference, so it needs a definition
+const int DrawLists::MAX_CAMERAS;
+
+void DrawLists::begin(const int threads, const Frustum* frustums, const int cameras)
+{
+	if ((int)threads_.size() < threads)
+	{
+		threads_.resize(threads);
+	}
+	threadCount_ = threads;
+	cameras_ = std::min(cameras, MAX_CAMERAS);
+	for (int i = 0; i < cameras_; ++i)
+	{
+		frustums_[i] = frustums[i];
+	}
+
+	// The old lists were in an arena that may have been reset since
+	for (FrameVector<DrawPacket>& list : lists_)
+	{
+		list = FrameVector<DrawPacket>();
+	}
+
+	for (int i = 0; i < threadCount_; ++i)
+	{
+		threads_[i].parts.clear();
+		for (std::vector<DrawPacket>& packets : threads_[i].packets)
+		{
+			packets.clear();
+		}
+	}
+}
+
+void DrawLists::cull(const int thread, const uint32_t model, const size_t firstPart)
+{
+	ThreadLists& lists = threads_[thread];
+
+	// A camera can't see more parts than there are, so sizing for all of
+	// them means the packets stop growing once the scene does, wherever
+	// the cameras look
+	for (int camera = 0; camera < cameras_; ++camera)
+	{
+		if (lists.packets[camera].capacity() < lists.parts.size())
+		{
+			lists.packets[camera].reserve(lists.parts.capacity());
+		}
+	}
+
+	// The model and the part's place in it share the low 48 bits of the
+	// sort key. Wrapping either would make keys collide, and the draw order
+	// change from frame to frame.
+	const uint32_t KEY_INDEX_LIMIT = 1 << 24;
+	if (model >= KEY_INDEX_LIMIT || lists.parts.size() - firstPart > KEY_INDEX_LIMIT)
+	{
+		std::cerr << "ERROR: draw lists can sort at most " << KEY_INDEX_LIMIT
+			<< " models of at most " << KEY_INDEX_LIMIT << " parts each!" << std::endl;
+		exit(13);
+	}
+
+	for (size_t i = firstPart; i < lists.parts.size(); ++i)
+	{
+		const ScenePart& part = lists.parts[i];
+		float center[3], radius;
+		partBounds(part, center, radius);
+
+		// Texture, primitive, model, then the part's place in its model
+		const uint64_t key =
+			(uint64_t)(part.texture & 0xff) << 56 |
+			(uint64_t)((int)part.primitive & 0xff) << 48 |
+			(uint64_t)model << 24 |
+			(uint64_t)(i - firstPart);
+
+		for (int camera = 0; camera < cameras_; ++camera)
+		{
+			if (frustums_[camera].intersectsSphere(center[0], center[1], center[2], radius))
+			{
+				lists.packets[camera].push_back({ key, (uint32_t)thread, (uint32_t)i });
+			}
+		}
+	}
+}
+
+void DrawLists::sort(const int camera)
+{
+	size_t count = 0;
+	for (int i = 0; i < threadCount_; ++i)
+	{
+		count += threads_[i].packets[camera].size();
+	}
+
+	FrameVector<DrawPacket> list;
+	list.reserve(count);
+	for (int i = 0; i < threadCount_; ++i)
+	{
+		const std::vector<DrawPacket>& packets = threads_[i].packets[camera];
+		list.insert(list.end(), packets.begin(), packets.end());
+	}
+
+	// Keys are unique, so the order doesn't depend on which thread found what
+	std::sort(list.begin(), list.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+	lists_[camera] = std::move(list);
+}
+
+size_t DrawLists::partCount() const
+{
+	size_t count = 0;
+	for (int i = 0; i < threadCount_; ++i)
+	{
+		count += threads_[i].parts.size();
+	}
+	return count;
+}
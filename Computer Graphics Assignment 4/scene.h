@@ -0,0 +1,134 @@
+// Header file for describing the scene independently of GL
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <stdint.h>
+#include <vector>
+#include "frameArena.h"
+#include "main.h"
+#include "vectorMath.h"
+
+// Texture slots, in the same order as textureNames in main.cpp
+enum TextureSlot
+{
+	TEXTURE_OAK_LOG = 0,
+	TEXTURE_OAK_LEAVES = 1,
+	TEXTURE_GRASS = 2,
+	TEXTURE_METAL = 3
+};
+
+// The shapes the scene is built from, each with a size of 1
+enum class Primitive
+{
+	CUBE,	// solidCube(1)
+	SPHERE,	// Unit diameter sphere
+	QUAD	// Unit square in the XZ plane, facing up
+};
+
+// One textured primitive placed in the world. Models describe themselves
+// as a list of these, so the same scene can be drawn by GL or by one of
+// the software renderers.
+struct ScenePart
+{
+	Primitive primitive;
+	int texture;		// TextureSlot
+	float uvScale;		// Texture coordinates are multiplied by this (so the ground can tile)
+	mat4 transform;		// Model space to world space
+};
+
+struct MeshVertex
+{
+	float x, y, z;
+	float u, v;
+};
+
+// Triangle list (three vertices per triangle) with the same positions and
+// texture coordinates GL is given when drawing the primitive
+const std::vector<MeshVertex>& primitiveMesh(const Primitive primitive);
+
+// Just the positions of the same vertices, for transforming in bulk
+const std::vector<float3>& primitivePositions(const Primitive primitive);
+
+// The six planes bounding what a camera can see, facing inwards
+struct Frustum
+{
+	float planes[6][4];	// (a, b, c, d) with a*x + b*y + c*z + d >= 0 inside
+
+	// Extracts the planes from projection * modelview
+	static Frustum fromMatrix(const mat4& viewProjection);
+
+	// Conservative: may keep spheres that are just outside a corner
+	bool intersectsSphere(const float x, const float y, const float z, const float radius) const;
+};
+
+// A sphere in world space that contains the whole part
+void partBounds(const ScenePart& part, float* center, float& radius);
+
+// A part one camera can see, found by traversal. Sorting on the key groups
+// the parts by texture, then primitive, and otherwise keeps them in model
+// order, whichever thread found them.
+struct DrawPacket
+{
+	uint64_t key;
+	uint32_t thread;	// Whose parts the part is in
+	uint32_t part;
+};
+
+// The parts each camera draws this frame. Traversal runs on several threads
+// at once, each writing parts and packets to arrays of its own, so it needs
+// no locks. Sorting then merges each camera's packets into one list, and
+// submission walks that list with nothing left to decide but GL state.
+class DrawLists
+{
+public:
+	static const int MAX_CAMERAS = 2;
+
+	// Empties the lists for a frame with up to threads traversal threads.
+	// Keeps their storage, so it doesn't allocate once the scene settles.
+	void begin(const int threads, const Frustum* frustums, const int cameras);
+
+	// Where a traversal thread collects its models' parts
+	std::vector<ScenePart>& threadParts(const int thread) { return threads_[thread].parts; }
+
+	// Culls the thread's parts from firstPart on, which all belong to model,
+	// against every camera, and adds packets for the ones each can see
+	void cull(const int thread, const uint32_t model, const size_t firstPart);
+
+	// Merges every thread's packets for the camera and sorts them. Different
+	// cameras can be sorted at the same time. The list is allocated from the
+	// frame's arena, so it lasts until the frame after next begins.
+	void sort(const int camera);
+
+	const FrameVector<DrawPacket>& list(const int camera) const { return lists_[camera]; }
+	const ScenePart& part(const DrawPacket& packet) const { return threads_[packet.thread].parts[packet.part]; }
+
+	// Parts traversal found, before culling
+	size_t partCount() const;
+
+private:
+	struct ThreadLists
+	{
+		std::vector<ScenePart> parts;
+		std::vector<DrawPacket> packets[MAX_CAMERAS];
+		char padding[64];	// Keeps threads from writing to the same cache line
+	};
+
+	std::vector<ThreadLists> threads_;
+	int threadCount_ = 0;
+	Frustum frustums_[MAX_CAMERAS];
+	int cameras_ = 0;
+	FrameVector<DrawPacket> lists_[MAX_CAMERAS];
+};
+
+// Draws parts with GL, binding textureIDs[part.texture] if textures are given
+void drawPart(const ScenePart& part, const GLuint* textureIDs, const bool wireframe);
+void drawParts(const std::vector<ScenePart>& parts, const GLuint* textureIDs, const bool wireframe);
+
+// Draws a camera's sorted list, counting the parts it culled
+void drawParts(const DrawLists& lists, const int camera, const GLuint* textureIDs, const bool wireframe);
+
+#endif // SCENE_H
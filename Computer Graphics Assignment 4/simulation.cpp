@@ -0,0 +1,316 @@
+// Implementations for the robot simulation
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#include "simulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include "trace.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double clockSeconds(const Clock::time_point time)
+{
+	return std::chrono::duration<double>(time.time_since_epoch()).count();
+}
+
+// std::min() takes it by reference, so it needs a definition
+const int Simulation::MAX_INTERVAL;
+
+Simulation::Simulation(std::vector<Robot*>& robots, std::vector<Animation*>& animations, const double stepSeconds)
+	: robots_(robots), animations_(animations), stepSeconds_(stepSeconds) {}
+
+void Simulation::start()
+{
+	if (threaded())
+	{
+		return;
+	}
+
+	// Rendering has something to draw before the first step
+	reserve();
+	handleInput();
+	publish(clockSeconds(Clock::now()));
+	snapshots_.acquire();
+
+	stopping_ = false;
+	thread_ = std::thread(&Simulation::threadLoop, this);
+}
+
+void Simulation::stop()
+{
+	if (!threaded())
+	{
+		return;
+	}
+
+	stopping_ = true;
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex_);
+		wake_.notify_one();
+	}
+	thread_.join();
+}
+
+bool Simulation::advance(const int steps)
+{
+	// Robots added since the last snapshot count as a change. Their spans
+	// are added here too, so stepping doesn't allocate.
+	const bool resized = snapshot().robots.size() != robots_.size();
+	reserve();
+	bool changed = handleInput() || resized;
+
+	if (animating_ && steps > 0)
+	{
+		for (int i = 0; i < steps; ++i)
+		{
+			step();
+		}
+		changed = true;
+	}
+
+	// This thread is the only consumer, so the new snapshot is current now.
+	// A new robot count means every copy has to grow, so fill all three
+	// here rather than allocating in each of the next steps.
+	if (changed)
+	{
+		for (int i = resized ? 3 : 1; i > 0; --i)
+		{
+			publish(0.0);
+			snapshots_.acquire();
+		}
+	}
+	return changed;
+}
+
+void Simulation::reserve()
+{
+	spans_.resize(robots_.size());
+	updated_.reserve(robots_.size());
+	if (limbs_ != nullptr)
+	{
+		limbs_->reserve(robots_.size());
+	}
+}
+
+bool Simulation::send(const SimInput& input)
+{
+	if (!input_.push(input))
+	{
+		return false;
+	}
+
+	// Pairs with the fence in threadLoop(): either the thread sees this
+	// input before it sleeps, or we see that it's asleep and wake it
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (sleeping_.load(std::memory_order_relaxed))
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex_);
+		wake_.notify_one();
+	}
+	return true;
+}
+
+bool Simulation::handleInput()
+{
+	bool changed = false;
+	SimInput input;
+	while (input_.pop(input))
+	{
+		switch (input.type)
+		{
+		case SimInput::SET_ANIMATING:
+			changed = changed || animating_ != (input.value != 0);
+			animating_ = input.value != 0;
+			break;
+		}
+	}
+	return changed;
+}
+
+int Simulation::updateInterval(const Robot& robot, const SimViews& views, bool& visible) const
+{
+	visible = true;
+	if (views.count == 0)
+	{
+		return 1;
+	}
+
+	// Roughly the robot's bounding sphere, and the largest share of any
+	// view's height it takes up
+	const float3 center = robot.getPos() + float3(0, 2.5f, 0);
+	const float radius = 2.5f;
+	float size = 0.0f;
+	visible = false;
+	for (int i = 0; i < views.count; ++i)
+	{
+		if (views.frustums[i].intersectsSphere(center.x, center.y, center.z, radius))
+		{
+			const float distance = std::max((center - views.eyes[i]).length(), radius);
+			size = std::max(size, radius / (distance * views.tanHalfFov));
+			visible = true;
+		}
+	}
+	if (!visible)
+	{
+		return MAX_INTERVAL;
+	}
+
+	// Every step down to a tenth of the view, then half as often each time
+	// it halves again
+	int interval = 1;
+	for (float fullRate = 0.1f; size < fullRate && interval < MAX_INTERVAL; fullRate *= 0.5f)
+	{
+		interval *= 2;
+	}
+	return std::min(interval << lodBias_, MAX_INTERVAL);
+}
+
+void Simulation::step()
+{
+	TRACE_SCOPE("simulation step");
+	const Clock::time_point start = Clock::now();
+
+	// Scripts first, so robots are posed for whatever they've just started
+	if (scheduler_ != nullptr)
+	{
+		scheduler_->tick();
+	}
+
+	views_.acquire();
+	const SimViews& views = views_.front();
+	robotsVisible_ = 0;
+	robotsUpdated_ = 0;
+	updated_.clear();
+	for (size_t i = 0; i < robots_.size(); ++i)
+	{
+		bool visible;
+		const int interval = updateInterval(*robots_[i], views, visible);
+		robotsVisible_ += visible ? 1 : 0;
+
+		// Between updates, frames only need to know how far along it is
+		RobotSpan& span = spans_[i];
+		if (++span.done < span.interval)
+		{
+			robots_[i]->setUpdateSpan(span.done, span.interval);
+			continue;
+		}
+
+		// The next update lands on a step of the robot's own, so robots
+		// with the same interval take turns. A robot moving to a finer
+		// level waits for the end of its span first.
+		span.interval = interval - (int)((steps_ + i) % interval);
+		span.done = 0;
+		++robotsUpdated_;
+		updated_.push_back((uint32_t)i);
+
+		// Keep the pose from before the step so frames can blend from it. A
+		// walk that starts over has nothing to blend from. Scripted robots
+		// are posed where their plan has them at the end of the span.
+		robots_[i]->savePose();
+		if (rigs_ != nullptr)
+		{
+			(*rigs_)[i]->animate(scheduler_->now() + span.interval - 1, span.interval);
+		}
+		else
+		{
+			animations_[i]->animate(span.interval);
+			if (animations_[i]->restarted())
+			{
+				robots_[i]->savePose();
+			}
+		}
+		robots_[i]->setUpdateSpan(0, span.interval);
+	}
+
+	// Then hands and feet, on top of whatever the robots were posed with
+	if (limbs_ != nullptr)
+	{
+		limbs_->solve(robots_, updated_.data(), updated_.size());
+	}
+
+	++steps_;
+	animationMs_ = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	// Make robots coarser while the budget is blown, and finer once well under
+	if (budgetMs_ > 0.0)
+	{
+		if (animationMs_ > budgetMs_ && (1 << lodBias_) < MAX_INTERVAL)
+		{
+			++lodBias_;
+		}
+		else if (animationMs_ < budgetMs_ * 0.5 && lodBias_ > 0)
+		{
+			--lodBias_;
+		}
+	}
+}
+
+void Simulation::publish(const double time)
+{
+	// Copying over the snapshot from two publishes ago reuses its storage,
+	// so once the robot count settles this doesn't allocate
+	SimSnapshot& snapshot = snapshots_.back();
+	snapshot.robots.resize(robots_.size());
+	for (size_t i = 0; i < robots_.size(); ++i)
+	{
+		snapshot.robots[i] = *robots_[i];
+	}
+	snapshot.step = steps_;
+	snapshot.time = time;
+	snapshot.animationMs = animationMs_;
+	snapshot.robotsVisible = robotsVisible_;
+	snapshot.robotsUpdated = robotsUpdated_;
+	snapshot.animating = animating_;
+	snapshots_.publish();
+}
+
+void Simulation::threadLoop()
+{
+	TRACE_THREAD_NAME("simulation");
+
+	// If steps take longer than they simulate, start again from now rather
+	// than running further and further behind
+	const int MAX_STEPS_BEHIND = 5;
+	const Clock::duration interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(stepSeconds_));
+	Clock::time_point due = Clock::now();
+
+	while (!stopping_)
+	{
+		const bool changed = handleInput();
+
+		if (animating_)
+		{
+			std::this_thread::sleep_until(due);
+			step();
+			publish(clockSeconds(due));
+
+			due += interval;
+			if (Clock::now() - due > interval * MAX_STEPS_BEHIND)
+			{
+				due = Clock::now();
+			}
+			continue;
+		}
+
+		// Stopped, so show where the robots stopped and sleep until there's
+		// more input
+		if (changed)
+		{
+			publish(clockSeconds(Clock::now()));
+		}
+
+		sleeping_.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		{
+			std::unique_lock<std::mutex> lock(sleepMutex_);
+			wake_.wait(lock, [this] { return stopping_ || !input_.empty(); });
+		}
+		sleeping_.store(false, std::memory_order_relaxed);
+
+		// The time spent asleep isn't simulated
+		due = Clock::now();
+	}
+}
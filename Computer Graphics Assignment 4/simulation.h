@@ -0,0 +1,265 @@
+// Header file for the robot simulation and how it hands poses to rendering
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "animation.h"
+#include "behaviour.h"
+#include "limbSolver.h"
+
+// A fixed-size ring for passing values from one thread to one other thread
+// without locks. Each index is only ever written by one side.
+template <typename T, size_t CAPACITY>
+class SpscQueue
+{
+	static_assert((CAPACITY & (CAPACITY - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+	// Producer only. Returns false if the ring is full.
+	bool push(const T& item)
+	{
+		const size_t tail = tail_.load(std::memory_order_relaxed);
+		if (tail - head_.load(std::memory_order_acquire) == CAPACITY)
+		{
+			return false;
+		}
+		items_[tail & (CAPACITY - 1)] = item;
+		tail_.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only. Returns false if the ring is empty.
+	bool pop(T& item)
+	{
+		const size_t head = head_.load(std::memory_order_relaxed);
+		if (head == tail_.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		item = items_[head & (CAPACITY - 1)];
+		head_.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool empty() const
+	{
+		return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+	}
+
+private:
+	T items_[CAPACITY];
+	alignas(64) std::atomic<size_t> head_{ 0 };	// Next to pop, written by the consumer
+	alignas(64) std::atomic<size_t> tail_{ 0 };	// Next to push, written by the producer
+};
+
+// Three copies of a value: one the producer is writing, one the consumer is
+// reading, and the newest finished one between them. Publishing and taking
+// the newest are a single atomic exchange each, so neither side ever waits
+// for the other, and the consumer always gets a complete value.
+template <typename T>
+class TripleBuffer
+{
+public:
+	// Producer only. The copy to fill in, which still holds whatever was
+	// published two times ago.
+	T& back() { return buffers_[back_]; }
+
+	// Producer only. Makes the back copy the newest.
+	void publish()
+	{
+		back_ = middle_.exchange((uint8_t)(back_ | FRESH), std::memory_order_acq_rel) & INDEX;
+	}
+
+	// Consumer only. Takes the newest copy if one was published since the
+	// last call, and returns whether it did.
+	bool acquire()
+	{
+		if ((middle_.load(std::memory_order_relaxed) & FRESH) == 0)
+		{
+			return false;
+		}
+		front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+
+	// Consumer only
+	const T& front() const { return buffers_[front_]; }
+
+private:
+	static const uint8_t INDEX = 3;
+	static const uint8_t FRESH = 4;
+
+	T buffers_[3];
+	std::atomic<uint8_t> middle_{ 1 };	// Index, and whether it's newer than front_
+	uint8_t back_ = 0;
+	uint8_t front_ = 2;
+};
+
+// The robots' poses after one animation step. Each robot still has the pose
+// from before the step saved, so frames can blend between the two.
+struct SimSnapshot
+{
+	std::vector<Robot> robots;
+	uint64_t step = 0;			// Steps simulated so far
+	double time = 0.0;			// When the step was due, when on a thread
+	double animationMs = 0.0;	// What the last step cost
+	int robotsVisible = 0;		// To any camera, at the last step
+	int robotsUpdated = 0;		// Animated in the last step, rather than left between updates
+	bool animating = false;
+};
+
+// Where the cameras were and what they could see at the last frame, so the
+// simulation can animate robots that look small less often
+struct SimViews
+{
+	static const int MAX_VIEWS = 2;
+
+	Frustum frustums[MAX_VIEWS];
+	float3 eyes[MAX_VIEWS];
+	float tanHalfFov = 0.0f;	// Of the vertical field of view, which they all share
+	int count = 0;				// Until there are any, every robot is animated every step
+};
+
+// Input for the simulation
+struct SimInput
+{
+	enum Type : uint8_t
+	{
+		SET_ANIMATING		// value is 1 to walk, 0 to stop
+	};
+
+	Type type;
+	int value;
+};
+
+// Steps the robots' walks and publishes a snapshot after each step. It can
+// run on its own thread, pacing itself, or be advanced by hand, which keeps
+// headless runs and benchmarks deterministic. Either way input goes in
+// through send() and poses come out through acquire() and snapshot().
+class Simulation
+{
+public:
+	static const size_t INPUT_CAPACITY = 64;
+
+	// The robots and their animations are stepped in place, so nothing
+	// else may touch them once the thread has started
+	Simulation(std::vector<Robot*>& robots, std::vector<Animation*>& animations, const double stepSeconds);
+	~Simulation() { stop(); }
+
+	void setAnimating(const bool animating) { animating_ = animating; }
+
+	// Robots that look small from every camera are only animated every 2nd,
+	// 4th or 8th step, posed that many steps ahead each time, with frames
+	// blending across the gap. Robots no camera can see are animated every
+	// 8th. Each robot takes its turn on a different step, so every step
+	// costs about the same. With a budget, robots are moved to coarser
+	// levels while a step costs more than budgetMs, and back once it costs
+	// under half that. Without one (0) the levels only depend on the views,
+	// which keeps headless runs deterministic.
+	void setAnimationBudget(const double budgetMs) { budgetMs_ = budgetMs; }
+
+	// Scripted robots: rigs[i] poses robots[i] from its agent's plan instead
+	// of animations[i]. The scheduler resumes the scripts once a step, before
+	// any robot is posed. Like the robots, neither may be touched once the
+	// thread has started.
+	void setBehaviours(BehaviourScheduler& scheduler, std::vector<AgentRig*>& rigs)
+	{
+		scheduler_ = &scheduler;
+		rigs_ = &rigs;
+	}
+
+	// Robots' hands and feet are placed by solver after every step, for
+	// just the robots that step posed. It's the simulation's to use from
+	// then on, like the robots.
+	void setLimbSolver(LimbSolver& solver) { limbs_ = &solver; }
+
+	// From the one thread that renders, each frame
+	void setViews(const SimViews& views)
+	{
+		views_.back() = views;
+		views_.publish();
+	}
+
+	// Publishes the current poses and starts stepping on a thread of its
+	// own. Snapshot times are steady_clock seconds since its epoch.
+	void start();
+	void stop();
+	bool threaded() const { return thread_.joinable(); }
+
+	// Without a thread: handles any input, then runs steps animation steps.
+	// Returns whether that changed the snapshot, which is then current.
+	bool advance(const int steps);
+
+	// From the one thread that handles input. Returns false if the
+	// simulation is too far behind to take it.
+	bool send(const SimInput& input);
+
+	// From the one thread that renders. Takes the newest snapshot if there's
+	// one since the last call, and returns whether there was.
+	bool acquire() { return snapshots_.acquire(); }
+	const SimSnapshot& snapshot() const { return snapshots_.front(); }
+
+private:
+	// Returns whether any input changed the simulation
+	bool handleInput();
+	void step();
+
+	// Sizes everything a step uses for the robots there are now, so
+	// stepping doesn't allocate
+	void reserve();
+	void publish(const double time);
+	void threadLoop();
+
+	// How often robot needs animating, in steps, and whether any camera
+	// can see it
+	int updateInterval(const Robot& robot, const SimViews& views, bool& visible) const;
+
+	// Where each robot is in its current update span
+	struct RobotSpan
+	{
+		int interval = 1;
+		int done = 0;
+	};
+
+	static const int MAX_INTERVAL = 8;
+
+	std::vector<Robot*>& robots_;
+	std::vector<Animation*>& animations_;
+	BehaviourScheduler* scheduler_ = nullptr;
+	std::vector<AgentRig*>* rigs_ = nullptr;
+	LimbSolver* limbs_ = nullptr;
+	const double stepSeconds_;
+	bool animating_ = true;
+	uint64_t steps_ = 0;
+	double animationMs_ = 0.0;
+	std::vector<RobotSpan> spans_;
+	std::vector<uint32_t> updated_;	// Robots posed in the current step
+	int lodBias_ = 0;			// Every interval is doubled this many times
+	double budgetMs_ = 0.0;
+	int robotsVisible_ = 0;
+	int robotsUpdated_ = 0;
+
+	TripleBuffer<SimSnapshot> snapshots_;
+	TripleBuffer<SimViews> views_;
+	SpscQueue<SimInput, INPUT_CAPACITY> input_;
+
+	// The thread sleeps here while nothing is animating, so an idle scene
+	// costs nothing. Only sleeping and waking take the lock.
+	std::thread thread_;
+	std::mutex sleepMutex_;
+	std::condition_variable wake_;
+	std::atomic<bool> sleeping_{ false };
+	std::atomic<bool> stopping_{ false };
+};
+
+#endif // SIMULATION_H
@@ -0,0 +1,573 @@
+// Implementations for the multithreaded tile-based software rasterizer
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#include "softwareRenderer.h"
+#include "texture.h"
+
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <FreeImage/FreeImage.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define RASTER_SSE
+#include <emmintrin.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisecondsSince(const Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static uint32_t packColor(const float r, const float g, const float b)
+{
+	return (uint32_t)(r * 255.0f + 0.5f)
+		| (uint32_t)(g * 255.0f + 0.5f) << 8
+		| (uint32_t)(b * 255.0f + 0.5f) << 16
+		| 0xFF000000u;
+}
+
+// Blends two packed RGBA8 colours with an 8 bit weight, two channels at a time
+static uint32_t lerpColor(const uint32_t a, const uint32_t b, const uint32_t weight)
+{
+	const uint32_t rb = ((a & 0x00FF00FFu) * (256 - weight) + (b & 0x00FF00FFu) * weight) >> 8;
+	const uint32_t ga = (((a >> 8) & 0x00FF00FFu) * (256 - weight) + ((b >> 8) & 0x00FF00FFu) * weight) >> 8;
+	return (rb & 0x00FF00FFu) | ((ga & 0x00FF00FFu) << 8);
+}
+
+int loadSoftwareTexture(const char* filename, SoftwareTexture& texture)
+{
+	DecodedImage image;
+	int error = decodeImage(filename, image);
+	if (error != 0)
+	{
+		return error;
+	}
+
+	texture.width = image.width;
+	texture.height = image.height;
+	texture.texels.resize((size_t)image.width * image.height);
+	convertPixels
+	(
+		image.bits, image.pitch, image.sourceLayout,
+		(uint8_t*)texture.texels.data(), image.width * 4, PixelLayout::RGBA8,
+		image.width, image.height, image.palette
+	);
+	releaseImage(image);
+	return 0;
+}
+
+// Bilinear filtering with repeat wrapping, GL's defaults for our textures
+uint32_t sampleTexture(const SoftwareTexture& image, const float u, const float v)
+{
+	if (image.texels.empty())
+	{
+		return 0xFFFFFFFFu;
+	}
+
+	const float fx = u * image.width - 0.5f;
+	const float fy = v * image.height - 0.5f;
+	const float floorX = floorf(fx), floorY = floorf(fy);
+	const uint32_t ax = (uint32_t)((fx - floorX) * 256.0f);
+	const uint32_t ay = (uint32_t)((fy - floorY) * 256.0f);
+
+	// Only wrap when we have to, since the division is most of the cost
+	int x0 = (int)floorX, y0 = (int)floorY;
+	if ((unsigned int)x0 >= (unsigned int)image.width)
+	{
+		x0 %= image.width;
+		if (x0 < 0) x0 += image.width;
+	}
+	if ((unsigned int)y0 >= (unsigned int)image.height)
+	{
+		y0 %= image.height;
+		if (y0 < 0) y0 += image.height;
+	}
+	const int x1 = x0 + 1 == image.width ? 0 : x0 + 1;
+	const uint32_t* row0 = image.texels.data() + (size_t)y0 * image.width;
+	const uint32_t* row1 = image.texels.data() + (size_t)(y0 + 1 == image.height ? 0 : y0 + 1) * image.width;
+
+	return lerpColor(lerpColor(row0[x0], row0[x1], ax), lerpColor(row1[x0], row1[x1], ax), ay);
+}
+
+bool saveFramebuffer(const std::string& filename, const uint32_t* pixels, const int width, const int height)
+{
+	FREE_IMAGE_FORMAT format = FreeImage_GetFIFFromFilename(filename.c_str());
+	if (format == FIF_UNKNOWN)
+	{
+		std::cerr << "Unknown file format for " << filename << std::endl;
+		return false;
+	}
+
+	// Both are bottom-up, so it's a straight conversion
+	FIBITMAP* bitmap = FreeImage_Allocate(width, height, 24);
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+	const PixelLayout layout = PixelLayout::BGR8;
+#else
+	const PixelLayout layout = PixelLayout::RGB8;
+#endif
+	convertPixels
+	(
+		(const uint8_t*)pixels, width * 4, PixelLayout::RGBA8,
+		FreeImage_GetBits(bitmap), FreeImage_GetPitch(bitmap), layout,
+		width, height
+	);
+
+	const bool saved = FreeImage_Save(format, bitmap, filename.c_str(), 0) != 0;
+	FreeImage_Unload(bitmap);
+	if (!saved)
+	{
+		std::cerr << "Failed to save frame to " << filename << std::endl;
+	}
+	return saved;
+}
+
+SoftwareRenderer::SoftwareRenderer(const int width, const int height, ThreadPool& pool)
+	: width_(width), height_(height),
+	tilesX_((width + TILE_SIZE - 1) / TILE_SIZE), tilesY_((height + TILE_SIZE - 1) / TILE_SIZE),
+	pool_(pool), pixels_((size_t)width * height, 0xFF000000u), tileFragments_(tilesX_ * tilesY_)
+{
+}
+
+void SoftwareRenderer::setTextures(const SoftwareTexture* textures, const int count)
+{
+	textures_ = textures;
+	textureCount_ = count;
+}
+
+void SoftwareRenderer::fillRect(const int x, const int y, const int width, const int height, const float r, const float g, const float b)
+{
+	const uint32_t color = packColor(r, g, b);
+	const int x0 = std::max(x, 0), x1 = std::min(x + width, width_);
+	const int y0 = std::max(y, 0), y1 = std::min(y + height, height_);
+
+	for (int row = y0; row < y1; ++row)
+	{
+		std::fill(pixels_.begin() + (size_t)row * width_ + x0, pixels_.begin() + (size_t)row * width_ + x1, color);
+	}
+}
+
+void SoftwareRenderer::drawParts
+(
+	const std::vector<ScenePart>& parts,
+	const mat4& view,
+	const mat4& projection,
+	const int viewportX,
+	const int viewportY,
+	const int viewportWidth,
+	const int viewportHeight
+)
+{
+	stats_ = Stats();
+	viewport_[0] = viewportX;
+	viewport_[1] = viewportY;
+	viewport_[2] = viewportWidth;
+	viewport_[3] = viewportHeight;
+
+	const mat4 viewProjection = projection * view;
+	const int tileCount = tilesX_ * tilesY_;
+
+	// Phase one: transform, clip, set up and bin. A few chunks per thread
+	// keeps the load even without making the bins too fragmented.
+	Clock::time_point start = Clock::now();
+	const int chunkCount = std::max(1, std::min((int)parts.size(), pool_.size() * 4));
+	if ((int)chunks_.size() < chunkCount)
+	{
+		chunks_.resize(chunkCount);
+	}
+	activeChunks_ = chunkCount;
+
+	pool_.parallelFor(chunkCount, [&](int index, int /*thread*/)
+	{
+		Chunk& chunk = chunks_[index];
+		chunk.triangles.clear();
+		chunk.bins.resize(tileCount);
+		for (std::vector<uint32_t>& bin : chunk.bins)
+		{
+			bin.clear();
+		}
+
+		const size_t begin = parts.size() * index / chunkCount;
+		const size_t end = parts.size() * (index + 1) / chunkCount;
+		for (size_t i = begin; i < end; ++i)
+		{
+			setupPart(parts[i], viewProjection, chunk);
+		}
+	});
+	stats_.setupMs = millisecondsSince(start);
+
+	// Phase two: shade every tile
+	start = Clock::now();
+	pool_.parallelFor(tileCount, [&](int tile, int /*thread*/)
+	{
+		rasterTile(tile);
+	});
+	stats_.rasterMs = millisecondsSince(start);
+
+	for (int i = 0; i < chunkCount; ++i)
+	{
+		stats_.triangles += (int)chunks_[i].triangles.size();
+		for (const std::vector<uint32_t>& bin : chunks_[i].bins)
+		{
+			stats_.binEntries += (int)bin.size();
+		}
+	}
+	for (long long fragments : tileFragments_)
+	{
+		stats_.fragments += fragments;
+	}
+}
+
+void SoftwareRenderer::setupPart(const ScenePart& part, const mat4& viewProjection, Chunk& chunk)
+{
+	const mat4 mvp = viewProjection * part.transform;
+	const std::vector<MeshVertex>& mesh = primitiveMesh(part.primitive);
+
+	for (size_t i = 0; i + 2 < mesh.size(); i += 3)
+	{
+		// Clip space position followed by the texture coordinates
+		float clip[3][6];
+		for (int k = 0; k < 3; ++k)
+		{
+			const MeshVertex& vertex = mesh[i + k];
+			mvp.transform(vertex.x, vertex.y, vertex.z, 1.0f, clip[k]);
+			clip[k][4] = vertex.u * part.uvScale;
+			clip[k][5] = vertex.v * part.uvScale;
+		}
+
+		// Throw away triangles entirely outside one of the side planes
+		bool outside = false;
+		for (int axis = 0; axis < 3 && !outside; ++axis)
+		{
+			outside = (clip[0][axis] > clip[0][3] && clip[1][axis] > clip[1][3] && clip[2][axis] > clip[2][3])
+				|| (clip[0][axis] < -clip[0][3] && clip[1][axis] < -clip[1][3] && clip[2][axis] < -clip[2][3]);
+		}
+		if (outside)
+		{
+			continue;
+		}
+
+		// Clip against the near plane (z >= -w), which can make a quad
+		float distance[3];
+		int inside = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			distance[k] = clip[k][2] + clip[k][3];
+			inside += distance[k] >= 0.0f;
+		}
+
+		if (inside == 3)
+		{
+			setupTriangle(clip, part.texture, chunk);
+			continue;
+		}
+
+		float polygon[4][6];
+		int count = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			const int next = (k + 1) % 3;
+			if (distance[k] >= 0.0f)
+			{
+				std::copy(clip[k], clip[k] + 6, polygon[count++]);
+			}
+			if ((distance[k] >= 0.0f) != (distance[next] >= 0.0f))
+			{
+				const float t = distance[k] / (distance[k] - distance[next]);
+				for (int c = 0; c < 6; ++c)
+				{
+					polygon[count][c] = clip[k][c] + t * (clip[next][c] - clip[k][c]);
+				}
+				++count;
+			}
+		}
+
+		for (int k = 1; k + 1 < count; ++k)
+		{
+			float fan[3][6];
+			std::copy(polygon[0], polygon[0] + 6, fan[0]);
+			std::copy(polygon[k], polygon[k] + 6, fan[1]);
+			std::copy(polygon[k + 1], polygon[k + 1] + 6, fan[2]);
+			setupTriangle(fan, part.texture, chunk);
+		}
+	}
+}
+
+void SoftwareRenderer::setupTriangle(const float clip[3][6], const int texture, Chunk& chunk)
+{
+	const float vx = (float)viewport_[0], vy = (float)viewport_[1];
+	const float vw = (float)viewport_[2], vh = (float)viewport_[3];
+
+	// To window space
+	float sx[3], sy[3];
+	Triangle triangle;
+	for (int k = 0; k < 3; ++k)
+	{
+		const float invW = 1.0f / clip[k][3];
+		sx[k] = vx + (clip[k][0] * invW * 0.5f + 0.5f) * vw;
+		sy[k] = vy + (clip[k][1] * invW * 0.5f + 0.5f) * vh;
+		triangle.z[k] = clip[k][2] * invW * 0.5f + 0.5f;
+		triangle.invW[k] = invW;
+		triangle.uOverW[k] = clip[k][4] * invW;
+		triangle.vOverW[k] = clip[k][5] * invW;
+	}
+
+	float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+	if (fabsf(area) < 1e-8f)
+	{
+		return;
+	}
+
+	// Nothing is culled, so make every triangle counter-clockwise
+	if (area < 0.0f)
+	{
+		std::swap(sx[1], sx[2]);
+		std::swap(sy[1], sy[2]);
+		std::swap(triangle.z[1], triangle.z[2]);
+		std::swap(triangle.invW[1], triangle.invW[2]);
+		std::swap(triangle.uOverW[1], triangle.uOverW[2]);
+		std::swap(triangle.vOverW[1], triangle.vOverW[2]);
+		area = -area;
+	}
+
+	// Edge i is opposite vertex i, and is scaled so it gives vertex i's weight
+	for (int i = 0; i < 3; ++i)
+	{
+		const int a = (i + 1) % 3, b = (i + 2) % 3;
+		const float dx = sx[b] - sx[a];
+		const float dy = sy[b] - sy[a];
+		triangle.edgeA[i] = -dy / area;
+		triangle.edgeB[i] = dx / area;
+		triangle.edgeC[i] = (dy * sx[a] - dx * sy[a]) / area;
+
+		// Pixels exactly on an edge belong to the triangle on its top or left
+		triangle.topLeft[i] = dy < 0.0f || (dy == 0.0f && dx < 0.0f);
+	}
+
+	// Bounds, clamped to the viewport and the framebuffer
+	const int viewMaxX = std::min(viewport_[0] + viewport_[2], width_) - 1;
+	const int viewMaxY = std::min(viewport_[1] + viewport_[3], height_) - 1;
+	triangle.minX = std::max((int)floorf(std::min(sx[0], std::min(sx[1], sx[2]))), std::max(viewport_[0], 0));
+	triangle.minY = std::max((int)floorf(std::min(sy[0], std::min(sy[1], sy[2]))), std::max(viewport_[1], 0));
+	triangle.maxX = std::min((int)ceilf(std::max(sx[0], std::max(sx[1], sx[2]))), viewMaxX);
+	triangle.maxY = std::min((int)ceilf(std::max(sy[0], std::max(sy[1], sy[2]))), viewMaxY);
+	triangle.texture = texture;
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+	{
+		return;
+	}
+
+	const uint32_t index = (uint32_t)chunk.triangles.size();
+	chunk.triangles.push_back(triangle);
+
+	// Bin into every tile the triangle might touch, skipping tiles that are
+	// entirely outside one of the edges
+	for (int ty = triangle.minY / TILE_SIZE; ty <= triangle.maxY / TILE_SIZE; ++ty)
+	{
+		for (int tx = triangle.minX / TILE_SIZE; tx <= triangle.maxX / TILE_SIZE; ++tx)
+		{
+			bool overlaps = true;
+			for (int i = 0; i < 3 && overlaps; ++i)
+			{
+				const float x = (triangle.edgeA[i] >= 0.0f ? (tx + 1) * TILE_SIZE - 0.5f : tx * TILE_SIZE + 0.5f);
+				const float y = (triangle.edgeB[i] >= 0.0f ? (ty + 1) * TILE_SIZE - 0.5f : ty * TILE_SIZE + 0.5f);
+				overlaps = triangle.edgeA[i] * x + triangle.edgeB[i] * y + triangle.edgeC[i] >= 0.0f;
+			}
+
+			if (overlaps)
+			{
+				chunk.bins[ty * tilesX_ + tx].push_back(index);
+			}
+		}
+	}
+}
+
+void SoftwareRenderer::rasterTile(const int tile)
+{
+	const int tileX = (tile % tilesX_) * TILE_SIZE;
+	const int tileY = (tile / tilesX_) * TILE_SIZE;
+	const int x0 = std::max(tileX, viewport_[0]);
+	const int y0 = std::max(tileY, viewport_[1]);
+	const int x1 = std::min(std::min(tileX + TILE_SIZE, viewport_[0] + viewport_[2]), width_) - 1;
+	const int y1 = std::min(std::min(tileY + TILE_SIZE, viewport_[1] + viewport_[3]), height_) - 1;
+
+	tileFragments_[tile] = 0;
+	if (x0 > x1 || y0 > y1)
+	{
+		return;
+	}
+
+	// The tile's depth buffer, cleared to the far plane. The padding lets
+	// the last four pixel block of the last row load past the end.
+	float depth[TILE_SIZE * TILE_SIZE + 4];
+	std::fill(depth, depth + TILE_SIZE * TILE_SIZE + 4, 1.0f);
+
+	for (int i = 0; i < activeChunks_; ++i)
+	{
+		const Chunk& chunk = chunks_[i];
+		for (uint32_t index : chunk.bins[tile])
+		{
+			const Triangle& triangle = chunk.triangles[index];
+			rasterTriangle
+			(
+				triangle,
+				std::max(x0, triangle.minX), std::max(y0, triangle.minY),
+				std::min(x1, triangle.maxX), std::min(y1, triangle.maxY),
+				depth, tileX, tileY
+			);
+		}
+	}
+}
+
+void SoftwareRenderer::rasterTriangle
+(
+	const Triangle& triangle,
+	const int x0,
+	const int y0,
+	const int x1,
+	const int y1,
+	float* depth,
+	const int tileX,
+	const int tileY
+)
+{
+	long long fragments = 0;
+
+#ifdef RASTER_SSE
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 lastX = _mm_set1_ps((float)x1 + 1.0f);
+	__m128 edgeA[3], topLeft[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		edgeA[i] = _mm_set1_ps(triangle.edgeA[i]);
+		topLeft[i] = _mm_castsi128_ps(_mm_set1_epi32(triangle.topLeft[i] ? -1 : 0));
+	}
+
+	for (int y = y0; y <= y1; ++y)
+	{
+		const float py = y + 0.5f;
+		float* depthRow = depth + (y - tileY) * TILE_SIZE - tileX;
+		uint32_t* colorRow = pixels_.data() + (size_t)y * width_;
+
+		for (int x = x0; x <= x1; x += 4)
+		{
+			const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+
+			// Barycentric weights for four pixels at once
+			__m128 weight[3];
+			__m128 covered = _mm_cmplt_ps(px, lastX);
+			for (int i = 0; i < 3; ++i)
+			{
+				weight[i] = _mm_add_ps(_mm_mul_ps(edgeA[i], px), _mm_set1_ps(triangle.edgeB[i] * py + triangle.edgeC[i]));
+				const __m128 inside = _mm_or_ps(_mm_cmpgt_ps(weight[i], zero), _mm_and_ps(_mm_cmpeq_ps(weight[i], zero), topLeft[i]));
+				covered = _mm_and_ps(covered, inside);
+			}
+			if (_mm_movemask_ps(covered) == 0)
+			{
+				continue;
+			}
+
+			// Depth test
+			const __m128 z = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(weight[0], _mm_set1_ps(triangle.z[0])),
+				_mm_mul_ps(weight[1], _mm_set1_ps(triangle.z[1]))),
+				_mm_mul_ps(weight[2], _mm_set1_ps(triangle.z[2])));
+			const __m128 oldDepth = _mm_loadu_ps(depthRow + x);
+			const __m128 pass = _mm_and_ps(covered, _mm_cmplt_ps(z, oldDepth));
+			const int passMask = _mm_movemask_ps(pass);
+			if (passMask == 0)
+			{
+				continue;
+			}
+			_mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, oldDepth)));
+
+			// Perspective correct texture coordinates
+			const __m128 invW = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(weight[0], _mm_set1_ps(triangle.invW[0])),
+				_mm_mul_ps(weight[1], _mm_set1_ps(triangle.invW[1]))),
+				_mm_mul_ps(weight[2], _mm_set1_ps(triangle.invW[2])));
+			const __m128 w = _mm_div_ps(_mm_set1_ps(1.0f), invW);
+			const __m128 u = _mm_mul_ps(w, _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(weight[0], _mm_set1_ps(triangle.uOverW[0])),
+				_mm_mul_ps(weight[1], _mm_set1_ps(triangle.uOverW[1]))),
+				_mm_mul_ps(weight[2], _mm_set1_ps(triangle.uOverW[2]))));
+			const __m128 v = _mm_mul_ps(w, _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(weight[0], _mm_set1_ps(triangle.vOverW[0])),
+				_mm_mul_ps(weight[1], _mm_set1_ps(triangle.vOverW[1]))),
+				_mm_mul_ps(weight[2], _mm_set1_ps(triangle.vOverW[2]))));
+
+			float us[4], vs[4];
+			_mm_storeu_ps(us, u);
+			_mm_storeu_ps(vs, v);
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				if (passMask & (1 << lane))
+				{
+					colorRow[x + lane] = sample(triangle.texture, us[lane], vs[lane]);
+					++fragments;
+				}
+			}
+		}
+	}
+#else
+	for (int y = y0; y <= y1; ++y)
+	{
+		const float py = y + 0.5f;
+		float* depthRow = depth + (y - tileY) * TILE_SIZE - tileX;
+		uint32_t* colorRow = pixels_.data() + (size_t)y * width_;
+
+		for (int x = x0; x <= x1; ++x)
+		{
+			const float px = x + 0.5f;
+			float weight[3];
+			bool covered = true;
+			for (int i = 0; i < 3 && covered; ++i)
+			{
+				weight[i] = triangle.edgeA[i] * px + triangle.edgeB[i] * py + triangle.edgeC[i];
+				covered = weight[i] > 0.0f || (weight[i] == 0.0f && triangle.topLeft[i]);
+			}
+			if (!covered)
+			{
+				continue;
+			}
+
+			const float z = weight[0] * triangle.z[0] + weight[1] * triangle.z[1] + weight[2] * triangle.z[2];
+			if (!(z < depthRow[x]))
+			{
+				continue;
+			}
+			depthRow[x] = z;
+
+			const float w = 1.0f / (weight[0] * triangle.invW[0] + weight[1] * triangle.invW[1] + weight[2] * triangle.invW[2]);
+			const float u = w * (weight[0] * triangle.uOverW[0] + weight[1] * triangle.uOverW[1] + weight[2] * triangle.uOverW[2]);
+			const float v = w * (weight[0] * triangle.vOverW[0] + weight[1] * triangle.vOverW[1] + weight[2] * triangle.vOverW[2]);
+			colorRow[x] = sample(triangle.texture, u, v);
+			++fragments;
+		}
+	}
+#endif
+
+	// Each tile only ever runs on one thread
+	const int tile = (tileY / TILE_SIZE) * tilesX_ + tileX / TILE_SIZE;
+	tileFragments_[tile] += fragments;
+}
+
+uint32_t SoftwareRenderer::sample(const int texture, const float u, const float v) const
+{
+	if (textures_ == nullptr || texture < 0 || texture >= textureCount_)
+	{
+		return 0xFFFFFFFFu;
+	}
+	return sampleTexture(textures_[texture], u, v);
+}
+
+bool SoftwareRenderer::save(const std::string& filename) const
+{
+	return saveFramebuffer(filename, pixels_.data(), width_, height_);
+}
@@ -0,0 +1,138 @@
+// Header file for the multithreaded tile-based software rasterizer
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef SOFTWARE_RENDERER_H
+#define SOFTWARE_RENDERER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "scene.h"
+#include "threadPool.h"
+
+// A texture kept in client memory. Texels are RGBA8, with rows bottom-up
+// just like the data GL is given.
+struct SoftwareTexture
+{
+	int width = 0;
+	int height = 0;
+	std::vector<uint32_t> texels;
+};
+
+// Decodes a file into RGBA8. Returns 0 on success, or decodeImage()'s error.
+int loadSoftwareTexture(const char* filename, SoftwareTexture& texture);
+
+// Bilinear filtering with repeat wrapping, matching GL_LINEAR and GL_REPEAT.
+// Returns RGBA8, or white for an empty texture.
+uint32_t sampleTexture(const SoftwareTexture& texture, const float u, const float v);
+
+// Saves RGBA8 pixels (bottom row first) through FreeImage. Returns false on
+// failure.
+bool saveFramebuffer(const std::string& filename, const uint32_t* pixels, const int width, const int height);
+
+// Rasterizes scene parts on the CPU with the same conventions as the GL
+// path: gluPerspective-style projection, GL_LESS depth testing, textures
+// replacing the colour, bilinear filtering and repeat wrapping.
+//
+// Each drawParts() call runs in two phases, both spread over the pool:
+//  1. Parts are split into chunks, and each chunk is transformed, clipped
+//     against the near plane, set up and binned into screen tiles.
+//  2. Tiles are shaded in parallel. Every tile owns its own depth buffer and
+//     walks the chunks' bins in submission order, evaluating the edge
+//     functions four pixels at a time with SSE. Tiles write straight into
+//     the framebuffer since no two of them share a pixel.
+//
+// Lines (axes, wireframes, the inner camera gizmo) aren't rasterized.
+class SoftwareRenderer
+{
+public:
+	// Time spent in each phase of the last drawParts() call
+	struct Stats
+	{
+		int triangles = 0;		// After clipping and culling
+		int binEntries = 0;		// Triangle/tile pairs
+		long long fragments = 0;	// Pixels that passed the depth test
+		double setupMs = 0.0;
+		double rasterMs = 0.0;
+	};
+
+	SoftwareRenderer(const int width, const int height, ThreadPool& pool);
+
+	void setTextures(const SoftwareTexture* textures, const int count);
+
+	// Fills a rectangle of the framebuffer, like drawing a quad with depth
+	// testing off in an ortho projection
+	void fillRect(const int x, const int y, const int width, const int height, const float r, const float g, const float b);
+
+	// Draws parts into the given viewport with a freshly cleared depth buffer
+	void drawParts
+	(
+		const std::vector<ScenePart>& parts,
+		const mat4& view,
+		const mat4& projection,
+		const int viewportX,
+		const int viewportY,
+		const int viewportWidth,
+		const int viewportHeight
+	);
+
+	int width() const { return width_; }
+	int height() const { return height_; }
+	const Stats& stats() const { return stats_; }
+
+	// RGBA8 pixels, bottom row first, same as glReadPixels
+	const uint32_t* pixels() const { return pixels_.data(); }
+
+	// Saves the framebuffer through FreeImage. Returns false on failure.
+	bool save(const std::string& filename) const;
+
+	static const int TILE_SIZE = 64;
+
+private:
+	// A triangle set up for rasterizing. The edge functions are scaled so
+	// that they give barycentric weights directly.
+	struct Triangle
+	{
+		float edgeA[3], edgeB[3], edgeC[3];
+		bool topLeft[3];
+		float z[3];		// Window space depth
+		float invW[3];	// 1/w, u/w, v/w for perspective correct texturing
+		float uOverW[3];
+		float vOverW[3];
+		int minX, minY, maxX, maxY;	// Inclusive pixel bounds
+		int texture;
+	};
+
+	// Everything one chunk of parts produced in phase one
+	struct Chunk
+	{
+		std::vector<Triangle> triangles;
+		std::vector<std::vector<uint32_t>> bins; // Triangle indices per tile
+	};
+
+	void setupPart(const ScenePart& part, const mat4& viewProjection, Chunk& chunk);
+	void setupTriangle(const float clip[3][6], const int texture, Chunk& chunk);
+	void rasterTile(const int tile);
+	void rasterTriangle(const Triangle& triangle, const int x0, const int y0, const int x1, const int y1, float* depth, const int tileX, const int tileY);
+	uint32_t sample(const int texture, const float u, const float v) const;
+
+	const int width_;
+	const int height_;
+	const int tilesX_;
+	const int tilesY_;
+	ThreadPool& pool_;
+	std::vector<uint32_t> pixels_;
+	const SoftwareTexture* textures_ = nullptr;
+	int textureCount_ = 0;
+
+	// State for the drawParts() call in progress
+	int viewport_[4] = { 0 };
+	std::vector<Chunk> chunks_;
+	int activeChunks_ = 0;	// The rest are left over from bigger calls
+	std::vector<long long> tileFragments_;
+	Stats stats_;
+};
+
+#endif // SOFTWARE_RENDERER_H
@@ -0,0 +1,572 @@
+// Implementations for texture decoding, pixel conversion, and upload
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#include "texture.h"
+
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TEXTURE_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#else
+#include <cpuid.h>
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// The layout FreeImage decodes 24 and 32 bit images into
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+static const PixelLayout nativeLayout24 = PixelLayout::BGR8;
+static const PixelLayout nativeLayout32 = PixelLayout::BGRA8;
+#else
+static const PixelLayout nativeLayout24 = PixelLayout::RGB8;
+static const PixelLayout nativeLayout32 = PixelLayout::RGBA8;
+#endif
+
+int bytesPerPixel(const PixelLayout layout)
+{
+	switch (layout)
+	{
+	case PixelLayout::INDEXED8:
+		return 1;
+	case PixelLayout::BGR8:
+	case PixelLayout::RGB8:
+		return 3;
+	default:
+		return 4;
+	}
+}
+
+//
+// Conversion paths
+//
+
+enum class ConversionPath { SCALAR, SSSE3, AVX2 };
+
+static ConversionPath detectConversionPath()
+{
+#ifdef TEXTURE_SIMD
+	unsigned int regs[4] = { 0 };
+	unsigned int xcr0 = 0;
+
+#ifdef _MSC_VER
+	__cpuid((int*)regs, 1);
+#else
+	__cpuid(1, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	const bool ssse3 = (regs[2] & (1 << 9)) != 0;
+	const bool osxsave = (regs[2] & (1 << 27)) != 0;
+
+	// AVX2 also needs the OS to save the upper halves of the YMM registers
+	if (osxsave)
+	{
+#ifdef _MSC_VER
+		xcr0 = (unsigned int)_xgetbv(0);
+#else
+		unsigned int edx;
+		__asm__ volatile ("xgetbv" : "=a"(xcr0), "=d"(edx) : "c"(0));
+#endif
+	}
+
+#ifdef _MSC_VER
+	__cpuidex((int*)regs, 7, 0);
+#else
+	__cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	const bool avx2 = (regs[1] & (1 << 5)) != 0 && (xcr0 & 6) == 6;
+
+	if (avx2)
+		return ConversionPath::AVX2;
+	if (ssse3)
+		return ConversionPath::SSSE3;
+#endif
+	return ConversionPath::SCALAR;
+}
+
+static const ConversionPath bestConversionPath = detectConversionPath();
+
+// Generic per-pixel conversion. Handles every pair of layouts, and is used
+// for the tail of each row by the SIMD paths.
+static void convertRowScalar
+(
+	const uint8_t* src,
+	const PixelLayout srcLayout,
+	uint8_t* dst,
+	const PixelLayout dstLayout,
+	const int begin,
+	const int end,
+	const uint8_t* palette
+)
+{
+	const int srcBpp = bytesPerPixel(srcLayout);
+	const int dstBpp = bytesPerPixel(dstLayout);
+	const bool dstSwapped = dstLayout == PixelLayout::BGR8 || dstLayout == PixelLayout::BGRA8;
+
+	for (int x = begin; x < end; ++x)
+	{
+		const uint8_t* s = src + x * srcBpp;
+		uint8_t rgba[4];
+
+		// Unpack into RGBA
+		switch (srcLayout)
+		{
+		case PixelLayout::INDEXED8:
+			memcpy(rgba, palette + s[0] * 4, 4);
+			break;
+		case PixelLayout::BGR8:
+			rgba[0] = s[2]; rgba[1] = s[1]; rgba[2] = s[0]; rgba[3] = 255;
+			break;
+		case PixelLayout::BGRA8:
+			rgba[0] = s[2]; rgba[1] = s[1]; rgba[2] = s[0]; rgba[3] = s[3];
+			break;
+		case PixelLayout::RGB8:
+			rgba[0] = s[0]; rgba[1] = s[1]; rgba[2] = s[2]; rgba[3] = 255;
+			break;
+		case PixelLayout::RGBA8:
+			memcpy(rgba, s, 4);
+			break;
+		default:
+			// Not a layout images load as, so write transparent black
+			// rather than whatever was on the stack
+			memset(rgba, 0, 4);
+			break;
+		}
+
+		// Pack into the destination layout
+		uint8_t* d = dst + x * dstBpp;
+		d[0] = dstSwapped ? rgba[2] : rgba[0];
+		d[1] = rgba[1];
+		d[2] = dstSwapped ? rgba[0] : rgba[2];
+		if (dstBpp == 4)
+		{
+			d[3] = rgba[3];
+		}
+	}
+}
+
+#ifdef TEXTURE_SIMD
+
+// Each of these converts as much of a row as it can with full vector loads
+// and stores, and returns the first pixel it didn't get to. Loads and stores
+// never run past the end of the row.
+
+// BGR <-> RGB, 4 pixels per 16 byte load. The top 4 bytes of each store are
+// junk that gets overwritten by the next iteration.
+TARGET_SSSE3 static int swizzle24To24SSSE3(const uint8_t* src, uint8_t* dst, const int width)
+{
+	const __m128i mask = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1);
+	int x = 0;
+	for (; x + 6 <= width; x += 4)
+	{
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(src + x * 3));
+		_mm_storeu_si128((__m128i*)(dst + x * 3), _mm_shuffle_epi8(pixels, mask));
+	}
+	return x;
+}
+
+// BGRA <-> RGBA, 4 pixels per iteration
+TARGET_SSSE3 static int swizzle32To32SSSE3(const uint8_t* src, uint8_t* dst, const int width)
+{
+	const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	int x = 0;
+	for (; x + 4 <= width; x += 4)
+	{
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(src + x * 4));
+		_mm_storeu_si128((__m128i*)(dst + x * 4), _mm_shuffle_epi8(pixels, mask));
+	}
+	return x;
+}
+
+// BGR -> RGBA with opaque alpha, 4 pixels per iteration
+TARGET_SSSE3 static int expand24To32SSSE3(const uint8_t* src, uint8_t* dst, const int width)
+{
+	const __m128i mask = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+	const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+	int x = 0;
+	for (; x + 6 <= width; x += 4)
+	{
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(src + x * 3));
+		pixels = _mm_or_si128(_mm_shuffle_epi8(pixels, mask), alpha);
+		_mm_storeu_si128((__m128i*)(dst + x * 4), pixels);
+	}
+	return x;
+}
+
+// BGRA -> RGB dropping alpha, 4 pixels per iteration
+TARGET_SSSE3 static int pack32To24SSSE3(const uint8_t* src, uint8_t* dst, const int width)
+{
+	const __m128i mask = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	int x = 0;
+	for (; x + 6 <= width; x += 4)
+	{
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(src + x * 4));
+		_mm_storeu_si128((__m128i*)(dst + x * 3), _mm_shuffle_epi8(pixels, mask));
+	}
+	return x;
+}
+
+// BGRA <-> RGBA, 8 pixels per iteration. The shuffle works within each
+// 128 bit lane, which is fine since pixels never straddle lanes.
+TARGET_AVX2 static int swizzle32To32AVX2(const uint8_t* src, uint8_t* dst, const int width)
+{
+	const __m256i mask = _mm256_setr_epi8
+	(
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15
+	);
+	int x = 0;
+	for (; x + 8 <= width; x += 8)
+	{
+		__m256i pixels = _mm256_loadu_si256((const __m256i*)(src + x * 4));
+		_mm256_storeu_si256((__m256i*)(dst + x * 4), _mm256_shuffle_epi8(pixels, mask));
+	}
+	return x;
+}
+
+#endif // TEXTURE_SIMD
+
+// True if the two layouts only differ by the order of red and blue
+static bool isSwizzle(const PixelLayout a, const PixelLayout b)
+{
+	return (a == PixelLayout::BGR8 && b == PixelLayout::RGB8)
+		|| (a == PixelLayout::RGB8 && b == PixelLayout::BGR8)
+		|| (a == PixelLayout::BGRA8 && b == PixelLayout::RGBA8)
+		|| (a == PixelLayout::RGBA8 && b == PixelLayout::BGRA8);
+}
+
+static void convertRow
+(
+	const uint8_t* src,
+	const PixelLayout srcLayout,
+	uint8_t* dst,
+	const PixelLayout dstLayout,
+	const int width,
+	const uint8_t* palette,
+	const ConversionPath path
+)
+{
+	int x = 0;
+
+#ifdef TEXTURE_SIMD
+	if (path != ConversionPath::SCALAR)
+	{
+		const int srcBpp = bytesPerPixel(srcLayout);
+		const int dstBpp = bytesPerPixel(dstLayout);
+
+		if (isSwizzle(srcLayout, dstLayout) && srcBpp == 4)
+		{
+			if (path == ConversionPath::AVX2)
+				x = swizzle32To32AVX2(src, dst, width);
+			x += swizzle32To32SSSE3(src + x * 4, dst + x * 4, width - x);
+		}
+		else if (isSwizzle(srcLayout, dstLayout))
+		{
+			x = swizzle24To24SSSE3(src, dst, width);
+		}
+		else if (srcLayout == PixelLayout::BGR8 && dstLayout == PixelLayout::RGBA8)
+		{
+			x = expand24To32SSSE3(src, dst, width);
+		}
+		else if (srcLayout == PixelLayout::BGRA8 && dstLayout == PixelLayout::RGB8)
+		{
+			x = pack32To24SSSE3(src, dst, width);
+		}
+		else if (srcLayout == dstLayout)
+		{
+			memcpy(dst, src, (size_t)width * dstBpp);
+			x = width;
+		}
+	}
+#endif
+
+	if (srcLayout == dstLayout && x < width)
+	{
+		const int bpp = bytesPerPixel(srcLayout);
+		memcpy(dst + x * bpp, src + x * bpp, (size_t)(width - x) * bpp);
+		return;
+	}
+
+	convertRowScalar(src, srcLayout, dst, dstLayout, x, width, palette);
+}
+
+static void convertPixels
+(
+	const uint8_t* src,
+	const int srcPitch,
+	const PixelLayout srcLayout,
+	uint8_t* dst,
+	const int dstPitch,
+	const PixelLayout dstLayout,
+	const int width,
+	const int height,
+	const uint8_t* palette,
+	const ConversionPath path
+)
+{
+	for (int y = 0; y < height; ++y)
+	{
+		convertRow(src + (size_t)y * srcPitch, srcLayout, dst + (size_t)y * dstPitch, dstLayout, width, palette, path);
+	}
+}
+
+void convertPixels
+(
+	const uint8_t* src,
+	const int srcPitch,
+	const PixelLayout srcLayout,
+	uint8_t* dst,
+	const int dstPitch,
+	const PixelLayout dstLayout,
+	const int width,
+	const int height,
+	const uint8_t* palette
+)
+{
+	convertPixels(src, srcPitch, srcLayout, dst, dstPitch, dstLayout, width, height, palette, bestConversionPath);
+}
+
+//
+// Decoding
+//
+
+int decodeImage(const char* filename, DecodedImage& image)
+{
+	// Check image format
+	FREE_IMAGE_FORMAT format = FreeImage_GetFIFFromFilename(filename);
+	if (format == FIF_UNKNOWN)
+	{
+		std::cerr << "Unknown file format for " << filename << std::endl;
+		return 1;
+	}
+
+	// Get image bitmap
+	FIBITMAP* bitmap = FreeImage_Load(format, filename, 0);
+	if (bitmap == nullptr)
+	{
+		std::cerr << "Failed to load image " << filename << std::endl;
+		return 2;
+	}
+
+	// We only convert 8 bit palettes and 24/32 bit colour ourselves. Anything
+	// more exotic (16 bit, HDR, 1/4 bit palettes) goes through FreeImage first.
+	const unsigned int bpp = FreeImage_GetBPP(bitmap);
+	const bool standard = FreeImage_GetImageType(bitmap) == FIT_BITMAP
+		&& (bpp == 24 || bpp == 32 || (bpp == 8 && FreeImage_GetPalette(bitmap) != nullptr));
+	if (!standard)
+	{
+		FIBITMAP* temp = FreeImage_ConvertTo32Bits(bitmap);
+		FreeImage_Unload(bitmap);
+		bitmap = temp;
+		if (bitmap == nullptr)
+		{
+			std::cerr << "Failed to convert image " << filename << std::endl;
+			return 2;
+		}
+	}
+
+	image.bitmap = bitmap;
+	image.bits = FreeImage_GetBits(bitmap);
+	image.width = FreeImage_GetWidth(bitmap);
+	image.height = FreeImage_GetHeight(bitmap);
+	image.pitch = FreeImage_GetPitch(bitmap);
+
+	if (image.bits == nullptr)
+	{
+		std::cerr << "Failed to get texture data from " << filename << std::endl;
+		releaseImage(image);
+		return 3;
+	}
+
+	switch (FreeImage_GetBPP(bitmap))
+	{
+	case 8:
+	{
+		// Expand the palette to RGBA once so each pixel is a single lookup
+		const RGBQUAD* colors = FreeImage_GetPalette(bitmap);
+		const unsigned int colorCount = FreeImage_GetColorsUsed(bitmap);
+		const unsigned int alphaCount = FreeImage_GetTransparencyCount(bitmap);
+		const BYTE* alphas = FreeImage_GetTransparencyTable(bitmap);
+
+		for (unsigned int i = 0; i < 256; ++i)
+		{
+			uint8_t* entry = image.palette + i * 4;
+			if (i < colorCount)
+			{
+				entry[0] = colors[i].rgbRed;
+				entry[1] = colors[i].rgbGreen;
+				entry[2] = colors[i].rgbBlue;
+			}
+			entry[3] = (alphas != nullptr && i < alphaCount) ? alphas[i] : 255;
+		}
+
+		image.sourceLayout = PixelLayout::INDEXED8;
+		image.uploadLayout = FreeImage_IsTransparent(bitmap) ? PixelLayout::RGBA8 : PixelLayout::RGB8;
+		break;
+	}
+	case 24:
+		image.sourceLayout = nativeLayout24;
+		image.uploadLayout = PixelLayout::RGB8;
+		break;
+	default:
+		image.sourceLayout = nativeLayout32;
+		image.uploadLayout = PixelLayout::RGBA8;
+		break;
+	}
+
+	return 0;
+}
+
+void releaseImage(DecodedImage& image)
+{
+	if (image.bitmap != nullptr)
+	{
+		FreeImage_Unload(image.bitmap);
+	}
+	image.bitmap = nullptr;
+	image.bits = nullptr;
+}
+
+bool needsConversion(const DecodedImage& image)
+{
+	return image.sourceLayout != image.uploadLayout;
+}
+
+size_t uploadSize(const DecodedImage& image)
+{
+	return (size_t)image.width * image.height * bytesPerPixel(image.uploadLayout);
+}
+
+void convertImage(const DecodedImage& image, uint8_t* dst)
+{
+	const int dstPitch = image.width * bytesPerPixel(image.uploadLayout);
+	convertPixels
+	(
+		image.bits, image.pitch, image.sourceLayout,
+		dst, dstPitch, image.uploadLayout,
+		image.width, image.height, image.palette
+	);
+}
+
+//
+// Upload
+//
+
+void uploadImage(const GLuint textureID, const DecodedImage& image)
+{
+	const bool alpha = image.uploadLayout == PixelLayout::RGBA8;
+	std::vector<uint8_t> converted;
+	const uint8_t* pixels = image.bits;
+
+	if (needsConversion(image))
+	{
+		converted.resize(uploadSize(image));
+		convertImage(image, converted.data());
+		pixels = converted.data();
+
+		// Converted rows are tightly packed
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	}
+	else
+	{
+		// FreeImage pads rows to 4 bytes, which is GL's default alignment
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glTexImage2D
+	(
+		GL_TEXTURE_2D,
+		0,
+		alpha ? GL_RGBA8 : GL_RGB8,
+		image.width,
+		image.height,
+		0,
+		alpha ? GL_RGBA : GL_RGB,
+		GL_UNSIGNED_BYTE,
+		pixels
+	);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+//
+// Benchmark
+//
+
+// Runs func repeatedly for at least a quarter of a second and returns
+// the throughput in MB/s for the given number of bytes per run.
+template <typename Func>
+static double measureThroughput(const size_t bytes, Func func)
+{
+	typedef std::chrono::steady_clock Clock;
+	const Clock::time_point start = Clock::now();
+	Clock::time_point now = start;
+	int runs = 0;
+
+	do
+	{
+		func();
+		++runs;
+		now = Clock::now();
+	} while (now - start < std::chrono::milliseconds(250));
+
+	const double seconds = std::chrono::duration<double>(now - start).count();
+	return (double)bytes * runs / seconds / (1024.0 * 1024.0);
+}
+
+void benchmarkTextureConversion(char** filenames, const int count)
+{
+	static const char* pathNames[] = { "scalar", "ssse3", "avx2" };
+	std::cout << "Pixel conversion throughput (MB/s of source pixels), best path: "
+		<< pathNames[(int)bestConversionPath] << std::endl;
+
+	for (int i = 0; i < count; ++i)
+	{
+		DecodedImage image;
+		if (decodeImage(filenames[i], image) != 0)
+		{
+			continue;
+		}
+
+		const size_t sourceBytes = (size_t)image.width * image.height * bytesPerPixel(image.sourceLayout);
+		std::vector<uint8_t> buffer(uploadSize(image));
+
+		// The old path: a full FreeImage conversion to a new 24 bit bitmap
+		const double freeImageRate = measureThroughput(sourceBytes, [&]()
+		{
+			FreeImage_Unload(FreeImage_ConvertTo24Bits(image.bitmap));
+		});
+
+		const double scalarRate = measureThroughput(sourceBytes, [&]()
+		{
+			convertPixels
+			(
+				image.bits, image.pitch, image.sourceLayout,
+				buffer.data(), image.width * bytesPerPixel(image.uploadLayout), image.uploadLayout,
+				image.width, image.height, image.palette, ConversionPath::SCALAR
+			);
+		});
+
+		const double bestRate = measureThroughput(sourceBytes, [&]()
+		{
+			convertImage(image, buffer.data());
+		});
+
+		std::cout << filenames[i] << " (" << image.width << "x" << image.height << ", "
+			<< bytesPerPixel(image.sourceLayout) * 8 << " bpp -> "
+			<< bytesPerPixel(image.uploadLayout) * 8 << " bpp)" << std::endl
+			<< "\tFreeImage_ConvertTo24Bits:\t" << freeImageRate << std::endl
+			<< "\tscalar:\t\t\t\t" << scalarRate << std::endl
+			<< "\t" << pathNames[(int)bestConversionPath] << ":\t\t\t\t" << bestRate << std::endl;
+
+		releaseImage(image);
+	}
+}
@@ -0,0 +1,82 @@
+// Header file for texture decoding, pixel conversion, and upload
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <FreeImage/FreeImage.h>
+#include "main.h"
+
+// The pixel layouts the texture loader knows about. FreeImage decodes into
+// BGR(A) on little-endian machines, while we upload RGB(A) to GL.
+enum class PixelLayout
+{
+	INDEXED8,	// 8-bit palette indices (palette is always RGBA)
+	BGR8,
+	BGRA8,
+	RGB8,
+	RGBA8
+};
+
+int bytesPerPixel(const PixelLayout layout);
+
+// A decoded image along with the layout it will be uploaded in. Images
+// with any alpha (32 bit images, palettes with transparency) keep it and
+// are uploaded as RGBA8, everything else is uploaded as RGB8.
+struct DecodedImage
+{
+	FIBITMAP* bitmap = nullptr;
+	const uint8_t* bits = nullptr; // First (bottom) row of the bitmap
+	int width = 0;
+	int height = 0;
+	int pitch = 0; // Bytes between rows of bits
+	PixelLayout sourceLayout = PixelLayout::BGR8;
+	PixelLayout uploadLayout = PixelLayout::RGB8;
+	uint8_t palette[256 * 4] = { 0 }; // RGBA, only used by INDEXED8 sources
+};
+
+// Decodes the given file. Returns 0 on success, otherwise prints an error
+// and returns 1 for an unknown format, 2 if decoding failed, and 3 if the
+// bitmap has no pixel data.
+int decodeImage(const char* filename, DecodedImage& image);
+void releaseImage(DecodedImage& image);
+
+// True if the decoded bits can be handed to GL as-is
+bool needsConversion(const DecodedImage& image);
+
+// Size in bytes of the image once converted into its tightly packed
+// upload layout
+size_t uploadSize(const DecodedImage& image);
+
+// Converts the image from its source layout into its upload layout in a
+// single pass. dst must hold at least uploadSize() bytes.
+void convertImage(const DecodedImage& image, uint8_t* dst);
+
+// Converts a block of pixels between two layouts. Uses SSSE3/AVX2
+// shuffles when the CPU supports them, and a scalar loop otherwise.
+void convertPixels
+(
+	const uint8_t* src,
+	const int srcPitch,
+	const PixelLayout srcLayout,
+	uint8_t* dst,
+	const int dstPitch,
+	const PixelLayout dstLayout,
+	const int width,
+	const int height,
+	const uint8_t* palette = nullptr
+);
+
+// Uploads a decoded image into the given texture object, converting it
+// first only if the decoded layout doesn't already match.
+void uploadImage(const GLuint textureID, const DecodedImage& image);
+
+// Times our conversion against FreeImage_ConvertTo24Bits for each file
+// and prints the throughput of both in MB/s.
+void benchmarkTextureConversion(char** filenames, const int count);
+
+#endif // TEXTURE_H
@@ -0,0 +1,278 @@
+// Implementations for streaming texture uploads off the render thread
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#include "textureStreamer.h"
+#include "trace.h"
+
+TextureStreamer::TextureStreamer(const int slotCount, const size_t slotSize, const int workerCount)
+	: slotCount_(slotCount), slotSize_(slotSize), workerCount_(workerCount)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	jobAdded_.notify_all();
+	slotFreed_.notify_all();
+
+	for (std::thread& worker : workers_)
+	{
+		worker.join();
+	}
+
+	// The context may already be gone by now, so GL objects are left for
+	// the driver to clean up along with it.
+	for (Job* job : pending_)
+		delete job;
+	for (Job* job : converted_)
+		delete job;
+	for (Job* job : inFlight_)
+		delete job;
+}
+
+void TextureStreamer::initialize()
+{
+	if (glext::hasPersistentBuffers())
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		const GLsizeiptr size = (GLsizeiptr)(slotCount_ * slotSize_);
+
+		glext::genBuffers(1, &buffer_);
+		glext::bindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer_);
+		glext::bufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+		mapped_ = (uint8_t*)glext::mapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+		glext::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		if (mapped_ == nullptr)
+		{
+			std::cerr << "WARNING: couldn't map the texture streaming buffer, "
+				<< "falling back to uploads from client memory" << std::endl;
+			glext::deleteBuffers(1, &buffer_);
+			buffer_ = 0;
+		}
+	}
+	else
+	{
+		std::cerr << "WARNING: persistently mapped buffers aren't supported, "
+			<< "textures will be uploaded from client memory" << std::endl;
+	}
+
+	slotFree_.assign(slotCount_, true);
+
+	// Workers start last so they always see the mapping
+	for (int i = 0; i < workerCount_; ++i)
+	{
+		workers_.emplace_back(&TextureStreamer::workerLoop, this);
+	}
+}
+
+void TextureStreamer::request(const std::string& filename, GLuint* handle)
+{
+	Job* job = new Job;
+	job->filename = filename;
+	job->handle = handle;
+	++outstanding_;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		pending_.push_back(job);
+	}
+	jobAdded_.notify_one();
+}
+
+void TextureStreamer::update()
+{
+	TRACE_SCOPE("TextureStreamer::update");
+
+	// Nothing has been asked for, so there's nothing to take or wait on
+	if (outstanding_ == 0)
+	{
+		return;
+	}
+
+	std::deque<Job*> ready;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		ready.swap(converted_);
+	}
+
+	// Start the transfers for everything the workers finished
+	for (Job* job : ready)
+	{
+		// Decoding failed, and the worker already said why. Keep the old texture.
+		if (job->width == 0)
+		{
+			--outstanding_;
+			delete job;
+			continue;
+		}
+
+		glGenTextures(1, &job->texture);
+		glBindTexture(GL_TEXTURE_2D, job->texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		const GLenum internalFormat = job->alpha ? GL_RGBA8 : GL_RGB8;
+		const GLenum format = job->alpha ? GL_RGBA : GL_RGB;
+
+		if (job->slot >= 0)
+		{
+			// With a pixel buffer bound, the data pointer is an offset into it
+			glext::bindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer_);
+			glTexImage2D
+			(
+				GL_TEXTURE_2D, 0, internalFormat, job->width, job->height, 0,
+				format, GL_UNSIGNED_BYTE, (const void*)(job->slot * slotSize_)
+			);
+			glext::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+			job->fence = glext::fenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			inFlight_.push_back(job);
+		}
+		else
+		{
+			glTexImage2D
+			(
+				GL_TEXTURE_2D, 0, internalFormat, job->width, job->height, 0,
+				format, GL_UNSIGNED_BYTE, job->staging.data()
+			);
+			swapIn(job);
+		}
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+
+	// Make sure the fences actually reach the GPU
+	if (!ready.empty())
+	{
+		glFlush();
+	}
+
+	// Swap in anything whose transfer has completed
+	for (size_t i = 0; i < inFlight_.size();)
+	{
+		Job* job = inFlight_[i];
+		const GLenum status = glext::clientWaitSync(job->fence, 0, 0);
+
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+		{
+			glext::deleteSync(job->fence);
+			releaseSlot(job->slot);
+			swapIn(job);
+
+			inFlight_[i] = inFlight_.back();
+			inFlight_.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+void TextureStreamer::workerLoop()
+{
+	TRACE_THREAD_NAME("texture worker");
+
+	for (;;)
+	{
+		Job* job = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			jobAdded_.wait(lock, [this]() { return stopping_ || !pending_.empty(); });
+			if (stopping_)
+			{
+				return;
+			}
+			job = pending_.front();
+			pending_.pop_front();
+		}
+
+		TRACE_SCOPE("decode texture");
+		DecodedImage image;
+		if (decodeImage(job->filename.c_str(), image) == 0)
+		{
+			const size_t size = uploadSize(image);
+			uint8_t* dst = nullptr;
+
+			// Images too big for a slot are staged in client memory instead
+			if (mapped_ != nullptr && size <= slotSize_)
+			{
+				job->slot = acquireSlot();
+				if (job->slot < 0)
+				{
+					releaseImage(image);
+					delete job;
+					return;
+				}
+				dst = mapped_ + job->slot * slotSize_;
+			}
+			else
+			{
+				job->staging.resize(size);
+				dst = job->staging.data();
+			}
+
+			convertImage(image, dst);
+			job->width = image.width;
+			job->height = image.height;
+			job->alpha = image.uploadLayout == PixelLayout::RGBA8;
+			releaseImage(image);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			converted_.push_back(job);
+		}
+	}
+}
+
+int TextureStreamer::acquireSlot()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	for (;;)
+	{
+		if (stopping_)
+		{
+			return -1;
+		}
+
+		for (int i = 0; i < slotCount_; ++i)
+		{
+			if (slotFree_[i])
+			{
+				slotFree_[i] = false;
+				return i;
+			}
+		}
+
+		slotFreed_.wait(lock);
+	}
+}
+
+void TextureStreamer::releaseSlot(const int slot)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		slotFree_[slot] = true;
+	}
+	slotFreed_.notify_one();
+}
+
+void TextureStreamer::swapIn(Job* job)
+{
+	const GLuint old = *job->handle;
+	*job->handle = job->texture;
+	if (old != 0)
+	{
+		glDeleteTextures(1, &old);
+	}
+
+	--outstanding_;
+	delete job;
+}
@@ -0,0 +1,84 @@
+// Header file for streaming texture uploads off the render thread
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "glExtensions.h"
+#include "texture.h"
+
+// Loads textures while the scene keeps rendering. Worker threads decode each
+// file and convert it straight into a slot of a persistently mapped pixel
+// buffer object. The render thread then kicks off the copy into a fresh
+// texture object, fences it, and only swaps the caller's handle once the
+// fence has signalled and the data is resident.
+//
+// If the context can't do persistent mapping, the workers convert into
+// client memory instead and the upload itself happens on the render thread.
+class TextureStreamer
+{
+public:
+	TextureStreamer(const int slotCount = 4, const size_t slotSize = 8 << 20, const int workerCount = 2);
+	~TextureStreamer();
+
+	// Sets up the pixel buffers. Must be called with a current context.
+	void initialize();
+
+	// Queues a file to be loaded into *handle. The old texture in *handle
+	// (if any) is deleted once the new one replaces it.
+	void request(const std::string& filename, GLuint* handle);
+
+	// Issues finished transfers and swaps in textures whose fences have
+	// signalled. Call once per frame from the render thread.
+	void update();
+
+	// True while any request hasn't been swapped in yet
+	bool busy() const { return outstanding_ > 0; }
+
+private:
+	struct Job
+	{
+		std::string filename;
+		GLuint* handle = nullptr;
+		int slot = -1;				// Pixel buffer slot, or -1 if staged in client memory
+		std::vector<uint8_t> staging;
+		int width = 0;
+		int height = 0;
+		bool alpha = false;
+		GLuint texture = 0;
+		GLsync fence = nullptr;
+	};
+
+	void workerLoop();
+	int acquireSlot(); // Blocks until a slot is free, or returns -1 on shutdown
+	void releaseSlot(const int slot);
+	void swapIn(Job* job);
+
+	const int slotCount_;
+	const size_t slotSize_;
+	const int workerCount_;
+
+	GLuint buffer_ = 0;
+	uint8_t* mapped_ = nullptr;	// Persistently mapped, slotCount_ * slotSize_ bytes
+	std::vector<bool> slotFree_;
+
+	std::vector<std::thread> workers_;
+	std::mutex mutex_;
+	std::condition_variable jobAdded_;
+	std::condition_variable slotFreed_;
+	std::deque<Job*> pending_;		// Waiting for a worker
+	std::deque<Job*> converted_;	// Waiting for the render thread to start the transfer
+	std::vector<Job*> inFlight_;	// Transfer issued, waiting on the fence
+	int outstanding_ = 0;
+	bool stopping_ = false;
+};
+
+#endif // TEXTURE_STREAMER_H
@@ -0,0 +1,105 @@
+// Implementations for the worker thread pool
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#include "threadPool.h"
+
+ThreadPool::ThreadPool(int threadCount) : next_(0)
+{
+	if (threadCount <= 0)
+	{
+		threadCount = (int)std::thread::hardware_concurrency();
+		if (threadCount <= 0)
+			threadCount = 1;
+	}
+
+	for (int i = 1; i < threadCount; ++i)
+	{
+		workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	started_.notify_all();
+
+	for (std::thread& worker : workers_)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::parallelFor(const int count, const std::function<void(int index, int thread)>& job)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	// Not worth waking anyone up for
+	if (workers_.empty() || count == 1)
+	{
+		for (int i = 0; i < count; ++i)
+			job(i, 0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		job_ = &job;
+		count_ = count;
+		next_.store(0);
+		busyWorkers_ = (int)workers_.size();
+		++generation_;
+	}
+	started_.notify_all();
+
+	runJobs(0);
+
+	// Wait for the workers to run out of jobs too
+	std::unique_lock<std::mutex> lock(mutex_);
+	finished_.wait(lock, [this]() { return busyWorkers_ == 0; });
+	job_ = nullptr;
+}
+
+void ThreadPool::workerLoop(const int thread)
+{
+	unsigned int seen = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			started_.wait(lock, [&]() { return stopping_ || generation_ != seen; });
+			if (stopping_)
+			{
+				return;
+			}
+			seen = generation_;
+		}
+
+		runJobs(thread);
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			last = --busyWorkers_ == 0;
+		}
+		if (last)
+		{
+			finished_.notify_one();
+		}
+	}
+}
+
+void ThreadPool::runJobs(const int thread)
+{
+	for (int index = next_.fetch_add(1); index < count_; index = next_.fetch_add(1))
+	{
+		(*job_)(index, thread);
+	}
+}
@@ -0,0 +1,54 @@
+// Header file for a simple pool of worker threads
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that split up indexed jobs between them.
+// The thread calling parallelFor() pitches in as well, so a pool of size 1
+// has no workers and runs everything inline.
+class ThreadPool
+{
+public:
+	// A threadCount of 0 uses one thread per core
+	explicit ThreadPool(int threadCount = 0);
+	~ThreadPool();
+
+	// Number of threads that run jobs, including the caller
+	int size() const { return (int)workers_.size() + 1; }
+
+	// Calls job(index, thread) for every index in [0, count) and returns
+	// once they've all finished. thread is in [0, size()) and is unique
+	// among the jobs running at the same time, so it can pick per-thread
+	// scratch space. The calling thread is always thread 0. Jobs are handed
+	// out one index at a time.
+	void parallelFor(const int count, const std::function<void(int index, int thread)>& job);
+
+private:
+	void workerLoop(const int thread);
+	void runJobs(const int thread);
+
+	std::vector<std::thread> workers_;
+	std::mutex mutex_;
+	std::condition_variable started_;
+	std::condition_variable finished_;
+
+	// The batch currently being run
+	const std::function<void(int, int)>* job_ = nullptr;
+	int count_ = 0;
+	std::atomic<int> next_;
+	int busyWorkers_ = 0;
+	unsigned int generation_ = 0;
+	bool stopping_ = false;
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,79 @@
+// Header file for scoped timers that produce Chrome trace-event JSON
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <string>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define TRACE_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_RDTSC
+#else
+#include <chrono>
+#endif
+
+// Tracing is compiled out unless ENABLE_TRACING is defined (the Debug
+// configurations define it). When it's on, TRACE_SCOPE("name") times the
+// rest of the enclosing scope, and TRACE_THREAD_NAME("name") labels the
+// calling thread. Span names have to be string literals, since only the
+// pointer is kept.
+#ifdef ENABLE_TRACING
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) setTraceThreadName(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+// Raw timestamp in unspecified ticks. writeTrace() converts them to time.
+inline uint64_t traceTimestamp()
+{
+#ifdef TRACE_RDTSC
+	return __rdtsc();
+#else
+	return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// Appends a span to the calling thread's ring buffer. Only the owning thread
+// ever writes to a ring, so this takes no locks. Once a ring is full the
+// oldest spans are overwritten.
+void recordSpan(const char* name, const uint64_t start, const uint64_t end);
+
+// Names the calling thread in the trace
+void setTraceThreadName(const char* name);
+
+class TraceScope
+{
+public:
+	explicit TraceScope(const char* name) : name_(name), start_(traceTimestamp()) {}
+	~TraceScope() { recordSpan(name_, start_, traceTimestamp()); }
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+	const char* name_;
+	const uint64_t start_;
+};
+
+// Writes every thread's spans as trace-event JSON, which chrome://tracing
+// and ui.perfetto.dev both open. Threads can keep recording while this
+// runs. Returns false if the file can't be written.
+bool writeTrace(const std::string& path);
+
+// Records spans in a tight loop on a throwaway thread and returns the
+// average cost of one, in nanoseconds. This works whether or not
+// ENABLE_TRACING is defined, so the cost is known before turning it on.
+double measureTraceOverhead();
+
+#endif // TRACE_H
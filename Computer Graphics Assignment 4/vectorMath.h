@@ -0,0 +1,612 @@
+// Header file for the vector, matrix and quaternion math
+// Computer Graphics Assignment 4
+// By Colby Reinhart
+// 12-1-2022
+
+#ifndef VECTOR_MATH_H
+#define VECTOR_MATH_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Everything here is inline, so the compiler can keep values in registers
+// across calls from any file. SSE is used whenever the compiler targets it,
+// which every x64 build does. Defining DISABLE_SIMD swaps in plain loops
+// instead, which give the same results bit for bit: each lane does the same
+// operations in the same order either way.
+#if !defined(DISABLE_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define VECTOR_MATH_SSE
+#include <xmmintrin.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VECTOR_MATH_SSE2
+#include <emmintrin.h>
+#endif
+#endif
+
+// Four floats operated on at once. The types below are built on these and
+// never touch the intrinsics directly.
+namespace simd
+{
+#ifdef VECTOR_MATH_SSE
+	typedef __m128 Lanes;
+
+	// The types are 16-byte aligned, but a 32-bit build's new only promises
+	// 8, so loads and stores don't assume it. They cost the same as aligned
+	// ones when the data does happen to be aligned.
+	inline Lanes load(const float* from) { return _mm_loadu_ps(from); }
+	inline void store(float* to, const Lanes v) { _mm_storeu_ps(to, v); }
+	inline Lanes set(const float x, const float y, const float z, const float w) { return _mm_setr_ps(x, y, z, w); }
+	inline Lanes splat(const float f) { return _mm_set1_ps(f); }
+	inline float first(const Lanes v) { return _mm_cvtss_f32(v); }
+
+	// Four unsigned 16-bit integers, converted to float
+	inline Lanes loadShorts(const uint16_t* from)
+	{
+#ifdef VECTOR_MATH_SSE2
+		const __m128i shorts = _mm_loadl_epi64((const __m128i*)from);
+		return _mm_cvtepi32_ps(_mm_unpacklo_epi16(shorts, _mm_setzero_si128()));
+#else
+		return _mm_setr_ps(from[0], from[1], from[2], from[3]);
+#endif
+	}
+
+	inline Lanes add(const Lanes a, const Lanes b) { return _mm_add_ps(a, b); }
+	inline Lanes sub(const Lanes a, const Lanes b) { return _mm_sub_ps(a, b); }
+	inline Lanes mul(const Lanes a, const Lanes b) { return _mm_mul_ps(a, b); }
+	inline Lanes div(const Lanes a, const Lanes b) { return _mm_div_ps(a, b); }
+	inline Lanes sqrt(const Lanes a) { return _mm_sqrt_ps(a); }
+
+	// a * b + c. SSE has no fused multiply-add, so this rounds twice.
+	inline Lanes multiplyAdd(const Lanes a, const Lanes b, const Lanes c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+
+	inline Lanes min(const Lanes a, const Lanes b) { return _mm_min_ps(a, b); }
+	inline Lanes max(const Lanes a, const Lanes b) { return _mm_max_ps(a, b); }
+
+	// All bits set in the lanes where a < b, and none in the others
+	inline Lanes lessThan(const Lanes a, const Lanes b) { return _mm_cmplt_ps(a, b); }
+
+	// Lanes of a where mask is set, and of b where it isn't
+	inline Lanes select(const Lanes mask, const Lanes a, const Lanes b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+	// Lane i of the result is lane I of a, and so on
+	template <int X, int Y, int Z, int W>
+	inline Lanes shuffle(const Lanes a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(W, Z, Y, X)); }
+#else
+	struct Lanes
+	{
+		float f[4];
+	};
+
+	inline Lanes load(const float* from)
+	{
+		Lanes v = { { from[0], from[1], from[2], from[3] } };
+		return v;
+	}
+
+	inline void store(float* to, const Lanes v)
+	{
+		for (int i = 0; i < 4; ++i)
+			to[i] = v.f[i];
+	}
+
+	inline Lanes set(const float x, const float y, const float z, const float w)
+	{
+		Lanes v = { { x, y, z, w } };
+		return v;
+	}
+
+	inline Lanes splat(const float f) { return set(f, f, f, f); }
+	inline float first(const Lanes v) { return v.f[0]; }
+	inline Lanes loadShorts(const uint16_t* from) { return set(from[0], from[1], from[2], from[3]); }
+
+	inline Lanes add(const Lanes a, const Lanes b) { return set(a.f[0] + b.f[0], a.f[1] + b.f[1], a.f[2] + b.f[2], a.f[3] + b.f[3]); }
+	inline Lanes sub(const Lanes a, const Lanes b) { return set(a.f[0] - b.f[0], a.f[1] - b.f[1], a.f[2] - b.f[2], a.f[3] - b.f[3]); }
+	inline Lanes mul(const Lanes a, const Lanes b) { return set(a.f[0] * b.f[0], a.f[1] * b.f[1], a.f[2] * b.f[2], a.f[3] * b.f[3]); }
+	inline Lanes div(const Lanes a, const Lanes b) { return set(a.f[0] / b.f[0], a.f[1] / b.f[1], a.f[2] / b.f[2], a.f[3] / b.f[3]); }
+	inline Lanes sqrt(const Lanes a) { return set(sqrtf(a.f[0]), sqrtf(a.f[1]), sqrtf(a.f[2]), sqrtf(a.f[3])); }
+	inline Lanes multiplyAdd(const Lanes a, const Lanes b, const Lanes c) { return add(mul(a, b), c); }
+
+	// Same as SSE's, which give b when they can't be compared
+	inline Lanes min(const Lanes a, const Lanes b) { return set(a.f[0] < b.f[0] ? a.f[0] : b.f[0], a.f[1] < b.f[1] ? a.f[1] : b.f[1], a.f[2] < b.f[2] ? a.f[2] : b.f[2], a.f[3] < b.f[3] ? a.f[3] : b.f[3]); }
+	inline Lanes max(const Lanes a, const Lanes b) { return set(a.f[0] > b.f[0] ? a.f[0] : b.f[0], a.f[1] > b.f[1] ? a.f[1] : b.f[1], a.f[2] > b.f[2] ? a.f[2] : b.f[2], a.f[3] > b.f[3] ? a.f[3] : b.f[3]); }
+
+	inline Lanes lessThan(const Lanes a, const Lanes b)
+	{
+		Lanes mask;
+		for (int i = 0; i < 4; ++i)
+		{
+			const uint32_t bits = a.f[i] < b.f[i] ? 0xffffffffu : 0u;
+			memcpy(&mask.f[i], &bits, sizeof(bits));
+		}
+		return mask;
+	}
+
+	inline Lanes select(const Lanes mask, const Lanes a, const Lanes b)
+	{
+		Lanes result;
+		for (int i = 0; i < 4; ++i)
+		{
+			uint32_t m, x, y;
+			memcpy(&m, &mask.f[i], sizeof(m));
+			memcpy(&x, &a.f[i], sizeof(x));
+			memcpy(&y, &b.f[i], sizeof(y));
+			const uint32_t bits = (m & x) | (~m & y);
+			memcpy(&result.f[i], &bits, sizeof(bits));
+		}
+		return result;
+	}
+
+	template <int X, int Y, int Z, int W>
+	inline Lanes shuffle(const Lanes a) { return set(a.f[X], a.f[Y], a.f[Z], a.f[W]); }
+#endif
+
+	// Every lane set to lane I of a
+	template <int I>
+	inline Lanes broadcast(const Lanes a) { return shuffle<I, I, I, I>(a); }
+
+	// x * x + y * y + z * z of a and b in every lane, ignoring the fourth,
+	// added up in the same order as writing it out would
+	inline Lanes dot3(const Lanes a, const Lanes b)
+	{
+		const Lanes products = mul(a, b);
+		const Lanes sum = add(add(broadcast<0>(products), broadcast<1>(products)), broadcast<2>(products));
+		return sum;
+	}
+
+	// The cross product of the first three lanes. The fourth is a's times
+	// b's minus itself, which is zero for finite values.
+	inline Lanes cross3(const Lanes a, const Lanes b)
+	{
+		return sub
+		(
+			mul(shuffle<1, 2, 0, 3>(a), shuffle<2, 0, 1, 3>(b)),
+			mul(shuffle<2, 0, 1, 3>(a), shuffle<1, 2, 0, 3>(b))
+		);
+	}
+}
+
+// A position or direction. The fourth float is padding so that a float3
+// fits in one register; it isn't part of the value and may hold anything.
+struct alignas(16) float3
+{
+	float x, y, z;
+	float pad;
+
+	float3() : x(0), y(0), z(0), pad(0) {}
+	float3(const float x, const float y, const float z) : x(x), y(y), z(z), pad(0) {}
+
+	simd::Lanes lanes() const { return simd::load(&x); }
+	static float3 fromLanes(const simd::Lanes v)
+	{
+		float3 result;
+		simd::store(&result.x, v);
+		return result;
+	}
+
+	float3& operator+=(const float3& rhs) { simd::store(&x, simd::add(lanes(), rhs.lanes())); return *this; }
+	float3& operator-=(const float3& rhs) { simd::store(&x, simd::sub(lanes(), rhs.lanes())); return *this; }
+	float3& operator*=(const float scalar) { simd::store(&x, simd::mul(lanes(), simd::splat(scalar))); return *this; }
+	float3& operator/=(const float scalar) { simd::store(&x, simd::div(lanes(), simd::splat(scalar))); return *this; }
+
+	float lengthSquared() const { return simd::first(simd::dot3(lanes(), lanes())); }
+	float length() const { return sqrtf(lengthSquared()); }
+
+	// Leaves a zero length vector as it is
+	void normalize()
+	{
+		const simd::Lanes v = lanes();
+		const simd::Lanes length = simd::sqrt(simd::dot3(v, v));
+		if (simd::first(length) > 0.0f)
+		{
+			simd::store(&x, simd::div(v, length));
+		}
+	}
+};
+
+// Component-wise, so * and / between two float3s scale each axis
+inline float3 operator+(const float3& a, const float3& b) { return float3::fromLanes(simd::add(a.lanes(), b.lanes())); }
+inline float3 operator-(const float3& a, const float3& b) { return float3::fromLanes(simd::sub(a.lanes(), b.lanes())); }
+inline float3 operator*(const float3& a, const float3& b) { return float3::fromLanes(simd::mul(a.lanes(), b.lanes())); }
+inline float3 operator/(const float3& a, const float3& b) { return float3::fromLanes(simd::div(a.lanes(), b.lanes())); }
+inline float3 operator*(const float3& a, const float scalar) { return float3::fromLanes(simd::mul(a.lanes(), simd::splat(scalar))); }
+inline float3 operator*(const float scalar, const float3& a) { return a * scalar; }
+inline float3 operator/(const float3& a, const float scalar) { return float3::fromLanes(simd::div(a.lanes(), simd::splat(scalar))); }
+inline float3 operator-(const float3& a) { return float3::fromLanes(simd::sub(simd::splat(0.0f), a.lanes())); }
+
+inline float dot(const float3& a, const float3& b) { return simd::first(simd::dot3(a.lanes(), b.lanes())); }
+inline float3 cross(const float3& a, const float3& b) { return float3::fromLanes(simd::cross3(a.lanes(), b.lanes())); }
+
+// A homogeneous position, or anything else that's four floats
+struct alignas(16) float4
+{
+	float x, y, z, w;
+
+	float4() : x(0), y(0), z(0), w(0) {}
+	float4(const float x, const float y, const float z, const float w) : x(x), y(y), z(z), w(w) {}
+	float4(const float3& xyz, const float w) : x(xyz.x), y(xyz.y), z(xyz.z), w(w) {}
+
+	simd::Lanes lanes() const { return simd::load(&x); }
+	static float4 fromLanes(const simd::Lanes v)
+	{
+		float4 result;
+		simd::store(&result.x, v);
+		return result;
+	}
+
+	float3 xyz() const { return float3(x, y, z); }
+};
+
+inline float4 operator+(const float4& a, const float4& b) { return float4::fromLanes(simd::add(a.lanes(), b.lanes())); }
+inline float4 operator-(const float4& a, const float4& b) { return float4::fromLanes(simd::sub(a.lanes(), b.lanes())); }
+inline float4 operator*(const float4& a, const float scalar) { return float4::fromLanes(simd::mul(a.lanes(), simd::splat(scalar))); }
+
+static const float DEGREES_TO_RADIANS = 3.14159265358979f / 180.0f;
+
+// A 4x4 matrix stored column-major, the same as glLoadMatrixf expects.
+// The builders below match the GL/GLU calls they're named after, so a
+// chain of them gives the same result as the matrix stack would.
+struct alignas(16) mat4
+{
+	float m[16];
+
+	simd::Lanes column(const int i) const { return simd::load(m + i * 4); }
+
+	static mat4 identity()
+	{
+		mat4 result = { { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 } };
+		return result;
+	}
+
+	static mat4 translation(const float x, const float y, const float z)
+	{
+		mat4 result = identity();
+		result.m[12] = x;
+		result.m[13] = y;
+		result.m[14] = z;
+		return result;
+	}
+
+	// Same formula as the glRotate man page
+	static mat4 rotation(const float degrees, const float x, const float y, const float z)
+	{
+		mat4 result = identity();
+
+		const float length = sqrtf(x * x + y * y + z * z);
+		if (length == 0.0f)
+		{
+			return result;
+		}
+		const float ax = x / length;
+		const float ay = y / length;
+		const float az = z / length;
+		const float c = cosf(degrees * DEGREES_TO_RADIANS);
+		const float s = sinf(degrees * DEGREES_TO_RADIANS);
+		const float t = 1.0f - c;
+
+		result.m[0] = ax * ax * t + c;
+		result.m[1] = ay * ax * t + az * s;
+		result.m[2] = ax * az * t - ay * s;
+		result.m[4] = ax * ay * t - az * s;
+		result.m[5] = ay * ay * t + c;
+		result.m[6] = ay * az * t + ax * s;
+		result.m[8] = ax * az * t + ay * s;
+		result.m[9] = ay * az * t - ax * s;
+		result.m[10] = az * az * t + c;
+		return result;
+	}
+
+	static mat4 scaling(const float x, const float y, const float z)
+	{
+		mat4 result = identity();
+		result.m[0] = x;
+		result.m[5] = y;
+		result.m[10] = z;
+		return result;
+	}
+
+	// Same as gluPerspective
+	static mat4 perspective(const float fovy, const float aspect, const float zNear, const float zFar)
+	{
+		const float f = 1.0f / tanf(fovy * DEGREES_TO_RADIANS / 2.0f);
+
+		mat4 result = { { 0 } };
+		result.m[0] = f / aspect;
+		result.m[5] = f;
+		result.m[10] = (zFar + zNear) / (zNear - zFar);
+		result.m[11] = -1.0f;
+		result.m[14] = 2.0f * zFar * zNear / (zNear - zFar);
+		return result;
+	}
+
+	// Same as gluLookAt
+	static mat4 lookAt
+	(
+		const float eyeX, const float eyeY, const float eyeZ,
+		const float centerX, const float centerY, const float centerZ,
+		const float upX, const float upY, const float upZ
+	)
+	{
+		// Forward
+		float fx = centerX - eyeX, fy = centerY - eyeY, fz = centerZ - eyeZ;
+		float length = sqrtf(fx * fx + fy * fy + fz * fz);
+		fx /= length; fy /= length; fz /= length;
+
+		// Side = forward x up
+		float sx = fy * upZ - fz * upY, sy = fz * upX - fx * upZ, sz = fx * upY - fy * upX;
+		length = sqrtf(sx * sx + sy * sy + sz * sz);
+		sx /= length; sy /= length; sz /= length;
+
+		// Recomputed up = side x forward
+		const float ux = sy * fz - sz * fy, uy = sz * fx - sx * fz, uz = sx * fy - sy * fx;
+
+		mat4 result = identity();
+		result.m[0] = sx; result.m[4] = sy; result.m[8] = sz;
+		result.m[1] = ux; result.m[5] = uy; result.m[9] = uz;
+		result.m[2] = -fx; result.m[6] = -fy; result.m[10] = -fz;
+		return result.translate(-eyeX, -eyeY, -eyeZ);
+	}
+
+	// Each column of the result is this matrix times the column of rhs
+	mat4 operator*(const mat4& rhs) const
+	{
+		const simd::Lanes c0 = column(0), c1 = column(1), c2 = column(2), c3 = column(3);
+		mat4 result;
+		for (int col = 0; col < 4; ++col)
+		{
+			const simd::Lanes r = rhs.column(col);
+			simd::store(result.m + col * 4, simd::add(simd::add(simd::add(
+				simd::mul(c0, simd::broadcast<0>(r)),
+				simd::mul(c1, simd::broadcast<1>(r))),
+				simd::mul(c2, simd::broadcast<2>(r))),
+				simd::mul(c3, simd::broadcast<3>(r))));
+		}
+		return result;
+	}
+
+	float4 operator*(const float4& v) const
+	{
+		const simd::Lanes lanes = v.lanes();
+		return float4::fromLanes(simd::add(simd::add(simd::add(
+			simd::mul(column(0), simd::broadcast<0>(lanes)),
+			simd::mul(column(1), simd::broadcast<1>(lanes))),
+			simd::mul(column(2), simd::broadcast<2>(lanes))),
+			simd::mul(column(3), simd::broadcast<3>(lanes))));
+	}
+
+	// As a position (w = 1), and as a direction (w = 0), which skips the
+	// translation
+	float3 transformPoint(const float3& p) const
+	{
+		const simd::Lanes lanes = p.lanes();
+		return float3::fromLanes(simd::add(simd::add(simd::add(
+			simd::mul(column(0), simd::broadcast<0>(lanes)),
+			simd::mul(column(1), simd::broadcast<1>(lanes))),
+			simd::mul(column(2), simd::broadcast<2>(lanes))),
+			column(3)));
+	}
+
+	float3 transformVector(const float3& v) const
+	{
+		const simd::Lanes lanes = v.lanes();
+		return float3::fromLanes(simd::add(simd::add(
+			simd::mul(column(0), simd::broadcast<0>(lanes)),
+			simd::mul(column(1), simd::broadcast<1>(lanes))),
+			simd::mul(column(2), simd::broadcast<2>(lanes))));
+	}
+
+	// Transforms (x, y, z, w) into out[4]
+	void transform(const float x, const float y, const float z, const float w, float* out) const
+	{
+		simd::store(out, (*this * float4(x, y, z, w)).lanes());
+	}
+
+	// Post-multiplies, like the glTranslatef/glRotatef/glScalef they mirror
+	mat4& translate(const float x, const float y, const float z)
+	{
+		// Only the last column changes
+		const simd::Lanes offset = simd::add(simd::add(
+			simd::mul(column(0), simd::splat(x)),
+			simd::mul(column(1), simd::splat(y))),
+			simd::mul(column(2), simd::splat(z)));
+		simd::store(m + 12, simd::add(column(3), offset));
+		return *this;
+	}
+
+	mat4& rotate(const float degrees, const float x, const float y, const float z)
+	{
+		*this = *this * rotation(degrees, x, y, z);
+		return *this;
+	}
+
+	mat4& scale(const float x, const float y, const float z)
+	{
+		simd::store(m, simd::mul(column(0), simd::splat(x)));
+		simd::store(m + 4, simd::mul(column(1), simd::splat(y)));
+		simd::store(m + 8, simd::mul(column(2), simd::splat(z)));
+		return *this;
+	}
+
+	// The inverse of a matrix whose bottom row is (0, 0, 0, 1), as every
+	// model matrix's is. The rows of the inverse's upper 3x3 are cross
+	// products of the columns over the determinant. A singular matrix gives
+	// the identity.
+	mat4 affineInverse() const
+	{
+		const float3 a(m[0], m[1], m[2]);
+		const float3 b(m[4], m[5], m[6]);
+		const float3 c(m[8], m[9], m[10]);
+		const float3 t(m[12], m[13], m[14]);
+
+		const float determinant = dot(a, cross(b, c));
+		if (determinant == 0.0f)
+		{
+			return identity();
+		}
+		const float3 row0 = cross(b, c) / determinant;
+		const float3 row1 = cross(c, a) / determinant;
+		const float3 row2 = cross(a, b) / determinant;
+
+		mat4 result =
+		{ {
+			row0.x, row1.x, row2.x, 0,
+			row0.y, row1.y, row2.y, 0,
+			row0.z, row1.z, row2.z, 0,
+			-dot(row0, t), -dot(row1, t), -dot(row2, t), 1
+		} };
+		return result;
+	}
+};
+
+// A rotation, as a unit quaternion. w is the real part.
+struct alignas(16) quat
+{
+	float x, y, z, w;
+
+	quat() : x(0), y(0), z(0), w(1) {}
+	quat(const float x, const float y, const float z, const float w) : x(x), y(y), z(z), w(w) {}
+
+	simd::Lanes lanes() const { return simd::load(&x); }
+	static quat fromLanes(const simd::Lanes v)
+	{
+		quat result;
+		simd::store(&result.x, v);
+		return result;
+	}
+
+	// Turns degrees around axis, which doesn't have to be unit length
+	static quat axisAngle(const float degrees, const float3& axis)
+	{
+		const float length = axis.length();
+		if (length == 0.0f)
+		{
+			return quat();
+		}
+		const float half = degrees * DEGREES_TO_RADIANS * 0.5f;
+		const float s = sinf(half) / length;
+		return quat(axis.x * s, axis.y * s, axis.z * s, cosf(half));
+	}
+
+	// Turns about x, then y, then z, the same as mat4's rotate() called
+	// for x, y and z in that order
+	static quat fromEuler(const float3& degrees)
+	{
+		return axisAngle(degrees.x, float3(1, 0, 0)) * axisAngle(degrees.y, float3(0, 1, 0)) * axisAngle(degrees.z, float3(0, 0, 1));
+	}
+
+	// Rotates by rhs first, then by this
+	quat operator*(const quat& rhs) const
+	{
+		const simd::Lanes a = lanes();
+		const simd::Lanes b = rhs.lanes();
+		const simd::Lanes result = simd::add(simd::add(simd::add(
+			simd::mul(simd::broadcast<3>(a), b),
+			simd::mul(simd::broadcast<0>(a), simd::mul(simd::shuffle<3, 2, 1, 0>(b), simd::set(1, -1, 1, -1)))),
+			simd::mul(simd::broadcast<1>(a), simd::mul(simd::shuffle<2, 3, 0, 1>(b), simd::set(1, 1, -1, -1)))),
+			simd::mul(simd::broadcast<2>(a), simd::mul(simd::shuffle<1, 0, 3, 2>(b), simd::set(-1, 1, 1, -1))));
+		return fromLanes(result);
+	}
+
+	quat conjugate() const { return quat(-x, -y, -z, w); }
+
+	float3 rotate(const float3& v) const
+	{
+		// v + 2w(q x v) + 2q x (q x v), with q the vector part
+		const simd::Lanes q = simd::set(x, y, z, 0.0f);
+		const simd::Lanes t = simd::mul(simd::cross3(q, v.lanes()), simd::splat(2.0f));
+		return float3::fromLanes(simd::add(simd::add(v.lanes(), simd::mul(t, simd::splat(w))), simd::cross3(q, t)));
+	}
+
+	// Leaves a zero quaternion as it is
+	void normalize()
+	{
+		const float length = sqrtf(x * x + y * y + z * z + w * w);
+		if (length > 0.0f)
+		{
+			simd::store(&x, simd::div(lanes(), simd::splat(length)));
+		}
+	}
+
+	mat4 matrix() const
+	{
+		mat4 result = mat4::identity();
+		result.m[0] = 1.0f - 2.0f * (y * y + z * z);
+		result.m[1] = 2.0f * (x * y + z * w);
+		result.m[2] = 2.0f * (x * z - y * w);
+		result.m[4] = 2.0f * (x * y - z * w);
+		result.m[5] = 1.0f - 2.0f * (x * x + z * z);
+		result.m[6] = 2.0f * (y * z + x * w);
+		result.m[8] = 2.0f * (x * z + y * w);
+		result.m[9] = 2.0f * (y * z - x * w);
+		result.m[10] = 1.0f - 2.0f * (x * x + y * y);
+		return result;
+	}
+};
+
+inline float dot(const quat& a, const quat& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+
+// Normalized linear interpolation, t of the way from a to b along the
+// shorter way round. Not quite constant speed, but close for the small
+// steps between keyframes, and much cheaper than slerp.
+inline quat nlerp(const quat& a, const quat& b, const float t)
+{
+	const float bWeight = dot(a, b) < 0.0f ? -t : t;
+	quat result = quat::fromLanes(simd::add(simd::mul(a.lanes(), simd::splat(1.0f - t)), simd::mul(b.lanes(), simd::splat(bWeight))));
+	result.normalize();
+	return result;
+}
+
+// Spherical linear interpolation: constant speed, the shorter way round
+inline quat slerp(const quat& a, const quat& b, const float t)
+{
+	float cosine = dot(a, b);
+	const float sign = cosine < 0.0f ? -1.0f : 1.0f;
+	cosine *= sign;
+
+	// Nearly the same rotation, where sin() would lose all its precision
+	if (cosine > 0.9995f)
+	{
+		return nlerp(a, b, t);
+	}
+
+	const float angle = acosf(cosine);
+	const float aWeight = sinf((1.0f - t) * angle) / sinf(angle);
+	const float bWeight = sign * sinf(t * angle) / sinf(angle);
+	return quat::fromLanes(simd::add(simd::mul(a.lanes(), simd::splat(aWeight)), simd::mul(b.lanes(), simd::splat(bWeight))));
+}
+
+//
+// Batch operations
+//
+
+// Transforms count positions by m. The columns stay in registers for the
+// whole loop, so this is cheaper than calling transformPoint on each. in and
+// out may be the same array.
+inline void transformPoints(const mat4& m, const float3* in, float3* out, const size_t count)
+{
+	const simd::Lanes c0 = m.column(0), c1 = m.column(1), c2 = m.column(2), c3 = m.column(3);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const simd::Lanes p = in[i].lanes();
+		simd::store(&out[i].x, simd::add(simd::add(simd::add(
+			simd::mul(c0, simd::broadcast<0>(p)),
+			simd::mul(c1, simd::broadcast<1>(p))),
+			simd::mul(c2, simd::broadcast<2>(p))),
+			c3));
+	}
+}
+
+// Normalizes count vectors in place, leaving zero length ones as they are
+inline void normalize(float3* vectors, const size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		vectors[i].normalize();
+	}
+}
+
+#endif // VECTOR_MATH_H